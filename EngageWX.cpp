@@ -85,9 +85,11 @@
 // 3. Ctrl-Right and Ctrl-left serves as a goto and back as described earlier.
 //
 // 4. Pressing and releasing Ctrl pop's up a small menu of selectable commands.
-// Only the last of these, "adjust fontsize", is implemented.
-// On selecting it using up-down arrow and pressing enter
+// Of these, "adjust fontsize" and "latency stats" are implemented.
+// On selecting "adjust fontsize" using up-down arrow and pressing enter
 // fontsize can be adjusted using the arrow keys.
+// "latency stats" shows how long key presses take to reach the screen,
+// these stats are also written to Latency.txt when the app exits.
 //
 // 5. Pressing Escape in any operational context exits that operational context.
 // If that context is the primary mode, it exits the app.
@@ -103,6 +105,13 @@
 #include "wx/filename.h"
 #include "wx/filefn.h"
 #include "wx/stdpaths.h"
+#include "wx/timer.h"
+#include "wx/stopwatch.h"
+#include "wx/thread.h"
+#include "wx/process.h"
+#include "wx/mstream.h"
+#include "wx/zstream.h"
+#include "wx/regex.h"
 
 struct SModeMsg;
 struct SModeFileSel;
@@ -110,12 +119,18 @@ struct SModeLineInp;
 struct SModeIntDisp;
 struct SModeSrcEdr;
 struct SModeLevAdj;
+struct SModeLatStats;
+struct SModeDiags;
+struct SModeSearch;
+struct SSearchScan;
+struct SDirLoad;
 struct SMode;
+struct SBufFile;
 class MyFrame;
 struct SModeManager;
 class ModalWindow;
 
-SMode* load_mode(int scrnW, int scrnH, wxFile& File);
+SMode* load_mode(int scrnW, int scrnH, SBufFile& File);
 void free_mode(SMode* pMode);
 void mode_on_load(SMode* pMode, SModeManager *pModeManager);
 void mode_on_unload(SMode* pMode, SModeManager* pModeManager);
@@ -138,6 +153,22 @@ bool file_sel_map(SMode* pMode, wxKeyEvent& Event, ModalWindow* pWin);
 void file_sel_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
 void file_sel_change_sel(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void file_sel_commit(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void file_sel_take_entries(ModalWindow* pWin);
+void file_sel_end_loads(ModalWindow* pWin);
+
+bool lat_stats_map(SMode* pMode, wxKeyEvent& Event, ModalWindow* pWin);
+void lat_stats_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
+void lat_stats_scroll(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+
+bool diags_map(SMode* pMode, wxKeyEvent& Event, ModalWindow* pWin);
+void diags_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
+void diags_change_sel(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void diags_goto(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+
+bool search_map(SMode* pMode, wxKeyEvent& Event, ModalWindow* pWin);
+void search_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
+void search_change_sel(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void search_goto(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 
 bool int_disp_map(SMode* pMode, wxKeyEvent& Event, ModalWindow* pWin);
 void int_disp_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
@@ -150,7 +181,9 @@ void src_edr_disp_state(SMode* pMode, ModalWindow* pWin, wxDC& DC);
 void src_edr_disp_update(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_on_load(SMode* pMode, SModeManager* pManager);
 void src_edr_on_unload(SMode* pMode, SModeManager* pManager);
-bool src_edr_serialize(SMode* pBase, wxFile& File, bool bToFrom);
+bool src_edr_serialize(SMode* pBase, SBufFile& File, bool bToFrom);
+bool src_edr_replay(SMode* pBase, SBufFile& File, int type);
+bool src_edr_resume(SMode* pBase);
 void src_edr_edit_char(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_update_caret(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_start_sel(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
@@ -168,12 +201,45 @@ void src_edr_build(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_debug(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_adjust_fontsize(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
 void src_edr_input_codefile(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_latency_stats(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_diagnostics(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_breakpoint(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_debug_step(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_search(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+void src_edr_search_typed(SMode* pMode, int phase, ModalWindow* pWin, wxDC& DC);
+bool src_edr_is_typing_search(SMode* pMode, ModalWindow* pWin);
+void typed_search_update(SModeSrcEdr* pSrcEdr, SModeLineInp* pLineInput);
 
 SModeManager* modal_init(int scrnWidth, int scrnHeight);
 void modal_exit(SModeManager* pModeManager);
+wxThread* modal_autosave(SModeManager* pModeManager, ModalWindow* pWin);
+void modal_autosave_done(wxThread* pThread, SModeManager* pModeManager);
+SBufFile* modal_snapshot(SModeManager* pModeManager, bool bShared = false);
+void free_snapshot(SBufFile* pImage);
+bool save_snapshot(SBufFile* pImage);
+void src_edr_export_done(wxThread* pThread, ModalWindow* pWin);
+void src_edr_build_poll(wxProcess* pProcess, ModalWindow* pWin);
+void src_edr_build_done(wxProcess* pProcess, int exitCode, ModalWindow* pWin);
+void src_edr_debug_poll(wxProcess* pProcess, ModalWindow* pWin);
+void src_edr_debug_done(wxProcess* pProcess, ModalWindow* pWin);
+bool src_edr_start_index(SMode* pMode, ModalWindow* pWin);
+void src_edr_index_done(wxThread* pThread, ModalWindow* pWin);
+void src_edr_scan_hits(ModalWindow* pWin);
+void src_edr_end_scan(ModalWindow* pWin);
 
 #define ABS(x) ((x)>0?(x):-(x))
 
+// build with -DMODAL_BENCH for the headless render benchmark (see render_bench())
+// BENCH_COUNT compiles to nothing in the regular app build
+#ifdef MODAL_BENCH
+long long benchElemAtCalls = 0; // calls to SCodeSection::get_element_at()
+long long benchTxtExtentCalls = 0; // calls to DC.GetTextExtent() on the src editor's render path
+#define BENCH_COUNT(ctr) ((ctr)++)
+bool render_bench(const wxArrayString& Args);
+#else
+#define BENCH_COUNT(ctr)
+#endif
+
 // BLOCK: WX INTERFACING BOILERPLATE
 // Modal's SModeManager interfaces with the wxWindow class of wxWidgets.
 // The ModeManager is concerned with receiving kybd events
@@ -186,6 +252,7 @@ void modal_exit(SModeManager* pModeManager);
 // which returns a loaded mode manager,
 // and calls modal_exit() in its destructor
 // which serialzes the mode manager to disk and then free's the ModeManager
+// While the app runs, it also calls modal_autosave() when the user is idle
 // It also dispatches kybd and paint events to the mode manager
 // and provides access to wxWindow::Refresh methods to send redraw requests
 // SUBBLOCK: WX BRIDGE STRUCTURES AND FUNCTIONS
@@ -205,6 +272,21 @@ void modal_exit(SModeManager* pModeManager);
 // and also wxPaint events
 // modes (contained in the mode manager) also use wxWindow::Refresh()
 // (via ModalWindow) to refresh parts or all of the screen
+// ids of ModalWindow's timers and of the events its worker threads send it
+enum {
+  ID_FRAME_TIMER = wxID_HIGHEST + 1,
+  ID_AUTOSAVE_TIMER,
+  ID_JOURNAL_TIMER,
+  ID_EXPORT_DONE,
+  ID_AUTOSAVE_DONE,
+  ID_BUILD_TIMER,
+  ID_BUILD_PROCESS,
+  ID_DEBUG_TIMER,
+  ID_DEBUG_PROCESS,
+  ID_INDEX_DONE,
+  ID_SCAN_HITS,
+  ID_DIR_ENTRIES
+};
 class ModalWindow : public wxWindow {
 public:
   ModalWindow( MyFrame *pOwner, wxSize Size );
@@ -214,9 +296,36 @@ public:
   void OnKeyDown(wxKeyEvent &Event);
   void OnKeyUp(wxKeyEvent &Event);
   void OnLostFocus(wxFocusEvent &Event); // this is needed for a special case
+  void OnFrameTimer(wxTimerEvent &Event); // dispatches coalesced navigation keys
+  void OnAutosaveTimer(wxTimerEvent &Event); // saves the session when the user is idle
+  void OnJournalTimer(wxTimerEvent &Event); // commits the journaled changes
+  void OnExportDone(wxThreadEvent &Event); // sent by the export thread when it's done
+  void OnAutosaveDone(wxThreadEvent &Event); // sent by the autosave thread when it's done
+  void OnBuildTimer(wxTimerEvent &Event); // reads the output of the running build
+  void OnBuildEnd(wxProcessEvent &Event); // sent when the build's compiler exits
+  void OnDebugTimer(wxTimerEvent &Event); // reads the output of the debugger
+  void OnDebugEnd(wxProcessEvent &Event); // sent when the debugger exits
+  void OnIndexDone(wxThreadEvent &Event); // sent by the index thread when it's done
+  void OnScanHits(wxThreadEvent &Event); // sent by the scan threads as they find lines and when they're done
+  void OnDirEntries(wxThreadEvent &Event); // sent by the dir load threads as they find entries and when they're done
   MyFrame *m_pOwner;
   SModeManager *m_pModeManager; 
   bool m_bUsrActn; // for OnPaint. Did the paint event come from a user action or from the OS
+  bool m_bCoalescing; // a batch of queued navigation keys is being dispatched, intent handlers must not Update()
+  wxTimer m_FrameTimer; // fires at the end of a frame interval to dispatch queued navigation keys
+  wxStopWatch m_FrameClock; // time base for frame pacing
+  wxTimer m_AutosaveTimer; // fires every autosave interval
+  wxThread *m_pSaveThread; // writes an autosave to disk, NULL if none is running
+  long m_lastInputTime; // time (ms, m_FrameClock) of the last key down
+  wxTimer m_JournalTimer; // fires a commit interval after a change is journaled
+  wxThread *m_pExportThread; // writes the exported source to disk, NULL if none is running
+  wxProcess *m_pBuildProcess; // the compiler of the running build, NULL if none is running
+  wxTimer m_BuildTimer; // fires every build poll interval while a build runs
+  wxProcess *m_pDebugProcess; // the debugger of the debug session, NULL if there is none
+  wxTimer m_DebugTimer; // fires every debug poll interval during a debug session
+  wxThread *m_pIndexThread; // indexes the lines of the codebase for search, NULL if none is running
+  SSearchScan *m_pScan; // the regex scan of the search pop-up, NULL if none is running
+  SDirLoad *m_pDirLoads; // the list of the file selector's dir loads not reaped yet
   wxDECLARE_EVENT_TABLE();
 };
 // an event table to map the events for ModalWindow : wxWindow
@@ -226,12 +335,767 @@ EVT_ERASE_BACKGROUND(ModalWindow::EraseBG)
 EVT_KEY_DOWN(ModalWindow::OnKeyDown)
 EVT_KEY_UP(ModalWindow::OnKeyUp)
 EVT_KILL_FOCUS(ModalWindow::OnLostFocus)
+EVT_TIMER(ID_FRAME_TIMER, ModalWindow::OnFrameTimer)
+EVT_TIMER(ID_AUTOSAVE_TIMER, ModalWindow::OnAutosaveTimer)
+EVT_TIMER(ID_JOURNAL_TIMER, ModalWindow::OnJournalTimer)
+EVT_THREAD(ID_EXPORT_DONE, ModalWindow::OnExportDone)
+EVT_THREAD(ID_AUTOSAVE_DONE, ModalWindow::OnAutosaveDone)
+EVT_TIMER(ID_BUILD_TIMER, ModalWindow::OnBuildTimer)
+EVT_END_PROCESS(ID_BUILD_PROCESS, ModalWindow::OnBuildEnd)
+EVT_TIMER(ID_DEBUG_TIMER, ModalWindow::OnDebugTimer)
+EVT_END_PROCESS(ID_DEBUG_PROCESS, ModalWindow::OnDebugEnd)
+EVT_THREAD(ID_INDEX_DONE, ModalWindow::OnIndexDone)
+EVT_THREAD(ID_SCAN_HITS, ModalWindow::OnScanHits)
+EVT_THREAD(ID_DIR_ENTRIES, ModalWindow::OnDirEntries)
 wxEND_EVENT_TABLE()
 
 // SUBBLOCK: MODAL'S BASE STRUCTURES -- MODE-MANAGER AND MODE
 
 // The maximum number of "user intents" any given mode can accomodate
 #define MAX_INTENTS 40
+// Frame pacing for navigation keys
+// the interval (ms) in which at most one navigation key is painted
+// and the max number of navigation keys queued for the next frame
+#define FRAME_INTERVAL 16
+#define MAX_PENDING_KEYS 64
+// Autosave
+// the interval (ms) between autosaves
+// and how long (ms) the user has to be idle before one is taken
+#define AUTOSAVE_INTERVAL 30000
+#define AUTOSAVE_IDLE 2000
+// Edit journal
+// the files of the journal and of the journal left over from a snapshot that is not yet saved
+// journaled records are committed to disk in a group every JOURNAL_COMMIT_INTERVAL (ms)
+// and the journal is compacted into a snapshot once it grows past JOURNAL_COMPACT_SIZE (bytes)
+#define JOURNAL_FILE "State.hxj"
+#define JOURNAL_OLD_FILE "State.hxj.old"
+#define JOURNAL_COMMIT_INTERVAL 200
+#define JOURNAL_COMPACT_SIZE (1 << 20)
+#define JOURNAL_DEFERRED_SIZE 64 // the most bytes a deferred journal record holds (see SJournal::defer_record())
+// State.hxp container format
+// a header (magic, version) followed by typed chunks
+// each chunk is stored as its type, payload length, payload CRC32 and the payload
+// a file without the magic is an old-format flat dump (see SBufFile::open())
+// the payload of a chunk can be deflated, the chunk's stored type then has HXC_DEFLATED set
+// chunks that are begun to be deflated are compressed at HXP_COMPRESS_LEVEL, 0 stores them as is
+#define HXP_MAGIC 0x5058484D
+#define HXP_VERSION 3
+#define HXC_DEFLATED 0x40000000
+#define HXP_COMPRESS_LEVEL wxZ_BEST_SPEED
+#define HXP_CHUNK_HDR_SIZE (3 * (int)sizeof(int))
+#define MAX_HXP_CHUNKS 64 // initial size of the chunk directory, it grows as needed
+#define MAX_HXP_DEPTH 8
+// chunk types
+enum {
+  // the legacy pseudo-chunk covering all of an old-format file
+  HXC_LEGACY=0,
+  // the mode manager's stack and each mode's state
+  HXC_MODE_STACK,
+  // a source editor's code element tree
+  HXC_CODE_TREE,
+  // a codebase's edit operations as they were before undo, they are not loaded
+  HXC_OP_LIST,
+  // a codebase's symbol set
+  HXC_SYMBOLS,
+  // a source editor's navigation trail
+  HXC_NAV_TRAIL,
+  // the generation of a snapshot or of a journal, the first chunk of a journal
+  HXC_JNL_GEN,
+  // journal records of a source editor
+  // an edit operation, a summarize, a goto, a back to and the view after any of them
+  HXC_JNL_OP,
+  HXC_JNL_SUMMARIZE,
+  HXC_JNL_GOTO,
+  HXC_JNL_BACK,
+  HXC_JNL_VIEW,
+  // the source file a codebase was loaded from
+  HXC_SOURCE,
+  // the result of a build, the only chunk of a build cache entry
+  HXC_BUILD_RESULT,
+  // a codebase's breakpoints
+  HXC_BREAKPOINTS,
+  // a codebase's edit operations (see SOpList)
+  HXC_OP_RUNS,
+  // journal records of a source editor, an edit operation done, an undo and a redo
+  // HXC_JNL_OP records from before undo are not replayed
+  HXC_JNL_EDIT,
+  HXC_JNL_UNDO,
+  HXC_JNL_REDO,
+  // journal record of a source editor, a paste moving the elements of the last cut (see SOpCutPasteSel)
+  HXC_JNL_MOVE,
+  // a source editor's buffer of the chars last cut
+  HXC_CUT_BUF
+};
+// the size of a journal's header, the file header and the HXC_JNL_GEN chunk
+#define JOURNAL_HDR_SIZE (2 * (int)sizeof(int) + HXP_CHUNK_HDR_SIZE + (int)sizeof(int))
+// the table crc32_buf() computes CRC32 (IEEE) with
+unsigned int aCrc32Table[256];
+// builds the CRC32 table, called once by MyApp::OnInit() before any thread is started
+// so that the worker threads computing CRCs only ever read it
+void crc32_init() {
+  for( unsigned int i=0; i<256; i++ ) {
+    unsigned int c = i;
+    for( int k=0; k<8; k++ )
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    aCrc32Table[i] = c;
+  }
+}
+// computes the CRC32 (IEEE) of len bytes at pData
+// pass the CRC of the preceding bytes as crc to continue it over pData
+unsigned int crc32_buf( const char *pData, int len, unsigned int crc = 0 ) {
+  wxASSERT_MSG( aCrc32Table[1] != 0, "crc32_init() has not been called" );
+  crc = crc ^ 0xFFFFFFFF;
+  for( int i=0; i<len; i++ )
+    crc = aCrc32Table[(crc ^ (unsigned char)pData[i]) & 0xFF] ^ (crc >> 8);
+  return( crc ^ 0xFFFFFFFF );
+}
+// the FNV-1a 64 offset basis, the hash of no bytes
+#define FNV64_BASIS 0xcbf29ce484222325ULL
+// computes the 64 bit FNV-1a hash of len bytes at pData
+// pass the hash of the preceding bytes as hash to continue it over pData
+unsigned long long fnv64_buf( const char *pData, int len, unsigned long long hash = FNV64_BASIS ) {
+  for( int i=0; i<len; i++ ) {
+    hash ^= (unsigned char) pData[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return( hash );
+}
+// a chunk of an SBufFile
+// when writing, the payload is accumulated in pData
+// when reading, pData points into the image of the file
+typedef struct SHxpChunk {
+  int type;
+  char *pData;
+  int len; // payload length
+  int size; // allocated size of pData when writing
+  int pos; // read position in the payload
+  bool bValid; // the payload's CRC matched when reading
+  bool bUsed; // already opened by a reader
+  bool bDeflate; // deflate the payload when writing, the payload is deflated when reading
+  wxMemoryInputStream *pMemIn; // the deflated payload of a chunk open for reading
+  wxZlibInputStream *pZIn; // inflates it as it is read, NULL for chunks stored as is
+} SHxpChunk;
+// bytes of an SBufFile's chunk written by reference (see SBufFile::WriteShared())
+typedef struct SHxpSplice {
+  int chunk; // the chunk they go in
+  int at; // the position in its payload they go at
+  const char *pData;
+  int len;
+} SHxpSplice;
+// A buffered binary file that all the serialize() fns read and write.
+// Serializers write and read one field at a time.
+// When writing, fields are combined in the payload of the open chunk
+// and the file is written in a few large writes when it is flush()ed (or close()d).
+// When reading, the whole file is read into memory in one go
+// and the chunks are parsed directly from that image.
+// Serializers bracket their data with begin_chunk()/end_chunk() when writing
+// and open_chunk()/close_chunk() when reading.
+// Chunks can be begun within chunks but are laid out one after the other in the file,
+// a reader finds them by type so a corrupt chunk only loses its own data.
+// Write() and Read() mirror wxFile's so the serializers use it the same way.
+// Large chunks can be deflated, they are compressed when flushed
+// and inflated straight into the serializers' fields as they are read.
+// An image can also be written in memory without a file (begin_image())
+// and saved later, possibly from another thread, with save_image().
+// The lines of such an image can be written by reference, while shareEpoch is set,
+// they are copied into it only when it's saved (see WriteShared()).
+typedef struct SBufFile {
+  void init() {
+    this->pFile = new wxFile();
+    this->pImage = NULL;
+    this->maxChunks = MAX_HXP_CHUNKS;
+    this->aChunks = (SHxpChunk*) malloc( this->maxChunks * sizeof(SHxpChunk) );
+    wxASSERT_MSG( this->aChunks != NULL, "malloc failure" );
+    this->numChunks = 0;
+    this->depth = 0;
+    this->bWriting = false;
+    this->bLegacy = false;
+    this->bError = false;
+    this->numCalls = 0;
+    this->numSyscalls = 0;
+    this->compressLevel = HXP_COMPRESS_LEVEL;
+    this->shareEpoch = 0;
+    this->pSplices = NULL;
+    this->numSplices = 0;
+    this->maxSplices = 0;
+  };
+  // creates (overwrites) the file at szPath for writing
+  bool create( const char *szPath ) {
+    this->begin_image();
+    this->bError = !this->pFile->Create( szPath, true );
+    return( !this->bError );
+  };
+  // starts writing an image in memory, no file is created
+  void begin_image() {
+    this->free_chunks();
+    this->bWriting = true;
+    this->bLegacy = false;
+    this->bError = false;
+    this->numCalls = 0;
+    this->numSyscalls = 0;
+  };
+  // creates (overwrites) the file at szPath and writes the image begun with begin_image() to it
+  // touches nothing but this SBufFile so it can be called from a worker thread
+  // returns false if the image is incomplete or any write fails
+  bool save_image( const char *szPath ) {
+    if( !this->bError )
+      this->bError = !this->pFile->Create( szPath, true );
+    return( this->close() );
+  };
+  // opens the file at szPath and reads it into memory
+  // verifies the header and builds the directory of chunks, checking each chunk's CRC
+  // a file without the header is an old-format dump, all of it is read as one legacy chunk
+  // returns false if the file can't be read or is of a newer version
+  bool open( const char *szPath ) {
+    this->free_chunks();
+    this->bWriting = false;
+    this->bLegacy = false;
+    this->numCalls = 0;
+    this->numSyscalls = 0;
+    this->bError = !this->pFile->Open( szPath );
+    // read the image of the file
+    int len = 0;
+    if( !this->bError ) {
+      len = (int) this->pFile->Length();
+      this->pImage = (char*) malloc( len + 1 );
+      wxASSERT_MSG( this->pImage != NULL, "malloc failure" );
+      this->numSyscalls++;
+      if( len > 0 && this->pFile->Read( this->pImage, len ) != len )
+        this->bError = true;
+    }
+    // new format, check the version and load the chunk directory
+    // the header fields are copied out, a chunk's header follows a payload of any length so it may be unaligned
+    int aFileHdr[2] = { 0, 0 };
+    if( !this->bError && len >= 2 * (int)sizeof(int) )
+      memcpy( aFileHdr, this->pImage, 2 * sizeof(int) );
+    if( !this->bError && len >= 2 * (int)sizeof(int) && aFileHdr[0] == HXP_MAGIC ) {
+      int version = aFileHdr[1];
+      if( version > HXP_VERSION ) {
+        wxLogError( "%s is from a newer version of this app", szPath );
+        this->bError = true;
+      }
+      int pos = 2 * sizeof(int);
+      bool bEnd = this->bError;
+      // a chunk that runs past the end of the file ends the directory
+      while( !bEnd && pos + HXP_CHUNK_HDR_SIZE <= len ) {
+        int aHdr[3];
+        memcpy( aHdr, this->pImage + pos, HXP_CHUNK_HDR_SIZE );
+        if( aHdr[1] < 0 || aHdr[1] > len - pos - HXP_CHUNK_HDR_SIZE )
+          bEnd = true;
+        else {
+          SHxpChunk *pChunk = this->add_chunk();
+          pChunk->type = aHdr[0] & ~HXC_DEFLATED;
+          pChunk->bDeflate = ( aHdr[0] & HXC_DEFLATED ) != 0;
+          pChunk->pMemIn = NULL;
+          pChunk->pZIn = NULL;
+          pChunk->len = aHdr[1];
+          pChunk->pData = this->pImage + pos + HXP_CHUNK_HDR_SIZE;
+          pChunk->size = 0;
+          pChunk->pos = 0;
+          pChunk->bValid = crc32_buf( pChunk->pData, pChunk->len ) == (unsigned int) aHdr[2];
+          pChunk->bUsed = false;
+          pos += HXP_CHUNK_HDR_SIZE + pChunk->len;
+        }
+      }
+    }
+    // old format, read it as a single flat stream
+    else if( !this->bError ) {
+      this->bLegacy = true;
+      SHxpChunk *pChunk = &(this->aChunks[0]);
+      pChunk->type = HXC_LEGACY;
+      pChunk->bDeflate = false;
+      pChunk->pMemIn = NULL;
+      pChunk->pZIn = NULL;
+      pChunk->len = len;
+      pChunk->pData = this->pImage;
+      pChunk->size = 0;
+      pChunk->pos = 0;
+      pChunk->bValid = true;
+      pChunk->bUsed = true;
+      this->numChunks = 1;
+      this->aOpen[0] = 0;
+      this->depth = 1;
+    }
+    return( !this->bError );
+  };
+  bool IsOpened() {
+    return( this->pFile->IsOpened() );
+  };
+  // adds an entry to the end of the chunk directory, growing it if it's full
+  SHxpChunk *add_chunk() {
+    if( this->numChunks == this->maxChunks ) {
+      this->maxChunks *= 2;
+      this->aChunks = (SHxpChunk*) realloc( this->aChunks, this->maxChunks * sizeof(SHxpChunk) );
+      wxASSERT_MSG( this->aChunks != NULL, "malloc failure" );
+    }
+    this->numChunks++;
+    return( &(this->aChunks[this->numChunks-1]) );
+  };
+  // starts a chunk of type, subsequent writes go to this chunk till end_chunk()
+  // with bDeflate the chunk's payload is compressed when it is flushed
+  void begin_chunk( int type, bool bDeflate = false ) {
+    wxASSERT_MSG( this->depth < MAX_HXP_DEPTH, "chunks nested too deep in SBufFile" );
+    if( this->depth < MAX_HXP_DEPTH ) {
+      SHxpChunk *pChunk = this->add_chunk();
+      pChunk->type = type;
+      pChunk->bDeflate = bDeflate;
+      pChunk->pMemIn = NULL;
+      pChunk->pZIn = NULL;
+      pChunk->size = 4096;
+      pChunk->pData = (char*) malloc( pChunk->size );
+      wxASSERT_MSG( pChunk->pData != NULL, "malloc failure" );
+      pChunk->len = 0;
+      this->aOpen[this->depth] = this->numChunks - 1;
+      this->depth++;
+    }
+    else
+      this->bError = true;
+  };
+  // ends the chunk begun last, writes go back to the chunk it was begun in
+  void end_chunk() {
+    if( this->depth > 0 )
+      this->depth--;
+  };
+  // opens the next unread chunk of type, subsequent reads come from it till close_chunk()
+  // returns false if there is no such chunk or if it is corrupt,
+  // the caller then has to do without the chunk's data
+  // in an old-format file every chunk is in the one flat stream so this always succeeds
+  bool open_chunk( int type ) {
+    bool bRetVal = false;
+    if( this->bLegacy ) {
+      if( this->depth < MAX_HXP_DEPTH ) {
+        this->aOpen[this->depth] = 0;
+        this->depth++;
+        bRetVal = true;
+      }
+    }
+    else {
+      int found = -1;
+      for( int i=0; i<this->numChunks && found == -1; i++ )
+        if( this->aChunks[i].type == type && !this->aChunks[i].bUsed )
+          found = i;
+      if( found != -1 ) {
+        this->aChunks[found].bUsed = true;
+        if( !this->aChunks[found].bValid )
+          wxLogError( "a corrupt chunk (type %d) of a saved session was skipped", type );
+        else if( this->depth < MAX_HXP_DEPTH ) {
+          this->push_chunk( found );
+          bRetVal = true;
+        }
+      }
+    }
+    return( bRetVal );
+  };
+  // makes the chunk at index the one being read
+  // a deflated chunk is read through an inflating stream over its payload in the image
+  void push_chunk( int index ) {
+    SHxpChunk *pChunk = &(this->aChunks[index]);
+    if( pChunk->bDeflate ) {
+      pChunk->pMemIn = new wxMemoryInputStream( pChunk->pData, pChunk->len );
+      pChunk->pZIn = new wxZlibInputStream( *(pChunk->pMemIn), wxZLIB_ZLIB );
+    }
+    this->aOpen[this->depth] = index;
+    this->depth++;
+  };
+  // deletes the inflating stream of a deflated chunk
+  void free_streams( SHxpChunk *pChunk ) {
+    if( pChunk->pZIn != NULL ) {
+      delete pChunk->pZIn;
+      delete pChunk->pMemIn;
+      pChunk->pZIn = NULL;
+      pChunk->pMemIn = NULL;
+    }
+  };
+  // opens the first unread chunk in the order they are in the file, whatever its type
+  // for files, like the journal, whose chunks are records to be read in sequence
+  // returns the chunk's type, or -1 at the end of the file or at a corrupt chunk
+  // since the records after a corrupt one can't be applied without it
+  int open_next_chunk() {
+    int type = -1;
+    int found = -1;
+    for( int i=0; i<this->numChunks && found == -1; i++ )
+      if( !this->aChunks[i].bUsed )
+        found = i;
+    if( found != -1 && !this->bLegacy && this->depth < MAX_HXP_DEPTH ) {
+      this->aChunks[found].bUsed = true;
+      if( this->aChunks[found].bValid ) {
+        this->push_chunk( found );
+        type = this->aChunks[found].type;
+      }
+    }
+    return( type );
+  };
+  // closes the chunk opened last, reads go back to the chunk that was being read before it
+  void close_chunk() {
+    if( this->depth > 0 ) {
+      this->free_streams( &(this->aChunks[this->aOpen[this->depth-1]]) );
+      this->depth--;
+    }
+  };
+  // appends count bytes from pData to the open chunk
+  size_t Write( const void *pData, size_t count ) {
+    this->numCalls++;
+    if( this->depth > 0 ) {
+      SHxpChunk *pChunk = &(this->aChunks[this->aOpen[this->depth-1]]);
+      if( pChunk->len + (int)count > pChunk->size ) {
+        while( pChunk->len + (int)count > pChunk->size )
+          pChunk->size *= 2;
+        pChunk->pData = (char*) realloc( pChunk->pData, pChunk->size );
+        wxASSERT_MSG( pChunk->pData != NULL, "malloc failure" );
+      }
+      memcpy( pChunk->pData + pChunk->len, pData, count );
+      pChunk->len += count;
+    }
+    else
+      this->bError = true;
+    return( count );
+  };
+  // appends count bytes at pData to the open chunk by reference, if shareEpoch is set, else copies them
+  // they are copied in when the chunk is flushed, the caller keeps them as they are till then
+  // the lines written by tl_serialize_shared() are kept by stamping them with shareEpoch (see SLineShares)
+  size_t WriteShared( const void *pData, size_t count ) {
+    if( this->shareEpoch == 0 || this->depth == 0 )
+      return( this->Write( pData, count ) );
+    this->numCalls++;
+    if( this->numSplices == this->maxSplices ) {
+      this->maxSplices = this->maxSplices * 2 + 1024;
+      this->pSplices = (SHxpSplice*) realloc( this->pSplices, this->maxSplices * sizeof(SHxpSplice) );
+      wxASSERT_MSG( this->pSplices != NULL, "malloc failure" );
+    }
+    SHxpSplice *pSplice = &(this->pSplices[this->numSplices]);
+    pSplice->chunk = this->aOpen[this->depth-1];
+    pSplice->at = this->aChunks[pSplice->chunk].len;
+    pSplice->pData = (const char*) pData;
+    pSplice->len = (int) count;
+    this->numSplices++;
+    return( count );
+  };
+  // copies the bytes written by reference to the chunk at index into its payload
+  void splice_chunk( int index ) {
+    SHxpChunk *pChunk = &(this->aChunks[index]);
+    int len = pChunk->len;
+    for( int i=0; i<this->numSplices; i++ )
+      if( this->pSplices[i].chunk == index )
+        len += this->pSplices[i].len;
+    if( len != pChunk->len ) {
+      char *pData = (char*) malloc( len > 0 ? len : 1 );
+      wxASSERT_MSG( pData != NULL, "malloc failure" );
+      int from = 0;
+      int to = 0;
+      for( int i=0; i<this->numSplices; i++ ) {
+        SHxpSplice *pSplice = &(this->pSplices[i]);
+        if( pSplice->chunk == index ) {
+          memcpy( pData + to, pChunk->pData + from, pSplice->at - from );
+          to += pSplice->at - from;
+          from = pSplice->at;
+          memcpy( pData + to, pSplice->pData, pSplice->len );
+          to += pSplice->len;
+        }
+      }
+      memcpy( pData + to, pChunk->pData + from, pChunk->len - from );
+      free( pChunk->pData );
+      pChunk->pData = pData;
+      pChunk->len = len;
+      pChunk->size = len;
+    }
+  };
+  // reads count bytes into pData from the open chunk
+  // returns the number of bytes read, less than count at the end of the chunk
+  // in which case the rest of pData is zeroed
+  size_t Read( void *pData, size_t count ) {
+    size_t numRead = 0;
+    this->numCalls++;
+    if( this->depth > 0 ) {
+      SHxpChunk *pChunk = &(this->aChunks[this->aOpen[this->depth-1]]);
+      // inflate straight into pData
+      if( pChunk->pZIn != NULL )
+        numRead = pChunk->pZIn->Read( pData, count ).LastRead();
+      else {
+        numRead = count;
+        if( numRead > (size_t)(pChunk->len - pChunk->pos) )
+          numRead = pChunk->len - pChunk->pos;
+        memcpy( pData, pChunk->pData + pChunk->pos, numRead );
+        pChunk->pos += numRead;
+      }
+    }
+    if( numRead < count ) {
+      memset( (char*)pData + numRead, 0, count - numRead );
+      this->bError = true;
+    }
+    return( numRead );
+  };
+  // writes out the header and the chunks
+  // returns false if any write to this file has failed
+  bool flush() {
+    if( this->bWriting && !this->bError ) {
+      int aHdr[2];
+      aHdr[0] = HXP_MAGIC;
+      aHdr[1] = HXP_VERSION;
+      this->numSyscalls++;
+      if( this->pFile->Write( aHdr, 2 * sizeof(int) ) != 2 * sizeof(int) )
+        this->bError = true;
+    }
+    return( this->flush_chunks() );
+  };
+  // writes out the chunks written since the last flush, without a header
+  // the journal appends its records to the end of its file with this
+  // returns false if any write to this file has failed
+  bool flush_chunks() {
+    if( this->bWriting && !this->bError ) {
+      int aHdr[3];
+      for( int i=0; i<this->numChunks && !this->bError; i++ ) {
+        if( this->numSplices > 0 )
+          this->splice_chunk( i );
+        SHxpChunk *pChunk = &(this->aChunks[i]);
+        char *pData = pChunk->pData;
+        aHdr[0] = pChunk->type;
+        aHdr[1] = pChunk->len;
+        // deflate the payload into a memory stream and write that instead
+        wxMemoryOutputStream MemOut;
+        if( pChunk->bDeflate && this->compressLevel != 0 ) {
+          wxZlibOutputStream ZOut( MemOut, this->compressLevel, wxZLIB_ZLIB );
+          ZOut.Write( pChunk->pData, pChunk->len );
+          if( !ZOut.Close() )
+            this->bError = true;
+          pData = (char*) MemOut.GetOutputStreamBuffer()->GetBufferStart();
+          aHdr[0] |= HXC_DEFLATED;
+          aHdr[1] = (int) MemOut.GetLength();
+        }
+        aHdr[2] = (int) crc32_buf( pData, aHdr[1] );
+        this->numSyscalls += 2;
+        if( this->pFile->Write( aHdr, HXP_CHUNK_HDR_SIZE ) != (size_t) HXP_CHUNK_HDR_SIZE )
+          this->bError = true;
+        else if( this->pFile->Write( pData, aHdr[1] ) != (size_t) aHdr[1] )
+          this->bError = true;
+      }
+      this->free_chunks();
+    }
+    return( !this->bError );
+  };
+  // flushes and closes the file
+  // returns false if any write to this file has failed
+  bool close() {
+    bool bRetVal = this->flush();
+    this->pFile->Close();
+    this->free_chunks();
+    return( bRetVal );
+  };
+  // frees the chunk payloads (when writing) or the image (when reading)
+  void free_chunks() {
+    for( int i=0; i<this->numChunks; i++ ) {
+      this->free_streams( &(this->aChunks[i]) );
+      if( this->bWriting )
+        free( this->aChunks[i].pData );
+    }
+    if( this->pImage != NULL )
+      free( this->pImage );
+    this->pImage = NULL;
+    this->numChunks = 0;
+    this->numSplices = 0;
+    this->depth = 0;
+  };
+  wxFile *pFile;
+  char *pImage; // the file read into memory
+  SHxpChunk *aChunks;
+  int numChunks;
+  int maxChunks;
+  int aOpen[MAX_HXP_DEPTH]; // stack of the chunks being written or read
+  int depth;
+  bool bWriting;
+  bool bLegacy; // reading an old-format file
+  bool bError; // a read ran past its chunk or a write failed
+  long numCalls; // Write()s and Read()s made by the serializers
+  long numSyscalls; // reads and writes made on the file
+  int compressLevel; // zlib level deflated chunks are written at, 0 writes them as is
+  long shareEpoch; // the epoch the lines written by reference are stamped with, 0 copies them
+  SHxpSplice *pSplices; // the bytes written by reference, in the order they were written
+  int numSplices;
+  int maxSplices;
+} SBufFile;
+// allocs and inits a buffered file on the heap and returns it
+// caller has to free
+SBufFile *new_buf_file() {
+  SBufFile *pBufFile = (SBufFile *) malloc( sizeof(SBufFile) );
+  wxASSERT_MSG( pBufFile != NULL, "malloc failure" );
+  pBufFile->init();
+  return( pBufFile );
+}
+// closes (without flushing) and frees a buffered file
+void free_buf_file( SBufFile *pBufFile ) {
+  pBufFile->free_chunks();
+  if( pBufFile->pFile->IsOpened() )
+    pBufFile->pFile->Close();
+  delete pBufFile->pFile;
+  free( pBufFile->aChunks );
+  free( pBufFile->pSplices );
+  free( pBufFile );
+}
+// An append-only journal of the edits and navigation made since the last snapshot (State.hxp)
+// so that a session survives a crash without rewriting the whole snapshot for every change.
+// Records are typed chunks, as in State.hxp, appended to State.hxj.
+// Modes write them with begin_record()/end_record() and read them back in SMode::fnReplay().
+// They are buffered in memory and committed (written and synced to disk) in a group.
+// A torn record at the end of the journal ends it when it is replayed.
+// Every snapshot has a generation, a journal is replayed on the snapshot of its generation.
+// Taking a snapshot rotate()s the journal to State.hxj.old and begins a fresh one,
+// State.hxj.old is removed once the snapshot is safely on disk.
+// If that fails, the older snapshot still has both journals to replay, State.hxj.old first.
+typedef struct SJournal {
+  void init() {
+    this->pBuf = new_buf_file();
+    this->gen = 0;
+    this->length = 0;
+    this->numPending = 0;
+    this->deferredType = -1;
+    this->deferredLen = 0;
+    this->bOpen = false;
+  };
+  // begins an empty journal of generation gen in State.hxj, discarding the one there
+  // returns false if it can't be created, changes are then only saved in snapshots
+  bool create( int gen ) {
+    this->close();
+    this->gen = gen;
+    this->pBuf->create( JOURNAL_FILE );
+    this->pBuf->begin_chunk( HXC_JNL_GEN );
+    this->pBuf->Write( &gen, sizeof(int) );
+    this->pBuf->end_chunk();
+    this->bOpen = this->pBuf->flush();
+    if( !this->bOpen )
+      wxLogError( "the edit journal %s could not be created", JOURNAL_FILE );
+    this->length = JOURNAL_HDR_SIZE;
+    this->pBuf->begin_image();
+    this->numPending = 0;
+    this->deferredType = -1;
+    return( this->bOpen );
+  };
+  // starts a record of type, the caller writes its payload to the returned file
+  // and calls end_record() when done
+  // the deferred record is written ahead of it, unless bAfterDeferred is false
+  // for a record whose replay does not depend on it
+  SBufFile& begin_record( int type, bool bAfterDeferred = true ) {
+    if( bAfterDeferred )
+      this->write_deferred();
+    this->pBuf->begin_chunk( type );
+    return( *(this->pBuf) );
+  };
+  void end_record() {
+    this->pBuf->end_chunk();
+    this->numPending++;
+  };
+  // sets a record of type with the len bytes of pData to be written after the records pending
+  // in place of the one set before it, for state of which a replay needs only the latest
+  // such as the view while typing, which is then journaled once per commit rather than per key
+  void defer_record( int type, const void *pData, int len ) {
+    wxASSERT_MSG( len <= JOURNAL_DEFERRED_SIZE, "deferred record too long" );
+    if( this->deferredType < 0 )
+      this->numPending++;
+    this->deferredType = type;
+    memcpy( this->aDeferred, pData, len );
+    this->deferredLen = len;
+  };
+  // writes the deferred record, if any, after the records pending
+  void write_deferred() {
+    if( this->deferredType >= 0 ) {
+      this->pBuf->begin_chunk( this->deferredType );
+      this->pBuf->Write( this->aDeferred, this->deferredLen );
+      this->pBuf->end_chunk();
+      this->deferredType = -1;
+    }
+  };
+  // writes the records pending since the last commit in one go and syncs them to disk
+  // if the journal can't be written it is closed, changes are then only saved in snapshots
+  bool commit() {
+    bool bRetVal = true;
+    if( this->numPending > 0 ) {
+      this->write_deferred();
+      if( this->bOpen ) {
+        int len = 0;
+        for( int i=0; i<this->pBuf->numChunks; i++ )
+          len += HXP_CHUNK_HDR_SIZE + this->pBuf->aChunks[i].len;
+        bRetVal = this->pBuf->flush_chunks() && this->pBuf->pFile->Flush();
+        this->length += len;
+        if( !bRetVal ) {
+          wxLogError( "the edit journal %s could not be written", JOURNAL_FILE );
+          this->close();
+        }
+      }
+      this->pBuf->begin_image();
+      this->numPending = 0;
+    }
+    return( bRetVal );
+  };
+  // true once the journal has grown past JOURNAL_COMPACT_SIZE or can't be written
+  // the session then has to be snapshotted
+  bool needs_compaction() {
+    return( !this->bOpen || this->length >= JOURNAL_COMPACT_SIZE );
+  };
+  // commits and closes this journal, it becomes State.hxj.old,
+  // and begins a new one of generation gen
+  // if State.hxj.old is still there, the snapshot it goes with was never saved
+  // so this journal's records are appended to it instead
+  // State.hxj is set aside even if it's not open, as after it's been replayed at startup
+  // or when it could not be written, it's then only removed once the new snapshot is saved
+  void rotate( int gen ) {
+    this->commit();
+    this->close();
+    if( wxFile::Exists( JOURNAL_FILE ) ) {
+      if( wxFile::Exists( JOURNAL_OLD_FILE ) ) {
+        if( !this->append_to_old() )
+          wxLogError( "the edit journal %s could not be appended to %s", JOURNAL_FILE, JOURNAL_OLD_FILE );
+      }
+      else
+        wxRenameFile( JOURNAL_FILE, JOURNAL_OLD_FILE, true );
+    }
+    this->create( gen );
+  };
+  // appends the records (everything after the header) of State.hxj to State.hxj.old
+  bool append_to_old() {
+    wxFile From;
+    wxFile To;
+    bool bRetVal = From.Open( JOURNAL_FILE ) && To.Open( JOURNAL_OLD_FILE, wxFile::write_append );
+    if( bRetVal ) {
+      int len = (int) From.Length() - JOURNAL_HDR_SIZE;
+      if( len > 0 ) {
+        char *pData = (char*) malloc( len );
+        wxASSERT_MSG( pData != NULL, "malloc failure" );
+        From.Seek( JOURNAL_HDR_SIZE );
+        bRetVal = From.Read( pData, len ) == len;
+        bRetVal = bRetVal && To.Write( pData, len ) == (size_t) len && To.Flush();
+        free( pData );
+      }
+    }
+    return( bRetVal );
+  };
+  // closes the journal file, pending records are dropped
+  void close() {
+    if( this->pBuf->pFile->IsOpened() )
+      this->pBuf->pFile->Close();
+    this->bOpen = false;
+  };
+  SBufFile *pBuf; // the records pending commit, its file is the journal
+  int gen; // the generation of the snapshot this journal goes with
+  int length; // the size of the journal file
+  int numPending; // records not yet committed
+  int deferredType; // the type of the deferred record, -1 if there is none
+  char aDeferred[JOURNAL_DEFERRED_SIZE]; // the payload of the deferred record
+  int deferredLen;
+  bool bOpen; // the journal file is open for appending
+} SJournal;
+// allocs and inits a journal on the heap and returns it
+// the journal is not open till it is create()d
+// caller has to free
+SJournal *new_journal() {
+  SJournal *pJournal = (SJournal *) malloc( sizeof(SJournal) );
+  wxASSERT_MSG( pJournal != NULL, "malloc failure" );
+  pJournal->init();
+  return( pJournal );
+}
+// closes and frees a journal, pending records are dropped
+void free_journal( SJournal *pJournal ) {
+  pJournal->close();
+  free_buf_file( pJournal->pBuf );
+  free( pJournal );
+}
 // Mode types
 enum {
   MODE_BASE=0,
@@ -242,7 +1106,13 @@ enum {
   MODE_FILE_SELECTOR, 
   MODE_LEVEL_ADJUSTER,
   // app specific primary mode IDs need to be enumed here 
-  MODE_SOURCE_EDITOR 
+  MODE_SOURCE_EDITOR,
+  // accessory modes added later are appended so serialized mode types stay valid
+  MODE_LATENCY_STATS,
+  MODE_DIAGNOSTICS,
+  MODE_SEARCH,
+  // the number of mode types, mode types are added before it
+  MODE_TYPES
 };
 // union for extending the base mode structure
 // it is contained by the base Mode structure
@@ -259,9 +1129,18 @@ typedef union UModeExtension {
   SModeLineInp * pLineInput;
   SModeFileSel *pFileSel;
   SModeLevAdj * pLevAdj;
+  SModeLatStats * pLatStats;
   // app specific primary modes are added here
   SModeSrcEdr * pSrcEdr; 
+  SModeDiags * pDiags;
+  SModeSearch * pSearch;
 } UModeExtension;
+// returns the time (us) on a monotonic clock, for latency tracing
+// it's started on the first call, so only differences of its times mean anything
+long long lat_now_us() {
+  static wxStopWatch Clock;
+  return( Clock.TimeInMicro().GetValue() );
+}
 // A mode (of operation) is represented by the SMode struct
 // SMode is a struct that is like an abstract class.
 // It contains several fn ptrs that have to be loaded by a concrete mode.
@@ -313,6 +1192,8 @@ typedef struct SMode {
     this->fnKey_up = mode_key_up;
     this->fnOn_load = mode_on_load;
     this->fnOn_unload = mode_on_unload;
+    this->fnReplay = NULL;
+    this->fnResume = NULL;
     this->scrnW = scrnW;
     this->scrnH = scrnH;
     this->bHasFocus = false;
@@ -325,6 +1206,9 @@ typedef struct SMode {
     else 
       this->dBaseFontPointSize = 0.0;
     this->bReset = true;
+    this->bCoalesceNav = false;
+    this->tDispatch = -1;
+    this->pUpdateRgn = NULL;
     this->type = MODE_BASE;
   };
   // all of the fn ptrs below have to be assigned for a mode to be operational
@@ -333,7 +1217,13 @@ typedef struct SMode {
   void (*fnDisp_state)( SMode *pMode, ModalWindow *pWin, wxDC &DC );
   void (*fnOn_load)( SMode *pBase, SModeManager *pManager );
   void (*fnOn_unload)( SMode *pBase, SModeManager* pManager);
-  bool (*fnSerialize)( SMode *pBase, wxFile &File, bool bToFrom );
+  bool (*fnSerialize)( SMode *pBase, SBufFile &File, bool bToFrom );
+  // replays a journal record of type opened in File, returns false if it's not this mode's
+  // NULL for modes that journal nothing
+  bool (*fnReplay)( SMode *pBase, SBufFile &File, int type );
+  // brings a restored mode up to date with what changed outside the app since it was saved
+  // returns true if the mode's state changed, NULL for modes that depend on nothing outside
+  bool (*fnResume)( SMode *pBase );
   void (*fnIntent_handler[MAX_INTENTS])( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC );
   // updates the display for this mode in response to a user action
   // called by the mode manager
@@ -341,6 +1231,16 @@ typedef struct SMode {
     // dispatch the current user intent for display
     this->fnIntent_handler[this->intent]( this, phase, pWin, DC );
   };
+  // stamps the time (us) an intent is dispatched from fnKybd_map, for latency tracing
+  // a mode's kybd map calls this just before it dispatches to an intent handler
+  void mark_dispatch() {
+    this->tDispatch = lat_now_us();
+  };
+  // checks if any part of Rect is in the region being painted
+  // fnDisp_state uses this to skip lines and panels that the OS did not invalidate
+  bool is_exposed( const wxRect& Rect ) {
+    return( this->pUpdateRgn == NULL || this->pUpdateRgn->Contains( Rect ) != wxOutRegion );
+  };
   // set's the font but does not load it yet
   void set_font( wxFont *pFont ) {
     this->pFont = pFont;
@@ -365,7 +1265,7 @@ typedef struct SMode {
     this->Location = Location;
   };
   // serializes the base data of a mode
-  void serialize( wxFile &File, bool bToFrom ) {
+  void serialize( SBufFile &File, bool bToFrom ) {
     if( bToFrom ) {
       File.Write( &(this->numIntents), sizeof(int) );
       File.Write( &(this->type), sizeof(int) );
@@ -396,6 +1296,9 @@ typedef struct SMode {
   double dFontScale;
   double dBaseFontPointSize;
   bool bReset;
+  bool bCoalesceNav; // navigation key repeats may be coalesced by the mode manager
+  long long tDispatch; // time (us) of the last intent dispatch, -1 if none
+  wxRegion *pUpdateRgn; // the invalidated region being painted by fnDisp_state, NULL if all of the screen
 } SMode;
 // phases of an intent implementation function
 // the kybd map function initiates intent dispatch
@@ -415,6 +1318,251 @@ typedef struct SMode {
 enum {
   PH_NOTIFY, PH_EXEC
 };
+// returns a printable name for a mode type
+const char *lat_mode_name( int type ) {
+  const char *szName = "unknown";
+  switch( type ) {
+    case MODE_BASE: szName = "base"; break;
+    case MODE_INTENT_DISPATCHER: szName = "intent disp"; break;
+    case MODE_MESSAGE: szName = "message"; break;
+    case MODE_LINE_INPUT: szName = "line input"; break;
+    case MODE_FILE_SELECTOR: szName = "file selector"; break;
+    case MODE_LEVEL_ADJUSTER: szName = "level adjuster"; break;
+    case MODE_SOURCE_EDITOR: szName = "source editor"; break;
+    case MODE_LATENCY_STATS: szName = "latency stats"; break;
+    case MODE_DIAGNOSTICS: szName = "diagnostics"; break;
+    case MODE_SEARCH: szName = "search"; break;
+    default: break;
+  }
+  return( szName );
+}
+wxString lat_intent_name( int type, int intent );
+// Latency tracing
+// Every key press is traced from ModalWindow::OnKeyDown to the end of the OnPaint
+// that puts its result on the screen.
+// A trace is stamped at 4 points:
+// t0 key down (ModalWindow::OnKeyDown)
+// t1 intent dispatch (SMode::mark_dispatch in the mode's fnKybd_map)
+// t2 PH_NOTIFY complete (the mode's fnKybd_map returns)
+// t3 paint complete (end of ModalWindow::OnPaint)
+// Traces are aggregated per (mode type, intent) into log-linear (HDR style) histograms
+// of the t0-t3 latency in microseconds.
+// Each power of 2 range is split into LAT_SUB_BUCKETS buckets, giving ~12% resolution.
+#define LAT_SUB_BUCKETS 8
+#define LAT_MAX_MSB 27
+#define LAT_BUCKETS ((LAT_MAX_MSB - 1) * LAT_SUB_BUCKETS)
+#define LAT_MODE_TYPES MODE_TYPES
+#define LAT_MAX_OPEN 80
+// a latency histogram for one (mode type, intent) slot
+typedef struct SLatHist {
+  void init() {
+    memset( this->aCounts, 0, sizeof(this->aCounts) );
+    this->numSamples = 0;
+    this->maxUs = 0;
+    this->sumDispatchUs = 0;
+    this->sumNotifyUs = 0;
+    this->sumPaintUs = 0;
+  };
+  // maps a latency to its bucket
+  // values below LAT_SUB_BUCKETS have a bucket each
+  // larger values are bucketed by their msb and the LAT_SUB_BUCKETS bits below it
+  static int bucket_of( long long us ) {
+    int index = 0;
+    if( us < 0 )
+      us = 0;
+    if( us < LAT_SUB_BUCKETS )
+      index = (int) us;
+    else {
+      int msb = 0;
+      while( (us >> (msb+1)) != 0 )
+        msb++;
+      if( msb > LAT_MAX_MSB )
+        index = LAT_BUCKETS - 1;
+      else
+        index = (msb - 2) * LAT_SUB_BUCKETS + (int) ((us >> (msb - 3)) & (LAT_SUB_BUCKETS - 1));
+    }
+    return( index );
+  };
+  // returns the mid value of a bucket
+  static long long value_of( int index ) {
+    long long us = index;
+    if( index >= LAT_SUB_BUCKETS ) {
+      int msb = index / LAT_SUB_BUCKETS + 2;
+      long long width = 1LL << (msb - 3);
+      us = (LAT_SUB_BUCKETS + index % LAT_SUB_BUCKETS) * width + width / 2;
+    }
+    return( us );
+  };
+  // adds a trace, its total latency and its stage durations
+  void add( long long t0, long long t1, long long t2, long long t3 ) {
+    long long us = t3 - t0;
+    this->aCounts[bucket_of( us )]++;
+    this->numSamples++;
+    if( us > this->maxUs )
+      this->maxUs = us;
+    this->sumDispatchUs += t1 - t0;
+    this->sumNotifyUs += t2 - t1;
+    this->sumPaintUs += t3 - t2;
+  };
+  // returns the latency (us) at percentile p (0-100)
+  long long percentile( double p ) {
+    long long retVal = 0;
+    long long target = (long long) (p / 100.0 * this->numSamples + 0.5);
+    long long count = 0;
+    bool bFound = false;
+    if( target < 1 )
+      target = 1;
+    for( int i=0; i<LAT_BUCKETS && !bFound; i++ ) {
+      count += this->aCounts[i];
+      if( count >= target ) {
+        retVal = value_of( i );
+        bFound = true;
+      }
+    }
+    if( retVal > this->maxUs )
+      retVal = this->maxUs;
+    return( retVal );
+  };
+  int aCounts[LAT_BUCKETS];
+  int numSamples;
+  long long maxUs;
+  long long sumDispatchUs;
+  long long sumNotifyUs;
+  long long sumPaintUs; // stage sums, for the mean breakdown
+} SLatHist;
+// a trace whose intent has been notified but not yet painted
+typedef struct SLatTrace {
+  int slot;
+  long long t0;
+  long long t1;
+  long long t2;
+} SLatTrace;
+// the latency tracer owned by the mode manager
+// histograms are allocated on the first trace of their slot
+typedef struct SLatTracer {
+  void init() {
+    for( int i=0; i<LAT_MODE_TYPES*MAX_INTENTS; i++ )
+      this->apHists[i] = NULL;
+    this->numOpen = 0;
+    this->tKeyDown = -1;
+    this->tSyncPaint = -1;
+    this->bInNotify = false;
+  };
+  static long long now_us() {
+    return( lat_now_us() );
+  };
+  // called by ModalWindow::OnKeyDown
+  void key_down() {
+    this->tKeyDown = now_us();
+  };
+  // called by the mode manager before it calls a mode's fnKybd_map
+  void begin_notify( SMode *pMode ) {
+    pMode->tDispatch = -1;
+    this->tSyncPaint = -1;
+    this->bInNotify = true;
+  };
+  // called by the mode manager after a mode's fnKybd_map returns
+  // keys that did not dispatch an intent are not traced
+  // if the intent painted synchronously (wxWindow::Update) the trace is closed here
+  // else it stays open till the next paint
+  void end_notify( SMode *pMode, long long t0 ) {
+    long long t2 = now_us();
+    this->bInNotify = false;
+    if( pMode->tDispatch >= 0 && t0 >= 0 && pMode->type < LAT_MODE_TYPES && pMode->intent >= 0 && pMode->intent < MAX_INTENTS ) {
+      int slot = pMode->type * MAX_INTENTS + pMode->intent;
+      // painted within PH_NOTIFY, count the paint as part of the notify stage
+      if( this->tSyncPaint >= 0 )
+        this->add( slot, t0, pMode->tDispatch, this->tSyncPaint, this->tSyncPaint );
+      // keep it open till the next paint, a full list is closed first
+      else {
+        if( this->numOpen == LAT_MAX_OPEN )
+          this->paint_done();
+        this->aOpen[this->numOpen].slot = slot;
+        this->aOpen[this->numOpen].t0 = t0;
+        this->aOpen[this->numOpen].t1 = pMode->tDispatch;
+        this->aOpen[this->numOpen].t2 = t2;
+        this->numOpen++;
+      }
+    }
+  };
+  // called at the end of ModalWindow::OnPaint
+  // closes the open traces
+  void paint_done() {
+    long long t3 = now_us();
+    if( this->bInNotify )
+      this->tSyncPaint = t3;
+    else {
+      for( int i=0; i<this->numOpen; i++ )
+        this->add( this->aOpen[i].slot, this->aOpen[i].t0, this->aOpen[i].t1, this->aOpen[i].t2, t3 );
+      this->numOpen = 0;
+    }
+  };
+  void add( int slot, long long t0, long long t1, long long t2, long long t3 ) {
+    if( this->apHists[slot] == NULL ) {
+      this->apHists[slot] = (SLatHist *) malloc( sizeof(SLatHist) );
+      wxASSERT_MSG( this->apHists[slot] != NULL, "malloc failure" );
+      this->apHists[slot]->init();
+    }
+    this->apHists[slot]->add( t0, t1, t2, t3 );
+  };
+  // formats the stats of a slot as a single line
+  wxString format_slot( int slot ) {
+    SLatHist *pHist = this->apHists[slot];
+    wxString strLine;
+    if( pHist != NULL && pHist->numSamples > 0 ) {
+      double n = (double) pHist->numSamples;
+      strLine = wxString::Format( "%-16s %-22s n %6d  p50 %7.2f  p90 %7.2f  p99 %7.2f  max %7.2f ms  (key-intent %.2f  notify %.2f  paint %.2f)",
+        lat_mode_name( slot / MAX_INTENTS ), lat_intent_name( slot / MAX_INTENTS, slot % MAX_INTENTS ), pHist->numSamples,
+        pHist->percentile( 50.0 ) / 1000.0, pHist->percentile( 90.0 ) / 1000.0,
+        pHist->percentile( 99.0 ) / 1000.0, pHist->maxUs / 1000.0,
+        pHist->sumDispatchUs / n / 1000.0, pHist->sumNotifyUs / n / 1000.0, pHist->sumPaintUs / n / 1000.0 );
+    }
+    return( strLine );
+  };
+  // dumps the stats of every traced slot and their histograms to a text file
+  bool dump( const char *szPath ) {
+    bool bRetVal = true;
+    wxFile File;
+    File.Create( szPath, true );
+    if( File.IsOpened() ) {
+      File.Write( wxString( "input-to-pixel latency per mode and intent\n" ) );
+      for( int i=0; i<LAT_MODE_TYPES*MAX_INTENTS; i++ ) {
+        if( this->apHists[i] != NULL ) {
+          File.Write( this->format_slot( i ) + "\n" );
+          // the non empty buckets, as bucket mid value (us) and count
+          for( int j=0; j<LAT_BUCKETS; j++ )
+            if( this->apHists[i]->aCounts[j] > 0 )
+              File.Write( wxString::Format( "  %10lld us %8d\n", SLatHist::value_of( j ), this->apHists[i]->aCounts[j] ) );
+        }
+      }
+      File.Close();
+    }
+    else
+      bRetVal = false;
+    return( bRetVal );
+  };
+  SLatHist *apHists[LAT_MODE_TYPES*MAX_INTENTS];
+  SLatTrace aOpen[LAT_MAX_OPEN];
+  int numOpen;
+  long long tKeyDown; // t0 of the key being processed
+  long long tSyncPaint; // end of a paint that ran within PH_NOTIFY, -1 if none
+  bool bInNotify;
+} SLatTracer;
+// allocs and inits a latency tracer on the heap and returns it
+SLatTracer *new_lat_tracer() {
+  SLatTracer *pTracer = (SLatTracer *) malloc( sizeof(SLatTracer) );
+  wxASSERT_MSG( pTracer != NULL, "malloc failure" );
+  pTracer->init();
+  return( pTracer );
+}
+void free_lat_tracer( SLatTracer *pTracer ) {
+  if( pTracer != NULL ) {
+    for( int i=0; i<LAT_MODE_TYPES*MAX_INTENTS; i++ )
+      if( pTracer->apHists[i] != NULL )
+        free( pTracer->apHists[i] );
+    free( pTracer );
+  }
+}
 // a mode link structure used to implement a stack of modes (used by the ModeManager)
 typedef struct SModeLink {
   SMode *pMode;
@@ -430,12 +1578,30 @@ typedef struct SModeLink {
 // cause the back-to-front state display of each mode in the stack
 // if they are caused by a user action, they are sent 
 // to the display update method of the mode at the top of the stack. 
+// Navigation keys (arrows, PgUp, PgDn) arriving faster than a frame
+// are queued for modes that allow it (bCoalesceNav)
+// and dispatched as one batch, painted as a single frame, by ModalWindow's frame timer.
+// When pop-ups are stacked over the primary mode,
+// the modes below the top are frozen into a background bitmap
+// on the first full paint after the push.
+// Until the next push, pop or replace, full-screen refresh's
+// blit that bitmap and only redraw the mode at the top of the stack.
 typedef struct SModeManager {
   SModeLink Stack;
   SMode *pCurMode; // the mode currently at the top of the stack
   int scrnW;
   int scrnH;
   wxFont* pFont;
+  wxBitmap *pBgSnapshot; // frozen image of the modes below the top, NULL if invalid
+  wxKeyEvent *apPendingKeys[MAX_PENDING_KEYS]; // navigation keys queued for the next frame
+  long long aPendingKeyTimes[MAX_PENDING_KEYS]; // their key down times, for latency tracing
+  int numPendingKeys;
+  long stateEpoch; // bumped on every key dispatched to a mode
+  long savedEpoch; // stateEpoch when the session was last autosaved
+  SJournal *pJournal; // the journal of changes since the last snapshot
+  int snapGen; // the generation of the last snapshot
+  long lastNavTime; // time (ms, ModalWindow::m_FrameClock) the last navigation key was dispatched
+  SLatTracer *pTracer; // input-to-pixel latency tracer
   // inits with the screen dimensions
   void init( int scrnW, int scrnH, wxFont *pFont ) {
     Stack.pMode = NULL;
@@ -444,9 +1610,37 @@ typedef struct SModeManager {
     this->scrnH = scrnH;
     this->pCurMode = NULL;
     this->pFont = pFont;
+    this->pBgSnapshot = NULL;
+    this->numPendingKeys = 0;
+    this->stateEpoch = 0;
+    this->savedEpoch = 0;
+    this->pJournal = new_journal();
+    this->snapGen = 0;
+    this->lastNavTime = -FRAME_INTERVAL;
+    this->pTracer = new_lat_tracer();
+  };
+  // drops the frozen background
+  // called whenever the modes below the top of the stack change
+  void invalidate_bg() {
+    if( this->pBgSnapshot != NULL ) {
+      delete this->pBgSnapshot;
+      this->pBgSnapshot = NULL;
+    }
+  };
+  // draws the modes below the top into the frozen background again, within rect only
+  // called when they change only there, the caller then refreshes rect
+  // with no frozen background there is nothing to do, it's drawn whole on the next paint
+  void redraw_bg( ModalWindow *pWin, wxRect rect ) {
+    if( this->pBgSnapshot != NULL ) {
+      wxMemoryDC MemDC( *(this->pBgSnapshot) );
+      wxRegion Update( rect );
+      MemDC.SetClippingRegion( rect );
+      this->disp_stack( pWin, MemDC, true, &Update );
+    }
   };
   void push( SMode *pMode ) {
     pMode->set_font(this->pFont);
+    this->invalidate_bg();
     bool bLast = false;
     SModeLink *pThisLink = &(this->Stack);
     // uninitialized stack, add the mode to the root of the stack
@@ -482,6 +1676,7 @@ typedef struct SModeManager {
     bool bRetVal = true;
     bool bLast = false;
     SModeLink *pThisLink = &(this->Stack);
+    this->invalidate_bg();
     // the first link is the last link so return false 
     if( pThisLink->pNextLink == NULL ) 
       bRetVal = false;
@@ -508,6 +1703,7 @@ typedef struct SModeManager {
   // replace the node at the top of mode stack
   void replace( SMode *pNewMode ) {
     pNewMode->set_font(this->pFont);
+    this->invalidate_bg();
     bool bLast = false;
     SModeLink *pThisLink = &(this->Stack);
     // find the last link in the stack and replace it
@@ -530,9 +1726,42 @@ typedef struct SModeManager {
   // this method is called by ModalWindow : wxWindow :: OnPaint
   // when it receives a paint event that was not caused by a user action
   // which implies the entire screen is to be repainted.
-  // it calls disp_state on each of the modes in the stack
-  // starting from the primary mode
-  void disp_state( ModalWindow *pWin, wxDC& DC ) {
+  // if only the primary mode is loaded, it is drawn directly
+  // else the modes below the top are drawn once into the frozen background
+  // and subsequent repaints blit it and draw only the top mode
+  // pUpdateRgn is the region invalidated by the OS, NULL if it is all of the screen
+  // it is handed to the modes drawn on DC so they can skip what lies outside it
+  void disp_state( ModalWindow *pWin, wxDC& DC, wxRegion *pUpdateRgn ) {
+    // only the primary mode is loaded, draw it directly
+    if( this->Stack.pMode == NULL || this->Stack.pNextLink == NULL )
+      this->disp_stack( pWin, DC, false, pUpdateRgn );
+    // pop-ups are loaded
+    // freeze the modes below the top into the background bitmap if needed
+    // blit the background then draw the top mode in its own font
+    else {
+      // freeze the modes below the top into the background bitmap
+      if( this->pBgSnapshot == NULL ) {
+        this->pBgSnapshot = new wxBitmap();
+        this->pBgSnapshot->CreateScaled( this->scrnW, this->scrnH, wxBITMAP_SCREEN_DEPTH, pWin->GetContentScaleFactor() );
+        wxMemoryDC MemDC( *(this->pBgSnapshot) );
+        this->disp_stack( pWin, MemDC, true, NULL );
+      }
+      // blit the background then draw the top mode in its own font
+      DC.DrawBitmap( *(this->pBgSnapshot), 0, 0 );
+      if( this->pCurMode->pFont != NULL ) {
+        this->pCurMode->load_font();
+        DC.SetFont( *(this->pCurMode->pFont) );
+      }
+      this->pCurMode->pUpdateRgn = pUpdateRgn;
+      this->pCurMode->fnDisp_state( this->pCurMode, pWin, DC );
+      this->pCurMode->pUpdateRgn = NULL;
+    }
+    return;
+  };
+  // draws the mode stack back to front on DC
+  // if bSkipTop, the mode at the top of the stack is not drawn
+  // each mode is given pUpdateRgn (NULL draws everything) while it is drawn
+  void disp_stack( ModalWindow *pWin, wxDC& DC, bool bSkipTop, wxRegion *pUpdateRgn ) {
     // draw a BG color (208,208,200) rect over the entire screen
     wxRect rect;
     rect.x = 0;
@@ -550,14 +1779,20 @@ typedef struct SModeManager {
     if( pThisLink->pMode != NULL ) {
       // draw each link till the last one is reached
       while( !bLast ) {
-        // this is the last link, draw it and exit
+        // this is the last link, draw it (unless skipped) and exit
         if( pThisLink->pNextLink == NULL ) {
           bLast = true;
-          pThisLink->pMode->fnDisp_state( pThisLink->pMode, pWin, DC );
+          if( !bSkipTop ) {
+            pThisLink->pMode->pUpdateRgn = pUpdateRgn;
+            pThisLink->pMode->fnDisp_state( pThisLink->pMode, pWin, DC );
+            pThisLink->pMode->pUpdateRgn = NULL;
+          }
         }
         // this is not the last link, draw it and load nextlnk
         else {
+          pThisLink->pMode->pUpdateRgn = pUpdateRgn;
           pThisLink->pMode->fnDisp_state( pThisLink->pMode, pWin, DC );
+          pThisLink->pMode->pUpdateRgn = NULL;
           pThisLink = pThisLink->pNextLink;
         }
       }
@@ -575,19 +1810,102 @@ typedef struct SModeManager {
     return;
   };  
   // calls the fnKybd_map() fn of the currently active mode
+  // a navigation key that arrives within a frame interval of the previous one
+  // is queued and dispatched by the frame timer at the end of the interval
+  // any other key first dispatches the queue so that input order is kept
   bool kybd_map( wxKeyEvent &Event, ModalWindow *pWin ) {
     pWin->m_bUsrActn = true;
-    if (this->pCurMode != NULL)
-      this->pCurMode->fnKybd_map(this->pCurMode, Event, pWin);  
+    if (this->pCurMode != NULL) {
+      // a navigation key
+      // dispatch it now if a frame interval has passed and nothing is queued
+      // else queue it and arm the frame timer for the rest of the interval
+      if( this->is_nav_key( Event ) ) {
+        long elapsed = pWin->m_FrameClock.Time() - this->lastNavTime;
+        // dispatch it now
+        if( this->numPendingKeys == 0 && elapsed >= FRAME_INTERVAL ) {
+          this->lastNavTime = pWin->m_FrameClock.Time();
+          this->dispatch_key( Event, this->pTracer->tKeyDown, pWin );
+        }
+        // queue it, a full queue is dispatched at once
+        else {
+          this->apPendingKeys[this->numPendingKeys] = (wxKeyEvent *) Event.Clone();
+          this->aPendingKeyTimes[this->numPendingKeys] = this->pTracer->tKeyDown;
+          this->numPendingKeys++;
+          if( this->numPendingKeys == MAX_PENDING_KEYS )
+            this->flush_nav_keys( pWin );
+          else if( !pWin->m_FrameTimer.IsRunning() ) {
+            int wait = FRAME_INTERVAL - elapsed;
+            pWin->m_FrameTimer.StartOnce( wait > 0 ? wait : 1 );
+          }
+        }
+      }
+      // any other key, dispatch the queue first
+      else {
+        this->flush_nav_keys( pWin );
+        pWin->m_bUsrActn = true;
+        this->dispatch_key( Event, this->pTracer->tKeyDown, pWin );
+      }
+    }
     return(true);
   }
+  // calls the fnKybd_map() fn of the currently active mode
+  // and traces it, tKeyDown is the time the key went down
+  void dispatch_key( wxKeyEvent &Event, long long tKeyDown, ModalWindow *pWin ) {
+    SMode *pMode = this->pCurMode;
+    this->stateEpoch++;
+    this->pTracer->begin_notify( pMode );
+    pMode->fnKybd_map( pMode, Event, pWin );
+    this->pTracer->end_notify( pMode, tKeyDown );
+  }
   // calls the fnKey_up() fn of the currently active mode
   bool key_up( wxKeyEvent &Event, ModalWindow *pWin ) {
+    this->flush_nav_keys( pWin );
     pWin->m_bUsrActn = true;
+    this->stateEpoch++;
     if (this->pCurMode != NULL)
       this->pCurMode->fnKey_up(this->pCurMode, Event, pWin);    
     return(true);
   }
+  // returns true if Event is a navigation key the current mode allows to be coalesced
+  // modifier chords (e.g. Ctrl-Arrow for goto) are never coalesced
+  bool is_nav_key( wxKeyEvent &Event ) {
+    bool bRetVal = false;
+    if( this->pCurMode != NULL && this->pCurMode->bCoalesceNav ) {
+      if( !this->pCurMode->bCtrlDown && !this->pCurMode->bShiftDown ) {
+        int key = Event.GetKeyCode();
+        bRetVal = key == WXK_UP || key == WXK_DOWN || key == WXK_LEFT || key == WXK_RIGHT;
+        bRetVal |= key == WXK_PAGEUP || key == WXK_PAGEDOWN;
+      }
+    }
+    return( bRetVal );
+  }
+  // dispatches the queued navigation keys in order
+  // called by the frame timer, when the queue is full, or before any other key
+  // a batch of more than one key is dispatched with ModalWindow::m_bCoalescing set
+  // so intent handlers only invalidate, and the net movement is painted as one frame
+  void flush_nav_keys( ModalWindow *pWin ) {
+    if( this->numPendingKeys > 0 ) {
+      bool bBatch = this->numPendingKeys > 1;
+      pWin->m_FrameTimer.Stop();
+      pWin->m_bCoalescing = bBatch;
+      // dispatch the queued keys in order
+      for( int i=0; i<this->numPendingKeys; i++ ) {
+        pWin->m_bUsrActn = true;
+        if( this->pCurMode != NULL )
+          this->dispatch_key( *(this->apPendingKeys[i]), this->aPendingKeyTimes[i], pWin );
+        delete this->apPendingKeys[i];
+        this->apPendingKeys[i] = NULL;
+      }
+      this->numPendingKeys = 0;
+      pWin->m_bCoalescing = false;
+      // paint the net result of the batch in a single frame
+      if( bBatch ) {
+        pWin->m_bUsrActn = false;
+        pWin->Refresh( true );
+      }
+      this->lastNavTime = pWin->m_FrameClock.Time();
+    }
+  }
   // resets the stored kybd state for all contained modes.
   // this fn is called when a paint evt occurs due to a system action
   // such as a window swap out swap in.
@@ -621,16 +1939,86 @@ typedef struct SModeManager {
       }
     }
   }
+  // begins a new snapshot generation
+  // called before the session is serialized into a snapshot
+  // the journal is rotated so that the changes from here on go with the new snapshot
+  void begin_snapshot() {
+    this->snapGen++;
+    this->pJournal->rotate( this->snapGen );
+  };
+  // replays the journals of the restored snapshot's generation onto the modes in the stack
+  // State.hxj.old is left over when the last snapshot was not saved,
+  // it is replayed first followed by State.hxj which then is of a later generation
+  // returns the number of records replayed
+  int replay_journal() {
+    int gen = -1;
+    int numReplayed = this->replay_file( JOURNAL_OLD_FILE, false, &gen );
+    numReplayed += this->replay_file( JOURNAL_FILE, gen == this->snapGen, &gen );
+    return( numReplayed );
+  };
+  // replays the journal at szPath if it is of the snapshot's generation
+  // or, with bLater, of a later one
+  // each record is passed to the modes in the stack, bottom up, till one replays it
+  // sets *pGen to the journal's generation (-1 if there's no journal)
+  // and returns the number of records replayed
+  int replay_file( const char *szPath, bool bLater, int *pGen ) {
+    int numReplayed = 0;
+    *pGen = -1;
+    SBufFile *pFile = new_buf_file();
+    if( wxFile::Exists( szPath ) && pFile->open( szPath ) && !pFile->bLegacy ) {
+      if( pFile->open_next_chunk() == HXC_JNL_GEN ) {
+        pFile->Read( pGen, sizeof(int) );
+        pFile->close_chunk();
+      }
+      if( *pGen == this->snapGen || ( bLater && *pGen > this->snapGen ) ) {
+        int type = pFile->open_next_chunk();
+        while( type != -1 ) {
+          bool bReplayed = false;
+          SModeLink *pThisLink = &(this->Stack);
+          while( pThisLink != NULL && !bReplayed ) {
+            if( pThisLink->pMode != NULL && pThisLink->pMode->fnReplay != NULL )
+              bReplayed = pThisLink->pMode->fnReplay( pThisLink->pMode, *pFile, type );
+            pThisLink = pThisLink->pNextLink;
+          }
+          if( bReplayed )
+            numReplayed++;
+          pFile->close_chunk();
+          type = pFile->open_next_chunk();
+        }
+      }
+      pFile->close();
+    }
+    free_buf_file( pFile );
+    return( numReplayed );
+  };
+  // resumes each mode in the stack once the session is restored and its journal replayed
+  // returns true if any mode's state changed
+  bool resume() {
+    bool bChanged = false;
+    SModeLink *pThisLink = &(this->Stack);
+    while( pThisLink != NULL ) {
+      if( pThisLink->pMode != NULL && pThisLink->pMode->fnResume != NULL )
+        bChanged |= pThisLink->pMode->fnResume( pThisLink->pMode );
+      pThisLink = pThisLink->pNextLink;
+    }
+    if( bChanged )
+      this->stateEpoch++;
+    return( bChanged );
+  };
   // serializes to/from a file the state of this mode manager
   // called when a Modal app exits
-  // stores the mode stack and every mode in the mode stack
-  bool serialize( wxFile &File, bool bToFrom ) {
+  // stores the snapshot's generation, the mode stack and every mode in the mode stack
+  bool serialize( SBufFile &File, bool bToFrom ) {
     bool bRetVal = true;
     bool bNextLink = false;
     // store each next link (if !NULL) starting from the first
     if( bToFrom ) {
       SModeLink *pThisLink = &(this->Stack);
       bool bLast = false;
+      File.begin_chunk( HXC_JNL_GEN );
+      File.Write( &(this->snapGen), sizeof(int) );
+      File.end_chunk();
+      File.begin_chunk( HXC_MODE_STACK );
       // the stack is not empty, traverse throguh its links and serialize them
       if( pThisLink->pMode != NULL ) {
         // keep traversing till end of stack or link serialization error
@@ -657,27 +2045,45 @@ typedef struct SModeManager {
           }
         }
       }
+      File.end_chunk();
     }
-    // load the stack from the serialized data
+    // load the snapshot's generation and the stack from the serialized data
+    // fails if the stack is corrupt or a mode could not be loaded
+    // old-format files have no generation, their journal (if any) is not replayed
     else {
-      bool bNextLink = true;
-      SModeLink *pNextLink = &(this->Stack);
-      // keep loading links till the last link is reached
-      while (bNextLink) {
-        File.Read(&(bNextLink), sizeof(bool));
-        pNextLink->pMode = load_mode(scrnW, scrnH, File);
-        pNextLink->pMode->set_font(this->pFont);
-        // there are more links. Load this link and goto next link
-        if (bNextLink) {
-          pNextLink->pNextLink = (SModeLink*)malloc(sizeof(SModeLink));
-          pNextLink = pNextLink->pNextLink;
-        }
-        // there are no more links. Signal link load exit. Set curMode
-        else {
-          pNextLink->pNextLink = NULL;
-          this->pCurMode = pNextLink->pMode;
+      this->snapGen = -1;
+      if( !File.bLegacy && File.open_chunk( HXC_JNL_GEN ) ) {
+        File.Read( &(this->snapGen), sizeof(int) );
+        File.close_chunk();
+      }
+      if( File.open_chunk( HXC_MODE_STACK ) ) {
+        bool bNextLink = true;
+        SModeLink *pNextLink = &(this->Stack);
+        // keep loading links till the last link is reached
+        while (bNextLink) {
+          File.Read(&(bNextLink), sizeof(bool));
+          pNextLink->pMode = load_mode(scrnW, scrnH, File);
+          if (pNextLink->pMode != NULL)
+            pNextLink->pMode->set_font(this->pFont);
+          else {
+            bRetVal = false;
+            bNextLink = false;
+          }
+          // there are more links. Load this link and goto next link
+          if (bNextLink) {
+            pNextLink->pNextLink = (SModeLink*)malloc(sizeof(SModeLink));
+            pNextLink = pNextLink->pNextLink;
+          }
+          // there are no more links. Signal link load exit. Set curMode
+          else {
+            pNextLink->pNextLink = NULL;
+            this->pCurMode = pNextLink->pMode;
+          }
         }
+        File.close_chunk();
       }
+      else
+        bRetVal = false;
     }
     return( bRetVal );
   };
@@ -690,7 +2096,7 @@ SModeManager * new_mode_manager( int scrnW, int scrnH, wxFont *pFont ) {
   return( pModeManager );
 }
 // loads a mode manager from state stored in a file
-SModeManager *load_mode_manager( int scrnW, int scrnH, wxFont *pFont, wxFile &File ) {
+SModeManager *load_mode_manager( int scrnW, int scrnH, wxFont *pFont, SBufFile &File ) {
   SModeManager *pModeManager = (SModeManager *) malloc( sizeof(SModeManager) );
   pModeManager->init( scrnW, scrnH, pFont );
   pModeManager->serialize( File, false );
@@ -723,12 +2129,19 @@ void free_mode_manager( SModeManager *pModeManager ) {
   }
   // free the link set
   for (int i = numLinks - 1; i >= 0; i--) {
-    free_mode( ppLinkSet[i]->pMode );
+    // a mode may be missing from a stack whose restore failed
+    if( ppLinkSet[i]->pMode != NULL )
+      free_mode( ppLinkSet[i]->pMode );
     // dont free the first link since that's on the stack and not the heap
     if( i>0 )
       free(ppLinkSet[i]);
   }
   free( ppLinkSet );
+  for (int i = 0; i < pModeManager->numPendingKeys; i++)
+    delete pModeManager->apPendingKeys[i];
+  pModeManager->invalidate_bg();
+  free_lat_tracer( pModeManager->pTracer );
+  free_journal( pModeManager->pJournal );
   delete pModeManager->pFont;
   free( pModeManager );
 }
@@ -751,6 +2164,12 @@ public:
 wxIMPLEMENT_APP(MyApp);
 // the app's entry point
 bool MyApp::OnInit() {
+  crc32_init();
+#ifdef MODAL_BENCH
+  // the benchmark build runs headless and exits without creating a window
+  // this is done before wxApp::OnInit() which would reject the bench's options
+  exit( render_bench( argv.GetArguments() ) ? EXIT_SUCCESS : EXIT_FAILURE );
+#endif
   if( !wxApp::OnInit() )
     return false;
   int scrnWidth = wxSystemSettings::GetMetric(wxSYS_SCREEN_X,NULL);
@@ -775,19 +2194,74 @@ ModalWindow::ModalWindow(MyFrame *pOwner, wxSize Size ) : wxWindow(pOwner, wxID_
   double dScale = GetContentScaleFactor();
   m_pModeManager = modal_init( Size.GetWidth()/dScale, Size.GetHeight()/dScale );
   m_bUsrActn = false;
+  m_bCoalescing = false;
   m_pOwner = pOwner;
+  // the frame timer dispatches queued navigation keys to the mode manager
+  m_FrameTimer.SetOwner( this, ID_FRAME_TIMER );
+  m_FrameClock.Start();
+  m_lastInputTime = 0;
+  // the autosave timer saves the session in the background
+  m_pSaveThread = NULL;
+  m_AutosaveTimer.SetOwner( this, ID_AUTOSAVE_TIMER );
+  m_AutosaveTimer.Start( AUTOSAVE_INTERVAL );
+  m_JournalTimer.SetOwner( this, ID_JOURNAL_TIMER );
+  m_pExportThread = NULL;
+  m_pBuildProcess = NULL;
+  m_BuildTimer.SetOwner( this, ID_BUILD_TIMER );
+  m_pDebugProcess = NULL;
+  m_DebugTimer.SetOwner( this, ID_DEBUG_TIMER );
+  // the codebase of a restored session is indexed for search in the background
+  m_pIndexThread = NULL;
+  m_pScan = NULL;
+  m_pDirLoads = NULL;
+  if( m_pModeManager->pCurMode != NULL && m_pModeManager->pCurMode->type == MODE_SOURCE_EDITOR )
+    src_edr_start_index( m_pModeManager->pCurMode, this );
 }
 ModalWindow::~ModalWindow() {
+  // an autosave or export in progress has to finish before the final save
+  m_AutosaveTimer.Stop();
+  m_JournalTimer.Stop();
+  if( m_pSaveThread != NULL )
+    modal_autosave_done( m_pSaveThread, m_pModeManager );
+  if( m_pExportThread != NULL )
+    src_edr_export_done( m_pExportThread, NULL );
+  if( m_pIndexThread != NULL )
+    src_edr_index_done( m_pIndexThread, NULL );
+  src_edr_end_scan( this );
+  file_sel_end_loads( this );
+  // a running build or debug session is abandoned, wx deletes the detached process when it ends
+  m_BuildTimer.Stop();
+  if( m_pBuildProcess != NULL ) {
+    long pid = m_pBuildProcess->GetPid();
+    m_pBuildProcess->Detach();
+    wxProcess::Kill( pid, wxSIGKILL );
+  }
+  m_DebugTimer.Stop();
+  if( m_pDebugProcess != NULL ) {
+    long pid = m_pDebugProcess->GetPid();
+    m_pDebugProcess->Detach();
+    wxProcess::Kill( pid, wxSIGKILL );
+  }
   modal_exit(m_pModeManager);
 }
 void ModalWindow::OnPaint(wxPaintEvent& event) {
-  wxAutoBufferedPaintDC DC(this);
-  // event was produced by the OS (load or relaod app) not the user
-  if (!m_bUsrActn) 
-    m_pModeManager->disp_state(this, DC);
-  // event is a response to a user action
-  else 
-    m_pModeManager->disp_update(this, DC);
+  // the DC is scoped so the buffer is blitted before the paint is traced
+  {
+    wxAutoBufferedPaintDC DC(this);
+    // event was produced by the OS (load or relaod app) not the user
+    // only the invalidated region is redrawn, NULL if it covers the whole window
+    if (!m_bUsrActn) {
+      wxRegion Update( GetUpdateRegion() );
+      wxRegion *pUpdate = &Update;
+      if( Update.Contains( GetClientRect() ) == wxInRegion )
+        pUpdate = NULL;
+      m_pModeManager->disp_state(this, DC, pUpdate);
+    }
+    // event is a response to a user action
+    else 
+      m_pModeManager->disp_update(this, DC);
+  }
+  m_pModeManager->pTracer->paint_done();
   return;
 }
 // Needed by wxWidgets, helps to reduce flicker
@@ -795,8 +2269,14 @@ void ModalWindow::EraseBG(wxEraseEvent& event) {
   return;
 }
 void ModalWindow::OnKeyDown(wxKeyEvent& event) {
-  if (m_pModeManager != NULL) 
+  m_lastInputTime = m_FrameClock.Time();
+  if (m_pModeManager != NULL) {
+    m_pModeManager->pTracer->key_down();
     m_pModeManager->kybd_map( event, this );
+    // commit what the key journaled along with whatever follows it in the commit interval
+    if( m_pModeManager->pJournal->numPending > 0 && !m_JournalTimer.IsRunning() )
+      m_JournalTimer.StartOnce( JOURNAL_COMMIT_INTERVAL );
+  }
   return;
 }
 void ModalWindow::OnKeyUp(wxKeyEvent& event) {
@@ -819,11 +2299,115 @@ void ModalWindow::OnKeyUp(wxKeyEvent& event) {
 // These need to be reset before further kybd event processing.
 // Hence reset_kybd_state is called here
 void ModalWindow::OnLostFocus(wxFocusEvent& event) {
-  if (m_pModeManager != NULL) 
+  if (m_pModeManager != NULL) {
+    m_pModeManager->flush_nav_keys( this );
     m_pModeManager->reset_kybd_state();
+  }
   event.Skip();
   return;
 }
+// Processes the frame timer armed by SModeManager::kybd_map
+// dispatches the navigation keys queued during the last frame interval
+void ModalWindow::OnFrameTimer(wxTimerEvent& event) {
+  if (m_pModeManager != NULL) 
+    m_pModeManager->flush_nav_keys( this );
+  return;
+}
+// Processes the autosave timer
+// if the user is typing, retries once they have been idle for AUTOSAVE_IDLE
+// otherwise starts a new autosave if none is running
+void ModalWindow::OnAutosaveTimer(wxTimerEvent& event) {
+  if( m_FrameClock.Time() - m_lastInputTime < AUTOSAVE_IDLE )
+    m_AutosaveTimer.StartOnce( AUTOSAVE_IDLE );
+  else {
+    if( m_pSaveThread == NULL && m_pModeManager != NULL )
+      m_pSaveThread = modal_autosave( m_pModeManager, this );
+    m_AutosaveTimer.Start( AUTOSAVE_INTERVAL );
+  }
+  return;
+}
+// Processes the journal timer armed by OnKeyDown
+// commits the changes journaled during the last commit interval
+void ModalWindow::OnJournalTimer(wxTimerEvent& event) {
+  if (m_pModeManager != NULL) 
+    m_pModeManager->pJournal->commit();
+  return;
+}
+// Processes the event the autosave thread sends when it has written the snapshot
+// reaps the thread, which tells the user if the snapshot could not be saved
+void ModalWindow::OnAutosaveDone(wxThreadEvent& event) {
+  if (m_pSaveThread != NULL) {
+    modal_autosave_done(m_pSaveThread, m_pModeManager);
+    m_pSaveThread = NULL;
+  }
+  return;
+}
+// Processes the event the export thread sends when it has written the source
+// reaps the thread and lets the src editor tell the user
+void ModalWindow::OnExportDone(wxThreadEvent& event) {
+  if (m_pExportThread != NULL) {
+    src_edr_export_done(m_pExportThread, this);
+    m_pExportThread = NULL;
+  }
+  return;
+}
+// Processes the event the index thread sends when it has indexed the codebase
+// reaps the thread and lets the src editor install the index, which may start another
+void ModalWindow::OnIndexDone(wxThreadEvent& event) {
+  if (m_pIndexThread != NULL) {
+    wxThread* pThread = m_pIndexThread;
+    m_pIndexThread = NULL;
+    src_edr_index_done(pThread, this);
+  }
+  return;
+}
+// Processes the events the scan threads send as they find lines
+// lets the src editor show the lines found so far, the scan is reaped once they're all done
+void ModalWindow::OnScanHits(wxThreadEvent& event) {
+  if (m_pScan != NULL)
+    src_edr_scan_hits(this);
+  return;
+}
+// Processes the events the dir load threads send as they find entries
+// lets the file selector add them to its panels, the loads are reaped once they're done
+void ModalWindow::OnDirEntries(wxThreadEvent& event) {
+  file_sel_take_entries(this);
+  return;
+}
+// Processes the build timer started with a build
+// lets the src editor read what the compiler has output so far
+void ModalWindow::OnBuildTimer(wxTimerEvent& event) {
+  if (m_pBuildProcess != NULL)
+    src_edr_build_poll(m_pBuildProcess, this);
+  return;
+}
+// Processes the event sent when the build's compiler exits
+// lets the src editor read the rest of its output and show the diagnostics
+void ModalWindow::OnBuildEnd(wxProcessEvent& event) {
+  m_BuildTimer.Stop();
+  if (m_pBuildProcess != NULL) {
+    src_edr_build_done(m_pBuildProcess, event.GetExitCode(), this);
+    m_pBuildProcess = NULL;
+  }
+  return;
+}
+// Processes the debug timer started with a debug session
+// lets the src editor read what the debugger has output so far
+void ModalWindow::OnDebugTimer(wxTimerEvent& event) {
+  if (m_pDebugProcess != NULL)
+    src_edr_debug_poll(m_pDebugProcess, this);
+  return;
+}
+// Processes the event sent when the debugger exits
+// lets the src editor end the debug session
+void ModalWindow::OnDebugEnd(wxProcessEvent& event) {
+  m_DebugTimer.Stop();
+  if (m_pDebugProcess != NULL) {
+    src_edr_debug_done(m_pDebugProcess, this);
+    m_pDebugProcess = NULL;
+  }
+  return;
+}
 // BLOCK: UTILITIES PROVIDED BY THE TOOLKIT
 // Some utlity structs and fns provided by Modal
 // Text processing for line and pages of text
@@ -841,7 +2425,96 @@ typedef struct STxtLine {
   char *szBuf;
   int length;
   int maxLength;
+  long shareEpoch; // the epoch of the last copy of lines szBuf was shared with (see SLineShares), 0 if none
 } STxtLine;
+// Copies of lines for worker threads (see SLineCopy), and autosave images (see SBufFile::WriteShared()),
+// point at the buffers of the lines instead of copying their chars.
+// Each copy takes an epoch and stamps the lines it shares with it.
+// A line stamped with the epoch of a live copy gets a buffer of its own before it's written to
+// (see tl_own()), and its old buffer is retired, not freed, as it is when the line is freed.
+// A retired buffer is freed once every copy that may point at it is freed.
+// It's used on the main thread, worker threads only read the buffers shared.
+typedef struct SLineShares {
+  // begins a copy, returns its epoch
+  long begin() {
+    if( this->numLive == this->maxLive ) {
+      this->maxLive = this->maxLive * 2 + 4;
+      this->pLive = (long *) realloc( this->pLive, this->maxLive * sizeof(long) );
+      wxASSERT_MSG( this->pLive != NULL, "malloc failure" );
+    }
+    this->epoch++;
+    this->pLive[this->numLive] = this->epoch;
+    this->numLive++;
+    return( this->epoch );
+  };
+  // ends the copy of epoch, frees the buffers no copy may point at any more
+  void end( long epoch ) {
+    for( int i=0; i<this->numLive; i++ ) {
+      if( this->pLive[i] == epoch ) {
+        this->numLive--;
+        this->pLive[i] = this->pLive[this->numLive];
+        break;
+      }
+    }
+    int numKept = 0;
+    for( int i=0; i<this->numRetired; i++ ) {
+      if( this->is_live( this->pRetiredEpochs[i] ) ) {
+        this->pszRetired[numKept] = this->pszRetired[i];
+        this->pRetiredEpochs[numKept] = this->pRetiredEpochs[i];
+        numKept++;
+      }
+      else
+        free( this->pszRetired[i] );
+    }
+    this->numRetired = numKept;
+  };
+  // true if a copy of epoch shareEpoch or earlier is live, it may point at a buffer stamped shareEpoch
+  bool is_live( long shareEpoch ) {
+    bool bRetVal = false;
+    for( int i=0; i<this->numLive && !bRetVal; i++ )
+      bRetVal = this->pLive[i] <= shareEpoch;
+    return( bRetVal );
+  };
+  // true if the buffer of pLine may be pointed at by a live copy
+  bool is_shared( STxtLine *pLine ) {
+    return( pLine->shareEpoch != 0 && this->numLive > 0 && this->is_live( pLine->shareEpoch ) );
+  };
+  // retires the buffer szBuf of a line stamped shareEpoch
+  void retire( char *szBuf, long shareEpoch ) {
+    if( this->numRetired == this->maxRetired ) {
+      this->maxRetired = this->maxRetired * 2 + 64;
+      this->pszRetired = (char **) realloc( this->pszRetired, this->maxRetired * sizeof(char *) );
+      this->pRetiredEpochs = (long *) realloc( this->pRetiredEpochs, this->maxRetired * sizeof(long) );
+      wxASSERT_MSG( this->pszRetired != NULL && this->pRetiredEpochs != NULL, "malloc failure" );
+    }
+    this->pszRetired[this->numRetired] = szBuf;
+    this->pRetiredEpochs[this->numRetired] = shareEpoch;
+    this->numRetired++;
+  };
+  long epoch; // the epoch of the last copy begun
+  long *pLive; // the epochs of the copies not yet ended
+  int numLive;
+  int maxLive;
+  char **pszRetired; // the buffers retired and the epochs they were stamped with
+  long *pRetiredEpochs;
+  int numRetired;
+  int maxRetired;
+} SLineShares;
+SLineShares LineShares = { 0, NULL, 0, 0, NULL, NULL, 0, 0 };
+// gives pLine a buffer of its own if it's shared with a live copy of lines
+// called before pLine's buffer is written to or realloc'd
+void tl_own( STxtLine *pLine ) {
+  if( LineShares.is_shared( pLine ) ) {
+    int maxLength = pLine->maxLength > pLine->length ? pLine->maxLength : pLine->length;
+    char *szBuf = (char *) malloc( (maxLength + 1) * sizeof(char) );
+    wxASSERT_MSG( szBuf != NULL, "malloc failure" );
+    memcpy( szBuf, pLine->szBuf, pLine->length );
+    szBuf[pLine->length] = 0;
+    LineShares.retire( pLine->szBuf, pLine->shareEpoch );
+    pLine->szBuf = szBuf;
+  }
+  pLine->shareEpoch = 0;
+}
 // gets the screen location of the caret at the specified index in the line
 // based on the current font loaded in the DC
 int tl_caret_loc(STxtLine* pLine, int index, wxDC& DC, ModalWindow *pWin ) {
@@ -858,6 +2531,7 @@ int tl_caret_loc(STxtLine* pLine, int index, wxDC& DC, ModalWindow *pWin ) {
   szTemp[strLen] = 0;
   int width;
   int height;
+  BENCH_COUNT(benchTxtExtentCalls);
   DC.GetTextExtent( wxString( szTemp ), &width, &height );
   retVal = width - 1;
   free(szTemp);
@@ -868,6 +2542,7 @@ int tl_caret_loc(STxtLine* pLine, int index, wxDC& DC, ModalWindow *pWin ) {
 STxtLine* new_txt_line( char *szData ) {
   STxtLine* pRetVal = (STxtLine*)malloc(sizeof(STxtLine));
   wxASSERT_MSG(pRetVal != NULL, "malloc failure");
+  pRetVal->shareEpoch = 0;
   int len = 0;
   // create a line with 100 chars if pcData == NULL else strlen(pcData) chars 
   // create a line with 100 chars
@@ -895,7 +2570,11 @@ STxtLine* new_txt_line( char *szData ) {
 void tl_free( STxtLine *pLine ) {
   if (pLine != NULL) {
     if (pLine->szBuf != NULL) {
-      free(pLine->szBuf);
+      // a copy of lines may still point at its buffer
+      if( LineShares.is_shared( pLine ) )
+        LineShares.retire( pLine->szBuf, pLine->shareEpoch );
+      else
+        free(pLine->szBuf);
       pLine->szBuf = NULL;
     }
     free(pLine);
@@ -911,6 +2590,7 @@ STxtLine * new_txt_line_wx( wxString strFrom ) {
   int len = strlen( szTemp );
   pRetVal->maxLength = len * 2 + 1; 
   pRetVal->length = len;
+  pRetVal->shareEpoch = 0;
   pRetVal->szBuf = (char *) malloc( (pRetVal->maxLength+1) * sizeof(char) );
   wxASSERT_MSG(pRetVal->szBuf != NULL, "malloc failure");
 
@@ -927,6 +2607,7 @@ STxtLine get_txt_line( char pcFrom[] ) {
   STxtLine RetVal;
   RetVal.maxLength = length * 2 + 1;
   RetVal.length = length;
+  RetVal.shareEpoch = 0;
   RetVal.szBuf = (char *) malloc( (RetVal.maxLength+1) * sizeof(char) );
   wxASSERT_MSG(RetVal.szBuf != NULL, "malloc failure");
   for (int i = 0; i < RetVal.length; i++)
@@ -941,6 +2622,7 @@ STxtLine * tl_clone( STxtLine *pszFrom ) {
   wxASSERT_MSG(pRetVal != NULL, "malloc failure");
   pRetVal->maxLength = pszFrom->maxLength;
   pRetVal->length = pszFrom->length;
+  pRetVal->shareEpoch = 0;
   pRetVal->szBuf = (char *) malloc((pRetVal->maxLength + 1) * sizeof(char));
   wxASSERT_MSG(pRetVal->szBuf != NULL, "malloc failure");
   for (int i = 0; i < pRetVal->length; i++)
@@ -951,22 +2633,27 @@ STxtLine * tl_clone( STxtLine *pszFrom ) {
 // inserts the sepcified char at the specified location in the txtline
 // if index is -1 or greater than txtline->length, char is appended to the end
 void tl_insert_char( STxtLine *pThis, char cChar, int index ) {
+  tl_own( pThis );
   int idx;
   wxASSERT_MSG( index >=0 && index <= pThis->length, "index OOR in tl_insert_char");
   idx = index;
-  if( idx >= pThis->maxLength ) {
+  // grow when full, szBuf holds maxLength chars and the terminating 0
+  if( pThis->length >= pThis->maxLength ) {
     pThis->maxLength = pThis->maxLength * 2 + 1;
-    pThis->szBuf = (char *) realloc( pThis->szBuf, pThis->maxLength * sizeof(char) );
+    pThis->szBuf = (char *) realloc( pThis->szBuf, (pThis->maxLength + 1) * sizeof(char) );
+    wxASSERT_MSG( pThis->szBuf != NULL, "malloc failure" );
   }
   for( int i=pThis->length-1; i>=idx; i-- )
     pThis->szBuf[i+1] = pThis->szBuf[i];
   pThis->szBuf[idx] = cChar;
   pThis->length += 1;
+  pThis->szBuf[pThis->length] = 0;
   return;
 }
 // deletes char at the specified location in the txtline
 // if index is -1 or greater than txtline->length, char is deleted from the end
 void tl_delete_char( STxtLine *pThis, int index ) {
+  tl_own( pThis );
   int idx;
   wxASSERT_MSG(index >= 0 && index <= pThis->length, "index OOR in tl_insert_char");
   idx = index;
@@ -980,6 +2667,7 @@ void tl_delete_char( STxtLine *pThis, int index ) {
 // and returns the cutout as an szString
 // caller must free
 char * tl_cut_out( STxtLine *pThis, int from, int to ) {
+  tl_own( pThis );
   char * pcRetVal = NULL;
   wxASSERT_MSG(!(from < 0 || to > pThis->length || to < from), "invalid indices in call to tl_cut_out");
   pcRetVal = (char *) malloc( (to-from+1) * sizeof( char ) );
@@ -994,6 +2682,7 @@ char * tl_cut_out( STxtLine *pThis, int from, int to ) {
 }
 // inserts the specified szString at the specified location in TxtLine
 void tl_insert( STxtLine *pThis, char szToken[], int at ) {
+  tl_own( pThis );
   int length = strlen( szToken );
   if( (pThis->length + length + 1) > pThis->maxLength ) {
     pThis->maxLength = pThis->length + length + 1;
@@ -1080,6 +2769,7 @@ bool tl_isempty( STxtLine *pThis ) {
 // removes the specified szString, if it exists from the TxtLine
 // returns true if found and removed
 bool tl_remove( STxtLine *pThis, char pcToken[] ) {
+  tl_own( pThis );
   bool bFound = false;
   int lenToken = strlen( pcToken );
   wxASSERT_MSG(lenToken > 0, "empty string in tl_remove");
@@ -1152,6 +2842,7 @@ STxtLine* tl_before_first_deref( STxtLine *pThis ) {
 // of the specified szString token.
 // return true if found and shortened
 bool tl_before_first( STxtLine *pThis, char pcToken[] ) {
+  tl_own( pThis );
   bool bFound = false;
   int lenToken = strlen( pcToken );
   wxASSERT_MSG( lenToken > 0, "empty string passed to tl_remove");
@@ -1298,6 +2989,7 @@ STxtLine* tl_extract_word(STxtLine* pThis, char *pcSeparator) {
 // trims out any spaces and tabs from both sides of this TxtLine
 // returns true if any trimming was done
 bool tl_trim( STxtLine *pThis ) {
+  tl_own( pThis );
   bool bRetVal = false;
   bool bFound = true;
   char cTest;
@@ -1340,7 +3032,7 @@ bool tl_trim( STxtLine *pThis ) {
 
   return( bRetVal );
 }
-void tl_serialize( STxtLine *pLine, wxFile &File, bool bToFrom ) {
+void tl_serialize( STxtLine *pLine, SBufFile &File, bool bToFrom ) {
   // write to 
   if( bToFrom ) {
     File.Write( &(pLine->length), sizeof(int) );
@@ -1350,22 +3042,152 @@ void tl_serialize( STxtLine *pLine, wxFile &File, bool bToFrom ) {
   else {
     File.Read( &(pLine->length), sizeof(int) );
     pLine->szBuf = (char *) malloc( (pLine->length+1) * sizeof(char) );
-    pLine->maxLength = pLine->length+1;
+    pLine->maxLength = pLine->length;
+    pLine->shareEpoch = 0;
     File.Read( pLine->szBuf, (pLine->length+1) * sizeof(char) );
   }
 }
+// writes pLine to File as tl_serialize() does, its chars by reference if File shares the lines
+// the line is stamped to keep them, so it's only for lines written to through the tl_ fns (see tl_own())
+void tl_serialize_shared( STxtLine *pLine, SBufFile &File ) {
+  File.Write( &(pLine->length), sizeof(int) );
+  if( File.shareEpoch > pLine->shareEpoch )
+    pLine->shareEpoch = File.shareEpoch;
+  File.WriteShared( pLine->szBuf, (pLine->length+1)*sizeof(char) );
+}
 // loads a STxtLine from a File
-STxtLine * tl_load( wxFile &File ) {
+STxtLine * tl_load( SBufFile &File ) {
   STxtLine *pLine = (STxtLine *) malloc( sizeof(STxtLine) );
   tl_serialize( pLine, File, false );
   return( pLine );
 }
-// struct to hold a page which is an ordered collection of lines
-typedef struct STxtPage {
-  void init( int maxLines ) {
-    this->maxLines = maxLines;
-    this->numLines = 0;
-    this->ppLines = (STxtLine **) malloc( maxLines * sizeof(STxtLine *) );
+// the room a gap line's gap is opened with
+#define GAP_LINE_GAP 64
+// struct to hold a line being edited, with a gap at the point of editing
+// chars are typed into the gap and deleted at its edges, so an edit costs the same on a line of any length
+// the chars are szBuf[0, gapStart) and szBuf[gapEnd, maxLength), moving the gap moves only those in between
+// it's loaded from an STxtLine and stored back into it, the STxtLine is stale in between
+// it's stored when the caret leaves the line or something other than the display reads it,
+// the display draws the line straight from here (see SCodeBase::clone_line)
+typedef struct SGapLine {
+  void init() {
+    this->pLine = NULL;
+    this->szBuf = NULL;
+    this->maxLength = 0;
+    this->gapStart = 0;
+    this->gapEnd = 0;
+    this->bDirty = false;
+  };
+  // gets the number of chars in this line
+  int get_length() {
+    return( this->maxLength - (this->gapEnd - this->gapStart) );
+  };
+  // gets the char at index in this line
+  char get_char( int index ) {
+    return( index < this->gapStart ? this->szBuf[index] : this->szBuf[index + this->gapEnd - this->gapStart] );
+  };
+  // loads pLine into this gap line, the gap is at its end
+  // the buffer of the last line loaded is reused if it's large enough
+  void load( STxtLine *pLine ) {
+    if( pLine->length + GAP_LINE_GAP > this->maxLength ) {
+      this->maxLength = pLine->length + GAP_LINE_GAP;
+      this->szBuf = (char *) realloc( this->szBuf, this->maxLength * sizeof(char) );
+      wxASSERT_MSG( this->szBuf != NULL, "malloc failure" );
+    }
+    memcpy( this->szBuf, pLine->szBuf, pLine->length );
+    this->gapStart = pLine->length;
+    this->gapEnd = this->maxLength;
+    this->pLine = pLine;
+    this->bDirty = false;
+  };
+  // moves the gap to index
+  void move_gap( int index ) {
+    if( index < this->gapStart ) {
+      memmove( this->szBuf + this->gapEnd - (this->gapStart - index), this->szBuf + index, this->gapStart - index );
+      this->gapEnd -= this->gapStart - index;
+      this->gapStart = index;
+    }
+    else if( index > this->gapStart ) {
+      memmove( this->szBuf + this->gapStart, this->szBuf + this->gapEnd, index - this->gapStart );
+      this->gapEnd += index - this->gapStart;
+      this->gapStart = index;
+    }
+  };
+  // inserts the length chars of szRun at index
+  // a gap too small for them is grown to twice the line, so growing is rare
+  void insert( char *szRun, int length, int index ) {
+    if( this->gapEnd - this->gapStart < length ) {
+      int numTail = this->maxLength - this->gapEnd;
+      int maxLength = 2 * (this->get_length() + length) + GAP_LINE_GAP;
+      this->szBuf = (char *) realloc( this->szBuf, maxLength * sizeof(char) );
+      wxASSERT_MSG( this->szBuf != NULL, "malloc failure" );
+      memmove( this->szBuf + maxLength - numTail, this->szBuf + this->gapEnd, numTail );
+      this->gapEnd = maxLength - numTail;
+      this->maxLength = maxLength;
+    }
+    this->move_gap( index );
+    memcpy( this->szBuf + this->gapStart, szRun, length );
+    this->gapStart += length;
+    this->bDirty = true;
+  };
+  // deletes the length chars at index
+  void remove( int index, int length ) {
+    this->move_gap( index );
+    this->gapEnd += length;
+    this->bDirty = true;
+  };
+  // writes the chars back into the line loaded, if they have been edited since it was loaded or stored
+  void store() {
+    if( this->bDirty && this->pLine != NULL ) {
+      int length = this->get_length();
+      tl_own( this->pLine );
+      if( length > this->pLine->maxLength ) {
+        this->pLine->maxLength = length;
+        this->pLine->szBuf = (char *) realloc( this->pLine->szBuf, (length + 1) * sizeof(char) );
+        wxASSERT_MSG( this->pLine->szBuf != NULL, "malloc failure" );
+      }
+      memcpy( this->pLine->szBuf, this->szBuf, this->gapStart );
+      memcpy( this->pLine->szBuf + this->gapStart, this->szBuf + this->gapEnd, this->maxLength - this->gapEnd );
+      this->pLine->length = length;
+      this->pLine->szBuf[length] = 0;
+      this->bDirty = false;
+    }
+  };
+  // copies the chars of this line into a new STxtLine, for the display
+  STxtLine *clone() {
+    int length = this->get_length();
+    STxtLine *pRetVal = (STxtLine *) malloc( sizeof(STxtLine) );
+    wxASSERT_MSG( pRetVal != NULL, "malloc failure" );
+    pRetVal->maxLength = length;
+    pRetVal->length = length;
+    pRetVal->shareEpoch = 0;
+    pRetVal->szBuf = (char *) malloc( (length + 1) * sizeof(char) );
+    wxASSERT_MSG( pRetVal->szBuf != NULL, "malloc failure" );
+    memcpy( pRetVal->szBuf, this->szBuf, this->gapStart );
+    memcpy( pRetVal->szBuf + this->gapStart, this->szBuf + this->gapEnd, this->maxLength - this->gapEnd );
+    pRetVal->szBuf[length] = 0;
+    return( pRetVal );
+  };
+  // stores the line loaded and lets go of it, before it may be freed
+  void release() {
+    this->store();
+    this->pLine = NULL;
+  };
+  STxtLine *pLine; // the line loaded
+  char *szBuf;
+  int maxLength;
+  int gapStart;
+  int gapEnd;
+  bool bDirty; // edited since loaded or stored
+} SGapLine;
+// struct to hold a page which is an ordered collection of lines
+typedef struct STxtPage {
+  void init( int maxLines ) {
+    this->maxLines = maxLines;
+    this->numLines = 0;
+    this->ppLines = (STxtLine **) malloc( maxLines * sizeof(STxtLine *) );
+    this->pBuf = NULL;
+    this->pViews = NULL;
   };
   // adds a line at the specified index in this TxtPage
   // if index == -1 adds it at the end
@@ -1379,22 +3201,39 @@ typedef struct STxtPage {
       idx = this->numLines;
     else
       idx = index;
-    for( int i=this->numLines-1; i>=idx; i-- )
-      this->ppLines[i+1] = this->ppLines[i];
+    memmove( this->ppLines + idx + 1, this->ppLines + idx, (this->numLines - idx) * sizeof(STxtLine *) );
     this->ppLines[idx] = pAdd;
     this->numLines += 1;
   }
+  // adds the numAdd lines of ppAdd at the specified index in this TxtPage
+  // the lines after it are moved once, not once per line added
+  // if index == -1 adds them at the end
+  void add_lines( STxtLine **ppAdd, int numAdd, int index ) {
+    int idx;
+    if( this->numLines + numAdd > this->maxLines ) {
+      while( this->numLines + numAdd > this->maxLines )
+        this->maxLines *= 2;
+      this->ppLines = (STxtLine **) realloc( this->ppLines, this->maxLines * sizeof(STxtLine *) );
+      wxASSERT_MSG( this->ppLines != NULL, "malloc failure" );
+    }
+    if( index == -1 || index > this->numLines )
+      idx = this->numLines;
+    else
+      idx = index;
+    memmove( this->ppLines + idx + numAdd, this->ppLines + idx, (this->numLines - idx) * sizeof(STxtLine *) );
+    memcpy( this->ppLines + idx, ppAdd, numAdd * sizeof(STxtLine *) );
+    this->numLines += numAdd;
+  }
   // removes the line at specified index from this TxtPage
   void remove_line( int index ) {
     wxASSERT_MSG(this->numLines > 0, "cannot remove a line, page is empty");
     wxASSERT_MSG( index >= 0  && index < this->numLines, "index out of range in STxtPage::remove_line");
 
     int idx = index;
-    for( int i=idx; i<this->numLines; i++ )
-      this->ppLines[i] = this->ppLines[i+1];
+    memmove( this->ppLines + idx, this->ppLines + idx + 1, (this->numLines - idx - 1) * sizeof(STxtLine *) );
     this->numLines -= 1;
   };
-  void serialize( wxFile &File, bool bToFrom ) {
+  void serialize( SBufFile &File, bool bToFrom ) {
     // store to
     if( bToFrom ) {
       File.Write( &(this->numLines), sizeof(int) );
@@ -1412,12 +3251,19 @@ typedef struct STxtPage {
   int maxLines;
   int numLines;
   STxtLine **ppLines;
+  // a page read by read_codefile() owns the text of its lines in pBuf
+  // its lines are views into pBuf held in pViews, not separately allocated
+  // they must not be edited or freed on their own, only copied (tl_clone())
+  char *pBuf;
+  STxtLine *pViews;
 } STxtPage;
 // clones the specified page on the stack
 STxtPage tp_clone( STxtPage From ) {
   STxtPage RetVal;
   RetVal.maxLines = From.maxLines;
   RetVal.numLines = From.numLines;
+  RetVal.pBuf = NULL;
+  RetVal.pViews = NULL;
   RetVal.ppLines = (STxtLine **) malloc( RetVal.maxLines * sizeof( STxtLine * ) );
   wxASSERT_MSG( RetVal.ppLines != NULL, "malloc failure");
   for( int i=0; i<RetVal.numLines; i++ )
@@ -1435,7 +3281,14 @@ STxtPage *new_txt_page( int maxLines ) {
 // frees  txt page ptr
 void free_txt_page(STxtPage* pPage) {
   if (pPage != NULL) {
-    if (pPage->ppLines != NULL) {
+    // the lines are views into pBuf
+    if (pPage->pViews != NULL) {
+      free(pPage->pViews);
+      free(pPage->pBuf);
+      free(pPage->ppLines);
+      pPage->ppLines = NULL;
+    }
+    else if (pPage->ppLines != NULL) {
       for (int i = 0; i < pPage->numLines; i++)
         if (pPage->ppLines[i] != NULL) {
           tl_free(pPage->ppLines[i]);
@@ -1447,6 +3300,76 @@ void free_txt_page(STxtPage* pPage) {
     free(pPage);
   }
 }
+// computes the CRC32 of the lines in a page, each followed by a newline
+unsigned int tp_crc(STxtPage* pPage) {
+  unsigned int crc = 0;
+  for (int i = 0; i < pPage->numLines; i++) {
+    crc = crc32_buf(pPage->ppLines[i]->szBuf, pPage->ppLines[i]->length, crc);
+    crc = crc32_buf("\n", 1, crc);
+  }
+  return(crc);
+}
+// struct to hold a growable buffer of text
+// a codebase writes its source into one to export it (see SCodeSection::write_source())
+typedef struct STxtBuf {
+  void init(int maxLength) {
+    this->maxLength = maxLength;
+    this->length = 0;
+    this->pData = (char*)malloc(maxLength);
+    wxASSERT_MSG(this->pData != NULL, "malloc failure");
+  };
+  // appends len chars at pAdd, doubling the buffer as needed
+  void append(const char* pAdd, int len) {
+    if (this->length + len > this->maxLength) {
+      while (this->length + len > this->maxLength)
+        this->maxLength *= 2;
+      this->pData = (char*)realloc(this->pData, this->maxLength);
+      wxASSERT_MSG(this->pData != NULL, "malloc failure");
+    }
+    memcpy(this->pData + this->length, pAdd, len);
+    this->length += len;
+  };
+  // appends a line followed by a newline
+  void append_line(STxtLine* pLine) {
+    this->append(pLine->szBuf, pLine->length);
+    this->append("\n", 1);
+  };
+  char* pData;
+  int length;
+  int maxLength;
+} STxtBuf;
+// allocs a txt buf on the heap, caller must free
+STxtBuf* new_txt_buf(int maxLength) {
+  STxtBuf* pRetVal = (STxtBuf*)malloc(sizeof(STxtBuf));
+  wxASSERT_MSG(pRetVal != NULL, "malloc failure");
+  pRetVal->init(maxLength);
+  return(pRetVal);
+}
+void free_txt_buf(STxtBuf* pBuf) {
+  if (pBuf != NULL) {
+    free(pBuf->pData);
+    free(pBuf);
+  }
+}
+// reads what is available of pStream without blocking, up to the end of a line
+// the chars read are appended to pPartial, without CRs
+// returns true if pPartial then holds a complete line, the newline is not appended
+// the caller empties pPartial once it is done with the line
+bool stream_read_line(wxInputStream* pStream, STxtBuf* pPartial) {
+  bool bLine = false;
+  bool bRead = pStream != NULL && pStream->CanRead();
+  while (bRead) {
+    int c = pStream->GetC();
+    if (c == '\n')
+      bLine = true;
+    else if (c != '\r' && c != wxEOF) {
+      char ch = (char)c;
+      pPartial->append(&ch, 1);
+    }
+    bRead = !bLine && c != wxEOF && pStream->CanRead();
+  }
+  return(bLine);
+}
 
 // SUBBLOCK: KYBD PROCESSING UTILITIES
 // This sub-block has some utilities to help with kybd event processing
@@ -1672,15 +3595,32 @@ typedef struct SModeLineInp {
     this->bReset = true;
     this->indexCaret = 0;
     this->bInputRcvd = false;
+    this->typedIntent = -1;
   };
   void set_caller( SMode *pCaller, int callerIntent, char *szMsg ) {
     this->pCaller = pCaller;
     this->callerIntent = callerIntent;
+    this->set_msg( szMsg );
+    this->bInputRcvd = false;
+    this->typedIntent = -1;
+  }
+  // the caller is also notified with typedIntent each time the input is typed into, before it is received
+  // it gets what's typed so far with get_typed() and has to refresh the window
+  void set_typed( int typedIntent ) {
+    this->typedIntent = typedIntent;
+  };
+  void set_msg( char *szMsg ) {
     if( this->pMsg != NULL )
       tl_free( this->pMsg );
     this->pMsg = new_txt_line( szMsg );
-    this->bInputRcvd = false;
-  }
+  };
+  // gets what's been typed so far, without the caret, caller has to free
+  STxtLine *get_typed() {
+    STxtLine *pRetVal = tl_clone( this->pInput );
+    pRetVal->length = this->indexCaret;
+    pRetVal->szBuf[this->indexCaret] = 0;
+    return( pRetVal );
+  };
   // loads the intent dispatch fns for this mode
   void load_intents( SMode *pBase ) {
     pBase->numIntents = 1;
@@ -1694,6 +3634,7 @@ typedef struct SModeLineInp {
   bool bReset;
   int indexCaret;
   bool bInputRcvd;
+  int typedIntent; // the caller's intent notified as the input is typed into, -1 if none
 } SModeLineInp;
 // allocs and inits a line input mode ptr on the heap and returns
 // the message and destination are set to NULL
@@ -1750,6 +3691,7 @@ bool line_input_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
       // getChar, add to g_pcSingleLine
       // if not char, handle backspace or arrow keys
       bool bExit = false;
+      bool bTyped = false;
       wxMemoryDC DC;
       if( pBase->pFont != NULL ) {
         pBase->load_font();
@@ -1761,6 +3703,7 @@ bool line_input_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
           pLineInp->pInput->szBuf[pLineInp->indexCaret-1] = '|';
           pLineInp->pInput->szBuf[pLineInp->indexCaret] = 0;
           pLineInp->indexCaret--;
+          bTyped = true;
         }
         pLineInp->bInputRcvd = false;
       }
@@ -1786,6 +3729,7 @@ bool line_input_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
               pLineInp->pInput->szBuf[pLineInp->indexCaret+1] = '|';
               pLineInp->pInput->szBuf[pLineInp->indexCaret+2] = 0;
               pLineInp->indexCaret++;
+              bTyped = true;
             }
           }
           // if return,
@@ -1800,14 +3744,21 @@ bool line_input_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
               pLineInp->indexCaret = 0;
               pWin->m_pModeManager->pop();
               pLineInp->bInputRcvd = true;
+              pBase->mark_dispatch();
               pLineInp->pCaller->fnIntent_handler[pLineInp->callerIntent]( pLineInp->pCaller, PH_NOTIFY, pWin, DC );
               bExit = true;
             }
           }
         }
       }
-      if( !bExit )
-        line_input_disp_update( pBase, PH_NOTIFY, pWin, DC );
+      // a caller that follows the typing refreshes the window itself
+      if( !bExit ) {
+        pBase->mark_dispatch();
+        if( bTyped && pLineInp->typedIntent != -1 )
+          pLineInp->pCaller->fnIntent_handler[pLineInp->typedIntent]( pLineInp->pCaller, PH_NOTIFY, pWin, DC );
+        else
+          line_input_disp_update( pBase, PH_NOTIFY, pWin, DC );
+      }
     }
   }
   pWin->m_bUsrActn = false;
@@ -1914,6 +3865,7 @@ typedef struct SModeLevAdj {
     this->pCaller = NULL;
     this->callerIntent = 0;
     this->bInputRcvd = false;
+    this->Rect = wxRect( 0, 0, 0, 0 );
   };
   void set_caller( SMode *pCaller, int callerIntent, char *szMsg ) {
     this->pCaller = pCaller;
@@ -1976,6 +3928,7 @@ bool lev_adj_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
       pWin->Update();
     }
     pBase->intent = LAI_ADJUST;
+    pBase->mark_dispatch();
     pBase->fnIntent_handler[pBase->intent](pBase, PH_NOTIFY, pWin, DC);
   }
   else if (pBase->key == WXK_ESCAPE) {
@@ -1986,16 +3939,25 @@ bool lev_adj_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
   return( bRetVal );
 } 
 
-// displays the current state of this level adjuster
-void lev_adj_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
+// ancillary fn that computes the framing rect of this level adjuster
+// for the font currently set on DC
+wxRect lev_adj_frame_rect( SMode *pBase, wxDC& DC ) {
   SModeLevAdj *pLevAdj = pBase->sExt.pLevAdj;
-  // display the level adjusters intro/usage message
   wxRect rectFrame;
   DC.GetTextExtent(wxString(pLevAdj->szMsg), &(rectFrame.width), &(rectFrame.height));
   rectFrame.width += 80;
   rectFrame.height *= 5;
   rectFrame.x = pBase->scrnW / 2 - rectFrame.width / 2;
   rectFrame.y = pBase->scrnH / 2 - rectFrame.height / 2;
+  return( rectFrame );
+}
+// displays the current state of this level adjuster
+void lev_adj_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
+  SModeLevAdj *pLevAdj = pBase->sExt.pLevAdj;
+  // display the level adjusters intro/usage message
+  // store the frame so an adjustment can refresh just this pop-up
+  wxRect rectFrame = lev_adj_frame_rect( pBase, DC );
+  pLevAdj->Rect = rectFrame;
   wxPen Pen = DC.GetPen();
   wxBrush Brush = DC.GetBrush();
   DC.SetPen(*wxTRANSPARENT_PEN);
@@ -2013,18 +3975,36 @@ void lev_adj_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     pBase->scrnH / 2 - height / 2);
 } 
 // intent handler for level adjuster LAI_ADJUST
+// notifies the caller of the adjustment
+// then refreshes only this pop-up's frame (before and after the adjustment)
+// the modes below are redrawn from the mode manager's frozen background
 void lev_adj_adjust( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   SModeLevAdj* pLevAdj = pBase->sExt.pLevAdj;
   if( phase == PH_NOTIFY ) {
+    bool bAdjusted = false;
+    wxRect rectPrev = pLevAdj->Rect;
     if (pBase->key == WXK_UP || pBase->key == WXK_RIGHT) {
       pLevAdj->bIncDec = true;
       pLevAdj->bInputRcvd = true;
       pLevAdj->pCaller->fnIntent_handler[pLevAdj->callerIntent](pLevAdj->pCaller, PH_NOTIFY, pWin, DC);
+      bAdjusted = true;
     }
     else if (pBase->key == WXK_DOWN || pBase->key == WXK_LEFT) {
       pLevAdj->bIncDec = false;
       pLevAdj->bInputRcvd = true;
       pLevAdj->pCaller->fnIntent_handler[pLevAdj->callerIntent](pLevAdj->pCaller, PH_NOTIFY, pWin, DC);
+      bAdjusted = true;
+    }
+    // refresh the union of the previous and the adjusted frame
+    // the adjustment may have changed the (shared) font
+    if( bAdjusted ) {
+      if( pBase->pFont != NULL ) {
+        pBase->load_font();
+        DC.SetFont( *(pBase->pFont) );
+      }
+      wxRect rectNew = lev_adj_frame_rect( pBase, DC );
+      pWin->m_bUsrActn = false;
+      pWin->RefreshRect( rectPrev.Union( rectNew ), true );
     }
   }
 }
@@ -2053,34 +4033,166 @@ void free_file_entry(SFileEntry Entry) {
   }
 }
 void dir_panel_add_entry(SDirPanel* pDirPanel, SFileEntry Entry);
+void file_sel_start_load(SMode* pMode, ModalWindow* pWin, int loadId, STxtLine* pDirName);
+void file_sel_drop_loads(SMode* pMode, ModalWindow* pWin, bool bAll);
+// Dir loading
+// A dir is loaded into a panel by a DirLoadThread, so a slow or huge dir doesn't freeze the window.
+// The entries it finds are posted to the window in batches and added to the panel as they come
+// (see file_sel_take_entries()), the panel is painted and can be navigated while it loads.
+// A panel knows its load by its loadId, which moves with the panel as the panels shift.
+// A load no panel has anymore is stale and is cancelled, its thread stops at its next entry.
+// the state a dir load's thread shares with the window, taken under pLock
+typedef struct SDirLoad {
+  void init( SMode *pFileSel, ModalWindow *pWin, int loadId, STxtLine *pDirName ) {
+    this->pFileSel = pFileSel;
+    this->pWin = pWin;
+    this->loadId = loadId;
+    this->pDirName = tl_clone( pDirName );
+    this->pLock = new wxCriticalSection();
+    this->maxEntries = FILES_PER_DIR;
+    this->pEntries = (SFileEntry *) malloc( this->maxEntries * sizeof(SFileEntry) );
+    wxASSERT_MSG( this->pEntries != NULL, "malloc failure" );
+    this->numEntries = 0;
+    this->bPosted = false;
+    this->bCancelled = false;
+    this->bDone = false;
+    this->pThread = NULL;
+    this->pNext = NULL;
+  };
+  // adds an entry found
+  // the window is sent an event unless it's been sent one it hasn't taken the entries for yet
+  void add_entry( SFileEntry Entry ) {
+    this->pLock->Enter();
+    if( this->numEntries == this->maxEntries ) {
+      this->maxEntries = this->maxEntries * 2;
+      this->pEntries = (SFileEntry *) realloc( this->pEntries, this->maxEntries * sizeof(SFileEntry) );
+      wxASSERT_MSG( this->pEntries != NULL, "malloc failure" );
+    }
+    this->pEntries[this->numEntries] = Entry;
+    this->numEntries++;
+    bool bPost = !this->bPosted;
+    this->bPosted = true;
+    this->pLock->Leave();
+    if( bPost )
+      wxQueueEvent( this->pWin, new wxThreadEvent( wxEVT_THREAD, ID_DIR_ENTRIES ) );
+  };
+  // the dir has been traversed, the window is sent an event
+  void finish() {
+    this->pLock->Enter();
+    this->bDone = true;
+    this->pLock->Leave();
+    wxQueueEvent( this->pWin, new wxThreadEvent( wxEVT_THREAD, ID_DIR_ENTRIES ) );
+  };
+  void cancel() {
+    this->pLock->Enter();
+    this->bCancelled = true;
+    this->pLock->Leave();
+  };
+  bool is_cancelled() {
+    this->pLock->Enter();
+    bool bRetVal = this->bCancelled;
+    this->pLock->Leave();
+    return( bRetVal );
+  };
+  // takes the entries found since the last take, *pNumEntries of them, caller has to free
+  // *pbDone gets if the dir has been traversed
+  SFileEntry *take_entries( int *pNumEntries, bool *pbDone ) {
+    SFileEntry *pRetVal = (SFileEntry *) malloc( this->maxEntries * sizeof(SFileEntry) );
+    wxASSERT_MSG( pRetVal != NULL, "malloc failure" );
+    this->pLock->Enter();
+    SFileEntry *pEntries = this->pEntries;
+    this->pEntries = pRetVal;
+    pRetVal = pEntries;
+    *pNumEntries = this->numEntries;
+    *pbDone = this->bDone;
+    this->numEntries = 0;
+    this->bPosted = false;
+    this->pLock->Leave();
+    return( pRetVal );
+  };
+  SMode *pFileSel; // the file selector it loads for
+  ModalWindow *pWin;
+  int loadId; // the panel's it loads
+  STxtLine *pDirName; // the dir it loads
+  wxCriticalSection *pLock;
+  SFileEntry *pEntries; // the entries found that the window has not taken yet
+  int numEntries;
+  int maxEntries;
+  bool bPosted; // the window has been sent an event for them
+  bool bCancelled;
+  bool bDone;
+  wxThread *pThread; // NULL if the dir was loaded without one
+  SDirLoad *pNext; // in the window's list of loads
+} SDirLoad;
+// allocs and inits a dir load on the heap, caller has to free
+SDirLoad *new_dir_load( SMode *pFileSel, ModalWindow *pWin, int loadId, STxtLine *pDirName ) {
+  SDirLoad *pLoad = (SDirLoad *) malloc( sizeof(SDirLoad) );
+  wxASSERT_MSG( pLoad != NULL, "malloc failure" );
+  pLoad->init( pFileSel, pWin, loadId, pDirName );
+  return( pLoad );
+}
+// frees a dir load whose thread has been reaped, with the entries it found that were not taken
+void free_dir_load( SDirLoad *pLoad ) {
+  if( pLoad != NULL ) {
+    for( int i=0; i<pLoad->numEntries; i++ )
+      free_file_entry( pLoad->pEntries[i] );
+    free( pLoad->pEntries );
+    tl_free( pLoad->pDirName );
+    delete pLoad->pLock;
+    free( pLoad );
+  }
+}
 // Modal's dir traverser
+// adds the files and dirs of a dir to a dir load, stops if it's cancelled
 class ModalDirTraverser : public wxDirTraverser {
 public:
-  ModalDirTraverser(SDirPanel* pFiles) {
-    m_pFiles = pFiles;
+  ModalDirTraverser(SDirLoad* pLoad) {
+    m_pLoad = pLoad;
   }
   virtual wxDirTraverseResult OnFile(const wxString& filename)
   {
+    if( m_pLoad->is_cancelled() )
+      return wxDIR_STOP;
     SFileEntry Entry;
     Entry.bFileDir = true;
     Entry.pName = new_txt_line_wx( filename );
-    dir_panel_add_entry(m_pFiles, Entry);
+    m_pLoad->add_entry(Entry);
     return wxDIR_CONTINUE;
   }
   virtual wxDirTraverseResult OnDir(const wxString& dirname)
   {
+    if( m_pLoad->is_cancelled() )
+      return wxDIR_STOP;
     SFileEntry Entry;
     wxDir Dir(dirname);
     if( Dir.IsOpened() ) {
       wxString strDir = Dir.GetNameWithSep();
       Entry.bFileDir = false;
       Entry.pName = new_txt_line_wx( strDir );
-      dir_panel_add_entry(m_pFiles, Entry);
+      m_pLoad->add_entry(Entry);
     }
     return wxDIR_IGNORE;
   }
 private:
-  SDirPanel* m_pFiles;
+  SDirLoad* m_pLoad;
+};
+// A worker thread that loads a dir
+// it traverses the dir of its load and adds the entries it finds to it
+class DirLoadThread : public wxThread {
+public:
+  DirLoadThread( SDirLoad *pLoad ) : wxThread( wxTHREAD_JOINABLE ) {
+    m_pLoad = pLoad;
+  };
+  virtual ExitCode Entry() {
+    wxDir Dir( wxString( m_pLoad->pDirName->szBuf ) );
+    if( Dir.IsOpened() ) {
+      ModalDirTraverser Traverser( m_pLoad );
+      Dir.Traverse( Traverser, wxEmptyString, wxDIR_DIRS | wxDIR_FILES );
+    }
+    m_pLoad->finish();
+    return( 0 );
+  };
+  SDirLoad *m_pLoad;
 };
 // struct to hold a panel full of file or directory entries
 typedef struct SDirPanel {
@@ -2101,34 +4213,46 @@ typedef struct SDirPanel {
     this->bActive = false;
     this->bRootDir = false;
     this->bReset = true;
+    this->loadId = 0;
+    this->bLoading = false;
+    this->bFollowSel = false;
+    this->pSelName = NULL;
   };
-  void load_dir(STxtLine* pDirName) {
+  // starts loading pDirName into this panel, its entries are added as the load with loadId finds them
+  // (see SDirLoad). The dir is not opened here, its name is made to end with a separator as wxDir's does
+  void load_dir(STxtLine* pDirName, int loadId) {
     if (this->pDirName != NULL) {
       tl_free(this->pDirName);
       this->pDirName = NULL;
     }
     this->erase();
-    wxDir Dir(wxString(pDirName->szBuf));
-    wxString strDirName = Dir.GetNameWithSep();
+    wxString strDirName(pDirName->szBuf);
+    if (!strDirName.EndsWith(wxString(wxFILE_SEP_PATH)))
+      strDirName += wxFILE_SEP_PATH;
     // if it's the root dir, set a flag on this dirpanel
     wxFileName FileName(strDirName);
     int numDirs = FileName.GetDirCount();
     if (numDirs == 0)
       this->bRootDir = true;
     this->pDirName = new_txt_line_wx(strDirName);
-    if (Dir.IsOpened()) {
-      ModalDirTraverser traverser(this);
-      int flags = wxDIR_DIRS | wxDIR_FILES;
-      Dir.Traverse(traverser, wxEmptyString, flags);
-    }
+    this->loadId = loadId;
+    this->bLoading = true;
     this->startIndex = 0;
     this->selIndex = 0;
     this->bReset = true;
   };
+  // also drops the load of this panel
   void erase() {
     for (int i = 0; i < this->numEntries; i++)
       free_file_entry(this->pEntries[i]);
     this->numEntries = 0;
+    this->loadId = 0;
+    this->bLoading = false;
+    this->bFollowSel = false;
+    if (this->pSelName != NULL) {
+      tl_free(this->pSelName);
+      this->pSelName = NULL;
+    }
   };
   void disp_init( int scrnH, int panelW, int entryH, int numEntries, int index ) {
     this->rectDisp.x = panelW / 2 + index * panelW;
@@ -2147,8 +4271,14 @@ typedef struct SDirPanel {
     if (index >= 0 && index < this->numEntries)
       this->startIndex = index;
   };
+  // the selection is the user's from now on, it stays on its entry as entries are loaded
   void inc_sel_index( int inc ) {
     wxASSERT(inc != 0);
+    this->bFollowSel = true;
+    if (this->pSelName != NULL) {
+      tl_free(this->pSelName);
+      this->pSelName = NULL;
+    }
     if (inc > 0) {
       if (this->selIndex + inc < this->numDispEntries)
         this->selIndex += inc;
@@ -2176,7 +4306,9 @@ typedef struct SDirPanel {
       }
     }
   };
-  void display(wxDC& DC) {
+  // pBase is the file selector mode this panel is drawn for
+  // entries outside the region being painted are skipped
+  void display(wxDC& DC, SMode *pBase) {
     // re-initialize display parameters
     if (this->bReset) {
       if (this->numEntries >= this->maxDispEntries)
@@ -2187,8 +4319,8 @@ typedef struct SDirPanel {
         this->startIndex = this->selIndex;
       this->bReset = false;
     }
-    // display this dir-panel if it is not empty
-    if (this->numEntries > 0) {
+    // display this dir-panel if it is not empty and is in the region being painted
+    if (this->numEntries > 0 && pBase->is_exposed(this->rectDisp)) {
       // display an empty rect around the sel index
       wxRect rect;
       rect.x = this->rectDisp.x + 20;
@@ -2209,68 +4341,72 @@ typedef struct SDirPanel {
       int height = 0;
       // display the entries in this dir panel
       for (int i = 0; i < this->numDispEntries && i < this->numEntries - this->startIndex; i++) {
-        // if we are in the rootdir, display the full filename path
-        // else just the filename (GetFullName)
-        if (this->pEntries[this->startIndex + i].bFileDir) {
-          wxString strFileName;
-          if (!this->bRootDir) {
-            wxFileName FileName(wxString(this->pEntries[this->startIndex + i].pName->szBuf));
-            strFileName = FileName.GetFullName();
-          }
-          else
-            strFileName = wxString(this->pEntries[this->startIndex + i].pName->szBuf);
-          STxtLine *pLine = new_txt_line_wx(strFileName); 
-          DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
-          // clip the length of the string to the width of the panel
-          while( width > this->rectDisp.width-80 ) {
-            char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
-            if (szTemp != NULL)
-            free(szTemp);
-            tl_insert(pLine, (char*)" ...", pLine->length);
+        // draw the entry only if it is in the region being painted
+        wxRect rectEntry(this->rectDisp.x, this->rectDisp.y + i * this->entryH, this->rectDisp.width, this->entryH);
+        if (pBase->is_exposed(rectEntry)) {
+          // if we are in the rootdir, display the full filename path
+          // else just the filename (GetFullName)
+          if (this->pEntries[this->startIndex + i].bFileDir) {
+            wxString strFileName;
+            if (!this->bRootDir) {
+              wxFileName FileName(wxString(this->pEntries[this->startIndex + i].pName->szBuf));
+              strFileName = FileName.GetFullName();
+            }
+            else
+              strFileName = wxString(this->pEntries[this->startIndex + i].pName->szBuf);
+            STxtLine *pLine = new_txt_line_wx(strFileName); 
             DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
-          }
-          DC.SetTextForeground(wxColour(0, 0, 0));
-          DC.DrawText( wxString( pLine->szBuf ),
-            this->rectDisp.x + this->rectDisp.width / 2 - width / 2,
-            this->rectDisp.y + this->entryH / 2 - height / 2 + i * this->entryH);
-          tl_free( pLine );
-          pLine = NULL;  
-        }
-        else {
-          wxDir Dir(wxString(this->pEntries[this->startIndex + i].pName->szBuf));
-          wxString strDir = Dir.GetNameWithSep();
-          wxString strDirName;
-          if (!this->bRootDir) {
-            wxFileName FileName(strDir);
-            wxArrayString strDirs = FileName.GetDirs();
-            int numDirs = strDirs.GetCount();
-            if (numDirs > 0) {
-              strDirName = strDirs[numDirs - 1];
+            // clip the length of the string to the width of the panel
+            while( width > this->rectDisp.width-80 ) {
+              char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
+              if (szTemp != NULL)
+              free(szTemp);
+              tl_insert(pLine, (char*)" ...", pLine->length);
+              DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
             }
+            DC.SetTextForeground(wxColour(0, 0, 0));
+            DC.DrawText( wxString( pLine->szBuf ),
+              this->rectDisp.x + this->rectDisp.width / 2 - width / 2,
+              this->rectDisp.y + this->entryH / 2 - height / 2 + i * this->entryH);
+            tl_free( pLine );
+            pLine = NULL;  
           }
-          else
-            strDirName = strDir;
-          STxtLine *pLine = new_txt_line_wx(strDirName); 
-          DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
-          while( width > this->rectDisp.width-80 ) {
-            char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
-            if (szTemp != NULL)
-            free(szTemp);
-            tl_insert(pLine, (char*)" ...", pLine->length);
+          else {
+            wxDir Dir(wxString(this->pEntries[this->startIndex + i].pName->szBuf));
+            wxString strDir = Dir.GetNameWithSep();
+            wxString strDirName;
+            if (!this->bRootDir) {
+              wxFileName FileName(strDir);
+              wxArrayString strDirs = FileName.GetDirs();
+              int numDirs = strDirs.GetCount();
+              if (numDirs > 0) {
+                strDirName = strDirs[numDirs - 1];
+              }
+            }
+            else
+              strDirName = strDir;
+            STxtLine *pLine = new_txt_line_wx(strDirName); 
             DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
+            while( width > this->rectDisp.width-80 ) {
+              char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
+              if (szTemp != NULL)
+              free(szTemp);
+              tl_insert(pLine, (char*)" ...", pLine->length);
+              DC.GetTextExtent( wxString( pLine->szBuf ), &width, &height);
+            }
+            int widthOutline = width + 20;
+            int heightOutline = height + 10;
+            DC.DrawRectangle( this->rectDisp.x + this->rectDisp.width / 2 - widthOutline / 2,
+              this->rectDisp.y + this->entryH / 2 - heightOutline / 2 + i * this->entryH,
+              widthOutline,
+              heightOutline );
+            DC.SetTextForeground(wxColour(0, 0, 64));
+            DC.DrawText( wxString( pLine->szBuf ),
+              this->rectDisp.x + this->rectDisp.width / 2 - width / 2,
+              this->rectDisp.y + this->entryH / 2 - height / 2 + i * this->entryH);
+            tl_free( pLine );
+            pLine = NULL;  
           }
-          int widthOutline = width + 20;
-          int heightOutline = height + 10;
-          DC.DrawRectangle( this->rectDisp.x + this->rectDisp.width / 2 - widthOutline / 2,
-            this->rectDisp.y + this->entryH / 2 - heightOutline / 2 + i * this->entryH,
-            widthOutline,
-            heightOutline );
-          DC.SetTextForeground(wxColour(0, 0, 64));
-          DC.DrawText( wxString( pLine->szBuf ),
-            this->rectDisp.x + this->rectDisp.width / 2 - width / 2,
-            this->rectDisp.y + this->entryH / 2 - height / 2 + i * this->entryH);
-          tl_free( pLine );
-          pLine = NULL;  
         }
       }
       DC.SetTextForeground(Colour);
@@ -2282,7 +4418,8 @@ typedef struct SDirPanel {
   // sets the index of the this dir panel
   // to pDirName if it matches an entry in the panel
   // and if that entry is in visible range
-  void set_index(STxtLine* pDirName) {
+  // returns false if none does
+  bool set_index(STxtLine* pDirName) {
     bool bFound = false;
     int index = -1;
     for (int i = 0; i < this->numEntries && !bFound; i++) {
@@ -2294,7 +4431,14 @@ typedef struct SDirPanel {
     if (bFound) {
       this->selIndex = index;
       this->bReset = true;
+      this->bFollowSel = true;
     }
+    return( bFound );
+  }
+  // sets the index to pDirName now, or as soon as the entry for it is loaded
+  void set_index_when_loaded(STxtLine* pDirName) {
+    if (!this->set_index(pDirName) && this->bLoading)
+      this->pSelName = tl_clone(pDirName);
   }
   SDirPanel clone() {
     SDirPanel RetVal;
@@ -2307,10 +4451,17 @@ typedef struct SDirPanel {
     RetVal.scrnH = this->scrnH;
     RetVal.bActive = this->bActive;
     RetVal.bRootDir = this->bRootDir;
+    RetVal.loadId = this->loadId;
+    RetVal.bLoading = this->bLoading;
+    RetVal.bFollowSel = this->bFollowSel;
     if( this->pDirName != NULL ) 
       RetVal.pDirName = tl_clone(pDirName);
     else
       RetVal.pDirName = NULL;
+    if( this->pSelName != NULL )
+      RetVal.pSelName = tl_clone(this->pSelName);
+    else
+      RetVal.pSelName = NULL;
     RetVal.pEntries = (SFileEntry*)malloc(RetVal.maxEntries * sizeof(SFileEntry));
     for (int i = 0; i < RetVal.numEntries; i++) {
       RetVal.pEntries[i].bFileDir = this->pEntries[i].bFileDir;
@@ -2333,6 +4484,10 @@ typedef struct SDirPanel {
   bool bRootDir;
   bool bReset;
   STxtLine* pDirName;
+  int loadId; // of the load that is or was loading this panel, 0 if none
+  bool bLoading; // entries are still being added
+  bool bFollowSel; // the selection stays on its entry as entries are added, else on the first one
+  STxtLine* pSelName; // the entry to select once it's loaded, NULL if none
 } SDirPanel;
 // adds an entry to the specified dir panel
 void dir_panel_add_entry(SDirPanel *pDirPanel, SFileEntry Entry) {
@@ -2372,6 +4527,12 @@ void dir_panel_add_entry(SDirPanel *pDirPanel, SFileEntry Entry) {
   }
   if( !bFound )  
     pDirPanel->pEntries[pDirPanel->numEntries] = Entry;
+  // an entry added above the selection of a panel being loaded pushes it down
+  else if( pDirPanel->bFollowSel && index <= pDirPanel->selIndex ) {
+    pDirPanel->selIndex++;
+    if( pDirPanel->selIndex - pDirPanel->startIndex >= pDirPanel->maxDispEntries )
+      pDirPanel->startIndex++;
+  }
   pDirPanel->numEntries += 1;
 }
 // frees the entries allocated in the dir panel
@@ -2383,6 +4544,8 @@ void free_dir_panel(SDirPanel DirPanel) {
     DirPanel.pEntries = NULL;
     tl_free(DirPanel.pDirName);
     DirPanel.pDirName = NULL;
+    if (DirPanel.pSelName != NULL)
+      tl_free(DirPanel.pSelName);
   }
 }
 
@@ -2420,6 +4583,8 @@ typedef struct SModeFileSel {
     this->activePanel = -1;
     this->pStartDir = NULL;
     this->pFilePath = NULL;
+    this->nextLoadId = 0;
+    this->bCheckStartDir = false;
   };
   // loads the intent dispatch fns for this mode
   void load_intents( SMode *pBase ) {
@@ -2427,7 +4592,9 @@ typedef struct SModeFileSel {
     pBase->fnIntent_handler[FSI_CHANGE_SELECTION] = file_sel_change_sel;
     pBase->fnIntent_handler[FSI_COMMIT] = file_sel_commit;
   };
-  void set_caller(SMode* pCaller, int callerIntent, STxtLine* pStartDir) {
+  // the dirs are loaded in the background, the ones loaded before are dropped
+  // if the current dir turns out to be empty, its parent is loaded in its place (see file_sel_load_done())
+  void set_caller(SMode* pCaller, int callerIntent, STxtLine* pStartDir, ModalWindow* pWin) {
     this->pCaller = pCaller;
     this->callerIntent = callerIntent;
     this->bInputRcvd = false;
@@ -2435,47 +4602,57 @@ typedef struct SModeFileSel {
       tl_free(this->pStartDir);
       this->pStartDir = NULL;
     }
-    // load the current dir in the center(2) panel
-    // the parent dir in the left of center(1) panel
-    // and the parent's parent in the leftmost(0) panel;
     wxString strFileName(pStartDir->szBuf);
     wxFileName FileName(strFileName);
-    STxtLine* pDirName = new_txt_line_wx(FileName.GetPath());
+    this->load_panels(FileName, pWin);
+    this->bCheckStartDir = true;
+    set_active_panel(2);
+    pBase->bReset = true;
+    file_sel_drop_loads(this->pBase, pWin, false);
+  };
+  // load the dir of FileName in the center(2) panel
+  // the parent dir in the left of center(1) panel
+  // and the parent's parent in the leftmost(0) panel;
+  // each selects the dir right of it once it's loaded
+  void load_panels(wxFileName FileName, ModalWindow* pWin) {
     for (int i = 0; i < 5; i++)
       this->aDirPanels[i].erase();
-    this->aDirPanels[2].load_dir(pDirName);
+    STxtLine* pDirName = new_txt_line_wx(FileName.GetPath());
+    this->load_panel(2, pDirName, pWin);
     tl_free(pDirName);
     pDirName = NULL;
-    // if curr dir is empty, load the parnet dir into it and proceed      
-    if( this->aDirPanels[2].numEntries == 0 ) {
-      int numDirs = FileName.GetDirCount();
-      wxASSERT( numDirs > 0 );
-      FileName.RemoveLastDir();
-      pDirName = new_txt_line_wx(FileName.GetPath());
-      this->aDirPanels[2].load_dir(pDirName);
-      tl_free(pDirName);
-      pDirName = NULL;
-    }
     int numDirs = FileName.GetDirCount();
     if (numDirs > 0) {
       FileName.RemoveLastDir();
       pDirName = new_txt_line_wx(FileName.GetPath());
-      this->aDirPanels[1].load_dir(pDirName);
+      this->load_panel(1, pDirName, pWin);
       tl_free(pDirName);
       pDirName = NULL;
-      this->aDirPanels[1].set_index(this->aDirPanels[2].pDirName);
+      this->aDirPanels[1].set_index_when_loaded(this->aDirPanels[2].pDirName);
     }
 
     if (numDirs > 1) {
       FileName.RemoveLastDir();
       pDirName = new_txt_line_wx(FileName.GetPath());
-      this->aDirPanels[0].load_dir(pDirName);
+      this->load_panel(0, pDirName, pWin);
       tl_free(pDirName);
       pDirName = NULL;
-      this->aDirPanels[0].set_index(this->aDirPanels[1].pDirName);
+      this->aDirPanels[0].set_index_when_loaded(this->aDirPanels[1].pDirName);
     }
-    set_active_panel(2);
-    pBase->bReset = true;
+  };
+  // starts loading pDirName into the panel at index in the background
+  void load_panel(int index, STxtLine* pDirName, ModalWindow* pWin) {
+    this->nextLoadId++;
+    this->aDirPanels[index].load_dir(pDirName, this->nextLoadId);
+    file_sel_start_load(this->pBase, pWin, this->nextLoadId, this->aDirPanels[index].pDirName);
+  };
+  // gets the index of the panel with the load loadId, -1 if none has it
+  int find_panel(int loadId) {
+    int retVal = -1;
+    for (int i = 0; i < 5 && retVal == -1; i++)
+      if (this->aDirPanels[i].loadId == loadId)
+        retVal = i;
+    return( retVal );
   };
   void set_active_panel(int index) {
     if (index >= 0 && index < 5) {
@@ -2498,6 +4675,8 @@ typedef struct SModeFileSel {
   int selEntry;
   SDirPanel aDirPanels[5];
   int activePanel;
+  int nextLoadId; // the last loadId given to a panel
+  bool bCheckStartDir; // the current dir, being loaded in the center panel, is replaced by its parent if it's empty
 } SModeFileSel;
 // allocs and inits a ptr on the heap and returns it
 // caller has to free
@@ -2521,6 +4700,123 @@ void free_file_sel(SMode* pMode) {
   free(pMode->sExt.pFileSel);
   free(pMode);
 }
+// starts the load loadId of pDirName for the file selector pMode on a DirLoadThread
+// if the thread could not be started, the dir is loaded here
+void file_sel_start_load( SMode *pMode, ModalWindow *pWin, int loadId, STxtLine *pDirName ) {
+  SDirLoad *pLoad = new_dir_load( pMode, pWin, loadId, pDirName );
+  DirLoadThread *pThread = new DirLoadThread( pLoad );
+  if( pThread->Create() != wxTHREAD_NO_ERROR || pThread->Run() != wxTHREAD_NO_ERROR ) {
+    delete pThread;
+    wxDir Dir( wxString( pLoad->pDirName->szBuf ) );
+    if( Dir.IsOpened() ) {
+      ModalDirTraverser Traverser( pLoad );
+      Dir.Traverse( Traverser, wxEmptyString, wxDIR_DIRS | wxDIR_FILES );
+    }
+    pLoad->finish();
+  }
+  else
+    pLoad->pThread = pThread;
+  pLoad->pNext = pWin->m_pDirLoads;
+  pWin->m_pDirLoads = pLoad;
+}
+// cancels the loads of the file selector pMode that none of its panels has anymore, or all of them if bAll
+// they are reaped once their threads stop (see file_sel_take_entries())
+void file_sel_drop_loads( SMode *pMode, ModalWindow *pWin, bool bAll ) {
+  for( SDirLoad *pLoad = pWin->m_pDirLoads; pLoad != NULL; pLoad = pLoad->pNext ) {
+    if( pLoad->pFileSel == pMode && ( bAll || pMode->sExt.pFileSel->find_panel( pLoad->loadId ) == -1 ) )
+      pLoad->cancel();
+  }
+}
+// the panel at index of the file selector pMode has been loaded
+// an empty current dir is replaced by its parent when the file selector is first loaded (see set_caller())
+// else an empty panel that's active hands over to the one left of it
+void file_sel_load_done( SMode *pMode, int index, ModalWindow *pWin ) {
+  SModeFileSel *pFileSel = pMode->sExt.pFileSel;
+  SDirPanel *pPanel = &(pFileSel->aDirPanels[index]);
+  pPanel->bLoading = false;
+  if( pPanel->pSelName != NULL ) {
+    tl_free( pPanel->pSelName );
+    pPanel->pSelName = NULL;
+  }
+  if( index == 2 && pFileSel->bCheckStartDir ) {
+    pFileSel->bCheckStartDir = false;
+    wxFileName FileName( wxString( pPanel->pDirName->szBuf ) );
+    if( pPanel->numEntries == 0 && FileName.GetDirCount() > 0 ) {
+      FileName.RemoveLastDir();
+      pFileSel->load_panels( FileName, pWin );
+      pFileSel->set_active_panel( 2 );
+      file_sel_drop_loads( pMode, pWin, false );
+    }
+  }
+  else if( pPanel->numEntries == 0 && index == pFileSel->activePanel && index > 0 )
+    pFileSel->set_active_panel( index - 1 );
+}
+// takes the entries the dir loads have found since they last did into the panels that have them
+// and refreshes a file selector that's up and had entries added. Done loads are reaped
+void file_sel_take_entries( ModalWindow *pWin ) {
+  SDirLoad **ppLink = &(pWin->m_pDirLoads);
+  SMode *pRefresh = NULL;
+  while( *ppLink != NULL ) {
+    SDirLoad *pLoad = *ppLink;
+    SMode *pMode = pLoad->pFileSel;
+    SModeFileSel *pFileSel = pMode->sExt.pFileSel;
+    int numEntries = 0;
+    bool bDone = false;
+    SFileEntry *pEntries = pLoad->take_entries( &numEntries, &bDone );
+    int index = pLoad->is_cancelled() ? -1 : pFileSel->find_panel( pLoad->loadId );
+    for( int i=0; i<numEntries; i++ ) {
+      if( index != -1 )
+        dir_panel_add_entry( &(pFileSel->aDirPanels[index]), pEntries[i] );
+      else
+        free_file_entry( pEntries[i] );
+    }
+    free( pEntries );
+    if( index != -1 && numEntries > 0 ) {
+      SDirPanel *pPanel = &(pFileSel->aDirPanels[index]);
+      if( pPanel->pSelName != NULL && pPanel->set_index( pPanel->pSelName ) ) {
+        tl_free( pPanel->pSelName );
+        pPanel->pSelName = NULL;
+      }
+      pPanel->bReset = true;
+      pMode->bReset = true;
+      pRefresh = pMode;
+    }
+    // the load is unlinked before it's done with, which can start new ones
+    if( bDone ) {
+      *ppLink = pLoad->pNext;
+      if( pLoad->pThread != NULL ) {
+        pLoad->pThread->Wait();
+        delete pLoad->pThread;
+      }
+      free_dir_load( pLoad );
+      if( index != -1 ) {
+        file_sel_load_done( pMode, index, pWin );
+        pMode->bReset = true;
+        pRefresh = pMode;
+      }
+    }
+    else
+      ppLink = &(pLoad->pNext);
+  }
+  // the panels are laid out again for the entries they have
+  if( pRefresh != NULL && pWin->m_pModeManager->pCurMode == pRefresh ) {
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+}
+// cancels all the dir loads and reaps them once their threads stop
+void file_sel_end_loads( ModalWindow *pWin ) {
+  while( pWin->m_pDirLoads != NULL ) {
+    SDirLoad *pLoad = pWin->m_pDirLoads;
+    pWin->m_pDirLoads = pLoad->pNext;
+    pLoad->cancel();
+    if( pLoad->pThread != NULL ) {
+      pLoad->pThread->Wait();
+      delete pLoad->pThread;
+    }
+    free_dir_load( pLoad );
+  }
+}
 
 // mode :: kybd map
 // called by the mode manager when the users inputs on the kybd
@@ -2536,8 +4832,9 @@ bool file_sel_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
   pBase->key = event.GetKeyCode();
   pBase->uniKey = event.GetUnicodeKey();
 
-  // case exit, pop the mode manager refresh the window
+  // case exit, drop the dir loads, pop the mode manager refresh the window
   if( pBase->key == WXK_ESCAPE ) {
+    file_sel_drop_loads( pBase, pWin, true );
     pWin->m_pModeManager->pop();
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
@@ -2550,11 +4847,13 @@ bool file_sel_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
     // dispatch to CHANGE_SELECTION
     if( bChangeSel ) {
       pBase->intent = FSI_CHANGE_SELECTION;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
     }
     // dispatch to COMMIT
     else if( pBase->key == WXK_RETURN || pBase->key == WXK_SPACE ) {
       pBase->intent = FSI_COMMIT;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
     }
   } // end case not exit
@@ -2588,23 +4887,30 @@ void file_sel_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     pBase->bReset = false;
   }
 
-  // display the currently selected file or dir at the top
+  // display the currently selected file or dir at the top, once the active panel has entries
   SDirPanel ActivePanel = pFileSel->aDirPanels[pFileSel->activePanel];
-  wxString strSelFileName = wxString(ActivePanel.pEntries[ActivePanel.selIndex].pName->szBuf);
-  int strW = 0;
-  int strH = 0;
-  DC.GetTextExtent( strSelFileName, &strW, &strH );
-  DC.DrawText( strSelFileName, pBase->scrnW/2 - strW/2, strH );
+  if (ActivePanel.numEntries > 0) {
+    wxString strSelFileName = wxString(ActivePanel.pEntries[ActivePanel.selIndex].pName->szBuf);
+    int strW = 0;
+    int strH = 0;
+    DC.GetTextExtent( strSelFileName, &strW, &strH );
+    if( pBase->is_exposed( wxRect( pBase->scrnW/2 - strW/2, strH, strW, strH ) ) )
+      DC.DrawText( strSelFileName, pBase->scrnW/2 - strW/2, strH );
+  }
   
   // display each of the 5 panels 
   for (int i = 0; i < 5; i++) 
-    pFileSel->aDirPanels[i].display(DC);
+    pFileSel->aDirPanels[i].display(DC, pBase);
 }
 // intent handler for CHANGE_SELECTION
 // user wants to change the selected using the arrows or PgUp PgDn
+// the dirs opened are loaded in the background, the loads of the dirs moved away from are dropped
 void file_sel_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   if( phase == PH_NOTIFY ) {
     SModeFileSel * pFileSel = pBase->sExt.pFileSel;
+    // the user has moved on from the current dir
+    if( pBase->key == WXK_LEFT || pBase->key == WXK_RIGHT )
+      pFileSel->bCheckStartDir = false;
     // change the current selection based on the arrows or PgUp PgDn
     switch( pBase->key ) {
       // move up a line in the current display column
@@ -2637,8 +4943,8 @@ void file_sel_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC )
               pFileSel->aDirPanels[i] = pFileSel->aDirPanels[i - 1].clone();
             }
             STxtLine* pDirName = new_txt_line_wx(FileName.GetPath());
-            pFileSel->aDirPanels[0].load_dir(pDirName);
-            pFileSel->aDirPanels[0].set_index(pFileSel->aDirPanels[1].pDirName);
+            pFileSel->load_panel(0, pDirName, pWin);
+            pFileSel->aDirPanels[0].set_index_when_loaded(pFileSel->aDirPanels[1].pDirName);
             pFileSel->aDirPanels[0].bActive = true;
             pBase->bReset = true;
             tl_free(pDirName);
@@ -2660,22 +4966,20 @@ void file_sel_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC )
         int selEntry = 0;
         // if the current panel is right-most, shift panels left
         // open a new panel at right-most location
+        // the new panel is active while it loads, it hands back if it's empty (see file_sel_load_done())
         if (pFileSel->activePanel == 4) {
           selEntry = ActivePanel.selIndex;
-          if (ActivePanel.pEntries[selEntry].bFileDir == false) {
+          if (ActivePanel.numEntries > 0 && ActivePanel.pEntries[selEntry].bFileDir == false) {
             pFileSel->aDirPanels[4].bActive = false;
             for (int i = 0; i < 4; i++) {
               free_dir_panel(pFileSel->aDirPanels[i]);
               pFileSel->aDirPanels[i] = pFileSel->aDirPanels[i + 1].clone();
             }
             STxtLine* pDirName = tl_clone(ActivePanel.pEntries[selEntry].pName);
-            pFileSel->aDirPanels[4].load_dir(pDirName);
+            pFileSel->load_panel(4, pDirName, pWin);
             tl_free(pDirName);
             pDirName = NULL;    
-            if( pFileSel->aDirPanels[4].numEntries > 0 )
-              pFileSel->aDirPanels[4].bActive = true;
-            else
-              pFileSel->aDirPanels[3].bActive = true;
+            pFileSel->aDirPanels[4].bActive = true;
           }
           pBase->bReset = true;
         }
@@ -2683,14 +4987,14 @@ void file_sel_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC )
         // erase all panels after the next panel in this case
         else {
           selEntry = ActivePanel.selIndex;
-          if (ActivePanel.pEntries[selEntry].bFileDir == false) {
-            if (!tl_equals(ActivePanel.pEntries[selEntry].pName, pFileSel->aDirPanels[pFileSel->activePanel + 1].pDirName)) {
-              pFileSel->aDirPanels[pFileSel->activePanel + 1].load_dir(ActivePanel.pEntries[selEntry].pName);
+          if (ActivePanel.numEntries > 0 && ActivePanel.pEntries[selEntry].bFileDir == false) {
+            if (pFileSel->aDirPanels[pFileSel->activePanel + 1].pDirName == NULL || !tl_equals(ActivePanel.pEntries[selEntry].pName, pFileSel->aDirPanels[pFileSel->activePanel + 1].pDirName)) {
+              pFileSel->load_panel(pFileSel->activePanel + 1, ActivePanel.pEntries[selEntry].pName, pWin);
               if (pFileSel->activePanel < 3)
                 for (int i = pFileSel->activePanel + 2; i < 5; i++)
                   pFileSel->aDirPanels[i].erase();
             }
-            if( pFileSel->aDirPanels[pFileSel->activePanel+1].numEntries > 0 )
+            if( pFileSel->aDirPanels[pFileSel->activePanel+1].numEntries > 0 || pFileSel->aDirPanels[pFileSel->activePanel+1].bLoading )
               pFileSel->set_active_panel(pFileSel->activePanel + 1);
           }
           pBase->bReset = true;
@@ -2707,6 +5011,7 @@ void file_sel_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC )
       }
       break;
     }
+    file_sel_drop_loads( pBase, pWin, false );
   }
   // PH_EXEC
   else
@@ -2720,7 +5025,8 @@ void file_sel_commit( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   if( phase == PH_NOTIFY ) {
     SModeFileSel * pFileSel = pBase->sExt.pFileSel;
     SDirPanel DirPanel = pFileSel->aDirPanels[pFileSel->activePanel];
-    if (DirPanel.pEntries[DirPanel.selIndex + DirPanel.startIndex].bFileDir) {
+    if (DirPanel.selIndex + DirPanel.startIndex < DirPanel.numEntries && DirPanel.pEntries[DirPanel.selIndex + DirPanel.startIndex].bFileDir) {
+      file_sel_drop_loads( pBase, pWin, true );
       if (pFileSel->pFilePath != NULL) {
         tl_free(pFileSel->pFilePath);
         pFileSel->pFilePath = NULL;    
@@ -2865,10 +5171,12 @@ bool int_disp_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
   else {
     if( pBase->key == WXK_UP  || pBase->key == WXK_DOWN ) {
       pBase->intent = IDI_CHANGE_SELECTION;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
     }
     else if( pBase->key == WXK_RETURN || pBase->key == WXK_SPACE ) {
       pBase->intent = IDI_EXECUTE;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
     }
   }
@@ -2912,39 +5220,43 @@ void int_disp_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     int_disp_set_rect(pBase, DC);
     pBase->bReset = false;
   }
-  // draw a bg-color bg rect
-  wxPen Pen = DC.GetPen();
-  wxBrush Brush = DC.GetBrush();
-  DC.SetPen( *wxTRANSPARENT_PEN );
-  DC.SetBrush( wxBrush( wxColour( 208, 208, 200 ) ) );
-  DC.DrawRectangle( pIntDisp->Rect );
-  DC.SetPen( Pen );
-  DC.SetBrush( Brush );
+  // nothing to draw if the dispatcher is outside the region being painted
+  if( pBase->is_exposed( pIntDisp->Rect ) ) {
+    // draw a bg-color bg rect
+    wxPen Pen = DC.GetPen();
+    wxBrush Brush = DC.GetBrush();
+    DC.SetPen( *wxTRANSPARENT_PEN );
+    DC.SetBrush( wxBrush( wxColour( 208, 208, 200 ) ) );
+    DC.DrawRectangle( pIntDisp->Rect );
+    DC.SetPen( Pen );
+    DC.SetBrush( Brush );
 
-  // draw a whitehighlight rect
-  wxRect rectH;
-  int heightLine = 0;
-  DC.GetTextExtent( wxString( pIntDisp->ppIntents[pIntDisp->curSel]->ptlName->szBuf ), &(rectH.width), &heightLine );
-  int linesStartY = ((pIntDisp->numIntents * 2 - 1) * heightLine)/2;
-  rectH.width = (int) (rectH.width + 10);
-  rectH.height = (int) (heightLine + 10);
-  rectH.x = pBase->scrnW/2 - rectH.width/2;
-  rectH.y = pBase->scrnH/2 - linesStartY + pIntDisp->curSel*2*heightLine - 5;
-  Pen = DC.GetPen();
-  Brush = DC.GetBrush();
-  DC.SetPen( *wxTRANSPARENT_PEN );
-  DC.SetBrush( *wxWHITE_BRUSH );
-  DC.DrawRectangle( rectH );
-  DC.SetPen( Pen );
-  DC.SetBrush( Brush );
+    // draw a whitehighlight rect
+    wxRect rectH;
+    int heightLine = 0;
+    DC.GetTextExtent( wxString( pIntDisp->ppIntents[pIntDisp->curSel]->ptlName->szBuf ), &(rectH.width), &heightLine );
+    int linesStartY = ((pIntDisp->numIntents * 2 - 1) * heightLine)/2;
+    rectH.width = (int) (rectH.width + 10);
+    rectH.height = (int) (heightLine + 10);
+    rectH.x = pBase->scrnW/2 - rectH.width/2;
+    rectH.y = pBase->scrnH/2 - linesStartY + pIntDisp->curSel*2*heightLine - 5;
+    Pen = DC.GetPen();
+    Brush = DC.GetBrush();
+    DC.SetPen( *wxTRANSPARENT_PEN );
+    DC.SetBrush( *wxWHITE_BRUSH );
+    DC.DrawRectangle( rectH );
+    DC.SetPen( Pen );
+    DC.SetBrush( Brush );
 
-  wxRect rectLine;
-  // draw the intent lines
-  for( int i=0; i<pIntDisp->numIntents; i++ ) {
-    DC.GetTextExtent( wxString( pIntDisp->ppIntents[i]->ptlName->szBuf), &rectLine.width, &rectLine.height );
-    rectLine.x = pBase->scrnW/2 - rectLine.width/2;
-    rectLine.y = pBase->scrnH/2 - linesStartY + i*2*rectLine.height;
-    DC.DrawText( wxString( pIntDisp->ppIntents[i]->ptlName->szBuf ), rectLine.x, rectLine.y );
+    wxRect rectLine;
+    // draw the intent lines
+    for( int i=0; i<pIntDisp->numIntents; i++ ) {
+      DC.GetTextExtent( wxString( pIntDisp->ppIntents[i]->ptlName->szBuf), &rectLine.width, &rectLine.height );
+      rectLine.x = pBase->scrnW/2 - rectLine.width/2;
+      rectLine.y = pBase->scrnH/2 - linesStartY + i*2*rectLine.height;
+      if( pBase->is_exposed( rectLine ) )
+        DC.DrawText( wxString( pIntDisp->ppIntents[i]->ptlName->szBuf ), rectLine.x, rectLine.y );
+    }
   }
 }
 // intent handler for CHANGE_SELECTION
@@ -2986,6 +5298,143 @@ void int_disp_execute( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
     pIntDisp->pCaller->fnIntent_handler[intent]( pIntDisp->pCaller, PH_NOTIFY, pWin, DC);
   }
 }
+// SUBBLOCK: LATENCY STATS
+// A pop-up mode that displays the input-to-pixel latency stats
+// collected by the mode manager's latency tracer,
+// one row per traced mode and intent.
+// Up and Down arrows scroll the rows, Esc exits.
+
+// the intents for mode latency stats
+enum {
+  LSI_SCROLL=0
+};
+#define LAT_STATS_ROWS 20
+// the pop-up latency stats mode
+typedef struct SModeLatStats {
+  void init( SMode *pBase ) {
+    pBase->fnDisp_state = lat_stats_disp_state;
+    pBase->fnKybd_map = lat_stats_map;
+    pBase->type = MODE_LATENCY_STATS;
+    pBase->bReset = true;
+    this->pBase = pBase;
+    this->load_intents( pBase );
+    this->firstRow = 0;
+    this->Rect = wxRect( 0, 0, 0, 0 );
+  };
+  // loads the intent dispatch fns for this mode
+  void load_intents( SMode *pBase ) {
+    pBase->numIntents = 1;
+    pBase->fnIntent_handler[LSI_SCROLL] = lat_stats_scroll;
+  };
+  SMode* pBase;
+  int firstRow; // the first displayed row
+  wxRect Rect;
+} SModeLatStats;
+// allocs and inits a latency stats mode ptr on the heap and returns it
+// caller has to free
+SMode * new_lat_stats( int scrnW, int scrnH, wxFont *pFont ) {
+  SMode *pMode = (SMode *) malloc( sizeof( SMode) );
+  pMode->init(scrnW, scrnH, pFont);
+  SModeLatStats *pLatStats = (SModeLatStats *)malloc(sizeof(SModeLatStats));
+  if (pLatStats != NULL) {
+    pMode->sExt.pLatStats = pLatStats;
+    pMode->sExt.pLatStats->init(pMode);
+  }
+  return( pMode );
+}
+void free_lat_stats(SMode* pMode) {
+  if (pMode != NULL) {
+    if (pMode->sExt.pLatStats != NULL)
+      free(pMode->sExt.pLatStats);
+    free(pMode);
+  }
+}
+
+// kybd map for mode latency stats
+bool lat_stats_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
+  bool bRetVal = true;
+  wxClientDC DC( pWin ); // dummy
+  if( pBase->pFont != NULL ) {
+    pBase->load_font();
+    DC.SetFont( *(pBase->pFont) );
+  }
+  pBase->key = event.GetKeyCode();
+  pBase->uniKey = event.GetUnicodeKey();
+
+  // case exit, pop this off the mode stack and refresh the window
+  // up or down arrow dispatch to SCROLL
+  if( pBase->key == WXK_ESCAPE ) {
+    pWin->m_pModeManager->pop();
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+  else if( pBase->key == WXK_UP || pBase->key == WXK_DOWN ) {
+    pBase->intent = LSI_SCROLL;
+    pBase->mark_dispatch();
+    pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
+  }
+  pWin->m_bUsrActn = false;
+  return( bRetVal );
+}
+// displays the current state of the latency stats
+// a title line followed by a row for every traced mode and intent
+void lat_stats_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
+  SModeLatStats *pLatStats = pBase->sExt.pLatStats;
+  SLatTracer *pTracer = pWin->m_pModeManager->pTracer;
+  wxString strTitle( "input-to-pixel latency, arrows to scroll, esc to exit" );
+  int widthLine;
+  int heightLine;
+
+  // determine the framing rect
+  DC.GetTextExtent( strTitle, &widthLine, &heightLine );
+  pLatStats->Rect.width = (9 * pBase->scrnW) / 10;
+  pLatStats->Rect.height = heightLine * (LAT_STATS_ROWS + 3);
+  pLatStats->Rect.x = pBase->scrnW / 2 - pLatStats->Rect.width / 2;
+  pLatStats->Rect.y = pBase->scrnH / 2 - pLatStats->Rect.height / 2;
+  wxPen Pen = DC.GetPen();
+  wxBrush Brush = DC.GetBrush();
+  DC.SetPen( *wxTRANSPARENT_PEN );
+  DC.SetBrush( wxBrush( wxColour( 208, 208, 200 ) ) );
+  DC.DrawRectangle( pLatStats->Rect );
+  DC.SetPen( Pen );
+  DC.SetBrush( Brush );
+
+  // draw the title and the visible rows
+  int x = pLatStats->Rect.x + 20;
+  int y = pLatStats->Rect.y + heightLine;
+  DC.DrawText( strTitle, x, y );
+  y += heightLine;
+  int row = 0;
+  for( int i=0; i<LAT_MODE_TYPES*MAX_INTENTS; i++ ) {
+    if( pTracer->apHists[i] != NULL ) {
+      if( row >= pLatStats->firstRow && row < pLatStats->firstRow + LAT_STATS_ROWS ) {
+        y += heightLine;
+        DC.DrawText( pTracer->format_slot( i ), x, y );
+      }
+      row++;
+    }
+  }
+  if( row == 0 )
+    DC.DrawText( wxString( "no key presses traced yet" ), x, y + heightLine );
+}
+// intent handler for latency stats LSI_SCROLL
+// scrolls the rows by one, no further than the last row shows at the bottom, and refreshes this pop-up's frame
+void lat_stats_scroll( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  SModeLatStats *pLatStats = pBase->sExt.pLatStats;
+  if( phase == PH_NOTIFY ) {
+    SLatTracer *pTracer = pWin->m_pModeManager->pTracer;
+    int numRows = 0;
+    for( int i=0; i<LAT_MODE_TYPES*MAX_INTENTS; i++ )
+      if( pTracer->apHists[i] != NULL )
+        numRows++;
+    if( pBase->key == WXK_UP && pLatStats->firstRow > 0 )
+      pLatStats->firstRow--;
+    else if( pBase->key == WXK_DOWN && pLatStats->firstRow < numRows - LAT_STATS_ROWS )
+      pLatStats->firstRow++;
+    pWin->m_bUsrActn = false;
+    pWin->RefreshRect( pLatStats->Rect, true );
+  }
+}
 // BLOCK: DATASTRUCTS DEFINED BY THIS APP
 // This block contains the data structures defined by this app.
 // Since this app processes Modal source-code files,
@@ -3028,7 +5477,7 @@ typedef struct SLocation {
     else
       return(false);
   }
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     if (bToFrom)
       File.Write(&(this->fileOffset), sizeof(int));
     else
@@ -3109,7 +5558,7 @@ typedef struct SNavTrail {
     }
     return(pRetVal);
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numSteps), sizeof(int));
@@ -3193,7 +5642,7 @@ typedef struct SVar {
         bRetVal = true;
     return(bRetVal);
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       tl_serialize(this->pName, File, bToFrom);
@@ -3301,7 +5750,7 @@ typedef struct SVarSet {
     return(pRetVal);
   }
 
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numVars), sizeof(int));
@@ -3381,7 +5830,7 @@ typedef struct SSymFunc {
           bRetVal = true;
     return(bRetVal);
   }
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       tl_serialize(this->pName, File, bToFrom);
@@ -3509,7 +5958,7 @@ typedef struct SFuncSet {
       }
     return(pRetVal);
   }
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numFuncs), sizeof(int));
@@ -3610,7 +6059,7 @@ typedef struct SClass {
   SLocation* get_var_location(SVar* pVar) {
     return(pVarSet->get_var_location(pVar));
   }
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       tl_serialize(this->pName, File, bToFrom);
@@ -3719,7 +6168,7 @@ typedef struct SStruct {
   SLocation* get_var_location(SVar* pVar) {
     return(pVarSet->get_var_location(pVar));
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       tl_serialize(this->pName, File, bToFrom);
@@ -3823,7 +6272,7 @@ typedef struct SClassSet {
       }
     return(pRetVal);
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     if (bToFrom) {
       File.Write(&(this->numClasses), sizeof(int));
       for (int i = 0; i < this->numClasses; i++)
@@ -3905,7 +6354,7 @@ typedef struct SStructSet {
     }
     return(retVal);
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numStructs), sizeof(int));
@@ -3966,7 +6415,7 @@ typedef struct SSymbolSet {
   }
   // this function assumes this SymSet has been initialized (on the load side)
   // load_codebase does this
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     this->pClassSet->serialize(File, bToFrom);
     this->pStructSet->serialize(File, bToFrom);
     this->pFuncSet->serialize(File, bToFrom);
@@ -4129,13 +6578,14 @@ void free_code_element(SCodeElement* pThis) {
     free(pThis);
   }
 }
-// writes out the source-code of this single code element to the wxTextFile
-void ce_write_source_single(SCodeElement* pElem, wxTextFile* pFile) {
-  pFile->AddLine(wxString(pElem->pLine->szBuf));
+// writes out the source-code of this single code element to the txt buf
+void ce_write_source_single(SCodeElement* pElem, STxtBuf* pSource) {
+  pSource->append_line(pElem->pLine);
 }
 SCodeSection* new_code_section(SCodeElement* pBaseElem, SSymbolSet* pSymSet, int symLinkType, int symLinkIndex);
-SCodeElement* load_code_element(wxFile& File, SCodeSection* pContainer, int indexContainer);
-void ce_serialize_base(SCodeElement* pElem, wxFile& File, bool bToFrom);
+SCodeElement* load_code_element(SBufFile& File, SCodeSection* pContainer, int indexContainer);
+void free_code_section(SCodeSection* pSec);
+void ce_serialize_base(SCodeElement* pElem, SBufFile& File, bool bToFrom);
 // struct for a (multi-line) code section element
 typedef struct SCodeSection {
   // initializes with a type, parent, index in parent's element list
@@ -4225,6 +6675,7 @@ typedef struct SCodeSection {
   // such a case implies lineLocation + *pnLineOffset == 0 or the length of the section - 1
   // this function is extensively used by the SSrcEditor mode's implementation functions
   SCodeElement* get_element_at(int lineLocation, int steps, int* pnLineOffset) {
+    BENCH_COUNT(benchElemAtCalls);
     // get the first element in this section
     SCodeElement* pElemNext = get_next_element(NULL, true);
     // first detrmine the element at the start of the walk
@@ -4510,7 +6961,12 @@ typedef struct SCodeSection {
   }
   // adds a section to the end of the element list
   bool add_section(int type, int index, int length, STxtPage* pPage, bool bInlineBrace, int symLinkType, int symLinkIndex) {
-    SCodeElement* pBaseElem = new_code_element(type, this, this->numElements, NULL);
+    return(this->insert_section(this->numElements, type, index, length, pPage, bInlineBrace, symLinkType, symLinkIndex));
+  }
+  // inserts a section at position at in the element list and parses it
+  // the elements from at onwards move down by one
+  bool insert_section(int at, int type, int index, int length, STxtPage* pPage, bool bInlineBrace, int symLinkType, int symLinkIndex) {
+    SCodeElement* pBaseElem = new_code_element(type, this, at, NULL);
     SCodeSection* pSec = new_code_section(pBaseElem, this->pSymSet, symLinkType, symLinkIndex);
     pSec->bSummarized = true;
     // everything is summarized except the parent block of a sub-block
@@ -4520,7 +6976,11 @@ typedef struct SCodeSection {
       this->maxElements = this->maxElements * 2;
       this->ppElements = (SCodeElement**)realloc(this->ppElements, this->maxElements * sizeof(SCodeElement*));
     }
-    this->ppElements[this->numElements] = pSec->pBaseElem;
+    for (int i = this->numElements - 1; i >= at; i--) {
+      this->ppElements[i + 1] = this->ppElements[i];
+      this->ppElements[i + 1]->indexContainer = i + 1;
+    }
+    this->ppElements[at] = pSec->pBaseElem;
     this->numElements++;
     bool bRetVal = pSec->parse(pPage, index, length, bInlineBrace);
     if( bRetVal ) {
@@ -4539,6 +6999,43 @@ typedef struct SCodeSection {
     }
     return( bRetVal );
   }
+  // removes and frees the element at position at in the element list
+  // the elements after it move up by one
+  void remove_element(int at) {
+    if (this->ppElements[at]->bSingle)
+      free_code_element(this->ppElements[at]);
+    else
+      free_code_section(this->ppElements[at]->pSec);
+    for (int i = at; i < this->numElements - 1; i++) {
+      this->ppElements[i] = this->ppElements[i + 1];
+      this->ppElements[i]->indexContainer = i;
+    }
+    this->numElements--;
+  }
+  // removes the numRemove elements at position at of the element list into ppRemoved
+  // and inserts the numInsert elements of ppInsert there
+  // the elements are moved, not copied, and the ones after them are moved once
+  // so splicing a range of any length costs one pass over the element list
+  void splice(int at, int numRemove, SCodeElement** ppRemoved, int numInsert, SCodeElement** ppInsert) {
+    int numTail = this->numElements - at - numRemove;
+    int numNew = this->numElements - numRemove + numInsert;
+    if (numNew > this->maxElements) {
+      while (numNew > this->maxElements)
+        this->maxElements = this->maxElements * 2;
+      this->ppElements = (SCodeElement**)realloc(this->ppElements, this->maxElements * sizeof(SCodeElement*));
+      wxASSERT_MSG(this->ppElements != NULL, "malloc failure");
+    }
+    if (numRemove > 0)
+      memcpy(ppRemoved, this->ppElements + at, numRemove * sizeof(SCodeElement*));
+    memmove(this->ppElements + at + numInsert, this->ppElements + at + numRemove, numTail * sizeof(SCodeElement*));
+    if (numInsert > 0)
+      memcpy(this->ppElements + at, ppInsert, numInsert * sizeof(SCodeElement*));
+    this->numElements = numNew;
+    for (int i = at; i < this->numElements; i++) {
+      this->ppElements[i]->pContainer = this;
+      this->ppElements[i]->indexContainer = i;
+    }
+  }
   // collapses this code-section
   // which means summarizing it
   // and recursively summarizing it's parent section
@@ -4594,18 +7091,18 @@ typedef struct SCodeSection {
            break;
     }
   };
-  // writes out the source of this code section to the specified source-code file
+  // writes out the source of this code section to the specified txt buf
   // this is recursive operation as it calls write_source on each of it's contained elements
-  void write_source(wxTextFile* pFile) {
+  void write_source(STxtBuf* pSource) {
     // write out each element in this section
     for (int i = 0; i < this->numElements; i++) {
       if (this->ppElements[i]->bSingle)
-        ce_write_source_single(this->ppElements[i], pFile);
+        ce_write_source_single(this->ppElements[i], pSource);
       else
-        this->ppElements[i]->pSec->write_source(pFile);
+        this->ppElements[i]->pSec->write_source(pSource);
     }
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numElements), sizeof(int));
@@ -4695,12 +7192,12 @@ void free_code_section(SCodeSection* pSec) {
   }
 }
 // writes to or reads from File the state of this single code element
-void ce_serialize_base(SCodeElement* pElem, wxFile& File, bool bToFrom) {
+void ce_serialize_base(SCodeElement* pElem, SBufFile& File, bool bToFrom) {
   // store to
   if (bToFrom) {
     File.Write(&(pElem->type), sizeof(int));
     File.Write(&(pElem->bSingle), sizeof(bool));
-    tl_serialize(pElem->pLine, File, true);
+    tl_serialize_shared(pElem->pLine, File);
   }
   // load from
   else {
@@ -6745,52 +9242,173 @@ enum {
   OP_EDIT_CHAR,
   OP_CUT_SEL,
   OP_PASTE_SEL,
+  OP_SPLIT_LINE,
   OP_NULL
 };
+// the most chars a run of typing holds, typing on goes into a new run
+#define OP_RUN_LENGTH 32
 // the edit character operation
+// a run of chars typed, or deleted with backspace, one after the other on a line
+// the chars are [index, index + length) of the line once typed or before being deleted
 typedef struct SOpEditChar {
-  char cChar;
+  char szRun[OP_RUN_LENGTH];
+  int length;
   int index;
   bool bInsDel;
-  void serialize(wxFile& File, bool bToFrom) {
+  // only the chars of the run are stored
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
-      File.Write(&(this->cChar), sizeof(char));
       File.Write(&(this->index), sizeof(int));
       File.Write(&(this->bInsDel), sizeof(bool));
+      File.Write(&(this->length), sizeof(int));
+      File.Write(this->szRun, this->length);
     }
     // load from
     else {
-      File.Read(&(this->cChar), sizeof(char));
       File.Read(&(this->index), sizeof(int));
       File.Read(&(this->bInsDel), sizeof(bool));
+      File.Read(&(this->length), sizeof(int));
+      if (this->length < 0 || this->length > OP_RUN_LENGTH) {
+        this->length = 0;
+        File.bError = true;
+      }
+      File.Read(this->szRun, this->length);
     }
   };
 } SOpEditChar;
 // the cut or paste selection operation
+// a range of numElems elements at index at of a section, the section is the one at depth
+// in the codebase whose first line is at secOffset (see section_from_file_offset())
+// the elements are moved in and out of the code tree, never copied (see SCodeSection::splice())
+// while they are out of it, cut or with their paste undone, the op holds them in ppElems
+// a cut pasted right after it is a move, the elements go to index toAt of the section at toDepth
+// whose first line is at toSecOffset once they have been cut
+// the symbols and breakpoints on their lines are held with them and put back where they go in
+// (see cutpaste_sel_hold_locations())
 typedef struct SOpCutPasteSel {
-  STxtPage CutPage;
+  int secOffset;
+  int depth;
+  int at;
+  int numElems;
+  int numLines; // the lines of the elements
+  SCodeElement** ppElems;
+  bool bHeld; // the op holds the elements
   bool bCutPaste;
-  void serialize(wxFile& File, bool bToFrom) {
+  bool bMoved;
+  int toSecOffset;
+  int toDepth;
+  int toAt; // where a cut has been pasted
+  int numLocs;
+  int* pLocIds; // the held symbol locations, their index in sym_set_get_locations()
+  int* pLocLines; // and their lines from the first line of the elements
+  int numBreaks;
+  int* pBreakLines; // the lines of the held breakpoints from the first line of the elements
+  // the elements and their locations are stored only while held, else they are in the code tree
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
-      CutPage.serialize(File, true);
+      File.Write(&(this->secOffset), sizeof(int));
+      File.Write(&(this->depth), sizeof(int));
+      File.Write(&(this->at), sizeof(int));
+      File.Write(&(this->numElems), sizeof(int));
+      File.Write(&(this->numLines), sizeof(int));
       File.Write(&(this->bCutPaste), sizeof(bool));
+      File.Write(&(this->bHeld), sizeof(bool));
+      File.Write(&(this->bMoved), sizeof(bool));
+      File.Write(&(this->toSecOffset), sizeof(int));
+      File.Write(&(this->toDepth), sizeof(int));
+      File.Write(&(this->toAt), sizeof(int));
+      for (int i = 0; i < this->numElems && this->bHeld; i++) {
+        ce_serialize_base(this->ppElems[i], File, true);
+        if (!this->ppElems[i]->bSingle)
+          this->ppElems[i]->pSec->serialize(File, true);
+      }
+      if (this->bHeld) {
+        File.Write(&(this->numLocs), sizeof(int));
+        File.Write(this->pLocIds, this->numLocs * sizeof(int));
+        File.Write(this->pLocLines, this->numLocs * sizeof(int));
+        File.Write(&(this->numBreaks), sizeof(int));
+        File.Write(this->pBreakLines, this->numBreaks * sizeof(int));
+      }
     }
     // load from
     else {
-      CutPage.serialize(File, false);
+      File.Read(&(this->secOffset), sizeof(int));
+      File.Read(&(this->depth), sizeof(int));
+      File.Read(&(this->at), sizeof(int));
+      File.Read(&(this->numElems), sizeof(int));
+      File.Read(&(this->numLines), sizeof(int));
       File.Read(&(this->bCutPaste), sizeof(bool));
+      File.Read(&(this->bHeld), sizeof(bool));
+      File.Read(&(this->bMoved), sizeof(bool));
+      File.Read(&(this->toSecOffset), sizeof(int));
+      File.Read(&(this->toDepth), sizeof(int));
+      File.Read(&(this->toAt), sizeof(int));
+      if (File.bError || this->numElems < 0) {
+        this->numElems = 0;
+        this->bHeld = false;
+        File.bError = true;
+      }
+      this->ppElems = (SCodeElement**)malloc((this->numElems + 1) * sizeof(SCodeElement*));
+      wxASSERT_MSG(this->ppElems != NULL, "malloc failure");
+      this->numLocs = 0;
+      this->numBreaks = 0;
+      if (this->bHeld) {
+        for (int i = 0; i < this->numElems; i++)
+          this->ppElems[i] = load_code_element(File, NULL, i);
+        File.Read(&(this->numLocs), sizeof(int));
+        if (File.bError || this->numLocs < 0)
+          this->numLocs = 0;
+      }
+      this->pLocIds = (int*)malloc((this->numLocs + 1) * sizeof(int));
+      this->pLocLines = (int*)malloc((this->numLocs + 1) * sizeof(int));
+      wxASSERT_MSG(this->pLocIds != NULL && this->pLocLines != NULL, "malloc failure");
+      if (this->bHeld) {
+        File.Read(this->pLocIds, this->numLocs * sizeof(int));
+        File.Read(this->pLocLines, this->numLocs * sizeof(int));
+        File.Read(&(this->numBreaks), sizeof(int));
+        if (File.bError || this->numBreaks < 0)
+          this->numBreaks = 0;
+      }
+      this->pBreakLines = (int*)malloc((this->numBreaks + 1) * sizeof(int));
+      wxASSERT_MSG(this->pBreakLines != NULL, "malloc failure");
+      if (this->bHeld)
+        File.Read(this->pBreakLines, this->numBreaks * sizeof(int));
     }
   };
 } SCutSel;
-// union to hold the different types of edit operations
-// it is contained by the edit operation struct as a way to extend the base representation
-typedef union SOpExt {
-  SOpEditChar EditChar;
+// the split line operation
+// splits a line at index into it and a line of the chars after index, or joins them back into it
+// the line after index is of type, a join keeps the type of the line it joins for its undo
+typedef struct SOpSplitLine {
+  int index;
+  int type;
+  bool bSplitJoin;
+  void serialize(SBufFile& File, bool bToFrom) {
+    // store to
+    if (bToFrom) {
+      File.Write(&(this->index), sizeof(int));
+      File.Write(&(this->type), sizeof(int));
+      File.Write(&(this->bSplitJoin), sizeof(bool));
+    }
+    // load from
+    else {
+      File.Read(&(this->index), sizeof(int));
+      File.Read(&(this->type), sizeof(int));
+      File.Read(&(this->bSplitJoin), sizeof(bool));
+    }
+  };
+} SOpSplitLine;
+// union to hold the different types of edit operations
+// it is contained by the edit operation struct as a way to extend the base representation
+typedef union SOpExt {
+  SOpEditChar EditChar;
   SOpCutPasteSel CutPasteSel;
+  SOpSplitLine SplitLine;
 } SOpExt;
 // the edit operation
+// fileOffset is the line edited and caretY where the caret was in the view then
 typedef struct SOperation {
   int type;
   SOpExt OpExt;
@@ -6798,7 +9416,7 @@ typedef struct SOperation {
   int caretY;
   int selStart;
   int selEnd;
-  void serialize(wxFile& File, bool bToFrom) {
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->type), sizeof(int));
@@ -6814,6 +9432,9 @@ typedef struct SOperation {
       case OP_PASTE_SEL:
         this->OpExt.CutPasteSel.serialize(File, true);
         break;
+      case OP_SPLIT_LINE:
+        this->OpExt.SplitLine.serialize(File, true);
+        break;
       default:
         break;
       }
@@ -6833,46 +9454,104 @@ typedef struct SOperation {
       case OP_PASTE_SEL:
         this->OpExt.CutPasteSel.serialize(File, false);
         break;
+      case OP_SPLIT_LINE:
+        this->OpExt.SplitLine.serialize(File, false);
+        break;
       default:
         break;
       }
     }
   }
 } SOperation;
-// initializes an edit char operation
-void op_edit_char_init(SOperation Op, int fileOffset, int caretY, char cChar, int key, int index, bool bInsDel) {
+// initializes an edit char operation of the length chars of szRun at index of the line at fileOffset
+// length is at most OP_RUN_LENGTH
+void op_edit_run_init(SOperation& Op, int fileOffset, int caretY, char* szRun, int length, int index, bool bInsDel) {
+  wxASSERT_MSG(length > 0 && length <= OP_RUN_LENGTH, "run length OOR in op_edit_run_init");
   Op.type = OP_EDIT_CHAR;
   Op.fileOffset = fileOffset;
   Op.caretY = caretY;
   Op.selStart = -1;
   Op.selEnd = -1;
-  Op.OpExt.EditChar.cChar = cChar;
+  memcpy(Op.OpExt.EditChar.szRun, szRun, length);
+  Op.OpExt.EditChar.length = length;
   Op.OpExt.EditChar.index = index;
   Op.OpExt.EditChar.bInsDel = bInsDel;
 }
+// initializes an edit char operation of the char cChar at index of the line at fileOffset
+void op_edit_char_init(SOperation& Op, int fileOffset, int caretY, char cChar, int index, bool bInsDel) {
+  op_edit_run_init(Op, fileOffset, caretY, &cChar, 1, index, bInsDel);
+}
+// initializes a split line operation splitting the line at fileOffset at index, or joining it
+// with the line after it, index is then the length of the line
+// the line split off is of type
+void op_split_line_init(SOperation& Op, int fileOffset, int caretY, int index, int type, bool bSplitJoin) {
+  Op.type = OP_SPLIT_LINE;
+  Op.fileOffset = fileOffset;
+  Op.caretY = caretY;
+  Op.selStart = -1;
+  Op.selEnd = -1;
+  Op.OpExt.SplitLine.index = index;
+  Op.OpExt.SplitLine.type = type;
+  Op.OpExt.SplitLine.bSplitJoin = bSplitJoin;
+}
 // clones an edit char operation on the stack
+// the run is held in the op, it's copied with it
 SOpEditChar op_edit_char_clone(SOpEditChar OpEC) {
-  SOpEditChar RetVal;
-  RetVal.cChar = OpEC.cChar;
-  RetVal.index = OpEC.index;
-  RetVal.bInsDel = OpEC.bInsDel;
+  SOpEditChar RetVal = OpEC;
   return(RetVal);
 }
-// initializes a cut or paste selection operation
-void op_cutpaste_sel_init(SOperation Op, int fileOffset, int caretY, int selStart, int selEnd, STxtPage CutPage, bool bCutPaste) {
+// gets the depth of pSec in its codebase, 0 being its base section (see section_from_file_offset())
+int section_depth(SCodeSection* pSec) {
+  int depth = 0;
+  for (SCodeSection* pCont = pSec; pCont->pBaseElem->type != CDE_CODEBASE; pCont = pCont->pBaseElem->pContainer)
+    depth++;
+  return(depth);
+}
+// initializes a cut or paste selection operation of numElems elements at index at of pSec
+// a paste is of the elements ppPaste, which the op takes over, a cut is of the elements there
+void op_cutpaste_sel_init(SOperation& Op, int fileOffset, int caretY, int selStart, int selEnd, SCodeSection* pSec, int at, int numElems, SCodeElement** ppPaste, bool bCutPaste) {
+  SOpCutPasteSel* pSel = &(Op.OpExt.CutPasteSel);
   Op.type = (bCutPaste ? OP_CUT_SEL : OP_PASTE_SEL);
   Op.fileOffset = fileOffset;
   Op.caretY = caretY;
   Op.selStart = selStart;
   Op.selEnd = selEnd;
-  Op.OpExt.CutPasteSel.CutPage = tp_clone(CutPage);
-  Op.OpExt.CutPasteSel.bCutPaste = bCutPaste;
+  pSel->secOffset = pSec->get_file_offset();
+  pSel->depth = section_depth(pSec);
+  pSel->at = at;
+  pSel->numElems = numElems;
+  pSel->ppElems = (SCodeElement**)malloc((numElems + 1) * sizeof(SCodeElement*));
+  wxASSERT_MSG(pSel->ppElems != NULL, "malloc failure");
+  pSel->numLines = 0;
+  for (int i = 0; i < numElems; i++) {
+    pSel->ppElems[i] = bCutPaste ? pSec->ppElements[at + i] : ppPaste[i];
+    pSel->numLines += ce_length(pSel->ppElems[i]);
+  }
+  pSel->bHeld = !bCutPaste;
+  pSel->bCutPaste = bCutPaste;
+  pSel->bMoved = false;
+  pSel->toSecOffset = -1;
+  pSel->toDepth = -1;
+  pSel->toAt = -1;
+  pSel->numLocs = 0;
+  pSel->pLocIds = NULL;
+  pSel->pLocLines = NULL;
+  pSel->numBreaks = 0;
+  pSel->pBreakLines = NULL;
+}
+// makes the cut Op, which holds its elements, a move of them to index toAt of the section at toDepth
+// whose first line is at toSecOffset, it is then done again to paste them there
+void op_cutpaste_sel_move(SOperation& Op, int toSecOffset, int toDepth, int toAt) {
+  SOpCutPasteSel* pSel = &(Op.OpExt.CutPasteSel);
+  pSel->bMoved = true;
+  pSel->toSecOffset = toSecOffset;
+  pSel->toDepth = toDepth;
+  pSel->toAt = toAt;
 }
 // clones a cut or paste selection op on the stack
+// the clone takes over the elements and the list of them, they are not copied
 SOpCutPasteSel op_cutpaste_sel_clone(SOpCutPasteSel OpCPS) {
-  SOpCutPasteSel RetVal;
-  RetVal.CutPage = tp_clone(OpCPS.CutPage);
-  RetVal.bCutPaste = OpCPS.bCutPaste;
+  SOpCutPasteSel RetVal = OpCPS;
   return(RetVal);
 }
 // clones an operation of any type on the stack
@@ -6893,37 +9572,158 @@ SOperation op_clone(SOperation Op) {
     RetVal.OpExt.CutPasteSel = op_cutpaste_sel_clone(Op.OpExt.CutPasteSel);
   }
                    break;
+  case OP_SPLIT_LINE:
+    RetVal.OpExt.SplitLine = Op.OpExt.SplitLine;
+    break;
   default:
     wxLogMessage("invalid op type in op_clone");
     break;
   }
   return(RetVal);
 }
-// an ordered list of operations that functions like a LIFO queue
+// frees what an operation holds, the op itself is held by value
+// the elements of a cut or paste are freed only if the op holds them
+void op_free(SOperation& Op) {
+  if ((Op.type == OP_CUT_SEL || Op.type == OP_PASTE_SEL) && Op.OpExt.CutPasteSel.ppElems != NULL) {
+    SOpCutPasteSel* pSel = &(Op.OpExt.CutPasteSel);
+    for (int i = 0; i < pSel->numElems && pSel->bHeld; i++) {
+      if (pSel->ppElems[i]->bSingle)
+        free_code_element(pSel->ppElems[i]);
+      else
+        free_code_section(pSel->ppElems[i]->pSec);
+    }
+    free(pSel->ppElems);
+    pSel->ppElems = NULL;
+    free(pSel->pLocIds);
+    free(pSel->pLocLines);
+    free(pSel->pBreakLines);
+  }
+  Op.type = OP_NULL;
+}
+// the most ops kept for undo, the oldest are dropped beyond it
+#define MAX_OPS 1024
+// the edit operations done on a codebase in the order they were done, for undo and redo
+// ops [0, numOps) are done, ops [numOps, topOps) have been undone and can be redone
+// chars typed or deleted one after the other on a line are coalesced into a single op
+// so that undo takes back a run of typing rather than a keystroke (see SOpEditChar)
 typedef struct SOpList {
   void init() {
     this->maxOps = 20;
     this->numOps = 0;
+    this->topOps = 0;
+    this->numEdits = 0;
+    this->bSealed = false;
     this->pOps = (SOperation*)malloc(maxOps * sizeof(SOperation));
   };
-  // adds an op to the end of this oplist
+  // tells if the edit char op Op carries on the run of the last op
+  // a run ends at another line, a change of direction, a gap, an undo or redo
+  // and where a space follows a word, so a run is about a word
+  bool extends(SOperation& Op) {
+    bool bRetVal = false;
+    if (this->numOps > 0 && !this->bSealed && Op.type == OP_EDIT_CHAR) {
+      SOperation* pLast = &(this->pOps[this->numOps - 1]);
+      SOpEditChar* pRun = &(pLast->OpExt.EditChar);
+      SOpEditChar* pAdd = &(Op.OpExt.EditChar);
+      bRetVal = pLast->type == OP_EDIT_CHAR && pLast->fileOffset == Op.fileOffset;
+      bRetVal = bRetVal && pRun->bInsDel == pAdd->bInsDel && pRun->length + pAdd->length <= OP_RUN_LENGTH;
+      if (bRetVal && pAdd->bInsDel)
+        bRetVal = pAdd->index == pRun->index + pRun->length && !(pAdd->szRun[0] == ' ' && pRun->szRun[pRun->length - 1] != ' ');
+      else if (bRetVal)
+        bRetVal = pAdd->index + pAdd->length == pRun->index;
+    }
+    return(bRetVal);
+  };
+  // adds an op that has been done to the end of this oplist
+  // the ops undone till now can no longer be redone
+  // an edit char op that carries on the run of the last op is merged into it
   void add(SOperation Op) {
-    if (numOps == maxOps) {
-      maxOps *= 2;
-      pOps = (SOperation*)realloc(pOps, maxOps * sizeof(SOperation));
-      wxASSERT_MSG(pOps != NULL, "OpList realloc failure");
+    this->drop_undone();
+    if (this->extends(Op)) {
+      SOpEditChar* pRun = &(this->pOps[this->numOps - 1].OpExt.EditChar);
+      SOpEditChar* pAdd = &(Op.OpExt.EditChar);
+      // a char deleted with backspace is before the ones deleted so far
+      if (!pAdd->bInsDel) {
+        memmove(pRun->szRun + pAdd->length, pRun->szRun, pRun->length);
+        memcpy(pRun->szRun, pAdd->szRun, pAdd->length);
+        pRun->index = pAdd->index;
+      }
+      else
+        memcpy(pRun->szRun + pRun->length, pAdd->szRun, pAdd->length);
+      pRun->length += pAdd->length;
+    }
+    else {
+      // the oldest op is dropped to bound the memory held
+      if (this->numOps == MAX_OPS) {
+        op_free(this->pOps[0]);
+        memmove(this->pOps, this->pOps + 1, (this->numOps - 1) * sizeof(SOperation));
+        this->numOps -= 1;
+      }
+      if (numOps == maxOps) {
+        maxOps *= 2;
+        pOps = (SOperation*)realloc(pOps, maxOps * sizeof(SOperation));
+        wxASSERT_MSG(pOps != NULL, "OpList realloc failure");
+      }
+      this->pOps[this->numOps] = op_clone(Op);
+      this->numOps += 1;
+    }
+    this->topOps = this->numOps;
+    this->bSealed = false;
+    this->numEdits += 1;
+  };
+  // the ops undone till now can no longer be redone
+  void drop_undone() {
+    while (this->topOps > this->numOps) {
+      this->topOps -= 1;
+      op_free(this->pOps[this->topOps]);
+    }
+  };
+  // the last op done has been changed where it is, as a cut is into a move by a paste
+  // the ops undone till now can no longer be redone
+  void amend_last() {
+    this->drop_undone();
+    this->bSealed = true;
+    this->numEdits += 1;
+  };
+  // returns the last op done if it is a cut still holding its elements, which a paste moves, else NULL
+  SOperation* get_held_cut() {
+    SOperation* pRetVal = NULL;
+    if (this->numOps > 0 && this->pOps[this->numOps - 1].type == OP_CUT_SEL) {
+      SOpCutPasteSel* pSel = &(this->pOps[this->numOps - 1].OpExt.CutPasteSel);
+      if (pSel->bHeld && !pSel->bMoved)
+        pRetVal = &(this->pOps[this->numOps - 1]);
+    }
+    return(pRetVal);
+  };
+  // takes the last op done off this oplist, it can be redone till an op is added
+  // returns the op for the caller to undo, NULL if there is none
+  SOperation* undo() {
+    SOperation* pRetVal = NULL;
+    if (this->numOps > 0) {
+      this->numOps -= 1;
+      pRetVal = &(this->pOps[this->numOps]);
+      this->bSealed = true;
+      this->numEdits += 1;
     }
-    this->pOps[this->numOps] = op_clone(Op);
-    this->numOps += 1;
+    return(pRetVal);
   };
-  // replaces the op at the end of this oplist
-  void replace(SOperation Op) {
-    this->pOps[this->numOps - 1] = op_clone(Op);
+  // puts the last op undone back on this oplist
+  // returns the op for the caller to redo, NULL if there is none
+  SOperation* redo() {
+    SOperation* pRetVal = NULL;
+    if (this->topOps > this->numOps) {
+      pRetVal = &(this->pOps[this->numOps]);
+      this->numOps += 1;
+      this->bSealed = true;
+      this->numEdits += 1;
+    }
+    return(pRetVal);
   };
-  // removes an op from the end of this oplist
-  void remove() {
-    this->numOps -= 1;
-    wxASSERT_MSG(this->numOps < 0, "op list underflow");
+  // empties this oplist, what has been done stays done
+  void clear() {
+    for (int i = 0; i < this->topOps; i++)
+      op_free(this->pOps[i]);
+    this->numOps = 0;
+    this->topOps = 0;
   };
   // returns the op at the end of this oplist
   SOperation get_last() {
@@ -6934,28 +9734,44 @@ typedef struct SOpList {
       RetVal = this->pOps[this->numOps - 1];
     return(RetVal);
   }
-  void serialize(wxFile& File, bool bToFrom) {
+  // the ops that can be redone are stored too
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to
     if (bToFrom) {
       File.Write(&(this->numOps), sizeof(int));
-      for (int i = 0; i < this->numOps; i++)
+      File.Write(&(this->topOps), sizeof(int));
+      File.Write(&(this->numEdits), sizeof(int));
+      for (int i = 0; i < this->topOps; i++)
         this->pOps[i].serialize(File, true);
     }
     // load from
     else {
       File.Read(&(this->numOps), sizeof(int));
+      File.Read(&(this->topOps), sizeof(int));
+      File.Read(&(this->numEdits), sizeof(int));
+      if (this->numOps < 0 || this->topOps < this->numOps || this->topOps > MAX_OPS)
+        File.bError = true;
       // realloc if we've run out of space to store ops
-      if (this->numOps >= this->maxOps) {
-        this->maxOps = this->numOps * 2;
+      else if (this->topOps >= this->maxOps) {
+        this->maxOps = this->topOps * 2;
         this->pOps = (SOperation*)realloc(this->pOps, this->maxOps * sizeof(SOperation));
         wxASSERT_MSG(pOps != NULL, "OpList realloc failure in serialize");
       }
-      for (int i = 0; i < this->numOps; i++)
+      for (int i = 0; i < this->topOps && !File.bError; i++)
         this->pOps[i].serialize(File, false);
+      // a corrupt list is dropped, the code tree is as it was saved
+      if (File.bError) {
+        this->numOps = 0;
+        this->topOps = 0;
+      }
+      this->bSealed = true;
     }
   };
   SOperation* pOps;
   int numOps;
+  int topOps;
+  int numEdits; // the number of edits done, undone and redone, it only grows
+  bool bSealed; // the last op is closed to merging
   int maxOps;
 } SOpList;
 // frees an oplist
@@ -6968,105 +9784,578 @@ void oplist_free(SOpList OpList) {
 // This sub-block defines the codebase struct and fns
 void serialize_map_file_offsets(SSymbolSet* pSymSet, SCodeBase* pCodeBase);
 void serialize_set_sym_sets(SCodeSection* pSec, SSymbolSet* pSymSet);
-
+SCodeSection* section_from_file_offset(int secOffset, int depth, SCodeBase* pCodeBase);
+void codebase_map_lines(SCodeBase* pCodeBase, int from, int to, int delta);
+void cutpaste_sel_hold_locations(SOpCutPasteSel* pSel, SCodeBase* pCodeBase, int from);
+void cutpaste_sel_put_locations(SOpCutPasteSel* pSel, SCodeBase* pCodeBase, int from);
+
+// reads a source file into a page of lines
+// the file is read as is in a single read and split at its newlines in place,
+// the \r of a \r\n is dropped and so is the newline ending the last line.
+// the page's lines are views into the read text (see STxtPage::pBuf)
+// the parser copies the lines it keeps in its code elements
+// returns NULL if it can't be read, caller must free
+STxtPage* read_codefile(wxString strFileName) {
+  STxtPage* pPage = NULL;
+  wxFile File;
+  if (wxFile::Exists(strFileName) && File.Open(strFileName)) {
+    wxFileOffset size = File.Length();
+    char* pBuf = (size >= 0) ? (char*)malloc((size_t)size + 1) : NULL;
+    if (pBuf != NULL && File.Read(pBuf, (size_t)size) == (ssize_t)size) {
+      char* pEnd = pBuf + size;
+      char* pScan = pBuf;
+      char* pNewline = NULL;
+      *pEnd = 0;
+      // count the lines to allocate the page and its views once
+      int numLines = 0;
+      while (pScan < pEnd) {
+        pNewline = (char*)memchr(pScan, '\n', pEnd - pScan);
+        pScan = (pNewline != NULL) ? pNewline + 1 : pEnd;
+        numLines++;
+      }
+      pPage = new_txt_page(numLines + 1);
+      pPage->pBuf = pBuf;
+      pPage->pViews = (STxtLine*)malloc((numLines + 1) * sizeof(STxtLine));
+      wxASSERT_MSG(pPage->pViews != NULL, "malloc failure");
+      // terminate each line in place and point a view at it
+      pScan = pBuf;
+      for (int i = 0; i < numLines; i++) {
+        pNewline = (char*)memchr(pScan, '\n', pEnd - pScan);
+        char* pLineEnd = (pNewline != NULL) ? pNewline : pEnd;
+        if (pLineEnd > pScan && pLineEnd[-1] == '\r')
+          pLineEnd--;
+        *pLineEnd = 0;
+        STxtLine* pView = &(pPage->pViews[i]);
+        pView->szBuf = pScan;
+        pView->length = (int)(pLineEnd - pScan);
+        pView->maxLength = pView->length + 1;
+        pView->shareEpoch = 0;
+        pPage->ppLines[i] = pView;
+        pScan = (pNewline != NULL) ? pNewline + 1 : pEnd;
+      }
+      pPage->numLines = numLines;
+    }
+    else if (pBuf != NULL)
+      free(pBuf);
+    File.Close();
+  }
+  return(pPage);
+}
 // the codebase, contains a symbol set and an oplist for it's editing ops
 // it is parsed from a file into a nested sequence of code sections
+// Search index
+// A trigram index of the single lines of a codebase, summarized or not.
+// Every 3 consecutive chars of a line are a trigram, the index has for each trigram
+// the ascending list of the lines it occurs in, its postings.
+// A line that contains a text has all of its trigrams, so the lines a search can find
+// are in the intersection of the postings of the trigrams of its text
+// and only these candidates are matched (see search_query()).
+// The index is built by an IndexThread from a copy of the lines (see src_edr_start_index())
+// so the user goes on editing while it's built.
+// The lines edited since the copy was taken are noted and are always matched.
+// A cut or paste adds lines to the code tree or takes them out, it drops the index till it's built again.
+// the trigram of the 3 chars at sz
+#define TRIGRAM(sz) ((((unsigned int)(unsigned char)(sz)[0]) << 16) | (((unsigned int)(unsigned char)(sz)[1]) << 8) | ((unsigned int)(unsigned char)(sz)[2]))
+typedef struct STrigramIndex {
+  void init() {
+    this->ppElems = NULL;
+    this->numElems = 0;
+    this->pTrigrams = NULL;
+    this->pFirsts = NULL;
+    this->numTrigrams = 0;
+    this->pPostings = NULL;
+    this->maxEdited = 64;
+    this->ppEdited = (SCodeElement**)malloc(this->maxEdited * sizeof(SCodeElement*));
+    wxASSERT_MSG(this->ppEdited != NULL, "malloc failure");
+    this->numEdited = 0;
+    this->snapEdited = 0;
+    this->treeEpoch = 0;
+    this->builtEpoch = -1;
+  };
+  // frees the index, the lines edited are kept
+  void clear() {
+    free(this->ppElems);
+    free(this->pTrigrams);
+    free(this->pFirsts);
+    free(this->pPostings);
+    this->ppElems = NULL;
+    this->pTrigrams = NULL;
+    this->pFirsts = NULL;
+    this->pPostings = NULL;
+    this->numElems = 0;
+    this->numTrigrams = 0;
+    this->builtEpoch = -1;
+  };
+  // drops the index, lines have been added to the code tree or taken out of it
+  // and the elements of those noted as edited may be freed
+  void invalidate() {
+    this->clear();
+    this->numEdited = 0;
+    this->snapEdited = 0;
+    this->treeEpoch++;
+  };
+  // notes that the line of the single pElem has been edited
+  // a line edited before the copy being indexed was taken is noted again
+  void note_edited(SCodeElement* pElem) {
+    bool bNoted = false;
+    for (int i = this->snapEdited; i < this->numEdited && !bNoted; i++)
+      bNoted = this->ppEdited[i] == pElem;
+    if (!bNoted) {
+      if (this->numEdited == this->maxEdited) {
+        this->maxEdited = this->maxEdited * 2;
+        this->ppEdited = (SCodeElement**)realloc(this->ppEdited, this->maxEdited * sizeof(SCodeElement*));
+        wxASSERT_MSG(this->ppEdited != NULL, "malloc failure");
+      }
+      this->ppEdited[this->numEdited] = pElem;
+      this->numEdited++;
+    }
+  };
+  // notes that a copy of the lines is being taken to be indexed
+  // returns the epoch of the code tree it is of
+  int snapshot() {
+    this->snapEdited = this->numEdited;
+    return(this->treeEpoch);
+  };
+  // tells if the index is of the lines of the code tree as it is
+  bool is_current() {
+    return(this->builtEpoch == this->treeEpoch);
+  };
+  // installs the index an IndexThread built of the copy of the lines taken at epoch
+  // the lines edited before the copy was taken are then in it and are forgotten.
+  // if the code tree has changed since, the index is of elements that may be gone and is freed
+  // the index takes the arrays either way, returns true if it was installed
+  bool install(SCodeElement** ppElems, int numElems, unsigned int* pTrigrams, int* pFirsts, int numTrigrams, int* pPostings, int epoch) {
+    bool bRetVal = epoch == this->treeEpoch;
+    if (bRetVal) {
+      this->clear();
+      this->ppElems = ppElems;
+      this->numElems = numElems;
+      this->pTrigrams = pTrigrams;
+      this->pFirsts = pFirsts;
+      this->numTrigrams = numTrigrams;
+      this->pPostings = pPostings;
+      this->builtEpoch = epoch;
+      this->numEdited -= this->snapEdited;
+      memmove(this->ppEdited, this->ppEdited + this->snapEdited, this->numEdited * sizeof(SCodeElement*));
+      this->snapEdited = 0;
+    }
+    else {
+      free(ppElems);
+      free(pTrigrams);
+      free(pFirsts);
+      free(pPostings);
+    }
+    return(bRetVal);
+  };
+  // gets in *ppPostings the postings of trigram, the indexes in ppElems of the lines it occurs in
+  // returns their number, 0 if it occurs in no line
+  int get_postings(unsigned int trigram, int** ppPostings) {
+    int retVal = 0;
+    int lo = 0;
+    int hi = this->numTrigrams;
+    *ppPostings = NULL;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (this->pTrigrams[mid] < trigram)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < this->numTrigrams && this->pTrigrams[lo] == trigram) {
+      *ppPostings = this->pPostings + this->pFirsts[lo];
+      retVal = this->pFirsts[lo + 1] - this->pFirsts[lo];
+    }
+    return(retVal);
+  };
+  SCodeElement** ppElems; // the single lines indexed in file order, the index of one is its file offset
+  int numElems;
+  unsigned int* pTrigrams; // the trigrams that occur in them, ascending
+  int* pFirsts; // the index in pPostings of the first posting of each trigram, and the end of the last's
+  int numTrigrams;
+  int* pPostings;
+  SCodeElement** ppEdited; // the lines edited since the copy of the lines indexed was taken
+  int numEdited;
+  int maxEdited;
+  int snapEdited; // how many of them were edited before the copy being indexed was taken
+  int treeEpoch; // counts the changes to the lines of the code tree
+  int builtEpoch; // the treeEpoch of the lines indexed, -1 if there is no index
+} STrigramIndex;
 typedef struct SCodeBase {
   // inits the codebase
   void init(SCodeSection* pBaseSec) {
     this->OpList.init();
+    this->GapLine.init();
+    this->SearchIndex.init();
     this->pSymSet = new_symbol_set();
     this->pBaseSec = pBaseSec;
     this->pBaseSec->pCodeBase = this;
     this->pBaseSec->set_symbol_set(pSymSet);
+    this->pSrcPath = NULL;
+    this->srcSize = 0;
+    this->srcMTime = 0;
+    this->srcHash = 0;
+    this->srcNumEdits = 0;
+    this->maxBreaks = 16;
+    this->pBreaks = (SLocation*)malloc(this->maxBreaks * sizeof(SLocation));
+    wxASSERT_MSG(this->pBreaks != NULL, "malloc failure");
+    this->numBreaks = 0;
   };
   bool load_codefile(wxString strFileName) {
     bool bRetVal = false;
-    wxTextFile* pFile = new wxTextFile(strFileName);
-    // open the file, load it into a page and parse the codebase
-    if (pFile->Exists()) {
-      pFile->Open();
-      if (pFile->IsOpened()) {
-        STxtPage* pPage = new_txt_page(pFile->GetLineCount());
-        for (int i = 0; i < (int) pFile->GetLineCount(); i++)
-          pPage->add_line(new_txt_line_wx(pFile->GetLine(i)), i);
-        if (this->pBaseSec->parse(pPage, 0, pFile->GetLineCount(), true))
-          bRetVal = true;
-        else
-          bRetVal = false;
-        free_txt_page(pPage);
-      }
-      pFile->Close();
+    // load the file into a page and parse the codebase
+    STxtPage* pPage = read_codefile(strFileName);
+    if (pPage != NULL && pPage->numLines > 0) {
+      bRetVal = this->pBaseSec->parse(pPage, 0, pPage->numLines, true);
+      if (bRetVal)
+        this->set_source(strFileName, tp_crc(pPage));
+    }
+    free_txt_page(pPage);
+    return(bRetVal);
+  };
+  // records strFileName, as it is on disk now, as the source of this codebase
+  // hash is the CRC32 of its lines (see tp_crc())
+  void set_source(wxString strFileName, unsigned int hash) {
+    if (this->pSrcPath != NULL)
+      tl_free(this->pSrcPath);
+    this->pSrcPath = new_txt_line_wx(strFileName);
+    this->srcSize = (long long) wxFileName(strFileName).GetSize().GetValue();
+    this->srcMTime = (long long) wxFileModificationTime(strFileName);
+    this->srcHash = hash;
+    this->srcNumEdits = this->OpList.numEdits;
+  };
+  // tells if strFileName is the source of this codebase
+  // and still has the size and modification time recorded for it
+  bool is_source_unchanged(wxString strFileName) {
+    bool bRetVal = false;
+    if (this->pSrcPath != NULL && strFileName == wxString(this->pSrcPath->szBuf) && wxFileName::FileExists(strFileName)) {
+      bRetVal = (long long) wxFileName(strFileName).GetSize().GetValue() == this->srcSize;
+      bRetVal = bRetVal && (long long) wxFileModificationTime(strFileName) == this->srcMTime;
     }
-    else
-      bRetVal = false;
-    delete(pFile);
     return(bRetVal);
   };
-  // performs the last edit operation in the oplist of this codebase
-  bool do_edit() {
-    bool bRetVal = true;
-    SOperation Op = this->OpList.get_last();
+  // does the edit operation Op on the code tree of this codebase, or undoes it if bUndo
+  // an edit char op inserts its run into its line or deletes it from there
+  // through GapLine, which the line is loaded into if it's not the one last edited
+  // a split line op splits its line there or joins it with the next one
+  // returns false if its line is not there or is too short, the code tree is then left as is
+  bool do_edit(SOperation& Op, bool bUndo = false) {
+    bool bRetVal = false;
     switch (Op.type) {
     case OP_EDIT_CHAR: {
-      //  char c = pMode->uniKey;
-      char c = 0;
-//      char cU = 0;
-      if (c != WXK_NONE) {
-        if (c >= 32) {
-          //      cU = to_upper( c, pSrcEdr->bShiftDown );
-          //      tl_insert_char( pCurLine, cU, pSrcEdr->Caret.x );
+      SOpEditChar* pRun = &(Op.OpExt.EditChar);
+      SCodeElement* pElem = NULL;
+      if (Op.fileOffset >= 0 && Op.fileOffset < this->pBaseSec->get_length())
+        pElem = elem_from_file_offset(Op.fileOffset, this);
+      if (pElem != NULL && pElem->bSingle && pElem->pLine != NULL) {
+        if (this->GapLine.pLine != pElem->pLine) {
+          this->GapLine.store();
+          this->GapLine.load(pElem->pLine);
+        }
+        // typing or redoing a delete undone inserts, deleting or undoing typing deletes
+        if (pRun->bInsDel != bUndo) {
+          bRetVal = pRun->index >= 0 && pRun->index <= this->GapLine.get_length();
+          if (bRetVal)
+            this->GapLine.insert(pRun->szRun, pRun->length, pRun->index);
+        }
+        else {
+          bRetVal = pRun->index >= 0 && pRun->index + pRun->length <= this->GapLine.get_length();
+          if (bRetVal)
+            this->GapLine.remove(pRun->index, pRun->length);
         }
+        if (bRetVal)
+          this->SearchIndex.note_edited(pElem);
       }
     }
                      break;
-    case OP_CUT_SEL: {
-
+    case OP_SPLIT_LINE: {
+      SOpSplitLine* pSplit = &(Op.OpExt.SplitLine);
+      SCodeElement* pElem = NULL;
+      if (Op.fileOffset >= 0 && Op.fileOffset < this->pBaseSec->get_length())
+        pElem = elem_from_file_offset(Op.fileOffset, this);
+      if (pElem != NULL && pElem->bSingle && pElem->pLine != NULL) {
+        if (this->GapLine.pLine != pElem->pLine) {
+          this->GapLine.store();
+          this->GapLine.load(pElem->pLine);
+        }
+        // splitting or undoing a join splits, joining or undoing a split joins
+        if (pSplit->bSplitJoin != bUndo)
+          bRetVal = this->split_line(pElem, Op.fileOffset, pSplit->index, pSplit->type);
+        else
+          bRetVal = this->join_line(pElem, Op.fileOffset, pSplit->index, &(pSplit->type));
+      }
     }
-                   break;
+                     break;
+    case OP_CUT_SEL:
     case OP_PASTE_SEL: {
-
+      SOpCutPasteSel* pSel = &(Op.OpExt.CutPasteSel);
+      // the line last edited may be cut and freed with the op later
+      this->GapLine.release();
+      // a cut or an undone paste takes the elements out, a paste or an undone cut puts them back
+      if (!pSel->bMoved) {
+        bool bOut = pSel->bCutPaste != bUndo;
+        if (pSel->bHeld != bOut)
+          bRetVal = this->splice_sel(pSel, pSel->secOffset, pSel->depth, pSel->at, bOut);
+        if (bRetVal)
+          pSel->bHeld = bOut;
+      }
+      // a move takes the elements out of where they were cut, unless they are held as they are
+      // when it's pasted, and puts them where they were pasted, an undone move does the reverse
+      else if (!bUndo) {
+        bRetVal = pSel->bHeld || this->splice_sel(pSel, pSel->secOffset, pSel->depth, pSel->at, true);
+        pSel->bHeld = bRetVal;
+        if (bRetVal)
+          bRetVal = this->sel_fits(pSel, pSel->toSecOffset, pSel->toDepth);
+        if (bRetVal)
+          bRetVal = this->splice_sel(pSel, pSel->toSecOffset, pSel->toDepth, pSel->toAt, false);
+        if (bRetVal)
+          pSel->bHeld = false;
+      }
+      else {
+        bRetVal = !pSel->bHeld && this->splice_sel(pSel, pSel->toSecOffset, pSel->toDepth, pSel->toAt, true);
+        if (bRetVal)
+          pSel->bHeld = !this->splice_sel(pSel, pSel->secOffset, pSel->depth, pSel->at, false);
+      }
     }
                      break;
     }
     return(bRetVal);
   };
-  // undoes the last edit operation in the oplist of this codebase
-  // removes the undone operation from the oplist
-  bool undo_edit() {
-    bool bRetVal = true;
+  // tells if the elements of pSel, while they are held, can be moved to the section at toDepth
+  // whose first line is at toSecOffset
+  // they go only in a section of the type and depth of the one they were cut from
+  // so that a block never ends up in a function, or a statement in a struct
+  bool sel_fits(SOpCutPasteSel* pSel, int toSecOffset, int toDepth) {
+    SCodeSection* pFrom = section_from_file_offset(pSel->secOffset, pSel->depth, this);
+    SCodeSection* pTo = section_from_file_offset(toSecOffset, toDepth, this);
+    bool bRetVal = pFrom != NULL && pTo != NULL && toDepth == pSel->depth;
+    return(bRetVal && pFrom->pBaseElem->type == pTo->pBaseElem->type);
+  };
+  // takes the elements of pSel out of index at of the section at depth whose first line is at secOffset
+  // into pSel->ppElems if bOut, else puts them back there, the lines after them are mapped
+  // and the symbols and breakpoints on their lines go out and back in with them
+  // returns false if there is no such section or the elements don't fit in it, it is then left as is
+  bool splice_sel(SOpCutPasteSel* pSel, int secOffset, int depth, int at, bool bOut) {
+    bool bRetVal = false;
+    SCodeSection* pSec = section_from_file_offset(secOffset, depth, this);
+    if (pSec != NULL) {
+      if (bOut)
+        bRetVal = at >= 0 && at + pSel->numElems <= pSec->numElements;
+      else
+        bRetVal = at >= 0 && at <= pSec->numElements;
+    }
+    if (bRetVal) {
+      int from = pSec->get_file_offset();
+      for (int i = 0; i < at; i++)
+        from += ce_length(pSec->ppElements[i]);
+      this->SearchIndex.invalidate();
+      if (bOut) {
+        cutpaste_sel_hold_locations(pSel, this, from);
+        pSec->splice(at, pSel->numElems, pSel->ppElems, 0, NULL);
+        codebase_map_lines(this, from, from + pSel->numLines, -pSel->numLines);
+      }
+      else {
+        pSec->splice(at, 0, NULL, pSel->numElems, pSel->ppElems);
+        // sections loaded with the op have no symbol set yet
+        for (int i = 0; i < pSel->numElems; i++)
+          if (!pSel->ppElems[i]->bSingle)
+            serialize_set_sym_sets(pSel->ppElems[i]->pSec, this->pSymSet);
+        codebase_map_lines(this, from, from, pSel->numLines);
+        cutpaste_sel_put_locations(pSel, this, from);
+      }
+    }
     return(bRetVal);
-  }
-  // compiles and links the codebase into an executable if possible
-  bool build() {
-    bool bRetVal = true;
+  };
+  // splits the line of the single pElem at fileOffset, loaded in GapLine, at index
+  // the chars after index go to a new single element of type after it in its section
+  // returns false if the line is shorter than index
+  bool split_line(SCodeElement* pElem, int fileOffset, int index, int type) {
+    int length = this->GapLine.get_length();
+    bool bRetVal = index >= 0 && index <= length;
+    if (bRetVal) {
+      char* szTail = (char*)malloc((length - index + 1) * sizeof(char));
+      wxASSERT_MSG(szTail != NULL, "malloc failure");
+      for (int i = index; i < length; i++)
+        szTail[i - index] = this->GapLine.get_char(i);
+      szTail[length - index] = 0;
+      this->GapLine.remove(index, length - index);
+      SCodeElement* pTail = new_code_element(type, pElem->pContainer, pElem->indexContainer + 1, NULL);
+      pTail->pLine = new_txt_line(szTail);
+      free(szTail);
+      this->SearchIndex.invalidate();
+      pElem->pContainer->splice(pElem->indexContainer + 1, 0, NULL, 1, &pTail);
+      codebase_map_lines(this, fileOffset + 1, fileOffset + 1, 1);
+    }
     return(bRetVal);
   };
-  // debugs the built executable
-  // if it's not been built, calls build first
-  bool debug() {
-    bool bRetVal = true;
+  // joins the line of the single pElem at fileOffset, loaded in GapLine, with the line of the single
+  // element after it in its section, which is taken out and freed, its type is kept in *pType
+  // the symbols and breakpoints on the line joined are dropped till the lines are parsed again
+  // returns false if pElem's line is not index chars long or there is no such element after it
+  bool join_line(SCodeElement* pElem, int fileOffset, int index, int* pType) {
+    SCodeSection* pSec = pElem->pContainer;
+    int at = pElem->indexContainer + 1;
+    bool bRetVal = index == this->GapLine.get_length() && at < pSec->numElements;
+    bRetVal = bRetVal && pSec->ppElements[at]->bSingle && pSec->ppElements[at]->pLine != NULL;
+    if (bRetVal) {
+      SCodeElement* pNext = NULL;
+      this->SearchIndex.invalidate();
+      pSec->splice(at, 1, &pNext, 0, NULL);
+      this->GapLine.insert(pNext->pLine->szBuf, pNext->pLine->length, index);
+      *pType = pNext->type;
+      free_code_element(pNext);
+      codebase_map_lines(this, fileOffset + 1, fileOffset + 2, -1);
+    }
+    return(bRetVal);
+  };
+  // undoes the edit operation Op, the last one done, on the code tree of this codebase
+  bool undo_edit(SOperation& Op) {
+    return(this->do_edit(Op, true));
+  }
+  // gets the length of the line of the single pElem as it is being edited (see GapLine)
+  int get_line_length(SCodeElement* pElem) {
+    return(pElem->pLine == this->GapLine.pLine ? this->GapLine.get_length() : pElem->pLine->length);
+  };
+  // gets the char at index in the line of the single pElem as it is being edited
+  char get_line_char(SCodeElement* pElem, int index) {
+    return(pElem->pLine == this->GapLine.pLine ? this->GapLine.get_char(index) : pElem->pLine->szBuf[index]);
+  };
+  // copies the line of pElem as it is being edited, without storing it (see GapLine)
+  // the caller has to tl_free it
+  STxtLine* clone_line(SCodeElement* pElem) {
+    return(pElem->pLine == this->GapLine.pLine && this->GapLine.bDirty ? this->GapLine.clone() : tl_clone(pElem->pLine));
+  };
+  // starts compiling the source file of this codebase with strCommand
+  // the compiler runs asynchronously, its output goes to pProcess which is notified when it exits
+  // returns false if there is no source file or the compiler could not be started
+  bool build(wxString strCommand, wxProcess* pProcess) {
+    bool bRetVal = false;
+    if (this->pSrcPath != NULL) {
+      pProcess->Redirect();
+      bRetVal = wxExecute(strCommand + " \"" + wxString(this->pSrcPath->szBuf) + "\"", wxEXEC_ASYNC, pProcess) != 0;
+    }
     return(bRetVal);
   };
-  void serialize(wxFile& File, bool bToFrom) {
+  // starts the debugger strCommand on the program strTarget built from this codebase
+  // the debugger runs asynchronously, it is driven through pProcess which is notified when it exits
+  // returns false if the debugger could not be started
+  bool debug(wxString strCommand, wxString strTarget, wxProcess* pProcess) {
+    pProcess->Redirect();
+    return(wxExecute(strCommand + " \"" + strTarget + "\"", wxEXEC_ASYNC, pProcess) != 0);
+  };
+  // returns the index of the breakpoint at fileOffset, -1 if there is none
+  int find_break(int fileOffset) {
+    int retVal = -1;
+    for (int i = 0; i < this->numBreaks && retVal == -1; i++)
+      if (this->pBreaks[i].fileOffset == fileOffset)
+        retVal = i;
+    return(retVal);
+  };
+  // sets a breakpoint at the line at fileOffset, the element pElem, or clears the one there
+  // returns true if a breakpoint was set
+  bool toggle_break(int fileOffset, SCodeElement* pElem) {
+    int index = this->find_break(fileOffset);
+    if (index != -1) {
+      this->numBreaks--;
+      this->pBreaks[index] = this->pBreaks[this->numBreaks];
+    }
+    else {
+      if (this->numBreaks == this->maxBreaks) {
+        this->maxBreaks = this->maxBreaks * 2;
+        this->pBreaks = (SLocation*)realloc(this->pBreaks, this->maxBreaks * sizeof(SLocation));
+        wxASSERT_MSG(this->pBreaks != NULL, "malloc failure");
+      }
+      this->pBreaks[this->numBreaks].init(pElem, fileOffset);
+      this->numBreaks++;
+    }
+    return(index == -1);
+  };
+
+  void serialize(SBufFile& File, bool bToFrom) {
     // store to 
+    // the code tree, op list and symbols each go in a chunk of their own
     if (bToFrom) {
+      this->GapLine.store();
+      File.begin_chunk(HXC_CODE_TREE, true);
       ce_serialize_base(this->pBaseSec->pBaseElem, File, true);
       this->pBaseSec->serialize(File, bToFrom);
+      File.end_chunk();
+      File.begin_chunk(HXC_OP_RUNS, true);
       this->OpList.serialize(File, true);
+      File.end_chunk();
+      File.begin_chunk(HXC_SYMBOLS, true);
       this->pSymSet->serialize(File, bToFrom);
+      File.end_chunk();
+      if (this->pSrcPath != NULL) {
+        File.begin_chunk(HXC_SOURCE);
+        tl_serialize(this->pSrcPath, File, true);
+        File.Write(&(this->srcSize), sizeof(long long));
+        File.Write(&(this->srcMTime), sizeof(long long));
+        File.Write(&(this->srcHash), sizeof(unsigned int));
+        File.Write(&(this->srcNumEdits), sizeof(int));
+        File.end_chunk();
+      }
+      if (this->numBreaks > 0) {
+        File.begin_chunk(HXC_BREAKPOINTS);
+        File.Write(&(this->numBreaks), sizeof(int));
+        for (int i = 0; i < this->numBreaks; i++)
+          this->pBreaks[i].serialize(File, true);
+        File.end_chunk();
+      }
     }
     // load from
+    // called by load_code_element() once the code tree has been loaded
+    // if the op list or symbols are corrupt, the codebase is restored without them
     else {
-      this->OpList.serialize(File, false);
-      pSymSet->serialize(File, false);
+      // the ops of an older file were never done on its code tree
+      bool bOpRuns = !File.bLegacy && File.open_chunk(HXC_OP_RUNS);
+      if (bOpRuns) {
+        this->OpList.serialize(File, false);
+        File.close_chunk();
+      }
+      if (File.open_chunk(HXC_SYMBOLS)) {
+        pSymSet->serialize(File, false);
+        File.close_chunk();
+      }
+      // the source is not known for old-format files
+      if (!File.bLegacy && File.open_chunk(HXC_SOURCE)) {
+        this->pSrcPath = tl_load(File);
+        File.Read(&(this->srcSize), sizeof(long long));
+        File.Read(&(this->srcMTime), sizeof(long long));
+        File.Read(&(this->srcHash), sizeof(unsigned int));
+        File.Read(&(this->srcNumEdits), sizeof(int));
+        File.close_chunk();
+        if (!bOpRuns)
+          this->OpList.numEdits = this->srcNumEdits;
+      }
+      if (!File.bLegacy && File.open_chunk(HXC_BREAKPOINTS)) {
+        int numBreaks = 0;
+        File.Read(&numBreaks, sizeof(int));
+        for (int i = 0; i < numBreaks && !File.bError; i++) {
+          SLocation Break;
+          Break.init(NULL, -1);
+          Break.serialize(File, false);
+          if (!File.bError && this->find_break(Break.fileOffset) == -1)
+            this->toggle_break(Break.fileOffset, NULL);
+        }
+        File.close_chunk();
+      }
       serialize_map_file_offsets(this->pSymSet, this);
       serialize_set_sym_sets(this->pBaseSec, this->pSymSet);
     }
   };
   SOpList OpList;
+  SGapLine GapLine; // the line last edited, stored back into the code tree when it's read
+  STrigramIndex SearchIndex; // the index of its lines for search
   SSymbolSet* pSymSet;
   SCodeSection* pBaseSec; // pointer to base code section of which this codebase is a sub-struct
+  STxtLine* pSrcPath; // the source file this codebase was loaded from, NULL if not known
+  long long srcSize; // its size and modification time when it was loaded
+  long long srcMTime;
+  unsigned int srcHash; // the CRC32 of its lines when it was loaded
+  int srcNumEdits; // OpList.numEdits then, if it differs this codebase has edits not in the file
+  SLocation* pBreaks; // the breakpoints set in this codebase
+  int numBreaks;
+  int maxBreaks;
 } SCodeBase;
 
 // new a codebase ptr on the heap
@@ -7082,7 +10371,7 @@ SCodeBase* new_codebase() {
   return(pElem->pSec->pCodeBase);
 }
 // load a code element from a File
-SCodeElement* load_code_element(wxFile& File, SCodeSection* pContainer, int indexContainer) {
+SCodeElement* load_code_element(SBufFile& File, SCodeSection* pContainer, int indexContainer) {
   SCodeElement* pElem = (SCodeElement*)malloc(sizeof(SCodeElement));
   if (pElem != NULL) {
     pElem->pContainer = pContainer;
@@ -7111,13 +10400,90 @@ void free_codebase(SCodeBase* pCodeBase) {
   if (pCodeBase != NULL) {
     free_symbol_set(pCodeBase->pSymSet);
     pCodeBase->pSymSet = NULL;
+    pCodeBase->OpList.clear();
     free(pCodeBase->OpList.pOps);
     pCodeBase->OpList.pOps = NULL;
+    free(pCodeBase->GapLine.szBuf);
+    pCodeBase->GapLine.szBuf = NULL;
+    pCodeBase->SearchIndex.clear();
+    free(pCodeBase->SearchIndex.ppEdited);
     free_code_section(pCodeBase->pBaseSec);
     pCodeBase->pBaseSec = NULL;
+    tl_free(pCodeBase->pSrcPath);
+    pCodeBase->pSrcPath = NULL;
+    free(pCodeBase->pBreaks);
     free(pCodeBase);
   }
 }
+// an index of the elements of a codebase by file offset
+// built in a single walk of the codebase at its current summarization.
+// get_element_at() returns the same element as
+// pBaseSec->get_element_at(fileOffset, 0, &offset)
+// but with a binary search instead of a walk from the start of the codebase.
+// it is only valid till the codebase is edited or (un)summarized
+// it speeds up patching the symbols' element pointers on restore (see serialize_map_file_offsets()),
+// the tree itself is still rebuilt node by node from the snapshot, there is no pointer-free image
+// of it to map, as all of the editor walks and edits the elements in place
+typedef struct SElemIndex {
+  void init(SCodeSection* pBaseSec) {
+    this->maxElems = 1024;
+    this->ppElems = (SCodeElement**)malloc(this->maxElems * sizeof(SCodeElement*));
+    this->pStarts = (int*)malloc(this->maxElems * sizeof(int));
+    wxASSERT_MSG(this->ppElems != NULL && this->pStarts != NULL, "malloc failure");
+    this->numElems = 0;
+    // walk the elements in display order accumulating their lengths
+    int fileOffset = 0;
+    SCodeElement* pElem = pBaseSec->get_next_element(NULL, true);
+    while (pElem != NULL) {
+      if (this->numElems == this->maxElems) {
+        this->maxElems = this->maxElems * 2;
+        this->ppElems = (SCodeElement**)realloc(this->ppElems, this->maxElems * sizeof(SCodeElement*));
+        this->pStarts = (int*)realloc(this->pStarts, this->maxElems * sizeof(int));
+        wxASSERT_MSG(this->ppElems != NULL && this->pStarts != NULL, "malloc failure");
+      }
+      this->ppElems[this->numElems] = pElem;
+      this->pStarts[this->numElems] = fileOffset;
+      this->numElems++;
+      fileOffset += ce_length(pElem);
+      pElem = pBaseSec->get_next_element(pElem, true);
+    }
+  };
+  // gets the element that contains fileOffset
+  // the first or last element if fileOffset is out of range, NULL if the codebase is empty
+  SCodeElement* get_element_at(int fileOffset) {
+    SCodeElement* pElem = NULL;
+    int lo = 0;
+    int hi = this->numElems - 1;
+    // find the last element starting at or before fileOffset
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (this->pStarts[mid] <= fileOffset)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    if (this->numElems > 0)
+      pElem = this->ppElems[lo];
+    return(pElem);
+  };
+  SCodeElement** ppElems; // the elements in display order
+  int* pStarts; // the file offset each element starts at
+  int numElems;
+  int maxElems;
+} SElemIndex;
+// allocs and inits an index of the codebase at pBaseSec
+// caller has to free
+SElemIndex* new_elem_index(SCodeSection* pBaseSec) {
+  SElemIndex* pIndex = (SElemIndex*)malloc(sizeof(SElemIndex));
+  wxASSERT_MSG(pIndex != NULL, "malloc failure");
+  pIndex->init(pBaseSec);
+  return(pIndex);
+}
+void free_elem_index(SElemIndex* pIndex) {
+  free(pIndex->ppElems);
+  free(pIndex->pStarts);
+  free(pIndex);
+}
 // ancillary used by serialize to store pointers as fileOffsets in the codebase
 SCodeElement* elem_from_file_offset(int fileOffset, SCodeBase* pCodeBase) {
   SCodeElement* pElem;
@@ -7132,86 +10498,218 @@ SCodeElement* elem_from_file_offset(int fileOffset, SCodeBase* pCodeBase) {
   }
   return(pElem);
 }
+// gets the section at depth in pCodeBase, 0 being its base section, whose first line is at secOffset
+// it ignores summarization, an empty section is found too
+// returns NULL if there is no such section
+SCodeSection* section_from_file_offset(int secOffset, int depth, SCodeBase* pCodeBase) {
+  SCodeSection* pSec = pCodeBase->pBaseSec;
+  int start = 0;
+  for (int d = 0; d < depth && pSec != NULL; d++) {
+    SCodeSection* pFound = NULL;
+    for (int i = 0; i < pSec->numElements && pFound == NULL && start <= secOffset; i++) {
+      SCodeElement* pElem = pSec->ppElements[i];
+      int length = ce_length(pElem);
+      if (!pElem->bSingle && secOffset >= start && (secOffset < start + length || (length == 0 && secOffset == start)))
+        pFound = pElem->pSec;
+      else
+        start += length;
+    }
+    pSec = pFound;
+  }
+  if (pSec != NULL && start != secOffset)
+    pSec = NULL;
+  return(pSec);
+}
 
-// the symbols in a codebase are pointers to elements in the codebase
-// since a pointer cant be serialized
-// we serialize the file offset location of the pointed to element instead.
-// when we load a serialized symbol with a file offset location,
-// this location has to be converted back to a pointer to an element in the codebase.
-// this functions does just that for the entire symbol set
-// it takes the unconverted symbol set and the codebase
-// in which to find the pointed to elements as inputs
-void serialize_map_file_offsets(SSymbolSet* pSymSet, SCodeBase* pCodeBase) {
-  int fileOffset = 0;
-  int dummy = 0;
-  // map the file offsets for the class set
+// shifts a symbol's location when lines of the codebase have been replaced
+// [from, to) are the replaced lines and delta the number of lines added in their place.
+// a location after them moves by delta, a location in them is dropped (-1)
+// till the lines are parsed again.
+// then, if pIndex is not NULL, points the location at its element in pIndex
+void map_location(SLocation* pLocation, SElemIndex* pIndex, int from, int to, int delta) {
+  if (pLocation->fileOffset >= to)
+    pLocation->fileOffset += delta;
+  else if (pLocation->fileOffset >= from) {
+    pLocation->fileOffset = -1;
+    pLocation->pCodeBaseLoc = NULL;
+  }
+  if (pIndex != NULL && pLocation->fileOffset != -1)
+    pLocation->pCodeBaseLoc = pIndex->get_element_at(pLocation->fileOffset);
+}
+// calls map_location() on every breakpoint of pCodeBase
+// the breakpoints on replaced lines are cleared
+void codebase_map_breaks(SCodeBase* pCodeBase, SElemIndex* pIndex, int from, int to, int delta) {
+  int num = 0;
+  for (int i = 0; i < pCodeBase->numBreaks; i++) {
+    map_location(&(pCodeBase->pBreaks[i]), pIndex, from, to, delta);
+    if (pCodeBase->pBreaks[i].fileOffset != -1) {
+      pCodeBase->pBreaks[num] = pCodeBase->pBreaks[i];
+      num++;
+    }
+  }
+  pCodeBase->numBreaks = num;
+}
+// ancillary fn of sym_set_get_locations()
+// a symbol without a location, such as a parameter, is skipped
+void sym_add_location(SLocation** ppLocs, int* pNum, SLocation* pLocation) {
+  if (pLocation != NULL) {
+    if (ppLocs != NULL)
+      ppLocs[*pNum] = pLocation;
+    *pNum += 1;
+  }
+}
+// gets the location of every symbol in pSymSet into ppLocs, if it's not NULL
+// they are always in the same order for a symbol set, so a location can be held by its index
+// returns the number of locations
+int sym_set_get_locations(SSymbolSet* pSymSet, SLocation** ppLocs) {
+  int num = 0;
+  // the class set
   for (int i = 0; i < pSymSet->pClassSet->numClasses; i++) {
     SClass* pClass = pSymSet->pClassSet->ppClasses[i];
-    fileOffset = pClass->pLocation->fileOffset;
-    if (fileOffset != -1)
-      pClass->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+    sym_add_location(ppLocs, &num, pClass->pLocation);
     // constr
     if (pClass->pConstr != NULL) {
-      fileOffset = pClass->pConstr->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pClass->pConstr->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pClass->pConstr->pLocation);
     }
     // destr
     if (pClass->pDestr != NULL) {
-      fileOffset = pClass->pDestr->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pClass->pDestr->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pClass->pDestr->pLocation);
     }
     // funcset
     for (int j = 0; j < pClass->pFuncSet->numFuncs; j++) {
       SSymFunc* pFunc = pClass->pFuncSet->ppFuncs[j];
-      fileOffset = pFunc->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pFunc->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pFunc->pLocation);
     }
     // varset
     for (int j = 0; j < pClass->pVarSet->numVars; j++) {
       SVar* pVar = pClass->pVarSet->ppVars[j];
-      fileOffset = pVar->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pVar->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pVar->pLocation);
     }
   }
-  // map the file offsets for the struct set
+  // the struct set
   for (int i = 0; i < pSymSet->pStructSet->numStructs; i++) {
     SStruct* pStruct = pSymSet->pStructSet->ppStructs[i];
-    fileOffset = pStruct->pLocation->fileOffset;
-    if (fileOffset != -1)
-      pStruct->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+    sym_add_location(ppLocs, &num, pStruct->pLocation);
     // funcset
     for (int j = 0; j < pStruct->pFuncSet->numFuncs; j++) {
       SSymFunc* pFunc = pStruct->pFuncSet->ppFuncs[j];
-      fileOffset = pFunc->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pFunc->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pFunc->pLocation);
     }
     // varset
     for (int j = 0; j < pStruct->pVarSet->numVars; j++) {
       SVar* pVar = pStruct->pVarSet->ppVars[j];
-      fileOffset = pVar->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pVar->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+      sym_add_location(ppLocs, &num, pVar->pLocation);
     }
   }
-  // map the file offsets for the func set
+  // the func set
   for (int i = 0; i < pSymSet->pFuncSet->numFuncs; i++) {
     SSymFunc* pFunc = pSymSet->pFuncSet->ppFuncs[i];
-    fileOffset = pFunc->pLocation->fileOffset;
-    if (fileOffset != -1)
-      pFunc->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
+    sym_add_location(ppLocs, &num, pFunc->pLocation);
     // varset
     for (int j = 0; j < pFunc->pVarSet->numVars; j++) {
       SVar* pVar = pFunc->pVarSet->ppVars[j];
-      fileOffset = pVar->pLocation->fileOffset;
-      if (fileOffset != -1)
-        pVar->pLocation->pCodeBaseLoc = pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &dummy);
-    }
-  }
+      sym_add_location(ppLocs, &num, pVar->pLocation);
+    }
+  }
+  return(num);
+}
+// calls map_location() on the location of every symbol in pSymSet
+void sym_set_map_locations(SSymbolSet* pSymSet, SElemIndex* pIndex, int from, int to, int delta) {
+  int num = sym_set_get_locations(pSymSet, NULL);
+  SLocation** ppLocs = (SLocation**)malloc((num + 1) * sizeof(SLocation*));
+  wxASSERT_MSG(ppLocs != NULL, "malloc failure");
+  sym_set_get_locations(pSymSet, ppLocs);
+  for (int i = 0; i < num; i++)
+    map_location(ppLocs[i], pIndex, from, to, delta);
+  free(ppLocs);
+}
+// maps the symbols and breakpoints of pCodeBase once the lines [from, to) of it
+// have been replaced by to - from + delta lines (see map_location())
+void codebase_map_lines(SCodeBase* pCodeBase, int from, int to, int delta) {
+  SElemIndex* pIndex = new_elem_index(pCodeBase->pBaseSec);
+  sym_set_map_locations(pCodeBase->pSymSet, pIndex, from, to, delta);
+  codebase_map_breaks(pCodeBase, pIndex, from, to, delta);
+  free_elem_index(pIndex);
+}
+// holds the symbols and breakpoints on the lines of pSel, which start at from, in pSel
+// before its elements are taken out and codebase_map_lines() drops them
+void cutpaste_sel_hold_locations(SOpCutPasteSel* pSel, SCodeBase* pCodeBase, int from) {
+  int to = from + pSel->numLines;
+  int num = sym_set_get_locations(pCodeBase->pSymSet, NULL);
+  SLocation** ppLocs = (SLocation**)malloc((num + 1) * sizeof(SLocation*));
+  wxASSERT_MSG(ppLocs != NULL, "malloc failure");
+  sym_set_get_locations(pCodeBase->pSymSet, ppLocs);
+  free(pSel->pLocIds);
+  free(pSel->pLocLines);
+  free(pSel->pBreakLines);
+  pSel->numLocs = 0;
+  for (int i = 0; i < num; i++)
+    if (ppLocs[i]->fileOffset >= from && ppLocs[i]->fileOffset < to)
+      pSel->numLocs++;
+  pSel->numBreaks = 0;
+  for (int i = 0; i < pCodeBase->numBreaks; i++)
+    if (pCodeBase->pBreaks[i].fileOffset >= from && pCodeBase->pBreaks[i].fileOffset < to)
+      pSel->numBreaks++;
+  pSel->pLocIds = (int*)malloc((pSel->numLocs + 1) * sizeof(int));
+  pSel->pLocLines = (int*)malloc((pSel->numLocs + 1) * sizeof(int));
+  pSel->pBreakLines = (int*)malloc((pSel->numBreaks + 1) * sizeof(int));
+  wxASSERT_MSG(pSel->pLocIds != NULL && pSel->pLocLines != NULL && pSel->pBreakLines != NULL, "malloc failure");
+  int numLocs = 0;
+  for (int i = 0; i < num; i++)
+    if (ppLocs[i]->fileOffset >= from && ppLocs[i]->fileOffset < to) {
+      pSel->pLocIds[numLocs] = i;
+      pSel->pLocLines[numLocs] = ppLocs[i]->fileOffset - from;
+      numLocs++;
+    }
+  int numBreaks = 0;
+  for (int i = 0; i < pCodeBase->numBreaks; i++)
+    if (pCodeBase->pBreaks[i].fileOffset >= from && pCodeBase->pBreaks[i].fileOffset < to) {
+      pSel->pBreakLines[numBreaks] = pCodeBase->pBreaks[i].fileOffset - from;
+      numBreaks++;
+    }
+  free(ppLocs);
+}
+// puts the symbols and breakpoints held in pSel back on its lines, which now start at from
+// once its elements are back in and codebase_map_lines() has mapped the lines after them
+void cutpaste_sel_put_locations(SOpCutPasteSel* pSel, SCodeBase* pCodeBase, int from) {
+  if (pSel->numLocs > 0 || pSel->numBreaks > 0) {
+    SElemIndex* pIndex = new_elem_index(pCodeBase->pBaseSec);
+    int num = sym_set_get_locations(pCodeBase->pSymSet, NULL);
+    SLocation** ppLocs = (SLocation**)malloc((num + 1) * sizeof(SLocation*));
+    wxASSERT_MSG(ppLocs != NULL, "malloc failure");
+    sym_set_get_locations(pCodeBase->pSymSet, ppLocs);
+    for (int i = 0; i < pSel->numLocs; i++)
+      if (pSel->pLocIds[i] >= 0 && pSel->pLocIds[i] < num) {
+        SLocation* pLocation = ppLocs[pSel->pLocIds[i]];
+        pLocation->fileOffset = from + pSel->pLocLines[i];
+        pLocation->pCodeBaseLoc = pIndex->get_element_at(pLocation->fileOffset);
+      }
+    for (int i = 0; i < pSel->numBreaks; i++) {
+      int fileOffset = from + pSel->pBreakLines[i];
+      if (pCodeBase->find_break(fileOffset) == -1)
+        pCodeBase->toggle_break(fileOffset, pIndex->get_element_at(fileOffset));
+    }
+    free(ppLocs);
+    free_elem_index(pIndex);
+  }
+  pSel->numLocs = 0;
+  pSel->numBreaks = 0;
+}
+
+// the symbols in a codebase are pointers to elements in the codebase
+// since a pointer cant be serialized
+// we serialize the file offset location of the pointed to element instead.
+// when we load a serialized symbol with a file offset location,
+// this location has to be converted back to a pointer to an element in the codebase.
+// this functions does just that for the entire symbol set
+// it takes the unconverted symbol set and the codebase
+// in which to find the pointed to elements as inputs
+void serialize_map_file_offsets(SSymbolSet* pSymSet, SCodeBase* pCodeBase) {
+  // index the codebase once instead of walking it for every symbol
+  SElemIndex* pIndex = new_elem_index(pCodeBase->pBaseSec);
+  sym_set_map_locations(pSymSet, pIndex, 0, 0, 0);
+  codebase_map_breaks(pCodeBase, pIndex, 0, 0, 0);
+  free_elem_index(pIndex);
   return;
 }
 
@@ -7229,6 +10727,175 @@ void serialize_set_sym_sets(SCodeSection* pSec, SSymbolSet* pSymSet) {
     if (!pSec->ppElements[i]->bSingle)
       serialize_set_sym_sets(pSec->ppElements[i]->pSec, pSymSet);
 }
+// gathers the lines of pSec in file order into ppLines from *pNum on
+// the lines are not copies, they are the lines of pSec's elements
+void cs_gather_lines(SCodeSection* pSec, STxtLine** ppLines, int* pNum) {
+  for (int i = 0; i < pSec->numElements; i++) {
+    if (pSec->ppElements[i]->bSingle) {
+      ppLines[*pNum] = pSec->ppElements[i]->pLine;
+      *pNum += 1;
+    }
+    else
+      cs_gather_lines(pSec->ppElements[i]->pSec, ppLines, pNum);
+  }
+}
+// parses pPage into pCodeBase all over again, with a fresh symbol set
+bool codebase_reparse(SCodeBase* pCodeBase, STxtPage* pPage) {
+  SCodeSection* pBaseSec = pCodeBase->pBaseSec;
+  for (int i = pBaseSec->numElements - 1; i >= 0; i--)
+    pBaseSec->remove_element(i);
+  free_symbol_set(pCodeBase->pSymSet);
+  pCodeBase->pSymSet = new_symbol_set();
+  pBaseSec->set_symbol_set(pCodeBase->pSymSet);
+  return(pBaseSec->parse(pPage, 0, pPage->numLines, true));
+}
+// parses again the top-level sections (preamble, blocks) of pCodeBase that lines [head, end) fall in.
+// pPage is the changed source, it has the lines of the codebase but for those.
+// the sections either side of the change are parsed again too,
+// a change at the edge of a section may have moved its demarcator.
+// on return [*pFrom, *pTo) are the lines of the replaced sections
+// returns false if the codebase is not a modal codefile or the change isn't confined to whole sections
+bool codebase_reparse_sections(SCodeBase* pCodeBase, STxtPage* pPage, int head, int end, int* pFrom, int* pTo) {
+  SCodeSection* pBaseSec = pCodeBase->pBaseSec;
+  int numOld = pBaseSec->get_length();
+  int delta = pPage->numLines - numOld;
+  int first = -1;
+  int last = -1;
+  // a modal codefile is a preamble followed by blocks
+  bool bRetVal = numOld > 0 && pBaseSec->ppElements[0]->type == CDE_PREAMBLE;
+  // find the sections holding the line before the change and the line after it
+  int lineBefore = (head > 0) ? head - 1 : 0;
+  int lineAfter = (end < numOld) ? end : numOld - 1;
+  int start = 0;
+  for (int i = 0; i < pBaseSec->numElements && bRetVal; i++) {
+    int length = ce_length(pBaseSec->ppElements[i]);
+    if (pBaseSec->ppElements[i]->bSingle)
+      bRetVal = false;
+    if (first == -1 && lineBefore < start + length) {
+      first = i;
+      *pFrom = start;
+    }
+    if (last == -1 && lineAfter < start + length) {
+      last = i;
+      *pTo = start + length;
+    }
+    start += length;
+  }
+  bRetVal = bRetVal && first != -1 && last != -1 && *pTo + delta > *pFrom;
+  // the new lines must start with the demarcator of the first section
+  // and a preamble must be followed by a block
+  if (bRetVal) {
+    STxtLine* pLine = pPage->ppLines[*pFrom];
+    if (first == 0) {
+      bool bBlock = last < pBaseSec->numElements - 1;
+      for (int i = *pFrom + 1; i < *pTo + delta && !bBlock; i++)
+        if (tl_find(pPage->ppLines[i], (char*)"// BLOCK:") == 0)
+          bBlock = true;
+      bRetVal = bBlock && tl_find(pLine, (char*)"// PREAMBLE:") == 0;
+    }
+    else
+      bRetVal = tl_find(pLine, (char*)"// BLOCK:") == 0;
+  }
+  if (bRetVal) {
+    int type = pBaseSec->ppElements[first]->type;
+    // drop the symbols in the replaced sections and shift the ones after them
+    // the symbols still there are added back as the new sections are parsed
+    sym_set_map_locations(pCodeBase->pSymSet, NULL, *pFrom, *pTo, delta);
+    for (int i = last; i >= first; i--)
+      pBaseSec->remove_element(i);
+    // parse the new lines into sections split at the block demarcators
+    // as parse_codebase() does
+    int at = first;
+    int offsetPrev = *pFrom;
+    for (int offset = *pFrom + 1; offset <= *pTo + delta && bRetVal; offset++) {
+      if (offset == *pTo + delta || tl_find(pPage->ppLines[offset], (char*)"// BLOCK:") == 0) {
+        bRetVal = pBaseSec->insert_section(at, type, offsetPrev, offset - offsetPrev, pPage, true, 0, -1);
+        type = CDE_BLOCK;
+        offsetPrev = offset;
+        at++;
+      }
+    }
+    // point the symbols at their elements in the spliced codebase
+    if (bRetVal) {
+      SElemIndex* pIndex = new_elem_index(pBaseSec);
+      sym_set_map_locations(pCodeBase->pSymSet, pIndex, 0, 0, 0);
+      free_elem_index(pIndex);
+    }
+  }
+  return(bRetVal);
+}
+// brings pCodeBase up to date with its source file if that changed on disk since it was recorded.
+// the lines common to the start and end of the old and new source are skipped
+// and only the sections the rest fall in are parsed again (see codebase_reparse_sections()),
+// the whole file if that fails.
+// a codebase with edits not in its source file (see SCodeBase::srcNumEdits) is kept as is.
+// on return [*pFrom, *pTo) are the lines of the codebase that were replaced
+// and *pDelta the number of lines added to it
+// returns true if the codebase changed
+bool codebase_refresh_source(SCodeBase* pCodeBase, int* pFrom, int* pTo, int* pDelta) {
+  bool bRetVal = false;
+  STxtPage* pPage = NULL;
+  wxString strFileName;
+  *pFrom = 0;
+  *pTo = 0;
+  *pDelta = 0;
+  // the lines are compared and may be parsed again
+  pCodeBase->GapLine.release();
+  if (pCodeBase->pSrcPath != NULL) {
+    strFileName = wxString(pCodeBase->pSrcPath->szBuf);
+    if (!pCodeBase->is_source_unchanged(strFileName)) {
+      if (pCodeBase->OpList.numEdits != pCodeBase->srcNumEdits)
+        wxLogMessage("%s changed on disk, keeping the codebase with your edits", strFileName);
+      else
+        pPage = read_codefile(strFileName);
+    }
+  }
+  // an emptied file is not parsed, the codebase is kept
+  if (pPage != NULL && pPage->numLines == 0) {
+    free_txt_page(pPage);
+    pPage = NULL;
+  }
+  if (pPage != NULL) {
+    unsigned int hash = tp_crc(pPage);
+    // if only touched, the codebase is as is
+    if (hash != pCodeBase->srcHash) {
+      int numOld = pCodeBase->pBaseSec->get_length();
+      int numNew = pPage->numLines;
+      STxtLine** ppOld = (STxtLine**)malloc((numOld + 1) * sizeof(STxtLine*));
+      wxASSERT_MSG(ppOld != NULL, "malloc failure");
+      int num = 0;
+      cs_gather_lines(pCodeBase->pBaseSec, ppOld, &num);
+      // skip the lines common to the start and end of both
+      int head = 0;
+      while (head < numOld && head < numNew && tl_equals(ppOld[head], pPage->ppLines[head]))
+        head++;
+      int tail = 0;
+      while (tail < numOld - head && tail < numNew - head && tl_equals(ppOld[numOld - 1 - tail], pPage->ppLines[numNew - 1 - tail]))
+        tail++;
+      free(ppOld);
+      if (head < numOld || head < numNew) {
+        *pDelta = numNew - numOld;
+        if (!codebase_reparse_sections(pCodeBase, pPage, head, numOld - tail, pFrom, pTo)) {
+          *pFrom = 0;
+          *pTo = numOld;
+          if (!codebase_reparse(pCodeBase, pPage))
+            wxLogError("%s could not be parsed", strFileName);
+        }
+        // the breakpoints on lines that did not change are kept
+        SElemIndex* pIndex = new_elem_index(pCodeBase->pBaseSec);
+        codebase_map_breaks(pCodeBase, pIndex, head, numOld - tail, *pDelta);
+        free_elem_index(pIndex);
+        // the edits were made to what the source was before, they can't be undone on it
+        pCodeBase->OpList.clear();
+        pCodeBase->SearchIndex.invalidate();
+        bRetVal = true;
+      }
+    }
+    pCodeBase->set_source(strFileName, hash);
+    free_txt_page(pPage);
+  }
+  return(bRetVal);
+}
 
 // BLOCK: THIS APP'S PRIMARY MODE, THE SOURCE EDITOR 
 // This block contains the definition for mode source editor
@@ -7243,69 +10910,711 @@ void serialize_set_sym_sets(SCodeSection* pSec, SSymbolSet* pSymSet) {
 // Goto is using Ctrl-right arrow, Back is Ctrl-left arrow
 // SUBBLOCK: BASE DEFINITIONS
 
-// the different (user) intents for mode source editor
+// Build diagnostics
+// A build runs the compiler on the exported source file (see src_edr_build()).
+// Every line it outputs is kept as an SDiag.
+// A line the compiler reported against the source file is a diagnostic,
+// it has a severity and the location of the source line it was reported at.
+// The diagnostics mode is a pop-up that lists the lines of the last build,
+// Up and Down arrows select a line, Enter goes to its location, Esc exits.
+// severities of a diagnostic
 enum {
-  // change the location of the caret using arrows or PgUp, PgDn
-  SEI_UPDATE_CARET=0,
-  // summarize or expand a section using Ctrl-S
-  SEI_SUMMARIZE,
-  // goto (or return from) the symbol at caret line using Ctrl-right/left
-  SEI_GOTO,
-  // edit a character using alphanumerics or Return or Backspace
-  SEI_EDIT_CHAR,
-  // start a selection using Shift-arrow
-  SEI_START_SEL,
-  // update a selection using Shift-arrow
-  SEI_UPDATE_SEL,
-  // unselect a selection by pressing an alphnumeric
-  SEI_UN_SEL,
-  // cut a selection using Ctrl-X
-  SEI_CUT_SEL,
-  // paste a selection using Ctrl-V
-  SEI_PASTE_SEL,
-  // undo the last edit operation using Ctrl-Z
-  SEI_UNDO,
-  // redo the last edit operation using Shift-Ctrl-Z
-  SEI_REDO,
-  // launch the mode level controls menu by pressing Ctrl
-  SEI_CONTROL,
-  // export the current codebase to a cpp file
-  SEI_EXPORT,
-  // save the current codebase and load a new one
-  SEI_LOAD_NEW,
-  // build the current codebase
-  SEI_BUILD,
-  // debug the current executable
-  SEI_DEBUG,
-  // agjust the fontsize
-  SEI_ADJUST_FONTSIZE,
-  // got a line in the codebase
-  SEI_GOTO_LINE,
-  // input the codefile to load
-  SEI_INPUT_CODEFILE
+  DGS_NONE=0,
+  DGS_NOTE,
+  DGS_WARNING,
+  DGS_ERROR
 };
-// the source editor mode
-typedef struct SModeSrcEdr {
-  // inits with scrnW, scrnH
-  // note that init does not set the codebase
-  // this has to be done before the mode can be used
-  void init( SMode *pBase ) {
-    pBase->fnDisp_state = src_edr_disp_state;
-    pBase->fnKybd_map = src_edr_map;
-    pBase->fnKey_up = src_edr_key_up;
-    pBase->fnSerialize = src_edr_serialize;
-    pBase->fnOn_load = src_edr_on_load;
-    pBase->type = MODE_SOURCE_EDITOR;
-    pBase->bReset = true;
-    this->pBase = pBase;
-    this->load_intents( pBase );
-    this->pLineInp = new_line_input( pBase->scrnW, pBase->scrnH, pBase->pFont );
-    this->pMsg = new_msg( pBase->scrnW, pBase->scrnH, pBase->pFont );
-    this->pFileSel = new_file_sel(pBase->scrnW, pBase->scrnH, pBase->pFont);
-    this->pLevAdj = new_lev_adj(pBase->scrnW, pBase->scrnH, pBase->pFont);
-    this->pCodeBase = NULL;
-    this->fileOffset = 0;
-    this->Caret.x = 0;
+// a line of build output
+typedef struct SDiag {
+  int severity; // DGS_NONE if the line is not a diagnostic
+  SLocation Location; // the source line it was reported at, fileOffset -1 if none
+  STxtLine *pText;
+} SDiag;
+// scans back over a ":<digits>" that ends at szLine[end]
+// returns the index of its ':', end if there is none
+int diag_scan_num( char *szLine, int end ) {
+  int retVal = end;
+  int start = end;
+  while( start > 0 && isdigit( (unsigned char) szLine[start - 1] ) )
+    start--;
+  if( start < end && start > 0 && szLine[start - 1] == ':' )
+    retVal = start - 1;
+  return( retVal );
+}
+// parses a line of compiler output for a diagnostic, returns its severity, DGS_NONE if it's not one
+// gcc and clang report <file>:<line>[:<col>]: <severity>: <message>
+// msvc reports <file>(<line>[,<col>]): <severity> <code>: <message>
+// *pLine is set to the line it was reported at if <file> is named szSrcName, else to 0
+int diag_parse( char *szLine, char *szSrcName, int *pLine ) {
+  const char *aszSev[] = { "fatal error", "error", "warning", "note" };
+  int aSev[] = { DGS_ERROR, DGS_ERROR, DGS_WARNING, DGS_NOTE };
+  int severity = DGS_NONE;
+  int len = strlen( szLine );
+  int end = 0;
+  *pLine = 0;
+  // the location ends at the first ": " followed by a severity
+  for( int i=0; i + 1 < len && severity == DGS_NONE; i++ ) {
+    if( szLine[i] == ':' && szLine[i + 1] == ' ' ) {
+      for( int j=0; j<4 && severity == DGS_NONE; j++ ) {
+        int sevEnd = i + 2 + strlen( aszSev[j] );
+        if( strncmp( szLine + i + 2, aszSev[j], strlen( aszSev[j] ) ) == 0 && (szLine[sevEnd] == ':' || szLine[sevEnd] == ' ') ) {
+          severity = aSev[j];
+          end = i;
+        }
+      }
+    }
+  }
+  // split the location into the file and the line
+  if( severity != DGS_NONE ) {
+    int nameEnd = end;
+    int line = 0;
+    if( end > 0 && szLine[end - 1] == ')' ) {
+      while( nameEnd > 0 && szLine[nameEnd] != '(' )
+        nameEnd--;
+      line = atoi( szLine + nameEnd + 1 );
+    }
+    else {
+      // the line is the first of up to 2 numbers
+      int numStart = diag_scan_num( szLine, end );
+      if( numStart < end ) {
+        nameEnd = diag_scan_num( szLine, numStart );
+        line = atoi( szLine + nameEnd + 1 );
+      }
+    }
+    if( line > 0 && wxFileName( wxString( szLine, nameEnd ) ).GetFullName() == wxString( szSrcName ) )
+      *pLine = line;
+  }
+  return( severity );
+}
+// the intents for mode diagnostics
+enum {
+  DGI_CHANGE_SEL=0,
+  DGI_GOTO
+};
+#define DIAGS_ROWS 20
+// the pop-up diagnostics mode
+typedef struct SModeDiags {
+  void init( SMode *pBase, SMode *pEditor ) {
+    pBase->fnDisp_state = diags_disp_state;
+    pBase->fnKybd_map = diags_map;
+    pBase->type = MODE_DIAGNOSTICS;
+    pBase->bReset = true;
+    this->pBase = pBase;
+    this->load_intents( pBase );
+    this->pEditor = pEditor;
+    this->pCodeBase = NULL;
+    this->pSrcName = NULL;
+    this->maxDiags = 64;
+    this->pDiags = (SDiag *) malloc( this->maxDiags * sizeof(SDiag) );
+    wxASSERT_MSG( this->pDiags != NULL, "malloc failure" );
+    this->numDiags = 0;
+    this->numErrors = 0;
+    this->numWarnings = 0;
+    this->bRunning = false;
+    this->bBuilt = false;
+    this->bCached = false;
+    this->pCachePath = NULL;
+    this->exitCode = 0;
+    this->pOutLine = new_txt_buf( 256 );
+    this->pErrLine = new_txt_buf( 256 );
+    this->firstRow = 0;
+    this->curSel = 0;
+    this->Rect = wxRect( 0, 0, 0, 0 );
+  };
+  // loads the intent dispatch fns for this mode
+  void load_intents( SMode *pBase ) {
+    pBase->numIntents = 2;
+    pBase->fnIntent_handler[DGI_CHANGE_SEL] = diags_change_sel;
+    pBase->fnIntent_handler[DGI_GOTO] = diags_goto;
+  };
+  // clears the lines of the last build for a build of pCodeBase
+  // the result of the build is to be cached at strCachePath
+  void reset( SCodeBase *pCodeBase, wxString strCachePath ) {
+    for( int i=0; i<this->numDiags; i++ )
+      tl_free( this->pDiags[i].pText );
+    this->numDiags = 0;
+    this->numErrors = 0;
+    this->numWarnings = 0;
+    this->bRunning = true;
+    this->bBuilt = true;
+    this->bCached = false;
+    tl_free( this->pCachePath );
+    this->pCachePath = new_txt_line_wx( strCachePath );
+    this->exitCode = 0;
+    this->pOutLine->length = 0;
+    this->pErrLine->length = 0;
+    this->firstRow = 0;
+    this->curSel = 0;
+    this->pCodeBase = pCodeBase;
+    tl_free( this->pSrcName );
+    this->pSrcName = new_txt_line_wx( wxFileName( wxString( pCodeBase->pSrcPath->szBuf ) ).GetFullName() );
+  };
+  // adds the line of build output in pLine and empties pLine
+  void add_line( STxtBuf *pLine ) {
+    if( this->numDiags == this->maxDiags ) {
+      this->maxDiags = this->maxDiags * 2;
+      this->pDiags = (SDiag *) realloc( this->pDiags, this->maxDiags * sizeof(SDiag) );
+      wxASSERT_MSG( this->pDiags != NULL, "malloc failure" );
+    }
+    SDiag *pDiag = &(this->pDiags[this->numDiags]);
+    int line = 0;
+    pLine->append( "", 1 );
+    pDiag->pText = new_txt_line( pLine->pData );
+    pDiag->severity = diag_parse( pLine->pData, this->pSrcName->szBuf, &line );
+    pDiag->Location.init( NULL, line - 1 );
+    if( pDiag->severity == DGS_ERROR )
+      this->numErrors++;
+    else if( pDiag->severity == DGS_WARNING )
+      this->numWarnings++;
+    this->numDiags++;
+    pLine->length = 0;
+  };
+  SMode *pBase;
+  SMode *pEditor; // the src editor that builds
+  SCodeBase *pCodeBase; // the codebase built
+  STxtLine *pSrcName; // the name of its source file
+  SDiag *pDiags;
+  int numDiags;
+  int maxDiags;
+  int numErrors;
+  int numWarnings;
+  bool bRunning; // the build is still running
+  bool bBuilt; // there has been a build
+  bool bCached; // its result came from the build cache
+  STxtLine *pCachePath; // the build cache entry of its result
+  int exitCode; // of the compiler
+  STxtBuf *pOutLine;
+  STxtBuf *pErrLine; // the partial last lines of the compiler's stdout and stderr
+  int firstRow; // the first displayed row
+  int curSel; // the selected row
+  wxRect Rect;
+} SModeDiags;
+// allocs and inits a diagnostics mode ptr on the heap for the src editor pEditor and returns it
+// caller has to free
+SMode * new_diags( SMode *pEditor, int scrnW, int scrnH, wxFont *pFont ) {
+  SMode *pMode = (SMode *) malloc( sizeof( SMode) );
+  pMode->init(scrnW, scrnH, pFont);
+  SModeDiags *pDiags = (SModeDiags *)malloc(sizeof(SModeDiags));
+  if (pDiags != NULL) {
+    pMode->sExt.pDiags = pDiags;
+    pMode->sExt.pDiags->init(pMode, pEditor);
+  }
+  return( pMode );
+}
+void free_diags(SMode* pMode) {
+  if (pMode != NULL) {
+    SModeDiags *pDiags = pMode->sExt.pDiags;
+    if (pDiags != NULL) {
+      for (int i = 0; i < pDiags->numDiags; i++)
+        tl_free(pDiags->pDiags[i].pText);
+      free(pDiags->pDiags);
+      tl_free(pDiags->pSrcName);
+      tl_free(pDiags->pCachePath);
+      free_txt_buf(pDiags->pOutLine);
+      free_txt_buf(pDiags->pErrLine);
+      free(pDiags);
+    }
+    free(pMode);
+  }
+}
+
+// Search
+// Ctrl-F pops up a line input for the text to search the codebase for,
+// an (extended) regex if it starts with a '/'.
+// The lines are searched through the codebase's index (see STrigramIndex),
+// or one by one if it's not built yet.
+// The search mode is a pop-up that lists the lines found,
+// Up and Down arrows select a line, Enter goes to it, Esc exits.
+// the intents for mode search
+enum {
+  SHI_CHANGE_SEL=0,
+  SHI_GOTO
+};
+#define SEARCH_ROWS 20
+// the most lines a search lists
+#define SEARCH_MAX_HITS 1000
+// a line found by a search
+typedef struct SSearchHit {
+  SLocation Location;
+  STxtLine *pText;
+} SSearchHit;
+// orders search hits by their file offset, for qsort()
+int search_hit_cmp( const void *pA, const void *pB ) {
+  return( ((SSearchHit *) pA)->Location.fileOffset - ((SSearchHit *) pB)->Location.fileOffset );
+}
+// the pop-up search mode
+typedef struct SModeSearch {
+  void init( SMode *pBase, SMode *pEditor ) {
+    pBase->fnDisp_state = search_disp_state;
+    pBase->fnKybd_map = search_map;
+    pBase->type = MODE_SEARCH;
+    pBase->bReset = true;
+    this->pBase = pBase;
+    this->load_intents( pBase );
+    this->pEditor = pEditor;
+    this->pCodeBase = NULL;
+    this->pQuery = NULL;
+    this->pHits = (SSearchHit *) malloc( SEARCH_MAX_HITS * sizeof(SSearchHit) );
+    wxASSERT_MSG( this->pHits != NULL, "malloc failure" );
+    this->numHits = 0;
+    this->numMatched = 0;
+    this->bIndexed = false;
+    this->bScanned = false;
+    this->bScanning = false;
+    this->bTruncated = false;
+    this->numLines = 0;
+    this->elapsed = 0;
+    this->firstRow = 0;
+    this->curSel = 0;
+    this->Rect = wxRect( 0, 0, 0, 0 );
+  };
+  // loads the intent dispatch fns for this mode
+  void load_intents( SMode *pBase ) {
+    pBase->numIntents = 2;
+    pBase->fnIntent_handler[SHI_CHANGE_SEL] = search_change_sel;
+    pBase->fnIntent_handler[SHI_GOTO] = search_goto;
+  };
+  // clears the lines found by the last search for a search of pCodeBase for szQuery
+  void reset( SCodeBase *pCodeBase, const char *szQuery ) {
+    for( int i=0; i<this->numHits; i++ )
+      tl_free( this->pHits[i].pText );
+    this->numHits = 0;
+    this->numMatched = 0;
+    this->bIndexed = false;
+    this->bScanned = false;
+    this->bScanning = false;
+    this->bTruncated = false;
+    this->numLines = 0;
+    this->elapsed = 0;
+    this->firstRow = 0;
+    this->curSel = 0;
+    this->pCodeBase = pCodeBase;
+    tl_free( this->pQuery );
+    this->pQuery = new_txt_line( (char *) szQuery );
+  };
+  // matches the line of the single pElem at fileOffset, it's found if it contains szText
+  // or if pRegex is not NULL, if it matches pRegex
+  // once SEARCH_MAX_HITS lines are found, the rest are not listed
+  void match( SCodeElement *pElem, int fileOffset, const char *szText, wxRegEx *pRegex ) {
+    this->numMatched++;
+    if( pElem->pLine != NULL && !this->bTruncated ) {
+      if( ( pRegex != NULL ) ? pRegex->Matches( wxString( pElem->pLine->szBuf ) ) : strstr( pElem->pLine->szBuf, szText ) != NULL )
+        this->add_hit( pElem, fileOffset, pElem->pLine->szBuf );
+    }
+  };
+  // adds the line szText of pElem at fileOffset to the lines found
+  void add_hit( SCodeElement *pElem, int fileOffset, char *szText ) {
+    if( this->numHits == SEARCH_MAX_HITS )
+      this->bTruncated = true;
+    else {
+      this->pHits[this->numHits].Location.init( pElem, fileOffset );
+      this->pHits[this->numHits].pText = new_txt_line( szText );
+      this->numHits++;
+    }
+  };
+  // puts the lines found in file order, a line found twice is listed once
+  // the line selected stays selected
+  void sort_hits() {
+    int num = 0;
+    int selOffset = ( this->curSel < this->numHits ) ? this->pHits[this->curSel].Location.fileOffset : -1;
+    qsort( this->pHits, this->numHits, sizeof(SSearchHit), search_hit_cmp );
+    for( int i=0; i<this->numHits; i++ ) {
+      if( num > 0 && this->pHits[num - 1].Location.fileOffset == this->pHits[i].Location.fileOffset )
+        tl_free( this->pHits[i].pText );
+      else {
+        if( this->pHits[i].Location.fileOffset == selOffset )
+          this->curSel = num;
+        this->pHits[num] = this->pHits[i];
+        num++;
+      }
+    }
+    this->numHits = num;
+    if( this->curSel < this->firstRow || this->curSel >= this->firstRow + SEARCH_ROWS )
+      this->firstRow = ( this->curSel >= SEARCH_ROWS ) ? this->curSel - SEARCH_ROWS + 1 : 0;
+  };
+  SMode *pBase;
+  SMode *pEditor; // the src editor that searched
+  SCodeBase *pCodeBase; // the codebase searched
+  STxtLine *pQuery; // what it was searched for
+  SSearchHit *pHits; // the lines found, in file order
+  int numHits;
+  int numMatched; // the lines matched to find them
+  bool bIndexed; // they were found through the index
+  bool bScanned; // or by a scan (see SSearchScan)
+  bool bScanning; // which is still finding lines
+  bool bTruncated; // more lines than SEARCH_MAX_HITS were found
+  int numLines; // the lines being scanned
+  long elapsed; // ms the search took
+  int firstRow; // the first displayed row
+  int curSel; // the selected row
+  wxRect Rect;
+} SModeSearch;
+// allocs and inits a search mode ptr on the heap for the src editor pEditor and returns it
+// caller has to free
+SMode * new_search( SMode *pEditor, int scrnW, int scrnH, wxFont *pFont ) {
+  SMode *pMode = (SMode *) malloc( sizeof( SMode) );
+  pMode->init(scrnW, scrnH, pFont);
+  SModeSearch *pSearch = (SModeSearch *)malloc(sizeof(SModeSearch));
+  if (pSearch != NULL) {
+    pMode->sExt.pSearch = pSearch;
+    pMode->sExt.pSearch->init(pMode, pEditor);
+  }
+  return( pMode );
+}
+void free_search(SMode* pMode) {
+  if (pMode != NULL) {
+    SModeSearch *pSearch = pMode->sExt.pSearch;
+    if (pSearch != NULL) {
+      for (int i = 0; i < pSearch->numHits; i++)
+        tl_free(pSearch->pHits[i].pText);
+      free(pSearch->pHits);
+      tl_free(pSearch->pQuery);
+      free(pSearch);
+    }
+    free(pMode);
+  }
+}
+// Search as you type
+// While the search line input is up, the lines of the codebase with what's typed so far in them
+// are highlighted in the src editor's center column.
+// The lines found for each prefix of the query are cached as a level of a stack.
+// Typing a char narrows down the deepest level, only its lines are checked again, and a backspace
+// pops back to the level cached for that prefix.
+// The first level is seeded from the codebase's trigram index, so only its candidates are checked.
+// The lines are found as the center column is drawn again into the frozen background
+// (see src_edr_search_typed() and typed_search_update()).
+// the most levels cached, the deepest is replaced past it
+#define TYPED_MAX_LEVELS 64
+// the shortest query followed, the length of a trigram
+#define TYPED_MIN_QUERY 3
+typedef struct STypedSearch {
+  void init() {
+    this->pQuery = new_txt_line( (char*)"" );
+    this->maxHits = 1024;
+    this->pHits = (SLocation *) malloc( this->maxHits * sizeof(SLocation) );
+    wxASSERT_MSG( this->pHits != NULL, "malloc failure" );
+    this->numHits = 0;
+    this->numLevels = 0;
+  };
+  // drops the levels, for a new query
+  void clear() {
+    this->pQuery->length = 0;
+    this->pQuery->szBuf[0] = 0;
+    this->numHits = 0;
+    this->numLevels = 0;
+  };
+  // sets the query to szQuery, the levels for prefixes of it are kept
+  void set_query( const char *szQuery ) {
+    int common = 0;
+    while( common < this->pQuery->length && szQuery[common] != 0 && szQuery[common] == this->pQuery->szBuf[common] )
+      common++;
+    while( this->numLevels > 0 && this->aLevelLengths[this->numLevels - 1] > common )
+      this->pop_level();
+    tl_free( this->pQuery );
+    this->pQuery = new_txt_line( (char*)szQuery );
+  };
+  // tells if the deepest level is for the query
+  bool is_current() {
+    return( this->numLevels > 0 && this->aLevelLengths[this->numLevels - 1] == this->pQuery->length );
+  };
+  // starts a level for the first length chars of the query, its lines are added with add_hit
+  void push_level( int length ) {
+    if( this->numLevels == TYPED_MAX_LEVELS )
+      this->pop_level();
+    this->aLevelStarts[this->numLevels] = this->numHits;
+    this->aLevelLengths[this->numLevels] = length;
+    this->numLevels++;
+  };
+  void pop_level() {
+    this->numLevels--;
+    this->numHits = this->aLevelStarts[this->numLevels];
+  };
+  void add_hit( SCodeElement *pElem, int fileOffset ) {
+    if( this->numHits == this->maxHits ) {
+      this->maxHits = this->maxHits * 2;
+      this->pHits = (SLocation *) realloc( this->pHits, this->maxHits * sizeof(SLocation) );
+      wxASSERT_MSG( this->pHits != NULL, "malloc failure" );
+    }
+    this->pHits[this->numHits].init( pElem, fileOffset );
+    this->numHits++;
+  };
+  // the lines of the deepest level, in file order
+  int get_hits( SLocation **ppHits ) {
+    int start = ( this->numLevels > 0 ) ? this->aLevelStarts[this->numLevels - 1] : 0;
+    *ppHits = this->pHits + start;
+    return( this->numHits - start );
+  };
+  // tells if the line at fileOffset is one of the deepest level's
+  bool is_hit( int fileOffset ) {
+    SLocation *pLevel;
+    int num = this->get_hits( &pLevel );
+    int lo = 0;
+    int hi = num;
+    while( lo < hi ) {
+      int mid = (lo + hi) / 2;
+      if( pLevel[mid].fileOffset < fileOffset )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return( lo < num && pLevel[lo].fileOffset == fileOffset );
+  };
+  STxtLine *pQuery; // what's typed so far
+  SLocation *pHits; // the lines of all the levels, a level's in file order after its parent's
+  int numHits;
+  int maxHits;
+  int aLevelStarts[TYPED_MAX_LEVELS]; // where each level's lines start in pHits
+  int aLevelLengths[TYPED_MAX_LEVELS]; // and the length of the prefix they were found for
+  int numLevels;
+} STypedSearch;
+// allocs and inits a typed search on the heap, caller has to free
+STypedSearch *new_typed_search() {
+  STypedSearch *pTyped = (STypedSearch *) malloc( sizeof(STypedSearch) );
+  wxASSERT_MSG( pTyped != NULL, "malloc failure" );
+  pTyped->init();
+  return( pTyped );
+}
+void free_typed_search( STypedSearch *pTyped ) {
+  if( pTyped != NULL ) {
+    tl_free( pTyped->pQuery );
+    free( pTyped->pHits );
+    free( pTyped );
+  }
+}
+
+// Debugging
+// A debug session runs gdb on the program built from the source
+// and drives it through its machine interface (GDB/MI).
+// Commands are written to gdb's stdin and its output records are read without blocking,
+// as a build's output is, so the user goes on editing while the program runs.
+// The breakpoints are the codebase's (see SCodeBase::pBreaks), they are set in gdb
+// as the session starts and as they are toggled.
+// The line the program stopped at is shown in the view.
+// states of a debug session
+enum {
+  DBS_NONE=0,
+  DBS_STARTED,
+  DBS_RUNNING,
+  DBS_STOPPED,
+  DBS_EXITED
+};
+// the debug session of a src editor
+typedef struct SDebugger {
+  void init() {
+    this->state = DBS_NONE;
+    this->Stop.init( NULL, -1 );
+    this->pCodeBase = NULL;
+    this->pSrcName = NULL;
+    this->pOutLine = new_txt_buf( 256 );
+    this->pErrLine = new_txt_buf( 256 );
+  };
+  // starts a session debugging pCodeBase
+  void reset( SCodeBase *pCodeBase ) {
+    this->state = DBS_STARTED;
+    this->Stop.init( NULL, -1 );
+    this->pCodeBase = pCodeBase;
+    tl_free( this->pSrcName );
+    this->pSrcName = new_txt_line_wx( wxFileName( wxString( pCodeBase->pSrcPath->szBuf ) ).GetFullName() );
+    this->pOutLine->length = 0;
+    this->pErrLine->length = 0;
+  };
+  int state;
+  SLocation Stop; // the source line the program is stopped at, fileOffset -1 if none
+  SCodeBase *pCodeBase; // the codebase debugged
+  STxtLine *pSrcName; // the name of its source file
+  STxtBuf *pOutLine;
+  STxtBuf *pErrLine; // the partial last lines of the debugger's stdout and stderr
+} SDebugger;
+// allocs and inits a debugger on the heap and returns it
+// caller has to free
+SDebugger * new_debugger() {
+  SDebugger *pDebugger = (SDebugger *) malloc( sizeof(SDebugger) );
+  wxASSERT_MSG( pDebugger != NULL, "malloc failure" );
+  pDebugger->init();
+  return( pDebugger );
+}
+void free_debugger( SDebugger *pDebugger ) {
+  if( pDebugger != NULL ) {
+    tl_free( pDebugger->pSrcName );
+    free_txt_buf( pDebugger->pOutLine );
+    free_txt_buf( pDebugger->pErrLine );
+    free( pDebugger );
+  }
+}
+
+// the different (user) intents for mode source editor
+enum {
+  // change the location of the caret using arrows or PgUp, PgDn
+  SEI_UPDATE_CARET=0,
+  // summarize or expand a section using Ctrl-S
+  SEI_SUMMARIZE,
+  // goto (or return from) the symbol at caret line using Ctrl-right/left
+  SEI_GOTO,
+  // edit a character using alphanumerics or Return or Backspace
+  SEI_EDIT_CHAR,
+  // start a selection using Shift-arrow
+  SEI_START_SEL,
+  // update a selection using Shift-arrow
+  SEI_UPDATE_SEL,
+  // unselect a selection by pressing an alphnumeric
+  SEI_UN_SEL,
+  // cut a selection using Ctrl-X
+  SEI_CUT_SEL,
+  // paste a selection using Ctrl-V
+  SEI_PASTE_SEL,
+  // undo the last edit operation using Ctrl-Z
+  SEI_UNDO,
+  // redo the last edit operation using Shift-Ctrl-Z
+  SEI_REDO,
+  // launch the mode level controls menu by pressing Ctrl
+  SEI_CONTROL,
+  // export the current codebase to a cpp file
+  SEI_EXPORT,
+  // save the current codebase and load a new one
+  SEI_LOAD_NEW,
+  // build the current codebase
+  SEI_BUILD,
+  // debug the current executable
+  SEI_DEBUG,
+  // agjust the fontsize
+  SEI_ADJUST_FONTSIZE,
+  // got a line in the codebase
+  SEI_GOTO_LINE,
+  // input the codefile to load
+  SEI_INPUT_CODEFILE,
+  // display the input-to-pixel latency stats
+  SEI_LATENCY_STATS,
+  // display the diagnostics of the last build
+  SEI_DIAGNOSTICS,
+  // set or clear a breakpoint at the caret line using Ctrl-B
+  SEI_BREAKPOINT,
+  // continue, step over or into, or stop the program being debugged using F5, F10, F11 or Shift-F5
+  SEI_DEBUG_STEP,
+  // search the codebase for a text or a regex using Ctrl-F
+  SEI_SEARCH,
+  // follow the search as it's typed
+  SEI_SEARCH_TYPED
+};
+// returns a printable name for the intent of a mode of type, the name of its enum
+// the modes with a single intent have no enum for it, it's named after their intent handler
+// an intent without a name is printed as its number
+#define LAT_INTENT_NAME( intent ) case intent: szName = #intent; break;
+wxString lat_intent_name( int type, int intent ) {
+  const char *szName = NULL;
+  switch( type ) {
+    case MODE_MESSAGE:
+      if( intent == 0 )
+        szName = "MSG_DISP_UPDATE";
+      break;
+    case MODE_LINE_INPUT:
+      if( intent == 0 )
+        szName = "LINE_INPUT_DISP_UPDATE";
+      break;
+    case MODE_LEVEL_ADJUSTER:
+      switch( intent ) {
+        LAT_INTENT_NAME( LAI_ADJUST )
+        default: break;
+      }
+      break;
+    case MODE_FILE_SELECTOR:
+      switch( intent ) {
+        LAT_INTENT_NAME( FSI_CHANGE_SELECTION )
+        LAT_INTENT_NAME( FSI_COMMIT )
+        default: break;
+      }
+      break;
+    case MODE_INTENT_DISPATCHER:
+      switch( intent ) {
+        LAT_INTENT_NAME( IDI_CHANGE_SELECTION )
+        LAT_INTENT_NAME( IDI_EXECUTE )
+        default: break;
+      }
+      break;
+    case MODE_LATENCY_STATS:
+      switch( intent ) {
+        LAT_INTENT_NAME( LSI_SCROLL )
+        default: break;
+      }
+      break;
+    case MODE_DIAGNOSTICS:
+      switch( intent ) {
+        LAT_INTENT_NAME( DGI_CHANGE_SEL )
+        LAT_INTENT_NAME( DGI_GOTO )
+        default: break;
+      }
+      break;
+    case MODE_SEARCH:
+      switch( intent ) {
+        LAT_INTENT_NAME( SHI_CHANGE_SEL )
+        LAT_INTENT_NAME( SHI_GOTO )
+        default: break;
+      }
+      break;
+    case MODE_SOURCE_EDITOR:
+      switch( intent ) {
+        LAT_INTENT_NAME( SEI_UPDATE_CARET )
+        LAT_INTENT_NAME( SEI_SUMMARIZE )
+        LAT_INTENT_NAME( SEI_GOTO )
+        LAT_INTENT_NAME( SEI_EDIT_CHAR )
+        LAT_INTENT_NAME( SEI_START_SEL )
+        LAT_INTENT_NAME( SEI_UPDATE_SEL )
+        LAT_INTENT_NAME( SEI_UN_SEL )
+        LAT_INTENT_NAME( SEI_CUT_SEL )
+        LAT_INTENT_NAME( SEI_PASTE_SEL )
+        LAT_INTENT_NAME( SEI_UNDO )
+        LAT_INTENT_NAME( SEI_REDO )
+        LAT_INTENT_NAME( SEI_CONTROL )
+        LAT_INTENT_NAME( SEI_EXPORT )
+        LAT_INTENT_NAME( SEI_LOAD_NEW )
+        LAT_INTENT_NAME( SEI_BUILD )
+        LAT_INTENT_NAME( SEI_DEBUG )
+        LAT_INTENT_NAME( SEI_ADJUST_FONTSIZE )
+        LAT_INTENT_NAME( SEI_GOTO_LINE )
+        LAT_INTENT_NAME( SEI_INPUT_CODEFILE )
+        LAT_INTENT_NAME( SEI_LATENCY_STATS )
+        LAT_INTENT_NAME( SEI_DIAGNOSTICS )
+        LAT_INTENT_NAME( SEI_BREAKPOINT )
+        LAT_INTENT_NAME( SEI_DEBUG_STEP )
+        LAT_INTENT_NAME( SEI_SEARCH )
+        LAT_INTENT_NAME( SEI_SEARCH_TYPED )
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+  return( szName != NULL ? wxString( szName ) : wxString::Format( "%d", intent ) );
+}
+// the source editor mode
+typedef struct SModeSrcEdr {
+  // inits with scrnW, scrnH
+  // note that init does not set the codebase
+  // this has to be done before the mode can be used
+  void init( SMode *pBase ) {
+    pBase->fnDisp_state = src_edr_disp_state;
+    pBase->fnKybd_map = src_edr_map;
+    pBase->fnKey_up = src_edr_key_up;
+    pBase->fnSerialize = src_edr_serialize;
+    pBase->fnReplay = src_edr_replay;
+    pBase->fnResume = src_edr_resume;
+    pBase->fnOn_load = src_edr_on_load;
+    pBase->type = MODE_SOURCE_EDITOR;
+    pBase->bReset = true;
+    pBase->bCoalesceNav = true;
+    this->pBase = pBase;
+    this->load_intents( pBase );
+    this->pLineInp = new_line_input( pBase->scrnW, pBase->scrnH, pBase->pFont );
+    this->pMsg = new_msg( pBase->scrnW, pBase->scrnH, pBase->pFont );
+    this->pFileSel = new_file_sel(pBase->scrnW, pBase->scrnH, pBase->pFont);
+    this->pLevAdj = new_lev_adj(pBase->scrnW, pBase->scrnH, pBase->pFont);
+    this->pLatStats = new_lat_stats(pBase->scrnW, pBase->scrnH, pBase->pFont);
+    this->pDiags = new_diags(pBase, pBase->scrnW, pBase->scrnH, pBase->pFont);
+    this->pSearch = new_search(pBase, pBase->scrnW, pBase->scrnH, pBase->pFont);
+    this->pTyped = new_typed_search();
+    this->pDebugger = new_debugger();
+    this->pCodeBase = NULL;
+    this->fileOffset = 0;
+    this->Caret.x = 0;
     this->Caret.y = 0;
     this->CaretPrev.x = 0;
     this->CaretPrev.y = 0;
@@ -7322,6 +11631,8 @@ typedef struct SModeSrcEdr {
     this->pNavTrail = new_nav_trail();
     this->bSelectingX = false;
     this->bSelectingY = false;
+    this->bCutBufLoaded = false;
+    this->pCutLine = new_txt_line((char*)"");
     this->pMemDC = NULL;
   };
   void set_codebase( SCodeBase *pCodeBase ) {
@@ -7330,7 +11641,7 @@ typedef struct SModeSrcEdr {
 
   // loads the intent dispatch fns for this mode
   void load_intents( SMode *pBase ) {
-    pBase->numIntents = 21;
+    pBase->numIntents = 26;
     pBase->fnIntent_handler[SEI_EDIT_CHAR] = src_edr_edit_char;
     pBase->fnIntent_handler[SEI_UPDATE_CARET] = src_edr_update_caret;
     pBase->fnIntent_handler[SEI_START_SEL] = src_edr_start_sel;
@@ -7349,7 +11660,13 @@ typedef struct SModeSrcEdr {
     pBase->fnIntent_handler[SEI_DEBUG] = src_edr_debug;
     pBase->fnIntent_handler[SEI_ADJUST_FONTSIZE] = src_edr_adjust_fontsize;
     pBase->fnIntent_handler[SEI_INPUT_CODEFILE] = src_edr_input_codefile;
-    pBase->sExt.pSrcEdr->pIntentDispatcher = new_int_disp( pBase, 5, pBase->scrnW, pBase->scrnH, pBase->pFont );
+    pBase->fnIntent_handler[SEI_LATENCY_STATS] = src_edr_latency_stats;
+    pBase->fnIntent_handler[SEI_DIAGNOSTICS] = src_edr_diagnostics;
+    pBase->fnIntent_handler[SEI_BREAKPOINT] = src_edr_breakpoint;
+    pBase->fnIntent_handler[SEI_DEBUG_STEP] = src_edr_debug_step;
+    pBase->fnIntent_handler[SEI_SEARCH] = src_edr_search;
+    pBase->fnIntent_handler[SEI_SEARCH_TYPED] = src_edr_search_typed;
+    pBase->sExt.pSrcEdr->pIntentDispatcher = new_int_disp( pBase, 7, pBase->scrnW, pBase->scrnH, pBase->pFont );
     // load the intent dispatcher for indirect-mapped intents
     SModeIntDisp *pIntDisp = this->pIntentDispatcher->sExt.pIntDisp;
     pIntDisp->add_intent( new_intent((char*)"Export source file", SEI_EXPORT ) );
@@ -7357,6 +11674,8 @@ typedef struct SModeSrcEdr {
     pIntDisp->add_intent( new_intent((char*)"Build", SEI_BUILD ) );
     pIntDisp->add_intent( new_intent((char*)"Debug", SEI_DEBUG ) );
     pIntDisp->add_intent( new_intent((char*)"Adjust Fontsize", SEI_ADJUST_FONTSIZE ) );
+    pIntDisp->add_intent( new_intent((char*)"Latency stats", SEI_LATENCY_STATS ) );
+    pIntDisp->add_intent( new_intent((char*)"Build diagnostics", SEI_DIAGNOSTICS ) );
   };
   SMode *pBase;
   SCodeBase *pCodeBase; // the CodeBase to be edited
@@ -7376,12 +11695,18 @@ typedef struct SModeSrcEdr {
   bool bSelectingX;
   bool bSelectingY;
   bool bCutBufLoaded; // selecting state
+  STxtLine *pCutLine; // the chars last cut, the lines last cut are held by their op (see SOpCutPasteSel)
   SNavTrail *pNavTrail;
   SMode *pIntentDispatcher; // to handle non-direct-mapped intents
   SMode *pLineInp; // for getting line input from the user
   SMode *pMsg; // for displaying a message for the user
   SMode *pFileSel;
   SMode* pLevAdj;
+  SMode* pLatStats; // for displaying the input-to-pixel latency stats
+  SMode* pDiags; // for displaying the diagnostics of the last build
+  SMode* pSearch; // for displaying the lines found by the last search
+  STypedSearch* pTyped; // the lines found as the search is typed
+  SDebugger* pDebugger; // the debug session
   wxMemoryDC* pMemDC;
 } SModeSrcEdr;
 // allocs and inits a ptr on the heap and returns it
@@ -7399,7 +11724,7 @@ SMode * new_src_edr( int scrnW, int scrnH, wxFont *pFont ) {
   return( pBase );
 }
 // loads a SrcEdr extension from File
-SModeSrcEdr * load_src_edr( SMode *pBase, wxFile &File ) {
+SModeSrcEdr * load_src_edr( SMode *pBase, SBufFile &File ) {
   SModeSrcEdr *pSrcEdr = (SModeSrcEdr *) malloc( sizeof( SModeSrcEdr) );
   pSrcEdr->init( pBase );
   pBase->fnSerialize( pBase, File, false );
@@ -7412,11 +11737,17 @@ void free_src_edr(SMode* pMode) {
   free_int_disp(pMode->sExt.pSrcEdr->pIntentDispatcher);
   free_file_sel(pMode->sExt.pSrcEdr->pFileSel);
   free_lev_adj(pMode->sExt.pSrcEdr->pLevAdj);
+  free_lat_stats(pMode->sExt.pSrcEdr->pLatStats);
+  free_diags(pMode->sExt.pSrcEdr->pDiags);
+  free_search(pMode->sExt.pSrcEdr->pSearch);
+  free_typed_search(pMode->sExt.pSrcEdr->pTyped);
+  free_debugger(pMode->sExt.pSrcEdr->pDebugger);
   if (pMode->sExt.pSrcEdr->pCodeBase != NULL) {
     free_codebase(pMode->sExt.pSrcEdr->pCodeBase);
     pMode->sExt.pSrcEdr->pCodeBase = NULL;
   }
   free_nav_trail(pMode->sExt.pSrcEdr->pNavTrail);
+  tl_free(pMode->sExt.pSrcEdr->pCutLine);
   if (pMode->sExt.pSrcEdr->pMemDC != NULL)
     delete(pMode->sExt.pSrcEdr->pMemDC);
   free(pMode->sExt.pSrcEdr);
@@ -7437,18 +11768,43 @@ bool src_edr_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
   pBase->key = event.GetKeyCode();
   pBase->uniKey = event.GetUnicodeKey();
 
+  // the line being typed into is stored before any other key, which may read it
+  bool bTyping = !pBase->bCtrlDown && ( pBase->key == WXK_BACK || ( pBase->uniKey >= 32 && pBase->uniKey < 127 ) );
+  if( !bTyping && pBase->key != WXK_SHIFT && pBase->sExt.pSrcEdr->pCodeBase != NULL )
+    pBase->sExt.pSrcEdr->pCodeBase->GapLine.store();
+
   if( pBase->key == WXK_ESCAPE )
     pWin->m_pOwner->Close(true);
   // map user kybd input to a user intent
+  // while selecting, any key but Shift-Arrow or Ctrl-X first dispatches to UN_SEL
   // if control not down 
+  // Shift-Arrow dispatches to START_SEL or UPDATE_SEL
   // arrows or pgup/dn dispatch to UPDATE_CARET
   // ctrl set intent only, dispatch will happen on key-up
   // shift set bShiftDwon
+  // F5, F10, F11 dispatch to DEBUG_STEP
   // else EDIT_CHAR
   // if control down
   // Ctrl-S dispatch to SUMMARIZE
   // Ctrl-Right/Left dispatch to GOTO
+  // Ctrl-B dispatch to BREAKPOINT
+  // Ctrl-Z, Ctrl-Y dispatch to UNDO, REDO
+  // Ctrl-X, Ctrl-V dispatch to CUT_SEL, PASTE_SEL
+  // Ctrl-F dispatch to SEARCH
   else {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    bool bVert = pBase->key == WXK_UP || pBase->key == WXK_DOWN;
+    bool bSelKey = !pBase->bCtrlDown && pBase->bShiftDown && ( bVert || pBase->key == WXK_RIGHT || pBase->key == WXK_LEFT );
+    // a selection of lines goes on with Shift-Up/Down, one of chars with Shift-Left/Right
+    bool bUnSel = pSrcEdr->bSelectingY ? !(bSelKey && bVert) : pSrcEdr->bSelectingX && !(bSelKey && !bVert);
+    bUnSel = bUnSel && pBase->key != WXK_SHIFT && pBase->key != WXK_CONTROL;
+    bUnSel = bUnSel && !( pBase->bCtrlDown && pBase->uniKey == 'X' );
+    // dispatch to UN_SEL, then go on to map the key
+    if( bUnSel ) {
+      pBase->intent = SEI_UN_SEL;
+      pBase->mark_dispatch();
+      pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+    }
     // control not down
     // arrows or pgup/dn dispatch to UPDATE_CARET
     // ctrl set intent only, dispatch will happen on key-up
@@ -7457,9 +11813,16 @@ bool src_edr_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
       bool bUpdateCaret = pBase->key == WXK_UP || pBase->key == WXK_DOWN;
       bUpdateCaret |= pBase->key == WXK_RIGHT || pBase->key == WXK_LEFT;
       bUpdateCaret |= pBase->key == WXK_PAGEUP || pBase->key == WXK_PAGEDOWN;
+      // dispatch to START_SEL or UPDATE_SEL
+      if( bSelKey ) {
+        pBase->intent = ( pSrcEdr->bSelectingX || pSrcEdr->bSelectingY ) ? SEI_UPDATE_SEL : SEI_START_SEL;
+        pBase->mark_dispatch();
+        pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
       // dispatch to UPDATE_CARET
-      if( bUpdateCaret  ) {
+      else if( bUpdateCaret  ) {
         pBase->intent = SEI_UPDATE_CARET;
+        pBase->mark_dispatch();
         pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
       }
       // store control down for next key procssing
@@ -7471,8 +11834,16 @@ bool src_edr_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
       }
       else if( pBase->key == WXK_SHIFT )
         pBase->bShiftDown = true;
-      else {
+      // dispatch to DEBUG_STEP
+      else if( pBase->key == WXK_F5 || pBase->key == WXK_F10 || pBase->key == WXK_F11 ) {
+        pBase->intent = SEI_DEBUG_STEP;
+        pBase->mark_dispatch();
+        pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
+      // backspace while selecting only unselects
+      else if( !bUnSel || pBase->key != WXK_BACK ) {
         pBase->intent = SEI_EDIT_CHAR;
+        pBase->mark_dispatch();
         pBase->fnIntent_handler[pBase->intent](pBase, PH_NOTIFY, pWin, DC);
       }
     }
@@ -7481,11 +11852,37 @@ bool src_edr_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
       // dispatch to SUMMARIZE
       if( pBase->uniKey == 'S' ) {
       pBase->intent = SEI_SUMMARIZE;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
       }
       // dispatch to GOTO
       else if( pBase->key == WXK_RIGHT || pBase->key == WXK_LEFT ) {
       pBase->intent = SEI_GOTO;
+      pBase->mark_dispatch();
+      pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
+      // dispatch to BREAKPOINT
+      else if( pBase->uniKey == 'B' ) {
+      pBase->intent = SEI_BREAKPOINT;
+      pBase->mark_dispatch();
+      pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
+      // dispatch to UNDO or REDO
+      else if( pBase->uniKey == 'Z' || pBase->uniKey == 'Y' ) {
+      pBase->intent = ( pBase->uniKey == 'Z' ) ? SEI_UNDO : SEI_REDO;
+      pBase->mark_dispatch();
+      pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
+      // dispatch to CUT_SEL or PASTE_SEL
+      else if( pBase->uniKey == 'X' || pBase->uniKey == 'V' ) {
+      pBase->intent = ( pBase->uniKey == 'X' ) ? SEI_CUT_SEL : SEI_PASTE_SEL;
+      pBase->mark_dispatch();
+      pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
+      }
+      // dispatch to SEARCH
+      else if( pBase->uniKey == 'F' ) {
+      pBase->intent = SEI_SEARCH;
+      pBase->mark_dispatch();
       pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC);
       }
     }
@@ -7528,6 +11925,96 @@ void src_edr_on_load(SMode* pBase, SModeManager *pManager ) {
   return;
 }
 // ancillary function used by src_edr_disp_state
+// checks if the display line at dispIndex in the column from x to x+width
+// is in the region being painted
+bool src_edr_line_exposed( SMode *pBase, int x, int width, int dispIndex ) {
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  wxRect rectLine( x, dispIndex * pSrcEdr->lineHeight, width, pSrcEdr->lineHeight );
+  return( pBase->is_exposed( rectLine ) );
+}
+// gets the range of the selection, from lo to hi
+// the file offsets of the first and last elements of a selection of lines
+// or the caret line's chars [lo, hi) of a selection of chars
+void src_edr_sel_range( SModeSrcEdr *pSrcEdr, int *pLo, int *pHi ) {
+  int start = pSrcEdr->bSelectingY ? pSrcEdr->selStartY : pSrcEdr->selStartX;
+  int end = pSrcEdr->bSelectingY ? pSrcEdr->selEndY : pSrcEdr->selEndX;
+  *pLo = ( start < end ) ? start : end;
+  *pHi = ( start < end ) ? end : start;
+}
+// ancillary function used by src_edr_disp_state
+// gets in rect the part of the display line at dispIndex, of pElem at elemOffset, that is selected
+// returns false if none of it is
+bool src_edr_sel_rect( SModeSrcEdr *pSrcEdr, SCodeElement *pElem, int elemOffset, int dispIndex, wxDC &DC, ModalWindow *pWin, wxRect &rect ) {
+  bool bRetVal = false;
+  int lo, hi;
+  src_edr_sel_range( pSrcEdr, &lo, &hi );
+  rect.x = pSrcEdr->colMidStart + pSrcEdr->counterWidth + 10;
+  rect.y = dispIndex * pSrcEdr->lineHeight + pSrcEdr->lineHeight - pSrcEdr->txtHeight;
+  rect.width = pSrcEdr->colRightStart - rect.x;
+  rect.height = pSrcEdr->txtHeight;
+  // a selection of lines covers the whole of each line
+  if( pSrcEdr->bSelectingY )
+    bRetVal = elemOffset >= lo && elemOffset <= hi;
+  // a selection of chars covers them on the caret line
+  else if( pSrcEdr->bSelectingX && dispIndex == pSrcEdr->Caret.y && hi > lo && hi <= pElem->pLine->length ) {
+    int start = tl_caret_loc( pElem->pLine, lo, DC, pWin );
+    rect.x += start;
+    rect.width = tl_caret_loc( pElem->pLine, hi, DC, pWin ) - start;
+    bRetVal = true;
+  }
+  return( bRetVal );
+}
+// refreshes the display lines from to to of the center column, which a selection is drawn in
+void src_edr_refresh_lines( SModeSrcEdr *pSrcEdr, int from, int to, ModalWindow *pWin ) {
+  wxRect rect;
+  rect.x = pSrcEdr->colMidStart;
+  rect.y = from * pSrcEdr->lineHeight;
+  rect.width = pSrcEdr->colRightStart - pSrcEdr->colMidStart;
+  rect.height = ( to - from + 2 ) * pSrcEdr->lineHeight - pSrcEdr->txtHeight;
+  pWin->Refresh( true, &rect );
+}
+// ancillary function used by src_edr_disp_state
+// draws strCtr, the line counter of the line at fileOffset, at x, y
+// the counter of a breakpoint is red, the one of the line the debugger stopped at is highlighted
+void src_edr_draw_counter( SModeSrcEdr *pSrcEdr, wxString &strCtr, int fileOffset, int x, int y, wxDC &DC ) {
+  wxColour Colour = DC.GetTextForeground();
+  if( pSrcEdr->pDebugger->state == DBS_STOPPED && pSrcEdr->pDebugger->Stop.fileOffset == fileOffset ) {
+    wxPen Pen = DC.GetPen();
+    wxBrush Brush = DC.GetBrush();
+    DC.SetPen( *wxTRANSPARENT_PEN );
+    DC.SetBrush( wxBrush( wxColour( 255, 224, 128 ) ) );
+    DC.DrawRectangle( wxRect( x - 5, y, pSrcEdr->counterWidth - 5, pSrcEdr->txtHeight ) );
+    DC.SetPen( Pen );
+    DC.SetBrush( Brush );
+  }
+  if( pSrcEdr->pCodeBase->find_break( fileOffset ) != -1 )
+    DC.SetTextForeground( wxColour( 192, 0, 0 ) );
+  else
+    DC.SetTextForeground( wxColour( 128, 128, 160 ) );
+  DC.DrawText( strCtr, x, y );
+  DC.SetTextForeground( Colour );
+}
+// ancillary function used by src_edr_disp_state
+// highlights where pLine, displayed at y in the center column, has the search being typed
+// the whole line if it's been clipped off
+void src_edr_draw_typed_hit( SModeSrcEdr *pSrcEdr, STxtLine *pLine, int y, wxDC &DC, ModalWindow *pWin ) {
+  STxtLine *pQuery = pSrcEdr->pTyped->pQuery;
+  char *pFound = strstr( pLine->szBuf, pQuery->szBuf );
+  wxRect rect( pSrcEdr->colMidStart + 10 + pSrcEdr->counterWidth, y, pSrcEdr->colRightStart - pSrcEdr->colMidStart - pSrcEdr->counterWidth - 10, pSrcEdr->txtHeight );
+  if( pFound != NULL ) {
+    int start = tl_caret_loc( pLine, pFound - pLine->szBuf, DC, pWin );
+    rect.x += start;
+    rect.width = tl_caret_loc( pLine, pFound - pLine->szBuf + pQuery->length, DC, pWin ) - start;
+  }
+  wxPen Pen = DC.GetPen();
+  wxBrush Brush = DC.GetBrush();
+  DC.SetPen( *wxTRANSPARENT_PEN );
+  DC.SetBrush( wxBrush( wxColour( 255, 224, 128 ) ) );
+  DC.DrawRectangle( rect );
+  DC.SetPen( Pen );
+  DC.SetBrush( Brush );
+}
+// ancillary function used by src_edr_disp_state
 wxColour get_element_colour( SCodeElement *pElem ) {
   int type = pElem->type;
   wxColour Colour;
@@ -7558,6 +12045,11 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     DC.SetFont(*(pBase->pFont));
     SCodeElement *pElem = NULL;  
     STxtLine* pLine = NULL;
+    // the line being typed into is drawn from GapLine, it's not stored
+    // so are the lines found for a search being typed
+    bool bTypingSearch = src_edr_is_typing_search(pBase, pWin);
+    if (bTypingSearch)
+      typed_search_update(pSrcEdr, pSrcEdr->pLineInp->sExt.pLineInput);
 
 
     // if a reset is needed recompute display parameters
@@ -7569,6 +12061,7 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
       wxString strTemp("9999");
       int widthTxt;
       int heightTxt;
+      BENCH_COUNT(benchTxtExtentCalls);
       DC.GetTextExtent(strTemp, &widthTxt, &heightTxt);
       pSrcEdr->txtHeight = heightTxt;
       pSrcEdr->lineHeight = (int) ((double)heightTxt * 1.0);
@@ -7627,45 +12120,45 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
         // check if we've reached EOF in which case set bEOF
         if (pSrcEdr->fileOffset + skip + lineOffset + ce_length(pElem) >= pSrcEdr->pCodeBase->pBaseSec->get_length())
           bEOF = true;
-        pLine = tl_clone(pElem->pLine);
+        // draw the line only if it is in the region being painted
+        if (src_edr_line_exposed(pBase, pSrcEdr->colRightStart, pBase->scrnW - pSrcEdr->colRightStart, dispIndex)) {
+          pLine = pSrcEdr->pCodeBase->clone_line(pElem);
+
+          // if it's a block or sub-block start, edit it for display
+          if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
+            tl_remove(pLine, (char*)"// BLOCK: ");
+            tl_remove(pLine, (char*)"// SUBBLOCK: ");
+          }
 
-        // if it's a block or sub-block start, edit it for display
-        if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
-          tl_remove(pLine, (char*)"// BLOCK: ");
-          tl_remove(pLine, (char*)"// SUBBLOCK: ");
-        }
+          int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
+          // if the display length of the line is greater than the section's dispwidth, clip the line
+          if (lineDispWidth > pBase->scrnW - pSrcEdr->colRightStart - pSrcEdr->counterWidth) {
+            char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
+            if (szTemp != NULL)
+              free(szTemp);
+            tl_insert(pLine, (char*)" ...", pLine->length);
+          }
 
-        int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
-        // if the display length of the line is greater than the section's dispwidth, clip the line
-        if (lineDispWidth > pBase->scrnW - pSrcEdr->colRightStart - pSrcEdr->counterWidth) {
-          char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
-          if (szTemp != NULL)
-            free(szTemp);
-          tl_insert(pLine, (char*)" ...", pLine->length);
+          // display the line
+          type = pElem->type;
+          wxColour ColourElem = get_element_colour(pElem);
+          // display the element in its designated colour
+          if (type != CDE_S_BLANK) {
+            wxColour Colour = DC.GetTextForeground();
+            DC.SetTextForeground(ColourElem);
+            DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
+            DC.SetTextForeground(Colour);
+          }
+
+          // display the counter
+          strCtr.Printf("%4d", pSrcEdr->fileOffset + skip + lineOffset + 1);
+          src_edr_draw_counter(pSrcEdr, strCtr, pSrcEdr->fileOffset + skip + lineOffset, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset, DC);
+          tl_free(pLine);
+          pLine = NULL;
         }
-
-        // display the line
-        type = pElem->type;
-        wxColour ColourElem = get_element_colour(pElem);
-        // display the element in its designated colour
-        if (type != CDE_S_BLANK) {
-          wxColour Colour = DC.GetTextForeground();
-          DC.SetTextForeground(ColourElem);
-          DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-          DC.SetTextForeground(Colour);
-        }
-
-        // display the counter
-        strCtr.Printf("%4d", pSrcEdr->fileOffset + skip + lineOffset + 1);
-        wxColour Colour = DC.GetTextForeground();
-        DC.SetTextForeground(wxColour(128, 128, 160));
-        DC.DrawText(strCtr, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-        DC.SetTextForeground(Colour);
-        dispIndex++;
-        tl_free(pLine);
-        pLine = NULL;    
-      }
-    }
+        dispIndex++;
+      }
+    }
 
     // display the left section
     bEOF = false;
@@ -7690,43 +12183,43 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
             bEOF = true;
           // display the element depnding on its type
           else {
-            pLine = tl_clone(pElem->pLine);
+            // draw the line only if it is in the region being painted
+            if (src_edr_line_exposed(pBase, 0, pSrcEdr->colMidStart, dispIndex)) {
+              pLine = pSrcEdr->pCodeBase->clone_line(pElem);
+
+              // if it's a block or sub-block start, edit it for display
+              if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
+                tl_remove(pLine, (char*)"// BLOCK: ");
+                tl_remove(pLine, (char*)"// SUBBLOCK: ");
+              }
 
-            // if it's a block or sub-block start, edit it for display
-            if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
-              tl_remove(pLine, (char*)"// BLOCK: ");
-              tl_remove(pLine, (char*)"// SUBBLOCK: ");
-            }
+              int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
+              // if the display length of the line is greater than the section's dispwidth, clip the line
+              if (lineDispWidth > pSrcEdr->colMidStart - pSrcEdr->counterWidth) {
+                char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
+                if (szTemp != NULL)
+                  free(szTemp);
+                tl_insert(pLine, (char*)" ...", pLine->length);
+              }
 
-            int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
-            // if the display length of the line is greater than the section's dispwidth, clip the line
-            if (lineDispWidth > pSrcEdr->colMidStart - pSrcEdr->counterWidth) {
-              char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
-              if (szTemp != NULL)
-                free(szTemp);
-              tl_insert(pLine, (char*)" ...", pLine->length);
-            }
+              // display the line
+              type = pElem->type;
+              wxColour ColourElem = get_element_colour(pElem);
+              // display the element in its designated colour
+              if (type != CDE_S_BLANK) {
+                wxColour Colour = DC.GetTextForeground();
+                DC.SetTextForeground(ColourElem);
+                DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
+                DC.SetTextForeground(Colour);
+              }
 
-            // display the line
-            type = pElem->type;
-            wxColour ColourElem = get_element_colour(pElem);
-            // display the element in its designated colour
-            if (type != CDE_S_BLANK) {
-              wxColour Colour = DC.GetTextForeground();
-              DC.SetTextForeground(ColourElem);
-              DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-              DC.SetTextForeground(Colour);
+              // display the counter
+              strCtr.Printf("%4d", pSrcEdr->fileOffset + skip + lineOffset + 1);
+              src_edr_draw_counter(pSrcEdr, strCtr, pSrcEdr->fileOffset + skip + lineOffset, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset, DC);
+              tl_free(pLine);
+              pLine = NULL;
             }
-
-            // display the counter
-            strCtr.Printf("%4d", pSrcEdr->fileOffset + skip + lineOffset + 1);
-            wxColour Colour = DC.GetTextForeground();
-            DC.SetTextForeground(wxColour(128, 128, 160));
-            DC.DrawText(strCtr, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-            DC.SetTextForeground(Colour);
             dispIndex++;
-            tl_free(pLine);
-            pLine = NULL;    
           } // end case there's something to display in the left section
         }
       }
@@ -7748,15 +12241,6 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     DC.SetPen(Pen);
     DC.SetBrush(Brush);
 
-    // if bSelecting, display the selection region in the bg
-    // TODO
-    if (pSrcEdr->bSelectingX) {
-
-    }
-    else if (pSrcEdr->bSelectingY) {
-
-    }
-
     bEOF = false;
     x = pSrcEdr->colMidStart + 10;
     dispIndex = 0;
@@ -7764,63 +12248,81 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     // draw based on type, draw the counter, check for EOF
     while (dispIndex < pSrcEdr->dispLines && !bEOF) {
       pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, dispIndex, &lineOffset);
-      pLine = tl_clone(pElem->pLine);
+      // draw the line only if it is in the region being painted
+      if (src_edr_line_exposed(pBase, pSrcEdr->colMidStart, pBase->scrnW - pSrcEdr->colMidStart, dispIndex)) {
+        pLine = pSrcEdr->pCodeBase->clone_line(pElem);
 
-      // if it's a block or sub-block start, edit it for display
-      if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
-        tl_remove(pLine, (char*)"// BLOCK: ");
-        tl_remove(pLine, (char*)"// SUBBLOCK: ");
-      }
+        // if it's a block or sub-block start, edit it for display
+        if (pElem->type == CDE_S_BLOCKSTART || pElem->type == CDE_S_SUBBLOCKSTART) {
+          tl_remove(pLine, (char*)"// BLOCK: ");
+          tl_remove(pLine, (char*)"// SUBBLOCK: ");
+        }
 
-      int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
-      // if the display length of the line is greater than the section's dispwidth, clip the line
-      // center section elements are allowed to overflow into the right display column
-      if (lineDispWidth > pBase->scrnW - pSrcEdr->colMidStart - pSrcEdr->counterWidth) {
-        char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
-        if (szTemp != NULL)
-          free(szTemp);
-        tl_insert(pLine, (char*)" ...", pLine->length);
-      }
-
-      type = pElem->type;
-      wxColour ColourElem = get_element_colour(pElem);
-      // display the element in its colour with a bg rect in bg color
-      // the bg rect is for cases where the element overflows into the right display column
-      if (type != CDE_S_BLANK) {
-        wxRect rectBG;
-        DC.GetTextExtent(wxString(pLine->szBuf), &rectBG.width, &rectBG.height);
-        rectBG.x = x + pSrcEdr->counterWidth;
-        rectBG.y = dispIndex * pSrcEdr->lineHeight + firstLineOffset;
-      if (rectBG.width > pSrcEdr->colRightStart - pSrcEdr->colMidStart - pSrcEdr->counterWidth)
-        rectBG.width += 40;
-//        rectBG.width = pBase->scrnW - rectBG.x - 1;
-        wxPen Pen = DC.GetPen();
-        wxBrush Brush = DC.GetBrush();
-        DC.SetPen(*wxTRANSPARENT_PEN);
-        DC.SetBrush(wxBrush(wxColour(208, 208, 200)));
-        DC.DrawRectangle(rectBG);
-        DC.SetPen(Pen);
-        DC.SetBrush(Brush);
-
-        wxColour Colour = DC.GetTextForeground();
-        DC.SetTextForeground(ColourElem);
-        DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-        DC.SetTextForeground(Colour);
-      }
-
-      // display the counter
-      strCtr.Printf("%4d", pSrcEdr->fileOffset + lineOffset + 1);
-      wxColour Colour = DC.GetTextForeground();
-      DC.SetTextForeground(wxColour(128, 128, 160));
-      DC.DrawText(strCtr, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
-      DC.SetTextForeground(Colour);
+        int lineDispWidth = tl_caret_loc(pLine, pLine->length, DC, pWin);
+        // if the display length of the line is greater than the section's dispwidth, clip the line
+        // center section elements are allowed to overflow into the right display column
+        if (lineDispWidth > pBase->scrnW - pSrcEdr->colMidStart - pSrcEdr->counterWidth) {
+          char* szTemp = tl_cut_out(pLine, pLine->length / 2, pLine->length);
+          if (szTemp != NULL)
+            free(szTemp);
+          tl_insert(pLine, (char*)" ...", pLine->length);
+        }
 
+        type = pElem->type;
+        wxColour ColourElem = get_element_colour(pElem);
+        // display the element in its colour with a bg rect in bg color
+        // the bg rect is for cases where the element overflows into the right display column
+        if (type != CDE_S_BLANK) {
+          wxRect rectBG;
+          BENCH_COUNT(benchTxtExtentCalls);
+          DC.GetTextExtent(wxString(pLine->szBuf), &rectBG.width, &rectBG.height);
+          rectBG.x = x + pSrcEdr->counterWidth;
+          rectBG.y = dispIndex * pSrcEdr->lineHeight + firstLineOffset;
+        if (rectBG.width > pSrcEdr->colRightStart - pSrcEdr->colMidStart - pSrcEdr->counterWidth)
+          rectBG.width += 40;
+  //        rectBG.width = pBase->scrnW - rectBG.x - 1;
+          wxPen Pen = DC.GetPen();
+          wxBrush Brush = DC.GetBrush();
+          DC.SetPen(*wxTRANSPARENT_PEN);
+          DC.SetBrush(wxBrush(wxColour(208, 208, 200)));
+          DC.DrawRectangle(rectBG);
+          DC.SetPen(Pen);
+          DC.SetBrush(Brush);
+        }
+
+        // if a search is being typed and this line has it, highlight it in the bg of the element
+        if (bTypingSearch && type != CDE_S_BLANK && pSrcEdr->pTyped->is_hit(pSrcEdr->fileOffset + lineOffset))
+          src_edr_draw_typed_hit(pSrcEdr, pLine, dispIndex * pSrcEdr->lineHeight + firstLineOffset, DC, pWin);
+
+        // if selecting, display the selection region in the bg of the element
+        wxRect rectSel;
+        if ((pSrcEdr->bSelectingX || pSrcEdr->bSelectingY) && src_edr_sel_rect(pSrcEdr, pElem, pSrcEdr->fileOffset + lineOffset, dispIndex, DC, pWin, rectSel)) {
+          wxPen Pen = DC.GetPen();
+          wxBrush Brush = DC.GetBrush();
+          DC.SetPen(*wxTRANSPARENT_PEN);
+          DC.SetBrush(wxBrush(wxColour(160, 192, 232)));
+          DC.DrawRectangle(rectSel);
+          DC.SetPen(Pen);
+          DC.SetBrush(Brush);
+        }
+
+        if (type != CDE_S_BLANK) {
+          wxColour Colour = DC.GetTextForeground();
+          DC.SetTextForeground(ColourElem);
+          DC.DrawText(wxString(pLine->szBuf), x + pSrcEdr->counterWidth, dispIndex * pSrcEdr->lineHeight + firstLineOffset);
+          DC.SetTextForeground(Colour);
+        }
+
+        // display the counter
+        strCtr.Printf("%4d", pSrcEdr->fileOffset + lineOffset + 1);
+        src_edr_draw_counter(pSrcEdr, strCtr, pSrcEdr->fileOffset + lineOffset, x, dispIndex * pSrcEdr->lineHeight + firstLineOffset, DC);
+        tl_free(pLine);
+        pLine = NULL;
+      }
       if (pSrcEdr->fileOffset + lineOffset + ce_length(pElem) >= pSrcEdr->pCodeBase->pBaseSec->get_length())
         bEOF = true;
       else
         dispIndex++;
-      tl_free(pLine);
-      pLine = NULL;    
     }
 
     // display the caret
@@ -7828,8 +12330,9 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
     DC.SetPen(wxPen(wxColour(255, 0, 0)));
     pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset);
     int caretLoc;
-    pLine = pElem->pLine;
+    pLine = pSrcEdr->pCodeBase->clone_line(pElem);
     caretLoc = tl_caret_loc(pLine, pSrcEdr->Caret.x, DC, pWin);
+    tl_free(pLine);
     caretLoc += pSrcEdr->colMidStart + pSrcEdr->counterWidth + 10;
     DC.DrawLine(caretLoc,
       pSrcEdr->Caret.y * pSrcEdr->lineHeight,
@@ -7840,7 +12343,7 @@ void src_edr_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
   return;
 }
 // write to or load from File the state of this source editor
-bool src_edr_serialize( SMode *pBase, wxFile &File, bool bToFrom ) {
+bool src_edr_serialize( SMode *pBase, SBufFile &File, bool bToFrom ) {
   bool bRetVal = true;
   SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
   // store to 
@@ -7861,28 +12364,1728 @@ bool src_edr_serialize( SMode *pBase, wxFile &File, bool bToFrom ) {
       File.Write( &(pSrcEdr->bSelectingX), sizeof(bool) );
       File.Write( &(pSrcEdr->bSelectingY), sizeof(bool) );
       File.Write( &(pSrcEdr->bCutBufLoaded), sizeof(bool) );
+      File.begin_chunk(HXC_NAV_TRAIL);
       pSrcEdr->pNavTrail->serialize(File, bToFrom);
+      File.end_chunk();
+      if( pSrcEdr->bCutBufLoaded ) {
+        File.begin_chunk(HXC_CUT_BUF);
+        tl_serialize( pSrcEdr->pCutLine, File, true );
+        File.end_chunk();
+      }
+    }
+  }
+  // load from
+  // the src editor can't be restored without its code tree
+  // it can without its nav trail
+  else {
+    if( File.open_chunk(HXC_CODE_TREE) ) {
+      SCodeElement* pElem = load_code_element(File, NULL, 0);
+      pSrcEdr->pCodeBase = pElem->pSec->pCodeBase;
+      File.close_chunk();
+    }
+    else
+      bRetVal = false;
+    File.Read( &(pSrcEdr->fileOffset), sizeof(int) );
+    File.Read( &(pSrcEdr->Caret.x), sizeof(int) );
+    File.Read( &(pSrcEdr->Caret.y), sizeof(int) );
+    File.Read( &(pSrcEdr->CaretPrev.x), sizeof(int) );
+    File.Read( &(pSrcEdr->CaretPrev.y), sizeof(int) );
+    File.Read( &(pSrcEdr->selStartX), sizeof(int) );
+    File.Read( &(pSrcEdr->selEndX), sizeof(int) );
+    File.Read( &(pSrcEdr->selStartY), sizeof(int) );
+    File.Read( &(pSrcEdr->selEndY), sizeof(int) );
+    File.Read( &(pSrcEdr->bSelectingX), sizeof(bool) );
+    File.Read( &(pSrcEdr->bSelectingY), sizeof(bool) );
+    File.Read( &(pSrcEdr->bCutBufLoaded), sizeof(bool) );
+    if( File.open_chunk(HXC_NAV_TRAIL) ) {
+      pSrcEdr->pNavTrail->serialize(File, bToFrom);
+      File.close_chunk();
+    }
+    // the cut buffer is loaded only if it was stored
+    pSrcEdr->bCutBufLoaded = !File.bLegacy && File.open_chunk(HXC_CUT_BUF);
+    if( pSrcEdr->bCutBufLoaded ) {
+      free( pSrcEdr->pCutLine->szBuf );
+      tl_serialize( pSrcEdr->pCutLine, File, false );
+      File.close_chunk();
+    }
+  }
+  return( bRetVal );
+}
+// brings the codebase up to date with its source file (see codebase_refresh_source())
+// the view and the nav trail move with the lines they are on
+// or to the start of the lines parsed again if they were on those
+// returns true if the codebase changed
+bool src_edr_refresh_source( SModeSrcEdr *pSrcEdr ) {
+  int from, to, delta;
+  bool bRetVal = false;
+  if( pSrcEdr->pCodeBase != NULL )
+    bRetVal = codebase_refresh_source( pSrcEdr->pCodeBase, &from, &to, &delta );
+  if( bRetVal ) {
+    if( pSrcEdr->fileOffset >= to )
+      pSrcEdr->fileOffset += delta;
+    else if( pSrcEdr->fileOffset >= from ) {
+      pSrcEdr->fileOffset = from;
+      pSrcEdr->Caret.y = 0;
+    }
+    // the caret's line may have changed under it
+    pSrcEdr->Caret.x = 0;
+    pSrcEdr->CaretPrev = pSrcEdr->Caret;
+    pSrcEdr->bSelectingX = false;
+    pSrcEdr->bSelectingY = false;
+    SNavTrail *pNavTrail = pSrcEdr->pNavTrail;
+    for( int i=0; i<pNavTrail->numSteps; i++ ) {
+      SLocation *pStep = pNavTrail->ppSteps[i];
+      if( pStep->fileOffset >= to )
+        pStep->fileOffset += delta;
+      else if( pStep->fileOffset >= from )
+        pStep->fileOffset = from;
+      pStep->pCodeBaseLoc = NULL;
+    }
+  }
+  return( bRetVal );
+}
+// resumes the src editor once the session is restored
+// the source file may have been changed outside Modal since
+bool src_edr_resume( SMode *pBase ) {
+  return( src_edr_refresh_source( pBase->sExt.pSrcEdr ) );
+}
+// SUBBLOCK: JOURNALING
+// The src editor journals its edit ops, summarizes, gotos and back tos
+// (see SJournal) as the intent handlers make them.
+// The handlers and src_edr_replay() share the fns below that make these changes
+// so a replay changes the codebase exactly as the handlers did.
+
+// summarizes or expands the section of the element caretY lines from fileOffset
+// see src_edr_summarize()
+void src_edr_do_summarize( SModeSrcEdr *pSrcEdr, int fileOffset, int caretY ) {
+  int lineOffset;
+  SCodeElement * pElem;
+  pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( fileOffset, caretY, &lineOffset );
+  // if it's not the starting element, collapse  the element
+  if( pElem->bSingle ) {
+    // if starting element of its container summarize the container
+    if( pElem->indexContainer == 0 )
+      pElem->pContainer->bSummarized = true;
+  }
+  else
+    pElem->pSec->bSummarized = false;
+}
+// goes from the element at the caret to the element at fileOffset
+// adds the caret's location to the nav trail, collapses the element at the caret
+// and expands the sections down to the element at fileOffset
+// returns that element, the caller places it on screen
+SCodeElement *src_edr_do_goto( SModeSrcEdr *pSrcEdr, int fileOffset ) {
+  int lineOffset = 0;
+  SCodeElement* pElem = NULL;
+  // get current element (at caret.y) and collapse it
+  pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset);
+  // add the current location to the nav trail
+  SLocation* pCurLoc = new_location(pElem, pSrcEdr->fileOffset + lineOffset);
+  pSrcEdr->pNavTrail->add_step(pCurLoc, pSrcEdr->Caret.y);
+  pElem = ce_collapse(pElem);
+  lineOffset = -1; // just to make it !=0
+  // get the elem at fileOffset, if it's summarized, unsummarize it, repeat
+  // until you get an unsummarized element
+  while (lineOffset != 0) {
+    pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &lineOffset);
+    if (!pElem->bSingle && lineOffset != 0)
+      pElem->pSec->bSummarized = false;
+  }
+  if (!pElem->bSingle)
+    pElem->pSec->bSummarized = false;
+  // expand the goto element
+  ce_expand(pElem);
+  return( pElem );
+}
+// goes back to the last location on the nav trail
+// collapses the element at the caret, expands the back to location
+// and sets fileOffset and caretY for it
+// returns false if the nav trail is empty
+bool src_edr_do_back_to( SModeSrcEdr *pSrcEdr ) {
+  int caretLoc = -1; 
+  SLocation *pBackToLoc = pSrcEdr->pNavTrail->remove_step( &caretLoc ); 
+  bool bRetVal = pBackToLoc != NULL;
+  if( pBackToLoc != NULL ) {
+    SCodeElement *pElem = NULL;
+    int lineOffset = 0;
+    // collapse the current location
+    pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+    pElem = ce_collapse( pElem );
+    lineOffset = -1;
+    // expand the backTo location
+    while( lineOffset != 0 ) {
+      pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pBackToLoc->fileOffset, 0, &lineOffset );
+      if( lineOffset != 0 )
+        pElem->pSec->bSummarized = false;
+    }
+    // set fileOffset and caretY for the back to location
+    pSrcEdr->pCodeBase->pBaseSec->get_element_at( pBackToLoc->fileOffset, -caretLoc, &lineOffset );
+    pSrcEdr->fileOffset = pBackToLoc->fileOffset + lineOffset;
+    pSrcEdr->Caret.y = caretLoc;
+    free_location( pBackToLoc );
+    pBackToLoc = NULL;
+  }
+  return( bRetVal );
+}
+// journals an edit op, does it on the codebase and adds it to the codebase's oplist
+// it's journaled as it is before it's done, a paste with the elements it puts in
+// and a cut without the ones it takes out, a replay does it from there
+// returns false if it could not be done, it is then dropped, as it is on a replay
+bool src_edr_add_op( SModeSrcEdr *pSrcEdr, SOperation &Op, ModalWindow *pWin ) {
+  SJournal *pJournal = pWin->m_pModeManager->pJournal;
+  // an edit op is replayed where it was done, whatever the view
+  Op.serialize( pJournal->begin_record( HXC_JNL_EDIT, false ), true );
+  pJournal->end_record();
+  bool bRetVal = pSrcEdr->pCodeBase->do_edit( Op );
+  if( bRetVal )
+    pSrcEdr->pCodeBase->OpList.add( Op );
+  else
+    op_free( Op );
+  return( bRetVal );
+}
+// pastes the held cut pCut, the last op done, by doing it again as a move (see op_cutpaste_sel_move())
+// returns false if its elements could not be moved, the cut is then left as it was
+bool src_edr_move_cut( SModeSrcEdr *pSrcEdr, SOperation *pCut ) {
+  bool bRetVal = pSrcEdr->pCodeBase->do_edit( *pCut );
+  if( bRetVal )
+    pSrcEdr->pCodeBase->OpList.amend_last();
+  else
+    pCut->OpExt.CutPasteSel.bMoved = false;
+  return( bRetVal );
+}
+// undoes the last edit op on the codebase, or redoes the last one undone if bRedo
+// and journals it
+// returns the op, NULL if there is nothing to undo or redo
+SOperation *src_edr_undo_op( SModeSrcEdr *pSrcEdr, bool bRedo, SJournal *pJournal ) {
+  SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+  SOperation *pOp = bRedo ? pCodeBase->OpList.redo() : pCodeBase->OpList.undo();
+  if( pOp != NULL ) {
+    if( bRedo )
+      pCodeBase->do_edit( *pOp );
+    else
+      pCodeBase->undo_edit( *pOp );
+    pJournal->begin_record( bRedo ? HXC_JNL_REDO : HXC_JNL_UNDO );
+    pJournal->end_record();
+  }
+  return( pOp );
+}
+// journals the view (file offset and caret)
+// written after the other records so that a replay ends where the user was
+// if bDefer it's written once at the next commit, or before a record that depends on it
+void src_edr_journal_view( SModeSrcEdr *pSrcEdr, SJournal *pJournal, bool bDefer = false ) {
+  int aView[3] = { pSrcEdr->fileOffset, pSrcEdr->Caret.x, pSrcEdr->Caret.y };
+  if( bDefer )
+    pJournal->defer_record( HXC_JNL_VIEW, aView, sizeof(aView) );
+  else {
+    pJournal->begin_record( HXC_JNL_VIEW ).Write( aView, sizeof(aView) );
+    pJournal->end_record();
+  }
+}
+// replays a journal record of type opened in File
+// called by SModeManager::replay_journal() after the src editor has been restored
+// returns false if the record is not a src editor's
+bool src_edr_replay( SMode *pBase, SBufFile &File, int type ) {
+  bool bRetVal = true;
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  if( pSrcEdr->pCodeBase == NULL )
+    bRetVal = false;
+  else {
+    switch( type ) {
+    // the ops of journals from before undo were never done on the code tree
+    case HXC_JNL_OP:
+      break;
+    case HXC_JNL_EDIT: {
+      SOperation Op;
+      Op.serialize( File, false );
+      if( !File.bError && pSrcEdr->pCodeBase->do_edit( Op ) )
+        pSrcEdr->pCodeBase->OpList.add( Op );
+      else
+        op_free( Op );
+    }
+      break;
+    case HXC_JNL_UNDO: {
+      SOperation *pOp = pSrcEdr->pCodeBase->OpList.undo();
+      if( pOp != NULL )
+        pSrcEdr->pCodeBase->undo_edit( *pOp );
+    }
+      break;
+    case HXC_JNL_REDO: {
+      SOperation *pOp = pSrcEdr->pCodeBase->OpList.redo();
+      if( pOp != NULL )
+        pSrcEdr->pCodeBase->do_edit( *pOp );
+    }
+      break;
+    case HXC_JNL_MOVE: {
+      int toSecOffset = 0;
+      int toDepth = 0;
+      int toAt = 0;
+      File.Read( &toSecOffset, sizeof(int) );
+      File.Read( &toDepth, sizeof(int) );
+      File.Read( &toAt, sizeof(int) );
+      SOperation *pCut = pSrcEdr->pCodeBase->OpList.get_held_cut();
+      if( pCut != NULL && !File.bError ) {
+        op_cutpaste_sel_move( *pCut, toSecOffset, toDepth, toAt );
+        src_edr_move_cut( pSrcEdr, pCut );
+      }
+    }
+      break;
+    case HXC_JNL_SUMMARIZE: {
+      int fileOffset = 0;
+      int caretY = 0;
+      File.Read( &fileOffset, sizeof(int) );
+      File.Read( &caretY, sizeof(int) );
+      src_edr_do_summarize( pSrcEdr, fileOffset, caretY );
+    }
+      break;
+    case HXC_JNL_GOTO: {
+      int fileOffset = 0;
+      File.Read( &fileOffset, sizeof(int) );
+      src_edr_do_goto( pSrcEdr, fileOffset );
+    }
+      break;
+    case HXC_JNL_BACK:
+      src_edr_do_back_to( pSrcEdr );
+      break;
+    case HXC_JNL_VIEW:
+      File.Read( &(pSrcEdr->fileOffset), sizeof(int) );
+      File.Read( &(pSrcEdr->Caret.x), sizeof(int) );
+      File.Read( &(pSrcEdr->Caret.y), sizeof(int) );
+      break;
+    default:
+      bRetVal = false;
+      break;
+    }
+  }
+  return( bRetVal );
+}
+// places the element at fileOffset, which is not in a summarized section, at the center of the view
+// and the caret on it
+void src_edr_center_on( SModeSrcEdr *pSrcEdr, int fileOffset ) {
+  int lineOffset = 0;
+  SCodeElement* pElem = NULL;
+  // get the element again in it's expanded state
+  pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &lineOffset);
+  // place the element at the center by walking back dispLines/2 steps;
+  pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, -pSrcEdr->dispLines / 2, &lineOffset);
+  pSrcEdr->fileOffset = fileOffset + lineOffset;
+  pSrcEdr->Caret.x = 0;
+
+  // in some cases, the element may not be at the center and under the caret
+  // account for such cases
+  SCodeElement* pElemTemp = NULL;
+  pElemTemp = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->dispLines / 2, &lineOffset);
+  if (tl_equals(pElemTemp->pLine, pElem->pLine))
+    pSrcEdr->Caret.y = pSrcEdr->dispLines / 2;
+  // find the location of pElem and set Caret.y
+  else {
+    bool bFound = false;
+    for (int i = 0; i <= pSrcEdr->dispLines / 2 && !bFound; i++) {
+      pElemTemp = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, i, &lineOffset);
+      if (tl_equals(pElemTemp->pLine, pElem->pLine)) {
+        bFound = true;
+        pSrcEdr->Caret.y = i;
+      }
+    }
+    wxASSERT(bFound);
+  }
+}
+// gets the file offset of the element at the caret
+int src_edr_caret_offset( SModeSrcEdr *pSrcEdr ) {
+  int lineOffset = 0;
+  pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+  return( pSrcEdr->fileOffset + lineOffset );
+}
+// places the caret at the start of the element at fileOffset, which is not in a summarized section
+// the view moves only if the element is not in it
+void src_edr_caret_on( SModeSrcEdr *pSrcEdr, int fileOffset ) {
+  int lineOffset = 0;
+  bool bFound = false;
+  int length = pSrcEdr->pCodeBase->pBaseSec->get_length();
+  if( fileOffset >= length )
+    fileOffset = length - 1;
+  for( int i=0; i<pSrcEdr->dispLines && !bFound && fileOffset >= pSrcEdr->fileOffset; i++ ) {
+    pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, i, &lineOffset );
+    if( pSrcEdr->fileOffset + lineOffset == fileOffset ) {
+      pSrcEdr->Caret.y = i;
+      bFound = true;
+    }
+  }
+  if( !bFound )
+    src_edr_center_on( pSrcEdr, fileOffset );
+  pSrcEdr->Caret.x = 0;
+}
+// goes to the element at fileOffset (see src_edr_do_goto()) and journals the goto
+// the element is placed at the center of the screen, under the caret
+void src_edr_goto_location( SModeSrcEdr *pSrcEdr, int fileOffset, SJournal *pJournal ) {
+  // collapse current, expand the goto element and journal the goto
+  src_edr_do_goto(pSrcEdr, fileOffset);
+  pJournal->begin_record(HXC_JNL_GOTO).Write(&fileOffset, sizeof(int));
+  pJournal->end_record();
+  src_edr_center_on(pSrcEdr, fileOffset);
+  src_edr_journal_view(pSrcEdr, pJournal);
+}
+// SUBBLOCK: BUILD AND DIAGNOSTICS
+// A build exports the codebase to its source file (see ExportThread)
+// and then runs the compiler on that file as a separate process (see SCodeBase::build()).
+// The compiler's stdout and stderr are pipes that are polled every BUILD_POLL_INTERVAL
+// for what is available, so the user goes on editing while it runs.
+// The lines read go into the src editor's diagnostics mode (see SModeDiags)
+// which pops up when the compiler exits.
+
+// the compiler the source is built with, the quoted path of the source file is appended to it
+// MODAL_BUILD_COMMAND in the environment overrides it
+#define BUILD_COMMAND "g++ -fsyntax-only -Wall"
+// ms between reads of the compiler's output
+#define BUILD_POLL_INTERVAL 50
+// a process a src editor runs, the compiler of a build or a debugger
+// its window is sent a wxProcessEvent with id when the process exits
+// the window then calls src_edr_build_done() or src_edr_debug_done()
+class EditorProcess : public wxProcess {
+public:
+  EditorProcess( SMode *pMode, ModalWindow *pWin, int id ) : wxProcess( pWin, id ) {
+    m_pMode = pMode;
+  };
+  SMode *m_pMode; // the src editor that runs it
+};
+// reads what is available of a compiler output stream without blocking
+// complete lines go to pDiags, a partial last line is kept in pPartial till the rest is read
+void diags_read( SModeDiags *pDiags, wxInputStream *pStream, STxtBuf *pPartial ) {
+  while( stream_read_line( pStream, pPartial ) )
+    pDiags->add_line( pPartial );
+}
+// points the diagnostics reported against the source at their elements in pCodeBase
+// a diagnostic past the end of pCodeBase, or of a build of another codebase, has no location
+void diags_map_locations( SModeDiags *pDiags, SCodeBase *pCodeBase ) {
+  SElemIndex *pIndex = NULL;
+  int numLines = 0;
+  if( pCodeBase != NULL && pCodeBase == pDiags->pCodeBase ) {
+    pIndex = new_elem_index( pCodeBase->pBaseSec );
+    numLines = ce_length( pCodeBase->pBaseSec->pBaseElem ) - 1;
+  }
+  for( int i=0; i<pDiags->numDiags; i++ ) {
+    SLocation *pLocation = &(pDiags->pDiags[i].Location);
+    if( pLocation->fileOffset >= numLines )
+      pLocation->fileOffset = -1;
+    if( pIndex != NULL && pLocation->fileOffset != -1 )
+      map_location( pLocation, pIndex, 0, 0, 0 );
+  }
+  if( pIndex != NULL )
+    free_elem_index( pIndex );
+}
+// Build cache
+// The result of a build, the compiler's exit code and output, is kept in BUILD_CACHE_DIR.
+// An entry is named by a key computed from the content of the exported source,
+// its path and the build command, so a build of a source that has been built before
+// with the same command takes its result from the cache instead of running the compiler.
+// Headers the source includes are not in the key, remove the directory after changing them.
+#define BUILD_CACHE_DIR "BuildCache"
+// returns the path of the cache entry for building the source at strPath with strCommand
+// srcHash is the FNV-1a 64 of the source, the key continues it over the command and the path
+wxString build_cache_path( wxString strCommand, wxString strPath, unsigned long long srcHash ) {
+  wxString strKey = "\n" + strCommand + "\n" + strPath;
+  const char *szKey = static_cast<const char *>( strKey.c_str() );
+  unsigned long long key = fnv64_buf( szKey, strlen( szKey ), srcHash );
+  return( wxString::Format( "%s/%08x%08x.hxb", BUILD_CACHE_DIR, (unsigned int) (key >> 32), (unsigned int) key ) );
+}
+// loads the result of a build from its cache entry into pDiags
+// returns false if there is no entry or it is corrupt
+bool diags_load_cached( SModeDiags *pDiags ) {
+  bool bRetVal = false;
+  SBufFile *pFile = new_buf_file();
+  if( wxFile::Exists( pDiags->pCachePath->szBuf ) && pFile->open( pDiags->pCachePath->szBuf ) && pFile->open_chunk( HXC_BUILD_RESULT ) ) {
+    int exitCode = 0;
+    int length = 0;
+    pFile->Read( &exitCode, sizeof(int) );
+    pFile->Read( &length, sizeof(int) );
+    if( !pFile->bError && length >= 0 ) {
+      // the output is stored as it was read, a line at a time
+      STxtBuf *pOutput = new_txt_buf( length + 1 );
+      pFile->Read( pOutput->pData, length );
+      pOutput->length = length;
+      bRetVal = !pFile->bError;
+      for( int i=0; i<pOutput->length && bRetVal; i++ ) {
+        if( pOutput->pData[i] == '\n' )
+          pDiags->add_line( pDiags->pOutLine );
+        else
+          pDiags->pOutLine->append( pOutput->pData + i, 1 );
+      }
+      free_txt_buf( pOutput );
+      pDiags->exitCode = exitCode;
+    }
+    pFile->close_chunk();
+  }
+  free_buf_file( pFile );
+  return( bRetVal );
+}
+// stores the result of the build in pDiags, which exited with exitCode, to its cache entry
+// a result that can't be stored is simply built again next time
+void diags_store_cached( SModeDiags *pDiags, int exitCode ) {
+  SBufFile *pFile = new_buf_file();
+  int length = 0;
+  for( int i=0; i<pDiags->numDiags; i++ )
+    length += pDiags->pDiags[i].pText->length + 1;
+  if( !wxDirExists( BUILD_CACHE_DIR ) )
+    wxMkdir( BUILD_CACHE_DIR );
+  pFile->begin_image();
+  pFile->begin_chunk( HXC_BUILD_RESULT, true );
+  pFile->Write( &exitCode, sizeof(int) );
+  pFile->Write( &length, sizeof(int) );
+  for( int i=0; i<pDiags->numDiags; i++ ) {
+    pFile->Write( pDiags->pDiags[i].pText->szBuf, pDiags->pDiags[i].pText->length );
+    pFile->Write( "\n", 1 );
+  }
+  pFile->end_chunk();
+  if( !pFile->save_image( pDiags->pCachePath->szBuf ) ) {
+    wxLogMessage( "the build result could not be cached in %s", pDiags->pCachePath->szBuf );
+    wxRemoveFile( pDiags->pCachePath->szBuf );
+  }
+  free_buf_file( pFile );
+}
+// maps the diagnostics of the last build to the codebase and shows them
+// in place of the building message, or a message if the build was clean
+// if the user is elsewhere, the diagnostics wait for SEI_DIAGNOSTICS
+void src_edr_build_finish( SMode *pEditor, int exitCode, ModalWindow *pWin ) {
+  SModeSrcEdr *pSrcEdr = pEditor->sExt.pSrcEdr;
+  SModeDiags *pDiags = pSrcEdr->pDiags->sExt.pDiags;
+  SModeManager *pModeManager = pWin->m_pModeManager;
+  diags_map_locations( pDiags, pSrcEdr->pCodeBase );
+  pDiags->bRunning = false;
+  pDiags->exitCode = exitCode;
+
+  if( pModeManager->pCurMode == pSrcEdr->pMsg )
+    pModeManager->pop();
+  if( pModeManager->pCurMode == pSrcEdr->pDiags ) {
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+  else if( pModeManager->pCurMode == pEditor ) {
+    if( exitCode == 0 && pDiags->numDiags == 0 ) {
+      pSrcEdr->pMsg->sExt.pMsg->set_msg( (char*)"the build succeeded" );
+      pModeManager->push( pSrcEdr->pMsg );
+    }
+    else
+      pModeManager->push( pSrcEdr->pDiags );
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+}
+// builds the source file of the src editor's codebase, srcHash is the FNV-1a 64 of the source
+// the diagnostics of the last build are cleared
+// if the build cache has the result it is shown right away, else the compiler is started
+// returns false if there is no source file, a build is running or the compiler could not be started
+bool src_edr_start_build( SMode *pBase, ModalWindow *pWin, unsigned long long srcHash ) {
+  bool bRetVal = false;
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+  if( pCodeBase != NULL && pCodeBase->pSrcPath != NULL && pWin->m_pBuildProcess == NULL ) {
+    SModeDiags *pDiags = pSrcEdr->pDiags->sExt.pDiags;
+    wxString strCommand;
+    if( !wxGetEnv( "MODAL_BUILD_COMMAND", &strCommand ) || strCommand.IsEmpty() )
+      strCommand = BUILD_COMMAND;
+    pDiags->reset( pCodeBase, build_cache_path( strCommand, wxString( pCodeBase->pSrcPath->szBuf ), srcHash ) );
+    if( diags_load_cached( pDiags ) ) {
+      pDiags->bCached = true;
+      src_edr_build_finish( pBase, pDiags->exitCode, pWin );
+      bRetVal = true;
+    }
+    else {
+      // a partly loaded entry is discarded
+      pDiags->reset( pCodeBase, wxString( pDiags->pCachePath->szBuf ) );
+      EditorProcess *pProcess = new EditorProcess( pBase, pWin, ID_BUILD_PROCESS );
+      if( pCodeBase->build( strCommand, pProcess ) ) {
+        pWin->m_pBuildProcess = pProcess;
+        pWin->m_BuildTimer.Start( BUILD_POLL_INTERVAL );
+        bRetVal = true;
+      }
+      else {
+        delete pProcess;
+        pDiags->bRunning = false;
+        wxLogError( "%s could not be run", strCommand );
+      }
+    }
+  }
+  return( bRetVal );
+}
+// reads what the running build's compiler has output so far
+// the diagnostics are redrawn if they are up
+void src_edr_build_poll( wxProcess *pProcess, ModalWindow *pWin ) {
+  EditorProcess *pBuild = (EditorProcess *) pProcess;
+  SModeSrcEdr *pSrcEdr = pBuild->m_pMode->sExt.pSrcEdr;
+  SModeDiags *pDiags = pSrcEdr->pDiags->sExt.pDiags;
+  int numDiags = pDiags->numDiags;
+  diags_read( pDiags, pProcess->GetInputStream(), pDiags->pOutLine );
+  diags_read( pDiags, pProcess->GetErrorStream(), pDiags->pErrLine );
+  if( pDiags->numDiags != numDiags && pWin->m_pModeManager->pCurMode == pSrcEdr->pDiags ) {
+    pWin->m_bUsrActn = false;
+    pWin->RefreshRect( pDiags->Rect, true );
+  }
+}
+// reaps the build's compiler once it has exited with exitCode
+// the rest of its output is read, the result is cached and shown (see src_edr_build_finish())
+// a compiler that did not exit normally (exitCode -1) is not cached
+void src_edr_build_done( wxProcess *pProcess, int exitCode, ModalWindow *pWin ) {
+  EditorProcess *pBuild = (EditorProcess *) pProcess;
+  SMode *pEditor = pBuild->m_pMode;
+  SModeDiags *pDiags = pEditor->sExt.pSrcEdr->pDiags->sExt.pDiags;
+  diags_read( pDiags, pProcess->GetInputStream(), pDiags->pOutLine );
+  diags_read( pDiags, pProcess->GetErrorStream(), pDiags->pErrLine );
+  if( pDiags->pOutLine->length > 0 )
+    pDiags->add_line( pDiags->pOutLine );
+  if( pDiags->pErrLine->length > 0 )
+    pDiags->add_line( pDiags->pErrLine );
+  delete pBuild;
+  if( exitCode != -1 )
+    diags_store_cached( pDiags, exitCode );
+  src_edr_build_finish( pEditor, exitCode, pWin );
+}
+// kybd map for mode diagnostics
+bool diags_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
+  bool bRetVal = true;
+  wxClientDC DC( pWin ); // dummy
+  if( pBase->pFont != NULL ) {
+    pBase->load_font();
+    DC.SetFont( *(pBase->pFont) );
+  }
+  pBase->key = event.GetKeyCode();
+  pBase->uniKey = event.GetUnicodeKey();
+
+  // case exit, pop this off the mode stack and refresh the window
+  // up or down arrow dispatch to CHANGE_SEL, return dispatches to GOTO
+  if( pBase->key == WXK_ESCAPE ) {
+    pWin->m_pModeManager->pop();
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+  else if( pBase->key == WXK_UP || pBase->key == WXK_DOWN ) {
+    pBase->intent = DGI_CHANGE_SEL;
+    pBase->mark_dispatch();
+    pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
+  }
+  else if( pBase->key == WXK_RETURN ) {
+    pBase->intent = DGI_GOTO;
+    pBase->mark_dispatch();
+    pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
+  }
+  pWin->m_bUsrActn = false;
+  return( bRetVal );
+}
+// displays the lines of the last build
+// a title line with the state of the build followed by the visible lines, the selected one highlighted
+void diags_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
+  SModeDiags *pDiags = pBase->sExt.pDiags;
+  wxString strTitle;
+  if( pDiags->bRunning )
+    strTitle = wxString::Format( "building, %d lines so far", pDiags->numDiags );
+  else if( pDiags->exitCode == 0 )
+    strTitle = wxString::Format( "the build succeeded, %d errors, %d warnings", pDiags->numErrors, pDiags->numWarnings );
+  else
+    strTitle = wxString::Format( "the build failed (%d), %d errors, %d warnings", pDiags->exitCode, pDiags->numErrors, pDiags->numWarnings );
+  if( pDiags->bCached )
+    strTitle += " (cached)";
+  strTitle += ", arrows to select, enter to go to, esc to exit";
+  int widthLine;
+  int heightLine;
+
+  // determine the framing rect
+  DC.GetTextExtent( strTitle, &widthLine, &heightLine );
+  pDiags->Rect.width = (9 * pBase->scrnW) / 10;
+  pDiags->Rect.height = heightLine * (DIAGS_ROWS + 3);
+  pDiags->Rect.x = pBase->scrnW / 2 - pDiags->Rect.width / 2;
+  pDiags->Rect.y = pBase->scrnH / 2 - pDiags->Rect.height / 2;
+  wxPen Pen = DC.GetPen();
+  wxBrush Brush = DC.GetBrush();
+  DC.SetPen( *wxTRANSPARENT_PEN );
+  DC.SetBrush( wxBrush( wxColour( 208, 208, 200 ) ) );
+  DC.DrawRectangle( pDiags->Rect );
+
+  // draw the title and the visible rows, long lines are clipped to the frame
+  int x = pDiags->Rect.x + 20;
+  int y = pDiags->Rect.y + heightLine;
+  DC.SetClippingRegion( pDiags->Rect );
+  DC.DrawText( strTitle, x, y );
+  y += heightLine;
+  for( int i=pDiags->firstRow; i<pDiags->numDiags && i<pDiags->firstRow + DIAGS_ROWS; i++ ) {
+    y += heightLine;
+    if( i == pDiags->curSel ) {
+      DC.SetBrush( *wxWHITE_BRUSH );
+      DC.DrawRectangle( wxRect( x - 5, y, pDiags->Rect.width - 30, heightLine ) );
+    }
+    DC.DrawText( wxString( pDiags->pDiags[i].pText->szBuf ), x, y );
+  }
+  if( pDiags->numDiags == 0 && !pDiags->bRunning )
+    DC.DrawText( wxString( pDiags->bBuilt ? "the compiler output nothing" : "nothing has been built yet" ), x, y + heightLine );
+  DC.DestroyClippingRegion();
+  DC.SetPen( Pen );
+  DC.SetBrush( Brush );
+}
+// intent handler for diagnostics DGI_CHANGE_SEL
+// moves the selection by one, scrolling the rows to keep it visible, and refreshes this pop-up's frame
+void diags_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  SModeDiags *pDiags = pBase->sExt.pDiags;
+  if( phase == PH_NOTIFY ) {
+    if( pBase->key == WXK_UP && pDiags->curSel > 0 )
+      pDiags->curSel--;
+    else if( pBase->key == WXK_DOWN && pDiags->curSel < pDiags->numDiags - 1 )
+      pDiags->curSel++;
+    if( pDiags->curSel < pDiags->firstRow )
+      pDiags->firstRow = pDiags->curSel;
+    else if( pDiags->curSel >= pDiags->firstRow + DIAGS_ROWS )
+      pDiags->firstRow = pDiags->curSel - DIAGS_ROWS + 1;
+    pWin->m_bUsrActn = false;
+    pWin->RefreshRect( pDiags->Rect, true );
+  }
+}
+// intent handler for diagnostics DGI_GOTO
+// if the selected line has a location in the codebase being edited
+// pops this mode and goes to it in the src editor (see src_edr_goto_location())
+void diags_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  SModeDiags *pDiags = pBase->sExt.pDiags;
+  SModeSrcEdr *pSrcEdr = pDiags->pEditor->sExt.pSrcEdr;
+  if( phase == PH_NOTIFY && pDiags->curSel < pDiags->numDiags && pSrcEdr->pCodeBase == pDiags->pCodeBase ) {
+    SLocation *pLocation = &(pDiags->pDiags[pDiags->curSel].Location);
+    // the codebase may have been edited since the build
+    if( pLocation->pCodeBaseLoc != NULL && pLocation->fileOffset < ce_length( pSrcEdr->pCodeBase->pBaseSec->pBaseElem ) - 1 ) {
+      pWin->m_pModeManager->pop();
+      src_edr_goto_location( pSrcEdr, pLocation->fileOffset, pWin->m_pModeManager->pJournal );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
+    }
+  }
+}
+// SUBBLOCK: DEBUGGING
+// A debug session runs gdb on the program built from the codebase as a separate process
+// (see SCodeBase::debug()) and drives it through its machine interface (MI).
+// Commands are written to its stdin, the records it outputs are polled every DEBUG_POLL_INTERVAL
+// like the compiler's output during a build, so the editor stays live while the program runs.
+// The breakpoints are the codebase's (see SCodeBase::toggle_break()), they are inserted when the
+// session starts and as they are toggled. When the program stops at a line of the source file
+// the editor goes to it and its counter is highlighted (see src_edr_draw_counter()).
+// The build only checks the source (see BUILD_COMMAND), so the program to debug is named
+// by MODAL_DEBUG_TARGET. It runs with its stdio off gdb's pipes, which carry only MI records.
+
+// the debugger, the quoted path of the program is appended to it
+// MODAL_DEBUG_COMMAND in the environment overrides it
+#define DEBUG_COMMAND "gdb --interpreter=mi2 -q"
+// ms between reads of the debugger's output
+#define DEBUG_POLL_INTERVAL 50
+// the file the debugged program's stdout and stderr go to, its stdin is the null device
+#define DEBUG_OUTPUT_FILE "Debug.txt"
+#ifdef __WXMSW__
+#define DEBUG_NULL_INPUT "NUL"
+#else
+#define DEBUG_NULL_INPUT "/dev/null"
+#endif
+// returns the path of the program to debug, MODAL_DEBUG_TARGET in the environment
+// empty if it's not set, the program is not built by BUILD_COMMAND which only checks the source
+wxString debug_target() {
+  wxString strTarget;
+  if( !wxGetEnv( "MODAL_DEBUG_TARGET", &strTarget ) )
+    strTarget = "";
+  return( strTarget );
+}
+// sends the MI command strCommand to the debugger running as pProcess
+void dbg_send( wxProcess *pProcess, wxString strCommand ) {
+  wxOutputStream *pStream = pProcess->GetOutputStream();
+  if( pStream != NULL ) {
+    strCommand += "\n";
+    const char *szCommand = static_cast<const char *>( strCommand.c_str() );
+    pStream->Write( szCommand, strlen( szCommand ) );
+  }
+}
+// sends the command to insert or delete the breakpoint at the line at fileOffset of the debugged source
+void dbg_send_break( SDebugger *pDebugger, wxProcess *pProcess, int fileOffset, bool bInsert ) {
+  wxString strLine = wxString::Format( "%s:%d", pDebugger->pSrcName->szBuf, fileOffset + 1 );
+  if( bInsert )
+    dbg_send( pProcess, "-break-insert \"" + strLine + "\"" );
+  else
+    dbg_send( pProcess, "-interpreter-exec console \"clear " + strLine + "\"" );
+}
+// finds the field szName="..." in the MI record szRecord and copies its unescaped value to pValue
+// returns false if the record has no such field
+bool mi_field( const char *szRecord, const char *szName, STxtBuf *pValue ) {
+  bool bRetVal = false;
+  int nameLength = strlen( szName );
+  pValue->length = 0;
+  for( const char *p = szRecord; *p != '\0' && !bRetVal; p++ ) {
+    // a field name follows the record's class or an opening brace of a tuple
+    if( ( *p == ',' || *p == '{' ) && strncmp( p + 1, szName, nameLength ) == 0 && p[nameLength + 1] == '=' && p[nameLength + 2] == '"' ) {
+      bRetVal = true;
+      for( const char *q = p + nameLength + 3; *q != '\0' && *q != '"'; q++ ) {
+        if( *q == '\\' && q[1] != '\0' )
+          q++;
+        pValue->append( q, 1 );
+      }
+    }
+  }
+  // the value is kept NUL terminated
+  pValue->append( "", 1 );
+  pValue->length--;
+  return( bRetVal );
+}
+// handles the MI record szRecord output by the debugger of the src editor pEditor
+// tracks the state of the program and goes to the line it stopped at
+void dbg_record( SMode *pEditor, const char *szRecord, ModalWindow *pWin ) {
+  SModeSrcEdr *pSrcEdr = pEditor->sExt.pSrcEdr;
+  SDebugger *pDebugger = pSrcEdr->pDebugger;
+  STxtBuf *pValue = new_txt_buf( 256 );
+  if( strncmp( szRecord, "*running", 8 ) == 0 ) {
+    pDebugger->state = DBS_RUNNING;
+    pDebugger->Stop.init( NULL, -1 );
+  }
+  else if( strncmp( szRecord, "*stopped", 8 ) == 0 ) {
+    pDebugger->Stop.init( NULL, -1 );
+    if( mi_field( szRecord, "reason", pValue ) && strncmp( pValue->pData, "exited", 6 ) == 0 )
+      pDebugger->state = DBS_EXITED;
+    else {
+      pDebugger->state = DBS_STOPPED;
+      int line = 0;
+      if( mi_field( szRecord, "line", pValue ) )
+        line = atoi( pValue->pData );
+      // a stop in another file, or in code without debug info, has no location in the codebase
+      if( line > 0 && mi_field( szRecord, "file", pValue ) && pDebugger->pCodeBase == pSrcEdr->pCodeBase
+        && wxFileName( wxString( pValue->pData ) ).GetFullName() == wxString( pDebugger->pSrcName->szBuf ) ) {
+        int numLines = ce_length( pSrcEdr->pCodeBase->pBaseSec->pBaseElem ) - 1;
+        if( line - 1 < numLines ) {
+          SElemIndex *pIndex = new_elem_index( pSrcEdr->pCodeBase->pBaseSec );
+          pDebugger->Stop.fileOffset = line - 1;
+          map_location( &(pDebugger->Stop), pIndex, 0, 0, 0 );
+          free_elem_index( pIndex );
+          if( pWin->m_pModeManager->pCurMode == pEditor )
+            src_edr_goto_location( pSrcEdr, pDebugger->Stop.fileOffset, pWin->m_pModeManager->pJournal );
+        }
+      }
+    }
+  }
+  else if( strncmp( szRecord, "^error", 6 ) == 0 && mi_field( szRecord, "msg", pValue ) )
+    wxLogMessage( "the debugger: %s", pValue->pData );
+  free_txt_buf( pValue );
+}
+// reads the records the debugger running as pProcess has output so far
+// the editor is redrawn if the state of the program changed
+void src_edr_debug_poll( wxProcess *pProcess, ModalWindow *pWin ) {
+  EditorProcess *pDebug = (EditorProcess *) pProcess;
+  SDebugger *pDebugger = pDebug->m_pMode->sExt.pSrcEdr->pDebugger;
+  int state = pDebugger->state;
+  int stopOffset = pDebugger->Stop.fileOffset;
+  while( stream_read_line( pProcess->GetInputStream(), pDebugger->pOutLine ) ) {
+    pDebugger->pOutLine->append( "", 1 );
+    dbg_record( pDebug->m_pMode, pDebugger->pOutLine->pData, pWin );
+    pDebugger->pOutLine->length = 0;
+  }
+  // the debugger's warnings are not shown, the program's own output is in DEBUG_OUTPUT_FILE
+  while( stream_read_line( pProcess->GetErrorStream(), pDebugger->pErrLine ) )
+    pDebugger->pErrLine->length = 0;
+  if( pDebugger->state != state || pDebugger->Stop.fileOffset != stopOffset ) {
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+}
+// reaps the debugger once it has exited and ends the session
+void src_edr_debug_done( wxProcess *pProcess, ModalWindow *pWin ) {
+  EditorProcess *pDebug = (EditorProcess *) pProcess;
+  SMode *pEditor = pDebug->m_pMode;
+  SModeSrcEdr *pSrcEdr = pEditor->sExt.pSrcEdr;
+  src_edr_debug_poll( pProcess, pWin );
+  pSrcEdr->pDebugger->state = DBS_NONE;
+  pSrcEdr->pDebugger->Stop.init( NULL, -1 );
+  delete pDebug;
+  if( pWin->m_pModeManager->pCurMode == pEditor ) {
+    pSrcEdr->pMsg->sExt.pMsg->set_msg( (char*)"the debug session has ended" );
+    pWin->m_pModeManager->push( pSrcEdr->pMsg );
+  }
+  pWin->m_bUsrActn = false;
+  pWin->Refresh( true );
+}
+// starts a debug session of the src editor's codebase on the program at strTarget
+// its breakpoints are inserted and the program is run
+// returns false if the debugger could not be started
+bool src_edr_start_debug( SMode *pBase, ModalWindow *pWin, wxString strTarget ) {
+  bool bRetVal = false;
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+  SDebugger *pDebugger = pSrcEdr->pDebugger;
+  wxString strCommand;
+  if( !wxGetEnv( "MODAL_DEBUG_COMMAND", &strCommand ) || strCommand.IsEmpty() )
+    strCommand = DEBUG_COMMAND;
+  pDebugger->reset( pCodeBase );
+  EditorProcess *pProcess = new EditorProcess( pBase, pWin, ID_DEBUG_PROCESS );
+  if( pCodeBase->debug( strCommand, strTarget, pProcess ) ) {
+    pWin->m_pDebugProcess = pProcess;
+    pWin->m_DebugTimer.Start( DEBUG_POLL_INTERVAL );
+    for( int i=0; i<pCodeBase->numBreaks; i++ )
+      dbg_send_break( pDebugger, pProcess, pCodeBase->pBreaks[i].fileOffset, true );
+    // the program gets stdio of its own, redirected by the shell gdb starts it with
+    // so it can't read gdb's commands or write into its records
+    dbg_send( pProcess, "-exec-arguments < " DEBUG_NULL_INPUT " > " DEBUG_OUTPUT_FILE " 2>&1" );
+    dbg_send( pProcess, "-exec-run" );
+    bRetVal = true;
+  }
+  else {
+    delete pProcess;
+    pDebugger->state = DBS_NONE;
+    wxLogError( "%s could not be run", strCommand );
+  }
+  return( bRetVal );
+}
+// SUBBLOCK: SEARCH
+// The lines of the codebase are indexed for search (see STrigramIndex) by an IndexThread
+// once the codebase is loaded, and again when a search finds the index dropped by a cut or paste.
+// A search gets the trigrams of the text it's for, for a regex those of the literal text
+// any line it matches must contain, and matches only the lines that have all of them.
+
+// the most trigrams of a query that are looked up
+#define SEARCH_MAX_TRIGRAMS 64
+// orders index keys, for qsort()
+int index_key_cmp( const void *pA, const void *pB ) {
+  unsigned long long a = *((unsigned long long *) pA);
+  unsigned long long b = *((unsigned long long *) pB);
+  return( ( a < b ) ? -1 : ( a > b ) );
+}
+// the most lines in a part of a copy of the lines
+#define COPY_PART_LINES 4096
+// A copy of the single lines of a codebase, summarized or not, in file order
+// for worker threads to read while the user goes on editing.
+// It is taken on the main thread, the chars of the lines are not copied, it points at their buffers
+// which stay as they are till it's freed, the lines edited meanwhile get new ones (see SLineShares)
+// The lines are split into parts at the blocks and subblocks they are in, a part has at most COPY_PART_LINES
+typedef struct SLineCopy {
+  void init( SCodeBase *pCodeBase ) {
+    this->maxElems = 1024;
+    this->ppElems = (SCodeElement **) malloc( this->maxElems * sizeof(SCodeElement *) );
+    this->pszLines = (char **) malloc( this->maxElems * sizeof(char *) );
+    this->pLengths = (int *) malloc( this->maxElems * sizeof(int) );
+    this->maxParts = 64;
+    this->pParts = (int *) malloc( (this->maxParts + 1) * sizeof(int) );
+    wxASSERT_MSG( this->ppElems != NULL && this->pszLines != NULL && this->pLengths != NULL && this->pParts != NULL, "malloc failure" );
+    this->numElems = 0;
+    this->numParts = 0;
+    this->epoch = LineShares.begin();
+    pCodeBase->GapLine.store();
+    this->add_part();
+    this->copy( pCodeBase->pBaseSec );
+    this->pParts[this->numParts] = this->numElems;
+  };
+  // starts a part at the next line, unless one starts there already
+  void add_part() {
+    if( this->numParts == 0 || this->pParts[this->numParts - 1] != this->numElems ) {
+      if( this->numParts == this->maxParts ) {
+        this->maxParts = this->maxParts * 2;
+        this->pParts = (int *) realloc( this->pParts, (this->maxParts + 1) * sizeof(int) );
+        wxASSERT_MSG( this->pParts != NULL, "malloc failure" );
+      }
+      this->pParts[this->numParts] = this->numElems;
+      this->numParts++;
+    }
+  };
+  // appends the single lines of pSec to the copy
+  void copy( SCodeSection *pSec ) {
+    for( int i=0; i<pSec->numElements; i++ ) {
+      SCodeElement *pElem = pSec->ppElements[i];
+      if( !pElem->bSingle ) {
+        bool bPart = pElem->type == CDE_BLOCK || pElem->type == CDE_SUBBLOCK;
+        if( bPart )
+          this->add_part();
+        this->copy( pElem->pSec );
+        if( bPart )
+          this->add_part();
+      }
+      else {
+        if( this->numElems - this->pParts[this->numParts - 1] == COPY_PART_LINES )
+          this->add_part();
+        if( this->numElems == this->maxElems ) {
+          this->maxElems = this->maxElems * 2;
+          this->ppElems = (SCodeElement **) realloc( this->ppElems, this->maxElems * sizeof(SCodeElement *) );
+          this->pszLines = (char **) realloc( this->pszLines, this->maxElems * sizeof(char *) );
+          this->pLengths = (int *) realloc( this->pLengths, this->maxElems * sizeof(int) );
+          wxASSERT_MSG( this->ppElems != NULL && this->pszLines != NULL && this->pLengths != NULL, "malloc failure" );
+        }
+        this->ppElems[this->numElems] = pElem;
+        this->pszLines[this->numElems] = (char*)"";
+        this->pLengths[this->numElems] = 0;
+        if( pElem->pLine != NULL ) {
+          pElem->pLine->shareEpoch = this->epoch;
+          this->pszLines[this->numElems] = pElem->pLine->szBuf;
+          this->pLengths[this->numElems] = pElem->pLine->length;
+        }
+        this->numElems++;
+      }
+    }
+  };
+  // gets the copy of the line at fileOffset
+  char *get_line( int fileOffset ) {
+    return( this->pszLines[fileOffset] );
+  };
+  // gets its length
+  int get_line_length( int fileOffset ) {
+    return( this->pLengths[fileOffset] );
+  };
+  SCodeElement **ppElems; // the elements of the lines copied, the index of one is its file offset
+  int numElems;
+  int maxElems;
+  char **pszLines; // the buffer of each line as it was copied, and its length
+  int *pLengths;
+  long epoch; // the epoch the lines are stamped with (see SLineShares)
+  int *pParts; // the first line of each part, and the end of the last
+  int numParts;
+  int maxParts;
+} SLineCopy;
+// allocs a copy of the lines of pCodeBase on the heap, caller has to free
+SLineCopy *new_line_copy( SCodeBase *pCodeBase ) {
+  SLineCopy *pCopy = (SLineCopy *) malloc( sizeof(SLineCopy) );
+  wxASSERT_MSG( pCopy != NULL, "malloc failure" );
+  pCopy->init( pCodeBase );
+  return( pCopy );
+}
+void free_line_copy( SLineCopy *pCopy ) {
+  if( pCopy != NULL ) {
+    free( pCopy->ppElems );
+    free( pCopy->pszLines );
+    free( pCopy->pLengths );
+    free( pCopy->pParts );
+    LineShares.end( pCopy->epoch );
+    free( pCopy );
+  }
+}
+// A worker thread that builds a trigram index of the lines of a codebase
+// the lines are copied in its constructor, on the main thread, and the thread touches no other app state
+// the copy shares the buffers of the lines (see SLineCopy), so taking it doesn't copy the text
+// it sends its window an ID_INDEX_DONE event when it's done
+// the window then calls src_edr_index_done(), which installs the index
+class IndexThread : public wxThread {
+public:
+  IndexThread( SMode *pMode, ModalWindow *pWin ) : wxThread( wxTHREAD_JOINABLE ) {
+    SCodeBase *pCodeBase = pMode->sExt.pSrcEdr->pCodeBase;
+    m_pMode = pMode;
+    m_pWin = pWin;
+    m_pCodeBase = pCodeBase;
+    m_pCopy = new_line_copy( pCodeBase );
+    m_pTrigrams = NULL;
+    m_pFirsts = NULL;
+    m_pPostings = NULL;
+    m_numTrigrams = 0;
+    m_epoch = pCodeBase->SearchIndex.snapshot();
+  };
+  virtual ~IndexThread() {
+    free_line_copy( m_pCopy );
+    free( m_pTrigrams );
+    free( m_pFirsts );
+    free( m_pPostings );
+  };
+  virtual ExitCode Entry() {
+    // a key for each trigram of each line, the trigram above the index of the line
+    int maxKeys = 0;
+    for( int i=0; i<m_pCopy->numElems; i++ )
+      if( m_pCopy->get_line_length( i ) > 2 )
+        maxKeys += m_pCopy->get_line_length( i ) - 2;
+    unsigned long long *pKeys = (unsigned long long *) malloc( (maxKeys + 1) * sizeof(unsigned long long) );
+    wxASSERT_MSG( pKeys != NULL, "malloc failure" );
+    int numKeys = 0;
+    for( int i=0; i<m_pCopy->numElems; i++ ) {
+      char *szLine = m_pCopy->get_line( i );
+      for( int j=0; j + 2 < m_pCopy->get_line_length( i ); j++ ) {
+        pKeys[numKeys] = ( ((unsigned long long) TRIGRAM( szLine + j )) << 32 ) | (unsigned int) i;
+        numKeys++;
+      }
+    }
+    // sorted, the keys of a trigram are together and in the order of their lines
+    qsort( pKeys, numKeys, sizeof(unsigned long long), index_key_cmp );
+    // a line is posted once for a trigram it has more than once
+    int numPostings = 0;
+    for( int i=0; i<numKeys; i++ ) {
+      if( i == 0 || pKeys[i] != pKeys[i - 1] ) {
+        numPostings++;
+        if( i == 0 || ( pKeys[i] >> 32 ) != ( pKeys[i - 1] >> 32 ) )
+          m_numTrigrams++;
+      }
+    }
+    m_pTrigrams = (unsigned int *) malloc( (m_numTrigrams + 1) * sizeof(unsigned int) );
+    m_pFirsts = (int *) malloc( (m_numTrigrams + 1) * sizeof(int) );
+    m_pPostings = (int *) malloc( (numPostings + 1) * sizeof(int) );
+    wxASSERT_MSG( m_pTrigrams != NULL && m_pFirsts != NULL && m_pPostings != NULL, "malloc failure" );
+    int numTrigrams = 0;
+    numPostings = 0;
+    for( int i=0; i<numKeys; i++ ) {
+      if( i == 0 || pKeys[i] != pKeys[i - 1] ) {
+        if( i == 0 || ( pKeys[i] >> 32 ) != ( pKeys[i - 1] >> 32 ) ) {
+          m_pTrigrams[numTrigrams] = (unsigned int) ( pKeys[i] >> 32 );
+          m_pFirsts[numTrigrams] = numPostings;
+          numTrigrams++;
+        }
+        m_pPostings[numPostings] = (int) ( pKeys[i] & 0xffffffff );
+        numPostings++;
+      }
+    }
+    m_pFirsts[m_numTrigrams] = numPostings;
+    free( pKeys );
+    wxQueueEvent( m_pWin, new wxThreadEvent( wxEVT_THREAD, ID_INDEX_DONE ) );
+    return( 0 );
+  };
+  SMode *m_pMode; // the src editor whose codebase is indexed
+  ModalWindow *m_pWin;
+  SCodeBase *m_pCodeBase; // the codebase indexed and the epoch of its code tree then
+  int m_epoch;
+  SLineCopy *m_pCopy; // the lines indexed
+  unsigned int *m_pTrigrams; // the index built (see STrigramIndex)
+  int *m_pFirsts;
+  int m_numTrigrams;
+  int *m_pPostings;
+};
+// starts an IndexThread on the lines of the src editor's codebase, unless one is running
+// returns false if there is no codebase to index or the thread could not be started
+bool src_edr_start_index( SMode *pBase, ModalWindow *pWin ) {
+  bool bRetVal = pWin->m_pIndexThread != NULL;
+  if( !bRetVal && pBase->sExt.pSrcEdr->pCodeBase != NULL ) {
+    IndexThread *pThread = new IndexThread( pBase, pWin );
+    if( pThread->Create() != wxTHREAD_NO_ERROR || pThread->Run() != wxTHREAD_NO_ERROR )
+      delete pThread;
+    else {
+      pWin->m_pIndexThread = pThread;
+      bRetVal = true;
+    }
+  }
+  return( bRetVal );
+}
+// reaps an IndexThread once it is done
+// its index is installed if it's of the src editor's codebase as it is now (see STrigramIndex::install())
+// else the codebase is indexed again, unless pWin is NULL as the app is exiting
+void src_edr_index_done( wxThread *pThread, ModalWindow *pWin ) {
+  IndexThread *pIndex = (IndexThread *) pThread;
+  pIndex->Wait();
+  SMode *pBase = pIndex->m_pMode;
+  SCodeBase *pCodeBase = pBase->sExt.pSrcEdr->pCodeBase;
+  if( pWin != NULL && pCodeBase != NULL && pCodeBase == pIndex->m_pCodeBase ) {
+    pCodeBase->SearchIndex.install( pIndex->m_pCopy->ppElems, pIndex->m_pCopy->numElems, pIndex->m_pTrigrams, pIndex->m_pFirsts, pIndex->m_numTrigrams, pIndex->m_pPostings, pIndex->m_epoch );
+    pIndex->m_pCopy->ppElems = NULL;
+    pIndex->m_pTrigrams = NULL;
+    pIndex->m_pFirsts = NULL;
+    pIndex->m_pPostings = NULL;
+  }
+  delete pIndex;
+  if( pWin != NULL && pCodeBase != NULL && !pCodeBase->SearchIndex.is_current() )
+    src_edr_start_index( pBase, pWin );
+}
+// gets into pTrigrams, at most maxTrigrams, the trigrams a line must have to contain szText
+// or if bRegex, to match the extended regex szText. These are the trigrams of the runs of literal chars
+// of the regex that are not in a group or made optional by a quantifier, none if it has alternatives.
+// returns their number
+int search_trigrams( const char *szText, bool bRegex, unsigned int *pTrigrams, int maxTrigrams ) {
+  int numTrigrams = 0;
+  int length = strlen( szText );
+  char *szRun = (char *) malloc( length + 1 );
+  wxASSERT_MSG( szRun != NULL, "malloc failure" );
+  int runLength = 0;
+  int depth = 0;
+  bool bAlternatives = false;
+  for( int i=0; i<=length && !bAlternatives; i++ ) {
+    char c = szText[i];
+    bool bLiteral = !bRegex && c != 0;
+    if( bRegex && c != 0 ) {
+      // an escaped char is literal, unless it's a class like \w
+      if( c == '\\' && i + 1 < length ) {
+        i++;
+        c = szText[i];
+        bLiteral = depth == 0 && !isalnum( (unsigned char) c );
+      }
+      else if( c == '|' )
+        bAlternatives = depth == 0;
+      else if( c == '(' )
+        depth++;
+      else if( c == ')' && depth > 0 )
+        depth--;
+      // a bracket expression is skipped, a ] first in it is one of its chars
+      else if( c == '[' ) {
+        i++;
+        if( i < length && szText[i] == '^' )
+          i++;
+        if( i < length && szText[i] == ']' )
+          i++;
+        while( i < length && szText[i] != ']' )
+          i++;
+      }
+      // the char before may not be there, it's dropped from the run, which ends here (below)
+      // so no trigram spans it, the literals after it start a new run
+      else if( c == '*' || c == '?' || c == '{' ) {
+        if( runLength > 0 )
+          runLength--;
+        while( c == '{' && i < length && szText[i] != '}' )
+          i++;
+        bLiteral = false;
+      }
+      else
+        bLiteral = depth == 0 && c != '.' && c != '^' && c != '$' && c != '+';
+    }
+    if( bLiteral ) {
+      szRun[runLength] = c;
+      runLength++;
+    }
+    // the run ends, its trigrams are emitted and a new one starts
+    else {
+      for( int j=0; j + 2 < runLength && numTrigrams < maxTrigrams; j++ ) {
+        pTrigrams[numTrigrams] = TRIGRAM( szRun + j );
+        numTrigrams++;
+      }
+      runLength = 0;
+    }
+  }
+  if( bAlternatives )
+    numTrigrams = 0;
+  free( szRun );
+  return( numTrigrams );
+}
+// gets into *ppLines the lines of pIndex posted for all of the numTrigrams (at least 1) trigrams in pTrigrams
+// their postings are intersected starting from the shortest's, so the lines ascend
+// returns their number, caller has to free *ppLines
+int index_candidates( STrigramIndex *pIndex, unsigned int *pTrigrams, int numTrigrams, int **ppLines ) {
+  int *apPostings[SEARCH_MAX_TRIGRAMS];
+  int aNumPostings[SEARCH_MAX_TRIGRAMS];
+  int aCursors[SEARCH_MAX_TRIGRAMS];
+  int shortest = 0;
+  int numLines = 0;
+  for( int i=0; i<numTrigrams; i++ ) {
+    aNumPostings[i] = pIndex->get_postings( pTrigrams[i], &(apPostings[i]) );
+    aCursors[i] = 0;
+    if( aNumPostings[i] < aNumPostings[shortest] )
+      shortest = i;
+  }
+  *ppLines = (int *) malloc( (aNumPostings[shortest] + 1) * sizeof(int) );
+  wxASSERT_MSG( *ppLines != NULL, "malloc failure" );
+  for( int i=0; i<aNumPostings[shortest]; i++ ) {
+    int line = apPostings[shortest][i];
+    bool bCandidate = true;
+    // the candidates ascend, so each postings list is searched on from where it was left
+    for( int j=0; j<numTrigrams && bCandidate; j++ ) {
+      if( j != shortest ) {
+        int lo = aCursors[j];
+        int hi = aNumPostings[j];
+        while( lo < hi ) {
+          int mid = (lo + hi) / 2;
+          if( apPostings[j][mid] < line )
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+        aCursors[j] = lo;
+        bCandidate = lo < aNumPostings[j] && apPostings[j][lo] == line;
+      }
+    }
+    if( bCandidate ) {
+      (*ppLines)[numLines] = line;
+      numLines++;
+    }
+  }
+  return( numLines );
+}
+// matches the single lines of pSec into pSearch, the first of them at *pFileOffset
+// *pFileOffset is moved past them
+void search_scan( SModeSearch *pSearch, SCodeSection *pSec, int *pFileOffset, const char *szText, wxRegEx *pRegex ) {
+  for( int i=0; i<pSec->numElements; i++ ) {
+    SCodeElement *pElem = pSec->ppElements[i];
+    if( pElem->bSingle ) {
+      pSearch->match( pElem, *pFileOffset, szText, pRegex );
+      (*pFileOffset)++;
+    }
+    else
+      search_scan( pSearch, pElem->pSec, pFileOffset, szText, pRegex );
+  }
+}
+// searches pCodeBase for the lines that contain szQuery, or that match it as a regex
+// if it starts with a '/', the lines found go to pSearch.
+// if the codebase's index is current, the candidates are the lines posted for all of the query's
+// trigrams, their postings are intersected starting from the shortest's, and the lines edited since.
+// else every line is matched
+// returns false if the regex is not valid
+bool search_query( SModeSearch *pSearch, SCodeBase *pCodeBase, const char *szQuery ) {
+  bool bRetVal = true;
+  wxStopWatch Clock;
+  bool bRegex = szQuery[0] == '/';
+  const char *szText = bRegex ? szQuery + 1 : szQuery;
+  wxRegEx Regex;
+  wxRegEx *pRegex = NULL;
+  STrigramIndex *pIndex = &(pCodeBase->SearchIndex);
+  pSearch->reset( pCodeBase, szQuery );
+  if( bRegex ) {
+    bRetVal = Regex.Compile( wxString( szText ), wxRE_EXTENDED | wxRE_NOSUB );
+    pRegex = &Regex;
+  }
+  pCodeBase->GapLine.store();
+  if( bRetVal && pIndex->is_current() ) {
+    unsigned int aTrigrams[SEARCH_MAX_TRIGRAMS];
+    int numTrigrams = search_trigrams( szText, bRegex, aTrigrams, SEARCH_MAX_TRIGRAMS );
+    pSearch->bIndexed = true;
+    for( int i=0; i<pIndex->numEdited; i++ )
+      pSearch->match( pIndex->ppEdited[i], ce_file_offset( pIndex->ppEdited[i] ), szText, pRegex );
+    // a query too short to have a trigram has every line as a candidate
+    if( numTrigrams == 0 ) {
+      for( int i=0; i<pIndex->numElems && !pSearch->bTruncated; i++ )
+        pSearch->match( pIndex->ppElems[i], i, szText, pRegex );
+    }
+    else {
+      int *pLines = NULL;
+      int numLines = index_candidates( pIndex, aTrigrams, numTrigrams, &pLines );
+      for( int i=0; i<numLines && !pSearch->bTruncated; i++ )
+        pSearch->match( pIndex->ppElems[pLines[i]], pLines[i], szText, pRegex );
+      free( pLines );
+    }
+  }
+  else if( bRetVal ) {
+    int fileOffset = 0;
+    search_scan( pSearch, pCodeBase->pBaseSec, &fileOffset, szText, pRegex );
+  }
+  pSearch->sort_hits();
+  pSearch->elapsed = Clock.Time();
+  return( bRetVal );
+}
+// tells if the index narrows down the lines a search for szQuery has to match (see search_query())
+bool search_is_narrowed( SCodeBase *pCodeBase, const char *szQuery ) {
+  unsigned int aTrigrams[SEARCH_MAX_TRIGRAMS];
+  bool bRegex = szQuery[0] == '/';
+  return( pCodeBase->SearchIndex.is_current() && search_trigrams( bRegex ? szQuery + 1 : szQuery, bRegex, aTrigrams, SEARCH_MAX_TRIGRAMS ) > 0 );
+}
+// orders locations by their file offset, for qsort()
+int location_cmp( const void *pA, const void *pB ) {
+  return( ((SLocation *) pA)->fileOffset - ((SLocation *) pB)->fileOffset );
+}
+// adds the lines with szText in them to pTyped, in file order
+// the candidates are the lines pIndex has posted for all of szText's trigrams and the lines edited since
+void typed_search_seed( STypedSearch *pTyped, STrigramIndex *pIndex, const char *szText ) {
+  unsigned int aTrigrams[SEARCH_MAX_TRIGRAMS];
+  int numTrigrams = search_trigrams( szText, false, aTrigrams, SEARCH_MAX_TRIGRAMS );
+  int *pLines = NULL;
+  int numLines = index_candidates( pIndex, aTrigrams, numTrigrams, &pLines );
+  int start = pTyped->numHits;
+  // an edited line is checked as it is now, not as it was indexed
+  for( int i=0; i<numLines; i++ ) {
+    SCodeElement *pElem = pIndex->ppElems[pLines[i]];
+    bool bEdited = false;
+    for( int j=0; j<pIndex->numEdited && !bEdited; j++ )
+      bEdited = pIndex->ppEdited[j] == pElem;
+    if( !bEdited && strstr( pElem->pLine->szBuf, szText ) != NULL )
+      pTyped->add_hit( pElem, pLines[i] );
+  }
+  for( int i=0; i<pIndex->numEdited; i++ )
+    if( strstr( pIndex->ppEdited[i]->pLine->szBuf, szText ) != NULL )
+      pTyped->add_hit( pIndex->ppEdited[i], ce_file_offset( pIndex->ppEdited[i] ) );
+  if( pIndex->numEdited > 0 )
+    qsort( pTyped->pHits + start, pTyped->numHits - start, sizeof(SLocation), location_cmp );
+  free( pLines );
+}
+// adds the lines of pSec, which starts at *pFileOffset, with szText in them to pTyped
+void typed_search_scan( STypedSearch *pTyped, SCodeSection *pSec, int *pFileOffset, const char *szText ) {
+  for( int i=0; i<pSec->numElements; i++ ) {
+    SCodeElement *pElem = pSec->ppElements[i];
+    if( pElem->bSingle ) {
+      if( pElem->pLine != NULL && strstr( pElem->pLine->szBuf, szText ) != NULL )
+        pTyped->add_hit( pElem, *pFileOffset );
+      (*pFileOffset)++;
+    }
+    else
+      typed_search_scan( pTyped, pElem->pSec, pFileOffset, szText );
+  }
+}
+// finds the lines for the query typed so far into the search line input, unless they are cached.
+// they are the lines of the deepest level cached for a prefix of it that still have it in them
+// or, with none cached, every line that has it, which the codebase's index narrows down if it's current.
+// a query is followed from TYPED_MIN_QUERY chars, the length of a trigram, shorter ones are in most lines.
+// the line input's message gets how many were found.
+// a regex is not followed, a longer one need not match fewer lines
+void typed_search_update( SModeSrcEdr *pSrcEdr, SModeLineInp *pLineInput ) {
+  STypedSearch *pTyped = pSrcEdr->pTyped;
+  char *szQuery = pTyped->pQuery->szBuf;
+  if( pTyped->pQuery->length >= TYPED_MIN_QUERY && szQuery[0] != '/' ) {
+    SLocation *pParent;
+    if( !pTyped->is_current() ) {
+      int numParent = pTyped->get_hits( &pParent );
+      // pHits can be realloc'd as lines are added, so the parent's are indexed from its start
+      int parentStart = pParent - pTyped->pHits;
+      bool bNarrowed = pTyped->numLevels > 0;
+      pTyped->push_level( pTyped->pQuery->length );
+      if( bNarrowed ) {
+        for( int i=parentStart; i<parentStart + numParent; i++ ) {
+          SLocation Hit = pTyped->pHits[i];
+          if( strstr( Hit.pCodeBaseLoc->pLine->szBuf, szQuery ) != NULL )
+            pTyped->add_hit( Hit.pCodeBaseLoc, Hit.fileOffset );
+        }
+      }
+      else if( pSrcEdr->pCodeBase->SearchIndex.is_current() ) {
+        pSrcEdr->pCodeBase->GapLine.store();
+        typed_search_seed( pTyped, &(pSrcEdr->pCodeBase->SearchIndex), szQuery );
+      }
+      else {
+        int fileOffset = 0;
+        pSrcEdr->pCodeBase->GapLine.store();
+        typed_search_scan( pTyped, pSrcEdr->pCodeBase->pBaseSec, &fileOffset, szQuery );
+      }
+    }
+    wxString strMsg = wxString::Format( "search? (/ for a regex) %d lines found", pTyped->get_hits( &pParent ) );
+    pLineInput->set_msg( (char*)(const char*)strMsg.mb_str() );
+  }
+  else
+    pLineInput->set_msg( (char*)"search? (/ for a regex)" );
+}
+// tells if the search line input of the src editor pBase is being typed into
+// never while drawn without a window (see render_bench())
+bool src_edr_is_typing_search( SMode *pBase, ModalWindow *pWin ) {
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  SModeLineInp *pLineInput = pSrcEdr->pLineInp->sExt.pLineInput;
+  return( pWin != NULL && pWin->m_pModeManager->pCurMode == pSrcEdr->pLineInp && pLineInput->pCaller == pBase && pLineInput->callerIntent == SEI_SEARCH );
+}
+// Regex scan
+// A search for a regex the index can't narrow down matches every line.
+// It's done by a pool of ScanThreads on a copy of the lines (see SLineCopy),
+// each takes the next part of it, a block or subblock, and matches its lines with a regex it compiled.
+// The lines found are posted to the window as they are found and go to the search pop-up
+// (see src_edr_scan_hits()), so the first show right away.
+// A scan is cancelled by Esc or by the next search, its threads stop at their next check.
+// the most threads a scan runs on
+#define SCAN_MAX_WORKERS 8
+// the lines a scan thread matches between checks for a cancel
+#define SCAN_CHECK_LINES 256
+// the state a scan's threads share, they take it under pLock
+typedef struct SSearchScan {
+  void init( SMode *pEditor, ModalWindow *pWin, const char *szRegex ) {
+    this->pEditor = pEditor;
+    this->pWin = pWin;
+    this->pRegex = new_txt_line( (char *) szRegex );
+    this->pCopy = new_line_copy( pEditor->sExt.pSrcEdr->pCodeBase );
+    this->pLock = new wxCriticalSection();
+    this->pClock = new wxStopWatch();
+    this->nextPart = 0;
+    this->maxPending = 256;
+    this->pPending = (int *) malloc( this->maxPending * sizeof(int) );
+    wxASSERT_MSG( this->pPending != NULL, "malloc failure" );
+    this->numPending = 0;
+    this->numScanned = 0;
+    this->bPosted = false;
+    this->bCancelled = false;
+    this->numWorkers = 0;
+    this->numDone = 0;
+  };
+  // gets the next part to scan, -1 if there is none or the scan is cancelled
+  // numScanned lines have been matched since the last part was taken
+  int next_part( int numScanned ) {
+    int retVal = -1;
+    this->pLock->Enter();
+    this->numScanned += numScanned;
+    if( !this->bCancelled && this->nextPart < this->pCopy->numParts ) {
+      retVal = this->nextPart;
+      this->nextPart++;
+    }
+    this->pLock->Leave();
+    return( retVal );
+  };
+  // adds the line at fileOffset to the lines found
+  // the window is sent an event unless it's been sent one it hasn't taken the lines for yet
+  void add_hit( int fileOffset ) {
+    this->pLock->Enter();
+    if( this->numPending == this->maxPending ) {
+      this->maxPending = this->maxPending * 2;
+      this->pPending = (int *) realloc( this->pPending, this->maxPending * sizeof(int) );
+      wxASSERT_MSG( this->pPending != NULL, "malloc failure" );
+    }
+    this->pPending[this->numPending] = fileOffset;
+    this->numPending++;
+    bool bPost = !this->bPosted;
+    this->bPosted = true;
+    this->pLock->Leave();
+    if( bPost )
+      wxQueueEvent( this->pWin, new wxThreadEvent( wxEVT_THREAD, ID_SCAN_HITS ) );
+  };
+  // a scan thread is done, the window is sent an event
+  void worker_done() {
+    this->pLock->Enter();
+    this->numDone++;
+    this->pLock->Leave();
+    wxQueueEvent( this->pWin, new wxThreadEvent( wxEVT_THREAD, ID_SCAN_HITS ) );
+  };
+  void cancel() {
+    this->pLock->Enter();
+    this->bCancelled = true;
+    this->pLock->Leave();
+  };
+  bool is_cancelled() {
+    this->pLock->Enter();
+    bool bRetVal = this->bCancelled;
+    this->pLock->Leave();
+    return( bRetVal );
+  };
+  // takes the lines found since the last take, *pNumHits of them, caller has to free
+  // *pNumScanned gets the lines matched so far and *pbDone if the scan threads are all done
+  int *take_hits( int *pNumHits, int *pNumScanned, bool *pbDone ) {
+    int *pRetVal = (int *) malloc( this->maxPending * sizeof(int) );
+    wxASSERT_MSG( pRetVal != NULL, "malloc failure" );
+    this->pLock->Enter();
+    int *pHits = this->pPending;
+    this->pPending = pRetVal;
+    pRetVal = pHits;
+    *pNumHits = this->numPending;
+    *pNumScanned = this->numScanned;
+    *pbDone = this->numDone == this->numWorkers;
+    this->numPending = 0;
+    this->bPosted = false;
+    this->pLock->Leave();
+    return( pRetVal );
+  };
+  SMode *pEditor; // the src editor that searched
+  ModalWindow *pWin;
+  STxtLine *pRegex; // what it searched for
+  SLineCopy *pCopy; // the lines it searched
+  wxCriticalSection *pLock;
+  wxStopWatch *pClock; // started with the scan
+  int nextPart; // the next part to be scanned
+  int *pPending; // the lines found that the window has not taken yet
+  int numPending;
+  int maxPending;
+  int numScanned; // the lines matched so far
+  bool bPosted; // the window has been sent an event for them
+  bool bCancelled;
+  wxThread *apWorkers[SCAN_MAX_WORKERS];
+  int numWorkers; // the threads started
+  int numDone; // and those of them that are done
+} SSearchScan;
+// allocs and inits a scan on the heap for pEditor's codebase, its lines are copied
+// caller has to free
+SSearchScan *new_search_scan( SMode *pEditor, ModalWindow *pWin, const char *szRegex ) {
+  SSearchScan *pScan = (SSearchScan *) malloc( sizeof(SSearchScan) );
+  wxASSERT_MSG( pScan != NULL, "malloc failure" );
+  pScan->init( pEditor, pWin, szRegex );
+  return( pScan );
+}
+// frees a scan whose threads have been reaped
+void free_search_scan( SSearchScan *pScan ) {
+  if( pScan != NULL ) {
+    tl_free( pScan->pRegex );
+    free_line_copy( pScan->pCopy );
+    delete pScan->pLock;
+    delete pScan->pClock;
+    free( pScan->pPending );
+    free( pScan );
+  }
+}
+// A worker thread of a scan
+// it matches the lines of the parts of the scan's copy it takes till there are none left
+// the regex is compiled for it, as a wxRegEx can't be shared between threads
+class ScanThread : public wxThread {
+public:
+  ScanThread( SSearchScan *pScan ) : wxThread( wxTHREAD_JOINABLE ) {
+    m_pScan = pScan;
+  };
+  virtual ExitCode Entry() {
+    SLineCopy *pCopy = m_pScan->pCopy;
+    wxRegEx Regex;
+    int part = -1;
+    if( Regex.Compile( wxString( m_pScan->pRegex->szBuf ), wxRE_EXTENDED | wxRE_NOSUB ) )
+      part = m_pScan->next_part( 0 );
+    while( part != -1 ) {
+      int start = pCopy->pParts[part];
+      int end = pCopy->pParts[part + 1];
+      bool bCancelled = false;
+      int i;
+      for( i=start; i<end && !bCancelled; i++ ) {
+        if( Regex.Matches( wxString( pCopy->get_line( i ) ) ) )
+          m_pScan->add_hit( i );
+        if( ( i - start + 1 ) % SCAN_CHECK_LINES == 0 )
+          bCancelled = m_pScan->is_cancelled();
+      }
+      part = m_pScan->next_part( i - start );
+    }
+    m_pScan->worker_done();
+    return( 0 );
+  };
+  SSearchScan *m_pScan;
+};
+// starts a scan of the src editor's codebase for szQuery, a '/' followed by a regex
+// on as many threads as there are CPUs, the lines it finds go to the search mode as they are found.
+// if no thread could be started, the lines are matched here (see search_query())
+// returns false if the regex is not valid
+bool src_edr_start_scan( SMode *pBase, ModalWindow *pWin, const char *szQuery ) {
+  SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+  SModeSearch *pSearch = pSrcEdr->pSearch->sExt.pSearch;
+  wxRegEx Regex;
+  bool bRetVal = Regex.Compile( wxString( szQuery + 1 ), wxRE_EXTENDED | wxRE_NOSUB );
+  if( bRetVal ) {
+    SSearchScan *pScan = new_search_scan( pBase, pWin, szQuery + 1 );
+    int numWorkers = wxThread::GetCPUCount();
+    if( numWorkers > SCAN_MAX_WORKERS )
+      numWorkers = SCAN_MAX_WORKERS;
+    if( numWorkers > pScan->pCopy->numParts )
+      numWorkers = pScan->pCopy->numParts;
+    if( numWorkers < 1 )
+      numWorkers = 1;
+    for( int i=0; i<numWorkers; i++ ) {
+      ScanThread *pThread = new ScanThread( pScan );
+      if( pThread->Create() != wxTHREAD_NO_ERROR || pThread->Run() != wxTHREAD_NO_ERROR )
+        delete pThread;
+      else {
+        pScan->apWorkers[pScan->numWorkers] = pThread;
+        pScan->numWorkers++;
+      }
+    }
+    if( pScan->numWorkers > 0 ) {
+      pSearch->reset( pSrcEdr->pCodeBase, szQuery );
+      pSearch->bScanned = true;
+      pSearch->bScanning = true;
+      pSearch->numLines = pScan->pCopy->numElems;
+      pWin->m_pScan = pScan;
+    }
+    else {
+      free_search_scan( pScan );
+      bRetVal = search_query( pSearch, pSrcEdr->pCodeBase, szQuery );
+    }
+  }
+  return( bRetVal );
+}
+// takes the lines the scan has found since it last did into the search mode
+// and refreshes the search pop-up if it's up.
+// once its threads are all done, or enough lines are found, the scan is reaped
+void src_edr_scan_hits( ModalWindow *pWin ) {
+  SSearchScan *pScan = pWin->m_pScan;
+  SModeSrcEdr *pSrcEdr = pScan->pEditor->sExt.pSrcEdr;
+  SModeSearch *pSearch = pSrcEdr->pSearch->sExt.pSearch;
+  int numHits = 0;
+  int numScanned = 0;
+  bool bDone = false;
+  int *pHits = pScan->take_hits( &numHits, &numScanned, &bDone );
+  for( int i=0; i<numHits; i++ )
+    pSearch->add_hit( pScan->pCopy->ppElems[pHits[i]], pHits[i], pScan->pCopy->get_line( pHits[i] ) );
+  free( pHits );
+  pSearch->sort_hits();
+  pSearch->numMatched = numScanned;
+  pSearch->elapsed = pScan->pClock->Time();
+  if( bDone || pSearch->bTruncated )
+    src_edr_end_scan( pWin );
+  if( pWin->m_pModeManager->pCurMode == pSrcEdr->pSearch ) {
+    pWin->m_bUsrActn = false;
+    pWin->RefreshRect( pSearch->Rect, true );
+  }
+}
+// cancels the scan of the search mode if one is running and reaps it once its threads stop
+void src_edr_end_scan( ModalWindow *pWin ) {
+  SSearchScan *pScan = pWin->m_pScan;
+  if( pScan != NULL ) {
+    pScan->cancel();
+    for( int i=0; i<pScan->numWorkers; i++ ) {
+      pScan->apWorkers[i]->Wait();
+      delete pScan->apWorkers[i];
+    }
+    pScan->pEditor->sExt.pSrcEdr->pSearch->sExt.pSearch->bScanning = false;
+    free_search_scan( pScan );
+    pWin->m_pScan = NULL;
+  }
+}
+// kybd map for mode search
+bool search_map( SMode *pBase, wxKeyEvent &event, ModalWindow *pWin ) {
+  bool bRetVal = true;
+  wxClientDC DC( pWin ); // dummy
+  if( pBase->pFont != NULL ) {
+    pBase->load_font();
+    DC.SetFont( *(pBase->pFont) );
+  }
+  pBase->key = event.GetKeyCode();
+  pBase->uniKey = event.GetUnicodeKey();
+
+  // case exit, cancel a scan still running, pop this off the mode stack and refresh the window
+  // up or down arrow dispatch to CHANGE_SEL, return dispatches to GOTO
+  if( pBase->key == WXK_ESCAPE ) {
+    src_edr_end_scan( pWin );
+    pWin->m_pModeManager->pop();
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+  else if( pBase->key == WXK_UP || pBase->key == WXK_DOWN ) {
+    pBase->intent = SHI_CHANGE_SEL;
+    pBase->mark_dispatch();
+    pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
+  }
+  else if( pBase->key == WXK_RETURN ) {
+    pBase->intent = SHI_GOTO;
+    pBase->mark_dispatch();
+    pBase->fnIntent_handler[pBase->intent]( pBase, PH_NOTIFY, pWin, DC );
+  }
+  pWin->m_bUsrActn = false;
+  return( bRetVal );
+}
+// displays the lines found by the last search
+// a title line with what was searched for and how followed by the visible lines, the selected one highlighted
+void search_disp_state( SMode *pBase, ModalWindow *pWin, wxDC& DC ) {
+  SModeSearch *pSearch = pBase->sExt.pSearch;
+  wxString strTitle = wxString::Format( "%d lines found for \"%s\"", pSearch->numHits, pSearch->pQuery->szBuf );
+  if( pSearch->bTruncated )
+    strTitle += " (the first ones)";
+  if( pSearch->bScanning )
+    strTitle += wxString::Format( ", scanning, %d of %d lines matched", pSearch->numMatched, pSearch->numLines );
+  else
+    strTitle += wxString::Format( ", %d lines matched in %ld ms", pSearch->numMatched, pSearch->elapsed );
+  if( pSearch->bScanned )
+    strTitle += " (scanned)";
+  else if( !pSearch->bIndexed )
+    strTitle += " (not indexed yet)";
+  strTitle += ", arrows to select, enter to go to, esc to exit";
+  int widthLine;
+  int heightLine;
+
+  // determine the framing rect
+  DC.GetTextExtent( strTitle, &widthLine, &heightLine );
+  pSearch->Rect.width = (9 * pBase->scrnW) / 10;
+  pSearch->Rect.height = heightLine * (SEARCH_ROWS + 3);
+  pSearch->Rect.x = pBase->scrnW / 2 - pSearch->Rect.width / 2;
+  pSearch->Rect.y = pBase->scrnH / 2 - pSearch->Rect.height / 2;
+  wxPen Pen = DC.GetPen();
+  wxBrush Brush = DC.GetBrush();
+  DC.SetPen( *wxTRANSPARENT_PEN );
+  DC.SetBrush( wxBrush( wxColour( 208, 208, 200 ) ) );
+  DC.DrawRectangle( pSearch->Rect );
+
+  // draw the title and the visible rows, each with its file offset, long lines are clipped to the frame
+  int x = pSearch->Rect.x + 20;
+  int y = pSearch->Rect.y + heightLine;
+  DC.SetClippingRegion( pSearch->Rect );
+  DC.DrawText( strTitle, x, y );
+  y += heightLine;
+  for( int i=pSearch->firstRow; i<pSearch->numHits && i<pSearch->firstRow + SEARCH_ROWS; i++ ) {
+    y += heightLine;
+    if( i == pSearch->curSel ) {
+      DC.SetBrush( *wxWHITE_BRUSH );
+      DC.DrawRectangle( wxRect( x - 5, y, pSearch->Rect.width - 30, heightLine ) );
+    }
+    DC.DrawText( wxString::Format( "%6d  %s", pSearch->pHits[i].Location.fileOffset, pSearch->pHits[i].pText->szBuf ), x, y );
+  }
+  DC.DestroyClippingRegion();
+  DC.SetPen( Pen );
+  DC.SetBrush( Brush );
+}
+// intent handler for search SHI_CHANGE_SEL
+// moves the selection by one, scrolling the rows to keep it visible, and refreshes this pop-up's frame
+void search_change_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  SModeSearch *pSearch = pBase->sExt.pSearch;
+  if( phase == PH_NOTIFY ) {
+    if( pBase->key == WXK_UP && pSearch->curSel > 0 )
+      pSearch->curSel--;
+    else if( pBase->key == WXK_DOWN && pSearch->curSel < pSearch->numHits - 1 )
+      pSearch->curSel++;
+    if( pSearch->curSel < pSearch->firstRow )
+      pSearch->firstRow = pSearch->curSel;
+    else if( pSearch->curSel >= pSearch->firstRow + SEARCH_ROWS )
+      pSearch->firstRow = pSearch->curSel - SEARCH_ROWS + 1;
+    pWin->m_bUsrActn = false;
+    pWin->RefreshRect( pSearch->Rect, true );
+  }
+}
+// intent handler for search SHI_GOTO
+// pops this mode and goes to the selected line in the src editor (see src_edr_goto_location())
+// which expands the sections it is in
+void search_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  SModeSearch *pSearch = pBase->sExt.pSearch;
+  SModeSrcEdr *pSrcEdr = pSearch->pEditor->sExt.pSrcEdr;
+  if( phase == PH_NOTIFY && pSearch->curSel < pSearch->numHits && pSrcEdr->pCodeBase == pSearch->pCodeBase ) {
+    SLocation *pLocation = &(pSearch->pHits[pSearch->curSel].Location);
+    if( pLocation->fileOffset < ce_length( pSrcEdr->pCodeBase->pBaseSec->pBaseElem ) ) {
+      src_edr_end_scan( pWin );
+      pWin->m_pModeManager->pop();
+      src_edr_goto_location( pSrcEdr, pLocation->fileOffset, pWin->m_pModeManager->pJournal );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
     }
   }
-  // load from
-  else {
-    SCodeElement* pElem = load_code_element(File, NULL, 0);
-    pSrcEdr->pCodeBase = pElem->pSec->pCodeBase;
-    File.Read( &(pSrcEdr->fileOffset), sizeof(int) );
-    File.Read( &(pSrcEdr->Caret.x), sizeof(int) );
-    File.Read( &(pSrcEdr->Caret.y), sizeof(int) );
-    File.Read( &(pSrcEdr->CaretPrev.x), sizeof(int) );
-    File.Read( &(pSrcEdr->CaretPrev.y), sizeof(int) );
-    File.Read( &(pSrcEdr->selStartX), sizeof(int) );
-    File.Read( &(pSrcEdr->selEndX), sizeof(int) );
-    File.Read( &(pSrcEdr->selStartY), sizeof(int) );
-    File.Read( &(pSrcEdr->selEndY), sizeof(int) );
-    File.Read( &(pSrcEdr->bSelectingX), sizeof(bool) );
-    File.Read( &(pSrcEdr->bSelectingY), sizeof(bool) );
-    File.Read( &(pSrcEdr->bCutBufLoaded), sizeof(bool) );
-    pSrcEdr->pNavTrail->serialize(File, bToFrom);
-  }
-  return( bRetVal );
 }
 // SUBBLOCK: INTENT HANDLERS
 
@@ -8015,7 +14218,9 @@ void src_edr_update_caret( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC
       rect.x = pSrcEdr->colMidStart + pSrcEdr->counterWidth + 10 + caretLocPrev;
       rect.y = pSrcEdr->CaretPrev.y * pSrcEdr->lineHeight;
       pWin->Refresh( true, &rect );
-      pWin->Update();
+      // a coalesced batch is painted once by the mode manager
+      if( !pWin->m_bCoalescing )
+        pWin->Update();
     }
   }
   // called by the OS to paint
@@ -8051,17 +14256,12 @@ void src_edr_summarize( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   // refresh the window
   if( phase == PH_NOTIFY ) {
     SModeSrcEdr * pSrcEdr = pBase->sExt.pSrcEdr;
-    int lineOffset;
-    SCodeElement * pElem;
-    pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
-    // if it's not the starting element, collapse  the element
-    if( pElem->bSingle ) {
-      // if starting element of its container summarize the container
-      if( pElem->indexContainer == 0 )
-        pElem->pContainer->bSummarized = true;
-    }
-    else
-      pElem->pSec->bSummarized = false;
+    SJournal *pJournal = pWin->m_pModeManager->pJournal;
+    src_edr_do_summarize( pSrcEdr, pSrcEdr->fileOffset, pSrcEdr->Caret.y );
+    SBufFile &Record = pJournal->begin_record( HXC_JNL_SUMMARIZE );
+    Record.Write( &(pSrcEdr->fileOffset), sizeof(int) );
+    Record.Write( &(pSrcEdr->Caret.y), sizeof(int) );
+    pJournal->end_record();
 
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
@@ -8340,6 +14540,16 @@ SLocation* get_requested_element(SCodeElement *pElem, int caretX, SSymbolSet *pS
   pWord = NULL;    
   return(pRetVal);
 }
+// goes to the symbol under the caret in pElem, the line at Caret.y (see get_requested_element())
+// returns the symbol's location, it's gone to only if it has a pCodeBaseLoc
+// returns NULL if there's no symbol under the caret
+SLocation* src_edr_goto_symbol( SModeSrcEdr *pSrcEdr, SCodeElement *pElem, SJournal *pJournal ) {
+  SLocation* pLocation = get_requested_element(pElem, pSrcEdr->Caret.x, pSrcEdr->pCodeBase->pSymSet);
+  if (pLocation != NULL && pLocation->pCodeBaseLoc != NULL)
+    // collapse current, expand the goto element and journal the goto
+    src_edr_goto_location(pSrcEdr, pLocation->fileOffset, pJournal);
+  return( pLocation );
+}
 // intent handler for GOTO
 // user wants to goto a hyperlink on a comment line
 // or to a symbol on a codeline using Ctrl-RArrow
@@ -8348,6 +14558,7 @@ void src_edr_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   // process goto or backto
   if( phase == PH_NOTIFY ) {
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    SJournal *pJournal = pWin->m_pModeManager->pJournal;
     // it's a goto
     // check the line at Caret.y
     // for an http
@@ -8375,59 +14586,10 @@ void src_edr_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
       else {
         tl_free(pLine);
         pLine = NULL;
-        SLocation* pLocation = NULL;
-        pLocation = get_requested_element(pElem, pSrcEdr->Caret.x, pSrcEdr->pCodeBase->pSymSet);
-        // if a symbol was found, set fileoffset, collapse current, expand goto and refresh
+        // if a symbol was found it's gone to, refresh
+        SLocation* pLocation = src_edr_goto_symbol(pSrcEdr, pElem, pJournal);
         if (pLocation != NULL) {
           if (pLocation->pCodeBaseLoc != NULL) {
-            int fileOffset = 0;
-            fileOffset = pLocation->fileOffset;
-            int lineOffset = 0;
-            SCodeElement* pElem = NULL;
-            // get current element (at caret.y) and collapse it
-            pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset);
-            // add the current location to the nav trail
-            SLocation* pCurLoc = new_location(pElem, pSrcEdr->fileOffset + lineOffset);
-            pSrcEdr->pNavTrail->add_step(pCurLoc, pSrcEdr->Caret.y);
-            pElem = ce_collapse(pElem);
-            lineOffset = -1; // just to make it !=0
-            // get the elem at fileOffset, if it's summarized, unsummarize it, repeat
-            // until you get an unsummarized element
-            while (lineOffset != 0) {
-              pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &lineOffset);
-              if (!pElem->bSingle && lineOffset != 0)
-                pElem->pSec->bSummarized = false;
-            }
-            if (!pElem->bSingle)
-              pElem->pSec->bSummarized = false;
-
-            // expand the goto element
-            ce_expand(pElem);
-            // get the element again in it's expanded state
-            pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, 0, &lineOffset);
-            // place the element at the center by walking back dispLines/2 steps;
-            pSrcEdr->pCodeBase->pBaseSec->get_element_at(fileOffset, -pSrcEdr->dispLines / 2, &lineOffset);
-            pSrcEdr->fileOffset = fileOffset + lineOffset;
-            pSrcEdr->Caret.x = 0;
-
-            // in some cases, the element may not be at the center and under the caret
-            // account for such cases
-            SCodeElement* pElemTemp = NULL;
-            pElemTemp = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->dispLines / 2, &lineOffset);
-            if (tl_equals(pElemTemp->pLine, pElem->pLine))
-              pSrcEdr->Caret.y = pSrcEdr->dispLines / 2;
-            // find the location of pElem and set Caret.y
-            else {
-              bool bFound = false;
-              for (int i = 0; i <= pSrcEdr->dispLines / 2 && !bFound; i++) {
-                pElemTemp = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, i, &lineOffset);
-                if (tl_equals(pElemTemp->pLine, pElem->pLine)) {
-                  bFound = true;
-                  pSrcEdr->Caret.y = i;
-                }
-              }
-              wxASSERT(bFound);
-            }
             pWin->m_bUsrActn = false;
             pWin->Refresh(true);
           }
@@ -8448,32 +14610,18 @@ void src_edr_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
               // if it's a valid fileOffset number, collapse current, expand goto number refresh
               if (lVal >= 0 && lVal < ce_length(pSrcEdr->pCodeBase->pBaseSec->pBaseElem) - 1) {
                 int lineOffset = 0;
-                SCodeElement* pElem;
-                // get current element (at caret.y) and collapse it
-                pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset);
-                // add the current location to the nav trail
-                SLocation* pCurLoc = new_location(pElem, pSrcEdr->fileOffset + lineOffset);
-                pSrcEdr->pNavTrail->add_step(pCurLoc, pSrcEdr->Caret.y);
-                pElem = ce_collapse(pElem);
-                lineOffset = -1; // just to make it !=0
-                // get the elem at lLval, if it's summarized, unsummarize it, repeat
-                // until you get an unsummarized element
-                while (lineOffset != 0) {
-                  pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at((int)lVal, 0, &lineOffset);
-                  if (!pElem->bSingle && lineOffset != 0)
-                    pElem->pSec->bSummarized = false;
-                }
-                if (!pElem->bSingle)
-                  pElem->pSec->bSummarized = false;
-
-                // expand the goto element
-                ce_expand(pElem);
+                int fileOffset = (int)lVal;
+                // collapse current, expand the goto element and journal the goto
+                src_edr_do_goto(pSrcEdr, fileOffset);
+                pJournal->begin_record(HXC_JNL_GOTO).Write(&fileOffset, sizeof(int));
+                pJournal->end_record();
                 // place the element at the center by walking back dispLines/2 steps;
-                pSrcEdr->fileOffset = (int)lVal + lineOffset;
-                pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, -pSrcEdr->dispLines / 2, &lineOffset);
+                pSrcEdr->fileOffset = fileOffset;
+                pSrcEdr->pCodeBase->pBaseSec->get_element_at(pSrcEdr->fileOffset, -pSrcEdr->dispLines / 2, &lineOffset);
                 pSrcEdr->fileOffset += lineOffset;
                 pSrcEdr->Caret.y = pSrcEdr->dispLines / 2;
                 pSrcEdr->pLineInp->sExt.pLineInput->bInputRcvd = false;
+                src_edr_journal_view(pSrcEdr, pJournal);
               }
               // check if it's a some other valid goto input
               else {
@@ -8498,27 +14646,11 @@ void src_edr_goto( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
       // set fileOffset and caretY for the back to location
       // reset the backTo location
       // refresh
-      int caretLoc = -1; 
-      SLocation *pBackToLoc = pSrcEdr->pNavTrail->remove_step( &caretLoc ); 
-      if( pBackToLoc != NULL ) {
-        SCodeElement *pElem = NULL;
-        int lineOffset = 0;
-        // collapse the current location
-        pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
-        pElem = ce_collapse( pElem );
-        lineOffset = -1;
-        // expand the backTo location
-        while( lineOffset != 0 ) {
-          pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pBackToLoc->fileOffset, 0, &lineOffset );
-          if( lineOffset != 0 )
-            pElem->pSec->bSummarized = false;
-        }
-        // set fileOffset and caretY for the back to location
-        pSrcEdr->pCodeBase->pBaseSec->get_element_at( pBackToLoc->fileOffset, -caretLoc, &lineOffset );
-        pSrcEdr->fileOffset = pBackToLoc->fileOffset + lineOffset;
-        pSrcEdr->Caret.y = caretLoc;
-        free_location( pBackToLoc );
-        pBackToLoc = NULL;
+      // journal the back to
+      if( src_edr_do_back_to( pSrcEdr ) ) {
+        pJournal->begin_record( HXC_JNL_BACK );
+        pJournal->end_record();
+        src_edr_journal_view( pSrcEdr, pJournal );
         // refresh
         pWin->m_bUsrActn = false;
         pWin->Refresh( true );
@@ -8608,45 +14740,62 @@ void src_edr_edit_char( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
     // if it's an alphanumberic, add the char to the current line
     // determine update rect based on mods made and generate a refresh
     if( bEditable ) {
+      // the op is on the line at the caret, the caret is kept within it
+      // the line may be being typed into, it's read as it is in the gap line
+      int fileOffset = pSrcEdr->fileOffset + chunkSize;
+      int length = pElem->bSingle ? pSrcEdr->pCodeBase->get_line_length( pElem ) : pElem->pLine->length;
+      if( pSrcEdr->Caret.x > length )
+        pSrcEdr->Caret.x = length;
       // delete the character before the caret location
       // if at the beginning of line cut the line and merge with previous line if possible
       if( pBase->key == WXK_BACK ) {
         // delete the character before the caret location          
         if( pSrcEdr->Caret.x > 0 ) {
-          // create a charedit delete operation
-          op_edit_char_init( Op, pSrcEdr->fileOffset, pSrcEdr->Caret.y, pBase->uniKey, pBase->key, pSrcEdr->Caret.x-1, false );
-          // add the operation to the codebase's oplist for a possible undo later,
-          pSrcEdr->pCodeBase->OpList.add( Op );
-          // execute the operation
-          pSrcEdr->pCodeBase->do_edit();
+          // create a charedit delete operation of the char deleted, so it can be undone
+          op_edit_char_init( Op, fileOffset, pSrcEdr->Caret.y, pSrcEdr->pCodeBase->get_line_char( pElem, pSrcEdr->Caret.x-1 ), pSrcEdr->Caret.x-1, false );
+          // execute the operation and add it to the codebase's oplist for a possible undo later
           // update the caret
-          pSrcEdr->Caret.x -= 1;
+          if( src_edr_add_op( pSrcEdr, Op, pWin ) )
+            pSrcEdr->Caret.x -= 1;
         }
-        // cut the line and merge with previous line if possible
-        else {
+        // join the line with the previous line, if it's the line of the same section in view above it
+        else if( pSrcEdr->Caret.y > 0 && pElem->bSingle ) {
+          int prevSize = 0;
+          SCodeElement *pPrev = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y - 1, &prevSize );
+          if( pPrev->bSingle && pPrev->pContainer == pElem->pContainer && pPrev->indexContainer + 1 == pElem->indexContainer ) {
+            int index = pSrcEdr->pCodeBase->get_line_length( pPrev );
+            op_split_line_init( Op, pSrcEdr->fileOffset + prevSize, pSrcEdr->Caret.y - 1, index, pElem->type, false );
+            if( src_edr_add_op( pSrcEdr, Op, pWin ) ) {
+              pSrcEdr->Caret.y -= 1;
+              pSrcEdr->Caret.x = index;
+              pWin->m_bUsrActn = false;
+              pWin->Refresh( true );
+            }
+          }
         }
       }
-      // create a new line with the line segment after current caret location
-      else if( pBase->key == WXK_RETURN ) {
-        // create a charedit insert operation
-        op_edit_char_init( Op, pSrcEdr->fileOffset, pSrcEdr->Caret.y, pBase->uniKey, pBase->key, pSrcEdr->Caret.x, true);
-        // add the operation to the codebase's oplist,
-        pSrcEdr->pCodeBase->OpList.add( Op );
-        // create a new line with the line segment after current caret location
-        pSrcEdr->Caret.y += 1;
-        pSrcEdr->Caret.x = 0;
-        pWin->m_bUsrActn = false;
-        pWin->Refresh( true );
+      // split the line at the caret location, the chars after it go to a new line below it
+      else if( pBase->key == WXK_RETURN && pElem->bSingle ) {
+        op_split_line_init( Op, fileOffset, pSrcEdr->Caret.y, pSrcEdr->Caret.x, CDE_S_CODELINE, true );
+        if( src_edr_add_op( pSrcEdr, Op, pWin ) ) {
+          pSrcEdr->Caret.y += 1;
+          pSrcEdr->Caret.x = 0;
+          pWin->m_bUsrActn = false;
+          pWin->Refresh( true );
+        }
       }
       // insert the entered char at the caret location
-      else {
+      // keys that are not chars insert nothing
+      else if( pBase->uniKey >= 32 && pBase->uniKey < 127 ) {
         // create a charedit insert operation
-        op_edit_char_init( Op, pSrcEdr->fileOffset, pSrcEdr->Caret.y, pBase->uniKey, pBase->key, pSrcEdr->Caret.x, true);
-        // add the operation to the codebase's oplist,
-        pSrcEdr->pCodeBase->OpList.add( Op );
+        op_edit_char_init( Op, fileOffset, pSrcEdr->Caret.y, to_upper( (char) pBase->uniKey, pBase->bShiftDown ), pSrcEdr->Caret.x, true );
+        // execute the operation and add it to the codebase's oplist,
         // insert the entered char at the caret location
-        pSrcEdr->Caret.x += 1;
+        if( src_edr_add_op( pSrcEdr, Op, pWin ) )
+          pSrcEdr->Caret.x += 1;
       }
+      // the view is journaled once for the keys typed till the next commit
+      src_edr_journal_view( pSrcEdr, pWin->m_pModeManager->pJournal, true );
       // determine startLine and number of refresh line for the refresh
       if( pSrcEdr->Caret.y == pSrcEdr->CaretPrev.y ) {
         refreshLines = 1;
@@ -8673,7 +14822,9 @@ void src_edr_edit_char( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
   // paints the areas to be updated
   else { // PH_EXEC
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    // the line typed into is drawn from GapLine, it's stored only when the caret leaves it
     pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &chunkSize );
+    STxtLine *pLine = pSrcEdr->pCodeBase->clone_line( pElem );
     // draw the update line/s
     wxBrush Brush( wxColour( 208,208,200 ) );
     wxPen Pen = DC.GetPen();
@@ -8687,76 +14838,323 @@ void src_edr_edit_char( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
     DC.DrawRectangle( rect );
     DC.SetPen( Pen );
     if( pElem->type != CDE_S_BLANK )
-      DC.DrawText( wxString( pElem->pLine->szBuf ), rect.x, pSrcEdr->Caret.y * pSrcEdr->lineHeight );
+      DC.DrawText( wxString( pLine->szBuf ), rect.x, pSrcEdr->Caret.y * pSrcEdr->lineHeight );
 
     // redraw the previous line if a new line has been created
     if( pSrcEdr->Caret.y != pSrcEdr->CaretPrev.y ) {
       SCodeElement *pElemPrev = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->CaretPrev.y, &chunkSize );
       if( pElemPrev->type != CDE_S_BLANK ) {
-      DC.DrawText( wxString( pElemPrev->pLine->szBuf ), rect.x, pSrcEdr->CaretPrev.y * pSrcEdr->lineHeight );
+      STxtLine *pLinePrev = pSrcEdr->pCodeBase->clone_line( pElemPrev );
+      DC.DrawText( wxString( pLinePrev->szBuf ), rect.x, pSrcEdr->CaretPrev.y * pSrcEdr->lineHeight );
+      tl_free( pLinePrev );
       }
     }
     // draw the caret
-    int caretLoc = pSrcEdr->colMidStart+tl_caret_loc( pElem->pLine, pSrcEdr->Caret.x, DC, pWin );
+    int caretLoc = pSrcEdr->colMidStart+tl_caret_loc( pLine, pSrcEdr->Caret.x, DC, pWin );
+    tl_free( pLine );
     DC.DrawLine( caretLoc, (pSrcEdr->Caret.y)*pSrcEdr->lineHeight, caretLoc, (pSrcEdr->Caret.y + 1)*pSrcEdr->lineHeight );
   }
 }
 // intent handler for START_SEL
 // user want to start a selection
 // by inputting Shift-Arrow key
+// Shift-Up/Down selects lines from the caret line, Shift-Left/Right chars of the caret line
 void src_edr_start_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-
+  if( phase == PH_NOTIFY ) {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    int lineOffset = 0;
+    SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+    if( pBase->key == WXK_UP || pBase->key == WXK_DOWN ) {
+      pSrcEdr->bSelectingY = true;
+      pSrcEdr->selStartY = pSrcEdr->fileOffset + lineOffset;
+      pSrcEdr->selEndY = pSrcEdr->selStartY;
+    }
+    // the chars of a summarized section can't be selected
+    else if( pElem->bSingle ) {
+      if( pSrcEdr->Caret.x > pElem->pLine->length )
+        pSrcEdr->Caret.x = pElem->pLine->length;
+      pSrcEdr->bSelectingX = true;
+      pSrcEdr->selStartX = pSrcEdr->Caret.x;
+      pSrcEdr->selEndX = pSrcEdr->selStartX;
+    }
+    if( pSrcEdr->bSelectingX || pSrcEdr->bSelectingY )
+      src_edr_update_sel( pBase, phase, pWin, DC );
+  }
+  // the caret is painted as it is for the arrow key
+  else
+    src_edr_update_caret( pBase, phase, pWin, DC );
 }
 // intent handler for UPDATE_SEL
 // user is in the process of updating a selection
 // by inputting Shift-Arrow key
+// the caret moves as it does for the arrow key and the selection ends at it
+// a selection of chars stays on its line
+// only the lines the selection has changed on are refreshed
 void src_edr_update_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-
- }
-// intent handler for ERASE_SEL
+  if( phase == PH_NOTIFY ) {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    int lineOffset = 0;
+    int fileOffsetPrev = pSrcEdr->fileOffset;
+    int caretYPrev = pSrcEdr->Caret.y;
+    SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+    bool bMove = pSrcEdr->bSelectingY;
+    bMove |= pBase->key == WXK_LEFT && pSrcEdr->Caret.x > 0;
+    bMove |= pBase->key == WXK_RIGHT && pSrcEdr->Caret.x < pElem->pLine->length;
+    if( bMove )
+      src_edr_update_caret( pBase, phase, pWin, DC );
+    if( pSrcEdr->bSelectingY ) {
+      pSrcEdr->selEndY = src_edr_caret_offset( pSrcEdr );
+      // a scroll refreshes the whole window
+      if( pSrcEdr->fileOffset == fileOffsetPrev ) {
+        if( caretYPrev < pSrcEdr->Caret.y )
+          src_edr_refresh_lines( pSrcEdr, caretYPrev, pSrcEdr->Caret.y, pWin );
+        else
+          src_edr_refresh_lines( pSrcEdr, pSrcEdr->Caret.y, caretYPrev, pWin );
+      }
+    }
+    else {
+      pSrcEdr->selEndX = pSrcEdr->Caret.x;
+      src_edr_refresh_lines( pSrcEdr, pSrcEdr->Caret.y, pSrcEdr->Caret.y, pWin );
+    }
+  }
+  // the caret is painted as it is for the arrow key
+  else
+    src_edr_update_caret( pBase, phase, pWin, DC );
+}
+// intent handler for UN_SEL
 // users wants to unselect the current selection
-// by pressing the Backspace key
+// by pressing the Backspace key, or any key but Shift-Arrow or Ctrl-X, which then does what it does
 void src_edr_un_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-
-}
-// intent handler for CUT_SEL
-// user want to cut the current selection by Ctrl-C or Ctrl-X
-void src_edr_cut_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-  // create an edit operation for a cut selection
-  // from the current selection
-  // and execute it on the codebase
-  // update the caret location
-  // refresh the window
   if( phase == PH_NOTIFY ) {
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    // a selection of lines may be on any line of the view
+    if( pSrcEdr->bSelectingY )
+      src_edr_refresh_lines( pSrcEdr, 0, pSrcEdr->dispLines - 1, pWin );
+    else
+      src_edr_refresh_lines( pSrcEdr, pSrcEdr->Caret.y, pSrcEdr->Caret.y, pWin );
+    pSrcEdr->bSelectingX = false;
+    pSrcEdr->bSelectingY = false;
+    pSrcEdr->selStartX = -1;
+    pSrcEdr->selEndX = -1;
+    pSrcEdr->selStartY = -1;
+    pSrcEdr->selEndY = -1;
+  }
+}
+// ancillary used by src_edr_cutpaste_sel
+// cuts the elements of the selection of lines, they are taken out of the code tree by the cut op
+// where its ends are in different sections, the sections they are in are cut whole
+// and so is a section the selection starts at the first line of
+// returns a message for the user if they could not be cut, NULL if they were
+char *src_edr_cut_lines( SModeSrcEdr *pSrcEdr, ModalWindow *pWin ) {
+  char *szRetVal = NULL;
+  int lo, hi, lineOffset;
+  src_edr_sel_range( pSrcEdr, &lo, &hi );
+  SCodeElement *pFirst = pSrcEdr->pCodeBase->pBaseSec->get_element_at( lo, 0, &lineOffset );
+  SCodeElement *pLast = pSrcEdr->pCodeBase->pBaseSec->get_element_at( hi, 0, &lineOffset );
+  // lift the ends to the sections they are in till they are in the same one
+  int depthFirst = section_depth( pFirst->pContainer );
+  int depthLast = section_depth( pLast->pContainer );
+  for( ; depthFirst > depthLast; depthFirst-- )
+    pFirst = pFirst->pContainer->pBaseElem;
+  for( ; depthLast > depthFirst; depthLast-- )
+    pLast = pLast->pContainer->pBaseElem;
+  while( pFirst->pContainer != pLast->pContainer ) {
+    pFirst = pFirst->pContainer->pBaseElem;
+    pLast = pLast->pContainer->pBaseElem;
+  }
+  while( pFirst->indexContainer == 0 && pFirst->pContainer->pBaseElem->type != CDE_CODEBASE ) {
+    pFirst = pFirst->pContainer->pBaseElem;
+    pLast = pFirst;
+  }
+  SCodeSection *pSec = pFirst->pContainer;
+  int numElems = pLast->indexContainer - pFirst->indexContainer + 1;
+  if( numElems == pSec->numElements )
+    szRetVal = (char*)"all of the file can't be cut";
+  else {
+    SOperation Op;
+    lo = ce_file_offset( pFirst );
+    op_cutpaste_sel_init( Op, lo, pSrcEdr->Caret.y, pSrcEdr->selStartY, pSrcEdr->selEndY, pSec, pFirst->indexContainer, numElems, NULL, true );
+    if( src_edr_add_op( pSrcEdr, Op, pWin ) )
+      src_edr_caret_on( pSrcEdr, lo );
+    else
+      szRetVal = (char*)"the lines could not be cut";
+  }
+  return( szRetVal );
+}
+// ancillary used by src_edr_cutpaste_sel
+// pastes the lines last cut before the caret line, the cut becomes a move of its elements there
+// before a section if the caret is on its first line
+// returns a message for the user if they could not be pasted, NULL if they were
+char *src_edr_paste_lines( SModeSrcEdr *pSrcEdr, ModalWindow *pWin ) {
+  char *szRetVal = NULL;
+  int lineOffset = 0;
+  SJournal *pJournal = pWin->m_pModeManager->pJournal;
+  SOperation *pCut = pSrcEdr->pCodeBase->OpList.get_held_cut();
+  SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+  while( pElem->indexContainer == 0 && pElem->pContainer->pBaseElem->type != CDE_CODEBASE )
+    pElem = pElem->pContainer->pBaseElem;
+  int fileOffset = ce_file_offset( pElem );
+  int toSecOffset = pElem->pContainer->get_file_offset();
+  int toDepth = section_depth( pElem->pContainer );
+  SOpCutPasteSel *pSel = &(pCut->OpExt.CutPasteSel);
+  // the lines go back only into a section like the one they were cut from
+  if( !pSrcEdr->pCodeBase->sel_fits( pSel, toSecOffset, toDepth ) )
+    szRetVal = (char*)"the lines cut can't be pasted in this section";
+  else {
+    op_cutpaste_sel_move( *pCut, toSecOffset, toDepth, pElem->indexContainer );
+    // journaled before it's done, as an edit op is
+    SBufFile &Record = pJournal->begin_record( HXC_JNL_MOVE );
+    Record.Write( &(pSel->toSecOffset), sizeof(int) );
+    Record.Write( &(pSel->toDepth), sizeof(int) );
+    Record.Write( &(pSel->toAt), sizeof(int) );
+    pJournal->end_record();
+    if( src_edr_move_cut( pSrcEdr, pCut ) )
+      src_edr_caret_on( pSrcEdr, fileOffset );
+    else
+      szRetVal = (char*)"the lines could not be pasted";
+  }
+  return( szRetVal );
+}
+// ancillary used by src_edr_cutpaste_sel
+// cuts the chars of the selection of chars into the cut buffer
+// they are deleted by edit char ops of at most OP_RUN_LENGTH chars each
+// returns a message for the user if they could not be cut, NULL if they were
+char *src_edr_cut_chars( SModeSrcEdr *pSrcEdr, ModalWindow *pWin ) {
+  char *szRetVal = NULL;
+  int lo, hi, lineOffset = 0;
+  src_edr_sel_range( pSrcEdr, &lo, &hi );
+  SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+  if( hi <= lo || !pElem->bSingle || hi > pElem->pLine->length )
+    szRetVal = (char*)"there are no chars selected to cut";
+  else {
+    SOperation Op;
+    STxtLine *pCut = pSrcEdr->pCutLine;
+    bool bCut = true;
+    pCut->length = 0;
+    for( int i=lo; i<hi; i++ )
+      tl_insert_char( pCut, pElem->pLine->szBuf[i], pCut->length );
+    pSrcEdr->bCutBufLoaded = true;
+    for( int done=0; done<pCut->length && bCut; done+=OP_RUN_LENGTH ) {
+      int length = ( pCut->length - done < OP_RUN_LENGTH ) ? pCut->length - done : OP_RUN_LENGTH;
+      op_edit_run_init( Op, pSrcEdr->fileOffset + lineOffset, pSrcEdr->Caret.y, pCut->szBuf + done, length, lo, false );
+      bCut = src_edr_add_op( pSrcEdr, Op, pWin );
+    }
+    pSrcEdr->Caret.x = lo;
+    if( !bCut )
+      szRetVal = (char*)"the chars could not be cut";
+  }
+  return( szRetVal );
+}
+// ancillary used by src_edr_cutpaste_sel
+// pastes the chars of the cut buffer at the caret, by edit char ops as if they were typed
+// returns a message for the user if they could not be pasted, NULL if they were
+char *src_edr_paste_chars( SModeSrcEdr *pSrcEdr, ModalWindow *pWin ) {
+  char *szRetVal = NULL;
+  int lineOffset = 0;
+  SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+  if( !pElem->bSingle )
+    szRetVal = (char*)"chars can't be pasted into a summarized section";
+  else {
+    SOperation Op;
+    STxtLine *pCut = pSrcEdr->pCutLine;
+    bool bPasted = true;
+    if( pSrcEdr->Caret.x > pElem->pLine->length )
+      pSrcEdr->Caret.x = pElem->pLine->length;
+    for( int done=0; done<pCut->length && bPasted; done+=OP_RUN_LENGTH ) {
+      int length = ( pCut->length - done < OP_RUN_LENGTH ) ? pCut->length - done : OP_RUN_LENGTH;
+      op_edit_run_init( Op, pSrcEdr->fileOffset + lineOffset, pSrcEdr->Caret.y, pCut->szBuf + done, length, pSrcEdr->Caret.x, true );
+      bPasted = src_edr_add_op( pSrcEdr, Op, pWin );
+      if( bPasted )
+        pSrcEdr->Caret.x += length;
+    }
+    if( !bPasted )
+      szRetVal = (char*)"the chars could not be pasted";
+  }
+  return( szRetVal );
+}
+// intent handler for CUT_SEL and PASTE_SEL
+// user want to cut the current selection by Ctrl-X or paste what was last cut by Ctrl-V
+// lines are moved by reference, a cut takes their elements out of the code tree
+// and a paste right after it puts them back before the caret line (see SOpCutPasteSel)
+// chars go through the cut buffer
+void src_edr_cutpaste_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY ) {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    char *szMsg = NULL;
     pSrcEdr->CaretPrev = pSrcEdr->Caret;
-
-//    SOperation Op;
-//    STxtPage CutPage;
-
-    //   op_cutpaste_sel_init( Op, pSrcEdr->fileOffset, pSrcEdr->Caret.y, pSrcEdr->selStart, pSrcEdr->selEnd, CutPage, true );
-    //   oplist_add( pSrcEdr->pCodeBase->OpList, Op );
-
-    // add the operation to the codebase's oplist,
-    // do the edit on the codebase
-
-
+    if( pBase->intent == SEI_CUT_SEL ) {
+      if( pSrcEdr->bSelectingY )
+        szMsg = src_edr_cut_lines( pSrcEdr, pWin );
+      else if( pSrcEdr->bSelectingX )
+        szMsg = src_edr_cut_chars( pSrcEdr, pWin );
+      else
+        szMsg = (char*)"there is nothing selected to cut";
+      // the selection is kept if it could not be cut
+      if( szMsg == NULL ) {
+        pSrcEdr->bSelectingX = false;
+        pSrcEdr->bSelectingY = false;
+      }
+    }
+    // the lines last cut are pasted if nothing has been done since
+    else if( pSrcEdr->pCodeBase->OpList.get_held_cut() != NULL )
+      szMsg = src_edr_paste_lines( pSrcEdr, pWin );
+    else if( pSrcEdr->bCutBufLoaded )
+      szMsg = src_edr_paste_chars( pSrcEdr, pWin );
+    else
+      szMsg = (char*)"there is nothing cut to paste";
+    src_edr_journal_view( pSrcEdr, pWin->m_pModeManager->pJournal );
+    if( szMsg != NULL ) {
+      pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
+      pWin->m_pModeManager->push( pSrcEdr->pMsg );
+    }
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
   }
-  else
-    wxLogError("PH_EXEC in src_edr_del_sel");
-
-}
-// intent handler for PASTE_SEL
-// user want to paste the current slection by Ctrl-V
-void src_edr_cutpaste_sel( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-
 }
-// intent handler for UNDO
-// user wants to undo the last edit using Ctrl-Z
+// intent handler for UNDO and REDO
+// user wants to undo the last edit using Ctrl-Z or redo the last one undone using Ctrl-Y
+// a run of typing is undone at once (see SOpList)
+// the caret goes to where the edit was, the view moves only if it's not on screen
 void src_edr_undoredo( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-
+  if( phase == PH_NOTIFY ) {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    SJournal *pJournal = pWin->m_pModeManager->pJournal;
+    bool bRedo = pBase->intent == SEI_REDO;
+    SOperation *pOp = NULL;
+    if( bRedo && pSrcEdr->pCodeBase->OpList.topOps > pSrcEdr->pCodeBase->OpList.numOps )
+      pOp = &(pSrcEdr->pCodeBase->OpList.pOps[pSrcEdr->pCodeBase->OpList.numOps]);
+    else if( !bRedo && pSrcEdr->pCodeBase->OpList.numOps > 0 )
+      pOp = &(pSrcEdr->pCodeBase->OpList.pOps[pSrcEdr->pCodeBase->OpList.numOps - 1]);
+    if( pOp != NULL && (pOp->type == OP_EDIT_CHAR || pOp->type == OP_SPLIT_LINE) ) {
+      // bring the line of the op into view, expanding its section if summarized
+      int lineOffset = 0;
+      SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pOp->fileOffset, 0, &lineOffset );
+      if( lineOffset != 0 || !pElem->bSingle )
+        src_edr_goto_location( pSrcEdr, pOp->fileOffset, pJournal );
+      else {
+        pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pOp->caretY, &lineOffset );
+        if( pSrcEdr->fileOffset + lineOffset == pOp->fileOffset && pOp->caretY < pSrcEdr->dispLines )
+          pSrcEdr->Caret.y = pOp->caretY;
+        else
+          src_edr_center_on( pSrcEdr, pOp->fileOffset );
+      }
+      src_edr_undo_op( pSrcEdr, bRedo, pJournal );
+      // the caret goes after what was typed or before what was deleted
+      // or where the line was split or joined
+      SOpEditChar *pRun = &(pOp->OpExt.EditChar);
+      if( pOp->type == OP_SPLIT_LINE )
+        pSrcEdr->Caret.x = pOp->OpExt.SplitLine.index;
+      else
+        pSrcEdr->Caret.x = ( pRun->bInsDel == bRedo ) ? pRun->index + pRun->length : pRun->index;
+    }
+    else if( pOp != NULL )
+      src_edr_undo_op( pSrcEdr, bRedo, pJournal );
+    if( pOp != NULL ) {
+      src_edr_journal_view( pSrcEdr, pJournal );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
+    }
+  }
 }
 // intent handler for CONTROL
 // user wants to do something with the file being edited
@@ -8770,20 +15168,152 @@ void src_edr_control( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
     pWin->m_bUsrActn = false;
   }
 }
+// the initial size of the buffer the source is exported into, it grows as needed
+#define EXPORT_BUF_SIZE (1<<20)
+// writes the exported source to strPath.tmp which then replaces strPath
+// so a failed export never leaves a torn source file behind
+// touches nothing but files so it is called from an ExportThread
+// returns false if the source could not be written, strPath is then left as it was
+bool save_source( STxtBuf *pSource, wxString strPath ) {
+  wxString strTmpPath = strPath + ".tmp";
+  wxFile File;
+  bool bRetVal = File.Create( strTmpPath, true );
+  bRetVal = bRetVal && File.Write( pSource->pData, pSource->length ) == (size_t) pSource->length;
+  if( File.IsOpened() )
+    bRetVal = File.Close() && bRetVal;
+  bRetVal = bRetVal && wxRenameFile( strTmpPath, strPath, true );
+  if( !bRetVal )
+    wxRemoveFile( strTmpPath );
+  return( bRetVal );
+}
+// A worker thread that writes the exported source of a codebase to its source file
+// the thread owns the source and frees it, it touches no other app state
+// it sends its window an ID_EXPORT_DONE event when it's done
+// the window then calls src_edr_export_done(), which starts a build if bBuild
+class ExportThread : public wxThread {
+public:
+  ExportThread( SMode *pMode, STxtBuf *pSource, ModalWindow *pWin, bool bBuild ) : wxThread( wxTHREAD_JOINABLE ) {
+    SCodeBase *pCodeBase = pMode->sExt.pSrcEdr->pCodeBase;
+    m_pMode = pMode;
+    m_pSource = pSource;
+    m_pWin = pWin;
+    m_pCodeBase = pCodeBase;
+    m_strPath = wxString( pCodeBase->pSrcPath->szBuf );
+    m_numEdits = pCodeBase->OpList.numEdits;
+    m_hash = 0;
+    m_buildHash = FNV64_BASIS;
+    m_bSaved = false;
+    m_bBuild = bBuild;
+  };
+  virtual ~ExportThread() {
+    free_txt_buf( m_pSource );
+  };
+  virtual ExitCode Entry() {
+    // the CRC of the source is the CRC of its lines (see tp_crc())
+    m_hash = crc32_buf( m_pSource->pData, m_pSource->length );
+    if( m_bBuild )
+      m_buildHash = fnv64_buf( m_pSource->pData, m_pSource->length );
+    m_bSaved = save_source( m_pSource, m_strPath );
+    wxQueueEvent( m_pWin, new wxThreadEvent( wxEVT_THREAD, ID_EXPORT_DONE ) );
+    return( 0 );
+  };
+  SMode *m_pMode; // the src editor that exported
+  STxtBuf *m_pSource;
+  ModalWindow *m_pWin;
+  SCodeBase *m_pCodeBase; // the codebase exported, its source path and number of edits then
+  wxString m_strPath;
+  int m_numEdits;
+  unsigned int m_hash; // the CRC32 of the source
+  unsigned long long m_buildHash; // the FNV-1a 64 of the source, for the build cache key
+  bool m_bSaved;
+  bool m_bBuild; // the source is exported to be built
+};
+// writes the source of the src editor's codebase into memory and starts an ExportThread on it
+// returns false if the thread could not be started
+bool src_edr_start_export( SMode *pBase, ModalWindow *pWin, bool bBuild ) {
+  bool bRetVal = true;
+  STxtBuf *pSource = new_txt_buf( EXPORT_BUF_SIZE );
+  pBase->sExt.pSrcEdr->pCodeBase->GapLine.store();
+  pBase->sExt.pSrcEdr->pCodeBase->pBaseSec->write_source( pSource );
+  ExportThread *pThread = new ExportThread( pBase, pSource, pWin, bBuild );
+  if( pThread->Create() != wxTHREAD_NO_ERROR || pThread->Run() != wxTHREAD_NO_ERROR ) {
+    delete pThread;
+    bRetVal = false;
+  }
+  else
+    pWin->m_pExportThread = pThread;
+  return( bRetVal );
+}
 // intent handler for EXPORT
-// user wants to export the current codebase to a .cpp file
-// launches a file browser
+// user wants to write the codebase back to its source file
+// the source is written out of the code tree into memory here, so it is consistent,
+// and an ExportThread writes it to disk while the user goes on editing
 void src_edr_export( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-  // pop-up a not yet supported message
   if( phase == PH_NOTIFY )
   {
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
-    pSrcEdr->pMsg->sExt.pMsg->set_msg((char*)".cpp export is under development" );
+    SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+    char *szMsg = NULL;
+    if( pWin->m_pExportThread != NULL )
+      szMsg = (char*)"the source file is still being exported";
+    else if( pCodeBase == NULL || pCodeBase->pSrcPath == NULL )
+      szMsg = (char*)"there is no source file to export to";
+    else if( !src_edr_start_export( pBase, pWin, false ) )
+      szMsg = (char*)"the source file could not be exported";
+    else
+      szMsg = (char*)"exporting the source file...";
+    pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
     pWin->m_pModeManager->push( pSrcEdr->pMsg );
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
   }
 }
+// reaps an ExportThread once it is done
+// the codebase's source is then recorded as the exported file (see SCodeBase::set_source())
+// and if the export was for a build, the compiler is started on it
+// the user is told how the export went, unless pWin is NULL as the app is exiting
+void src_edr_export_done( wxThread *pThread, ModalWindow *pWin ) {
+  ExportThread *pExport = (ExportThread *) pThread;
+  pExport->Wait();
+  SModeSrcEdr *pSrcEdr = pExport->m_pMode->sExt.pSrcEdr;
+  SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+  // edits made while the export ran are not in the file
+  if( pExport->m_bSaved && pCodeBase != NULL && pCodeBase == pExport->m_pCodeBase ) {
+    pCodeBase->set_source( pExport->m_strPath, pExport->m_hash );
+    pCodeBase->srcNumEdits = pExport->m_numEdits;
+  }
+  if( pWin != NULL ) {
+    char *szMsg = NULL;
+    bool bFailed = false;
+    if( !pExport->m_bSaved ) {
+      szMsg = (char*)"the source file could not be exported";
+      bFailed = true;
+      wxLogError( "%s could not be written", pExport->m_strPath );
+    }
+    // a build goes on in the background, its message stays up till it's done
+    else if( pExport->m_bBuild ) {
+      if( pCodeBase != pExport->m_pCodeBase || !src_edr_start_build( pExport->m_pMode, pWin, pExport->m_buildHash ) ) {
+        szMsg = (char*)"the build could not be started";
+        bFailed = true;
+      }
+    }
+    else
+      szMsg = (char*)"the source file has been exported";
+    // the exporting message is updated if it's still up, a failure is always shown
+    if( szMsg != NULL && pWin->m_pModeManager->pCurMode == pSrcEdr->pMsg ) {
+      pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
+    }
+    else if( bFailed ) {
+      pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
+      pWin->m_pModeManager->push( pSrcEdr->pMsg );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
+    }
+  }
+  delete pExport;
+}
 // intent handler for LOAD_NEW
 // user wants to save current codebase and load a new file
 // launches a file browser
@@ -8800,34 +15330,112 @@ void src_edr_load_new( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
 }
 // intent handler for BUILD
 // user wants to build the current codebase
-// launches a compiler and linker
+// exports it and then launches the compiler on the source file, both in the background
+// (see SUBBLOCK: BUILD AND DIAGNOSTICS)
 void src_edr_build( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-  // pop-up a not yet supported message
   if( phase == PH_NOTIFY )
   {
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
-    pSrcEdr->pMsg->sExt.pMsg->set_msg((char*)"building the current codebase is under development" );
+    SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+    char *szMsg = NULL;
+    if( pWin->m_pBuildProcess != NULL )
+      szMsg = (char*)"the last build is still running";
+    else if( pWin->m_pExportThread != NULL )
+      szMsg = (char*)"the source file is still being exported";
+    else if( pCodeBase == NULL || pCodeBase->pSrcPath == NULL )
+      szMsg = (char*)"there is no source file to build";
+    else if( !src_edr_start_export( pBase, pWin, true ) )
+      szMsg = (char*)"the source file could not be exported";
+    else
+      szMsg = (char*)"building the source file...";
+    pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
     pWin->m_pModeManager->push( pSrcEdr->pMsg );
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
   }
-
 }
 // intent handler for DEBUG
-// user wants to debug the codebase
-// build the codebase, if succesful
-// launches a debugger
+// user wants to debug the program built from the codebase
+// starts a debug session on it, or ends the one running
+// (see SUBBLOCK: DEBUGGING)
 void src_edr_debug( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
-  // pop-up a not yet supported message
   if( phase == PH_NOTIFY )
   {
     SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
-    pSrcEdr->pMsg->sExt.pMsg->set_msg( (char *) "debugging the current codebase is under development" );
+    SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+    char *szMsg = NULL;
+    if( pWin->m_pDebugProcess != NULL ) {
+      dbg_send( pWin->m_pDebugProcess, "-gdb-exit" );
+      szMsg = (char*)"ending the debug session...";
+    }
+    else if( pCodeBase == NULL || pCodeBase->pSrcPath == NULL )
+      szMsg = (char*)"there is no source file to debug";
+    else {
+      wxString strTarget = debug_target();
+      if( strTarget.IsEmpty() ) {
+        wxLogMessage( "set MODAL_DEBUG_TARGET to the program built from %s with -g", pCodeBase->pSrcPath->szBuf );
+        szMsg = (char*)"there is no program to debug";
+      }
+      else if( !wxFileName::FileExists( strTarget ) ) {
+        wxLogMessage( "%s (MODAL_DEBUG_TARGET) does not exist, build it with -g", strTarget );
+        szMsg = (char*)"there is no program to debug";
+      }
+      else if( !src_edr_start_debug( pBase, pWin, strTarget ) )
+        szMsg = (char*)"the debugger could not be started";
+      else
+        szMsg = (char*)"debugging, F5 continue, F10 next, F11 step, Shift-F5 stop";
+    }
+    pSrcEdr->pMsg->sExt.pMsg->set_msg( szMsg );
     pWin->m_pModeManager->push( pSrcEdr->pMsg );
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
   }
 }
+// intent handler for BREAKPOINT
+// user wants to set or clear a breakpoint at the caret line using Ctrl-B
+// the breakpoint is inserted in or deleted from the running debug session too
+void src_edr_breakpoint( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY )
+  {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    SCodeBase *pCodeBase = pSrcEdr->pCodeBase;
+    if( pCodeBase != NULL ) {
+      int lineOffset = 0;
+      SCodeElement *pElem = pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, pSrcEdr->Caret.y, &lineOffset );
+      int fileOffset = pSrcEdr->fileOffset + lineOffset;
+      bool bSet = pCodeBase->toggle_break( fileOffset, pElem );
+      if( pWin->m_pDebugProcess != NULL && pSrcEdr->pDebugger->pCodeBase == pCodeBase )
+        dbg_send_break( pSrcEdr->pDebugger, pWin->m_pDebugProcess, fileOffset, bSet );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
+    }
+  }
+}
+// intent handler for DEBUG_STEP
+// user wants to drive the program being debugged
+// F5 continues (or runs it again once it has exited), F10 steps over, F11 steps into
+// Shift-F5 ends the session, F5 without one starts it (see src_edr_debug())
+void src_edr_debug_step( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY )
+  {
+    SDebugger *pDebugger = pBase->sExt.pSrcEdr->pDebugger;
+    wxProcess *pProcess = pWin->m_pDebugProcess;
+    if( pProcess == NULL ) {
+      if( pBase->key == WXK_F5 && !pBase->bShiftDown )
+        src_edr_debug( pBase, phase, pWin, DC );
+    }
+    else if( pBase->key == WXK_F5 && pBase->bShiftDown )
+      dbg_send( pProcess, "-gdb-exit" );
+    else if( pBase->key == WXK_F5 && pDebugger->state == DBS_STOPPED )
+      dbg_send( pProcess, "-exec-continue" );
+    else if( pBase->key == WXK_F5 && pDebugger->state != DBS_RUNNING )
+      dbg_send( pProcess, "-exec-run" );
+    else if( pBase->key == WXK_F10 && pDebugger->state == DBS_STOPPED )
+      dbg_send( pProcess, "-exec-next" );
+    else if( pBase->key == WXK_F11 && pDebugger->state == DBS_STOPPED )
+      dbg_send( pProcess, "-exec-step" );
+  }
+}
 // intent handler for ADJUST_FONTSIZE
 // user wants to adjust the fontsize for their display
 // launches a SModeLevAdj pop-up for font-size adjustments
@@ -8840,9 +15448,13 @@ void src_edr_adjust_fontsize( SMode *pBase, int phase, ModalWindow *pWin, wxDC &
       pBase->bCtrlDown = false; // so this mode is not confused on return
       pSrcEdr->pLevAdj->sExt.pLevAdj->set_caller( pBase, SEI_ADJUST_FONTSIZE, (char*) "arrows to change font size, esc to exit" );
       pWin->m_pModeManager->push( pSrcEdr->pLevAdj );
+      pWin->m_bUsrActn = false;
+      pWin->Refresh( true );
     }
     // callback from the set-sel pop-up with the font-size update data
-    // set fontsize on pBase, reset pSrcEdr, Refresh
+    // set fontsize on pBase and flag a reset of pSrcEdr
+    // the editor is laid out again once, when the pop-up is popped,
+    // the level adjuster refreshes only its own frame per adjustment
     else {
       if( pSrcEdr->pLevAdj->sExt.pLevAdj->bIncDec ) 
        pBase->adjust_font_scale( 1.05 );
@@ -8851,10 +15463,101 @@ void src_edr_adjust_fontsize( SMode *pBase, int phase, ModalWindow *pWin, wxDC &
       pBase->bReset = true;
       pSrcEdr->pLevAdj->sExt.pLevAdj->bInputRcvd = false;
     }
+  }
+}
+// intent handler for LATENCY_STATS
+// user wants to see how long key presses take to reach the screen
+// launches the latency stats pop-up
+void src_edr_latency_stats( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY )
+  {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    pSrcEdr->pLatStats->sExt.pLatStats->firstRow = 0;
+    pWin->m_pModeManager->push( pSrcEdr->pLatStats );
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+}
+// intent handler for DIAGNOSTICS
+// user wants to see the diagnostics of the last build again
+// launches the diagnostics pop-up
+void src_edr_diagnostics( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY )
+  {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    pWin->m_pModeManager->push( pSrcEdr->pDiags );
+    pWin->m_bUsrActn = false;
+    pWin->Refresh( true );
+  }
+}
+// intent handler for SEARCH
+// user wants to find the lines of the codebase with a text in them, or that match a regex
+// pops up the line input for what to search for, then searches for it (see search_query())
+// or starts a scan for it (see src_edr_start_scan()), and launches the search pop-up with the lines found.
+// a search that finds the index dropped starts building it again
+void src_edr_search( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY )
+  {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    SModeLineInp *pLineInput = pSrcEdr->pLineInp->sExt.pLineInput;
+    // pop-up the line input for what to search for
+    // the lines with what's typed in them are highlighted as it's typed
+    if( !pLineInput->bInputRcvd ) {
+      pBase->bCtrlDown = false; // so this mode is not confused on return
+      pLineInput->set_caller( pBase, SEI_SEARCH, (char*)"search? (/ for a regex)" );
+      pLineInput->set_typed( SEI_SEARCH_TYPED );
+      pSrcEdr->pTyped->clear();
+      pWin->m_pModeManager->push( pSrcEdr->pLineInp );
+    }
+    // callback from the line-input pop-up with what to search for
+    else {
+      pLineInput->bInputRcvd = false;
+      if( pSrcEdr->pCodeBase != NULL && pLineInput->pInput->szBuf[0] != 0 ) {
+        SModeSearch *pSearch = pSrcEdr->pSearch->sExt.pSearch;
+        char *szQuery = pLineInput->pInput->szBuf;
+        bool bValid;
+        src_edr_end_scan( pWin );
+        // a regex the index can't narrow down is scanned for in the background
+        if( szQuery[0] == '/' && !search_is_narrowed( pSrcEdr->pCodeBase, szQuery ) )
+          bValid = src_edr_start_scan( pBase, pWin, szQuery );
+        else
+          bValid = search_query( pSearch, pSrcEdr->pCodeBase, szQuery );
+        if( bValid )
+          pWin->m_pModeManager->push( pSrcEdr->pSearch );
+        else {
+          pSrcEdr->pMsg->sExt.pMsg->set_msg( (char*)"the regex is not valid" );
+          pWin->m_pModeManager->push( pSrcEdr->pMsg );
+        }
+        if( !pSrcEdr->pCodeBase->SearchIndex.is_current() )
+          src_edr_start_index( pBase, pWin );
+      }
+    }
     pWin->m_bUsrActn = false;
     pWin->Refresh( true );
   }
 }
+// intent handler for SEARCH_TYPED
+// the search line input has been typed into
+// the typed query is set, the lines for it are found as the src editor is drawn (see typed_search_update()).
+// A scan still running is dropped.
+// the src editor is frozen below the line input and only its center column changes,
+// so only that is drawn again into the background, and refreshed along with the line input
+void src_edr_search_typed( SMode *pBase, int phase, ModalWindow *pWin, wxDC &DC ) {
+  if( phase == PH_NOTIFY ) {
+    SModeSrcEdr *pSrcEdr = pBase->sExt.pSrcEdr;
+    if( pSrcEdr->pCodeBase != NULL ) {
+      STxtLine *pQuery = pSrcEdr->pLineInp->sExt.pLineInput->get_typed();
+      src_edr_end_scan( pWin );
+      pSrcEdr->pTyped->set_query( pQuery->szBuf );
+      tl_free( pQuery );
+      wxRect rect( pSrcEdr->colMidStart, 0, pSrcEdr->colRightStart - pSrcEdr->colMidStart, pBase->scrnH );
+      pWin->m_pModeManager->redraw_bg( pWin, rect );
+      pWin->RefreshRect( rect, true );
+    }
+    pWin->m_bUsrActn = false;
+    line_input_disp_update( pSrcEdr->pLineInp, PH_NOTIFY, pWin, DC );
+  }
+}
 // intent handler for INPUT_CODEFILE
 // user wants to load a codefile into the src edr
 // gets the codefile path from pLineInput
@@ -8871,17 +15574,39 @@ void src_edr_input_codefile(SMode* pBase, int phase, ModalWindow* pWin, wxDC& DC
     strCodeFilePath = wxString( pSrcEdr->pFileSel->sExt.pFileSel->pFilePath->szBuf );
     pSrcEdr->pFileSel->sExt.pFileSel->bInputRcvd = false;
   }
-  if( strCodeFilePath.Matches("*.cpp") ) {
+  // a scan's lines point into the codebase, so it's ended first
+  src_edr_end_scan(pWin);
+  // the codebase already loaded from this file only needs to catch up with it
+  // the journal can't replay onto the refreshed codebase, so it's snapshotted
+  if (pSrcEdr->pCodeBase != NULL && pSrcEdr->pCodeBase->pSrcPath != NULL && strCodeFilePath == wxString(pSrcEdr->pCodeBase->pSrcPath->szBuf)) {
+    if (src_edr_refresh_source(pSrcEdr)) {
+      pWin->m_pModeManager->stateEpoch++;
+      src_edr_start_index(pBase, pWin);
+      // let a running autosave finish first
+      if (pWin->m_pSaveThread != NULL) {
+        modal_autosave_done(pWin->m_pSaveThread, pWin->m_pModeManager);
+        pWin->m_pSaveThread = NULL;
+      }
+      SBufFile* pImage = modal_snapshot(pWin->m_pModeManager);
+      if (pImage != NULL) {
+        save_snapshot(pImage);
+        free_buf_file(pImage);
+      }
+    }
+  }
+  else if( strCodeFilePath.Matches("*.cpp") ) {
     SCodeBase* pCodeBase = new_codebase();
-    if (pCodeBase->load_codefile(strCodeFilePath))
+    if (pCodeBase->load_codefile(strCodeFilePath)) {
       pSrcEdr->set_codebase(pCodeBase);
+      src_edr_start_index(pBase, pWin);
+    }
     else {
       free_codebase(pCodeBase);
       pBase->bCtrlDown = false; // so this mode is not confused on return
       wxDir Dir(wxStandardPaths::Get().GetDocumentsDir());
       wxString strDir = Dir.GetNameWithSep();
       STxtLine* pCodeFilePath = new_txt_line_wx(strDir);
-      pSrcEdr->pFileSel->sExt.pFileSel->set_caller(pBase, SEI_INPUT_CODEFILE, pCodeFilePath );
+      pSrcEdr->pFileSel->sExt.pFileSel->set_caller(pBase, SEI_INPUT_CODEFILE, pCodeFilePath, pWin );
       tl_free(pCodeFilePath);
       pCodeFilePath = NULL;    
       pWin->m_pModeManager->push(pSrcEdr->pFileSel);
@@ -8892,7 +15617,7 @@ void src_edr_input_codefile(SMode* pBase, int phase, ModalWindow* pWin, wxDC& DC
     wxDir Dir(wxStandardPaths::Get().GetDocumentsDir());
     wxString strDir = Dir.GetNameWithSep();
     STxtLine* pCodeFilePath = new_txt_line_wx(strDir);
-    pSrcEdr->pFileSel->sExt.pFileSel->set_caller(pBase, SEI_INPUT_CODEFILE, pCodeFilePath );
+    pSrcEdr->pFileSel->sExt.pFileSel->set_caller(pBase, SEI_INPUT_CODEFILE, pCodeFilePath, pWin );
     tl_free(pCodeFilePath);
     pCodeFilePath = NULL;    
     pWin->m_pModeManager->push(pSrcEdr->pFileSel);
@@ -8972,7 +15697,9 @@ void src_edr_scroll( SMode *pBase, bool bUp, bool bPageLine, ModalWindow *pWin )
   }
   pWin->m_bUsrActn = false;
   pWin->Refresh( true );
-  pWin->Update();
+  // a coalesced batch is painted once by the mode manager
+  if( !pWin->m_bCoalescing )
+    pWin->Update();
 }
 // free's a mode of any type
 // if you extend UModeExt, you must add your new ModeExt type to be freed here
@@ -8996,6 +15723,15 @@ void free_mode(SMode* pThis) {
   case MODE_SOURCE_EDITOR:
     free_src_edr(pThis);
     break;
+  case MODE_LATENCY_STATS:
+    free_lat_stats(pThis);
+    break;
+  case MODE_DIAGNOSTICS:
+    free_diags(pThis);
+    break;
+  case MODE_SEARCH:
+    free_search(pThis);
+    break;
   case MODE_BASE:
     free(pThis);
     break;
@@ -9005,7 +15741,7 @@ void free_mode(SMode* pThis) {
   }
 };
 // loads a serialized mode from a file
-SMode *load_mode( int scrnW, int scrnH, wxFile &File ) {
+SMode *load_mode( int scrnW, int scrnH, SBufFile &File ) {
   SMode *pMode = (SMode *) malloc( sizeof(SMode) );
   if (pMode != NULL) {
     pMode->init(scrnW, scrnH, NULL);
@@ -9015,7 +15751,11 @@ SMode *load_mode( int scrnW, int scrnH, wxFile &File ) {
         pMode->sExt.pSrcEdr = (SModeSrcEdr*)malloc(sizeof(SModeSrcEdr));
         if (pMode->sExt.pSrcEdr != NULL) {
           pMode->sExt.pSrcEdr->init(pMode);
-          pMode->fnSerialize(pMode, File, false);
+          // the mode can't be used without its state, discard it
+          if (!pMode->fnSerialize(pMode, File, false)) {
+            free_mode(pMode);
+            pMode = NULL;
+          }
         }
       }
       break;
@@ -9042,11 +15782,11 @@ SModeManager * load_UI_state( int scrnW, int scrnH, wxFont *pFont ) {
   pModeManager->push( pMode );
   return( pModeManager );
 }
-// initilize this Modal app
-// it is called by the constructor of ModalWindow
-SModeManager * modal_init( int scrnWidth, int scrnHeight ) {
-  SModeManager *pModeManager = NULL;
-
+// Ancillary fn.
+// creates the font used by all the modes
+// called by modal_init() and render_bench()
+// caller has to delete
+wxFont * new_default_font() {
   // we assume all users have the Helvetica font on their systems
   // we check if they dont and use a portable wxWidgets font instead
   // A note on fontsize.
@@ -9060,36 +15800,408 @@ SModeManager * modal_init( int scrnWidth, int scrnHeight ) {
   bool bIsOK = pFont->IsOk();
   if (!bIsOK) 
     pFont = new wxFont(wxFontInfo(10.0).Family(wxFONTFAMILY_SWISS).Weight(10) );
+  return( pFont );
+}
+// takes a snapshot of the session into an image in memory
+// begins a new snapshot generation so the journal from here on goes with the snapshot
+// returns the image (caller has to save and free it) or NULL if the session can't be serialized
+// with bShared the image shares the buffers of the lines (see SBufFile::WriteShared()),
+// so it costs a walk of the code tree and no copy of its text, it's then freed with free_snapshot()
+SBufFile *modal_snapshot( SModeManager *pModeManager, bool bShared ) {
+  SBufFile *pImage = new_buf_file();
+  pModeManager->begin_snapshot();
+  pImage->begin_image();
+  if( bShared )
+    pImage->shareEpoch = LineShares.begin();
+  if( !pModeManager->serialize( *pImage, true ) || pImage->bError ) {
+    free_snapshot( pImage );
+    pImage = NULL;
+  }
+  return( pImage );
+}
+// writes a snapshot image to State.hxp.tmp which then replaces State.hxp
+// so a crash mid-write never leaves a torn State.hxp behind
+// once the snapshot is in place, the journal of the previous one is dropped
+// touches nothing but files so it is called from an AutosaveThread too
+// returns false if the snapshot could not be saved, State.hxp is then left as it was
+bool save_snapshot( SBufFile *pImage ) {
+  bool bRetVal = pImage->save_image( "State.hxp.tmp" );
+  bRetVal = bRetVal && wxRenameFile( "State.hxp.tmp", "State.hxp", true );
+  if( bRetVal )
+    wxRemoveFile( JOURNAL_OLD_FILE );
+  else
+    wxRemoveFile( "State.hxp.tmp" );
+  return( bRetVal );
+}
+// frees a snapshot image, ending its share of the lines' buffers if it has one
+// called on the main thread, once the image is saved
+void free_snapshot( SBufFile *pImage ) {
+  if( pImage->shareEpoch != 0 )
+    LineShares.end( pImage->shareEpoch );
+  free_buf_file( pImage );
+}
+// A worker thread that saves an autosave snapshot
+// the image shares the buffers of the lines, which are copied into it, deflated and written here
+// it sends its window an ID_AUTOSAVE_DONE event when it's done
+// the window then calls modal_autosave_done(), which frees the image and reports a failure
+class AutosaveThread : public wxThread {
+public:
+  AutosaveThread( SBufFile *pImage, ModalWindow *pWin, long stateEpoch ) : wxThread( wxTHREAD_JOINABLE ) {
+    m_pImage = pImage;
+    m_pWin = pWin;
+    m_stateEpoch = stateEpoch;
+    m_bSaved = false;
+  };
+  virtual ExitCode Entry() {
+    m_bSaved = save_snapshot( m_pImage );
+    wxQueueEvent( m_pWin, new wxThreadEvent( wxEVT_THREAD, ID_AUTOSAVE_DONE ) );
+    return( 0 );
+  };
+  SBufFile *m_pImage;
+  ModalWindow *m_pWin;
+  long m_stateEpoch; // the mode manager's stateEpoch when the snapshot was taken
+  bool m_bSaved;
+};
+// autosaves the session, called by ModalWindow when the user is idle
+// edits and navigation are journaled as they happen,
+// so the session is only snapshotted when the journal needs compacting
+// and something has changed since the last autosave
+// the snapshot is taken here, sharing the lines' buffers, so it's consistent and copies no text,
+// an AutosaveThread copies the text in and writes it out
+// if the thread can't be started the snapshot is saved here
+// returns the running thread (the caller has to reap it with modal_autosave_done())
+// or NULL if there is none
+wxThread *modal_autosave( SModeManager *pModeManager, ModalWindow *pWin ) {
+  AutosaveThread *pThread = NULL;
+  bool bChanged = pModeManager->stateEpoch != pModeManager->savedEpoch;
+  if( bChanged && pModeManager->pJournal->needs_compaction() ) {
+    bool bSaved = false;
+    SBufFile *pImage = modal_snapshot( pModeManager, true );
+    if( pImage != NULL ) {
+      pThread = new AutosaveThread( pImage, pWin, pModeManager->stateEpoch );
+      if( pThread->Create() != wxTHREAD_NO_ERROR || pThread->Run() != wxTHREAD_NO_ERROR ) {
+        delete pThread;
+        pThread = NULL;
+        bSaved = save_snapshot( pImage );
+        free_snapshot( pImage );
+      }
+    }
+    if( bSaved )
+      pModeManager->savedEpoch = pModeManager->stateEpoch;
+    else if( pThread == NULL )
+      wxLogError( "the session could not be autosaved" );
+  }
+  return( pThread );
+}
+// reaps an AutosaveThread once it is done
+// the session counts as saved only if the snapshot got to disk, else the next autosave tries again
+void modal_autosave_done( wxThread *pThread, SModeManager *pModeManager ) {
+  AutosaveThread *pSave = (AutosaveThread *) pThread;
+  pSave->Wait();
+  if( pSave->m_bSaved )
+    pModeManager->savedEpoch = pSave->m_stateEpoch;
+  else
+    wxLogError( "the session could not be autosaved" );
+  free_snapshot( pSave->m_pImage );
+  delete pSave;
+}
+// initilize this Modal app
+// it is called by the constructor of ModalWindow
+SModeManager * modal_init( int scrnWidth, int scrnHeight ) {
+  SModeManager *pModeManager = NULL;
+  wxFont *pFont = new_default_font();
+  bool bRestored = false;
 
-  wxFile File;
-  if( wxFile::Exists("State.hxp") ) {
-    File.Open("State.hxp");
+  SBufFile *pFile = new_buf_file();
+  // restore the saved session
+  // old-format files are read as is and saved in the current format on exit
+  if( wxFile::Exists("State.hxp") && pFile->open("State.hxp") ) {
     pModeManager = new_mode_manager( scrnWidth, scrnHeight, pFont );
-    pModeManager->serialize( File, false );
-    File.Close();
+    bRestored = pModeManager->serialize( *pFile, false );
+    // the session could not be restored, start afresh
+    if( !bRestored ) {
+      wxLogError( "State.hxp could not be restored" );
+      free_mode_manager( pModeManager );
+      pModeManager = load_UI_state(scrnWidth, scrnHeight, new_default_font());
+    }
+    pFile->close();
   }
   else 
     pModeManager = load_UI_state(scrnWidth, scrnHeight, pFont);
+  free_buf_file( pFile );
+  // replay the changes journaled since the snapshot
+  // then bring the modes up to date, e.g. with source files changed on disk
+  // and fold the changes into a fresh snapshot, which also begins a fresh journal
+  // otherwise begin a fresh journal for the snapshot
+  bool bChanged = false;
+  if( bRestored ) {
+    bChanged = pModeManager->replay_journal() > 0;
+    bChanged |= pModeManager->resume();
+  }
+  if( bChanged ) {
+    SBufFile *pImage = modal_snapshot( pModeManager );
+    if( pImage != NULL ) {
+      save_snapshot( pImage );
+      free_buf_file( pImage );
+    }
+  }
+  else
+    pModeManager->pJournal->create( pModeManager->snapGen );
   
   return( pModeManager );
 }
 // exit a Modal app
 // last function to be called before app exits
-// serializes the mode manager to a file
+// serializes the mode manager to a snapshot
+// which makes the journal redundant, it is removed
+// if serialization failed, the last saved snapshot and its journals are kept
 void modal_exit( SModeManager *pModeManager ) {
-  wxFile File;
- 
-  File.Create("State.hxp", true);
-  // serialize state to the file
-  if( File.IsOpened() ) {
-    if (pModeManager->serialize(File, true))
-      File.Close();
-    // if serialization failed, close and remove file
-    else {
-      File.Close();
-      wxRemoveFile("./State.hxp");
+  SBufFile *pImage = modal_snapshot( pModeManager );
+  if( pImage != NULL ) {
+    if( save_snapshot( pImage ) ) {
+      pModeManager->pJournal->close();
+      wxRemoveFile( JOURNAL_FILE );
     }
+    free_buf_file( pImage );
   }
+  // dump the latency stats of this session
+  pModeManager->pTracer->dump( "Latency.txt" );
   free_mode_manager( pModeManager );
   return;
 }
+// SUBBLOCK: HEADLESS RENDER BENCHMARK
+// Compiled in only when building with -DMODAL_BENCH.
+// MyApp::OnInit() then calls render_bench() and exits without opening a window
+// so that rendering regressions can be caught in CI (e.g. under Xvfb).
+// usage: EngageWX <codefile> [--frames N] [--size WxH] [--scale S] [--compress L]
+// The codefile is loaded into a source editor which renders N frames
+// of each scripted scenario into a wxMemoryDC of the given screen size.
+// For each scenario the min, mean and max frame time in usec are printed
+// along with the number of get_element_at() and GetTextExtent() calls per frame.
+// Then the session is saved and restored, with its large chunks stored as is
+// and deflated at zlib level L (default HXP_COMPRESS_LEVEL),
+// and the time, syscalls and size of the file are printed.
+#ifdef MODAL_BENCH
+// the scripted scenarios
+enum {
+  // top of the file in its default summarization
+  BENCH_TOP=0,
+  // scrolled to the end of the file
+  BENCH_END,
+  // gotos to the symbols used on screen, through the collapse and expand of src_edr_goto_symbol()
+  BENCH_GOTO_STORM,
+  // all sections expanded, paging through the file
+  BENCH_EXPANDED,
+  BENCH_SCENARIOS
+};
+// ancillary fn
+// recursively unsummarizes a section and all it's sub-sections
+void bench_expand_all( SCodeSection *pSec ) {
+  pSec->bSummarized = false;
+  for( int i=0; i<pSec->numElements; i++ )
+    if( !pSec->ppElements[i]->bSingle )
+      bench_expand_all( pSec->ppElements[i]->pSec );
+}
+// ancillary fn
+// checks if an element is in a function's body
+// get_requested_element() walks up to the enclosing function, so only such lines are tried
+bool bench_in_func( SCodeElement *pElem ) {
+  SCodeSection *pThis = pElem->pContainer;
+  while( pThis != NULL && pThis->pBaseElem->type != CDE_FNDEFN && pThis->pBaseElem->type != CDE_CLASS_FNDEFN )
+    pThis = pThis->pBaseElem->pContainer;
+  return( pThis != NULL );
+}
+// ancillary fn
+// goes to a symbol used on screen, as a ctrl+right on it would (see src_edr_goto())
+// the lines are tried from a random one on, and the words in a line from it's start
+// returns false if no line on screen uses a symbol that can be gone to
+bool bench_goto_symbol( SModeSrcEdr *pSrcEdr, SJournal *pJournal, unsigned int *pSeed ) {
+  bool bRetVal = false;
+  *pSeed = *pSeed * 1103515245 + 12345;
+  int firstLine = (*pSeed >> 8) % pSrcEdr->dispLines;
+  for( int i=0; i<pSrcEdr->dispLines && !bRetVal; i++ ) {
+    int lineOffset = 0;
+    int caretY = (firstLine + i) % pSrcEdr->dispLines;
+    SCodeElement *pElem = pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, caretY, &lineOffset );
+    // past the end of the file get_element_at() returns the last element again
+    if( caretY > 0 && pElem == pSrcEdr->pCodeBase->pBaseSec->get_element_at( pSrcEdr->fileOffset, caretY-1, &lineOffset ) )
+      continue;
+    if( !bench_in_func( pElem ) )
+      continue;
+    STxtLine *pLine = pElem->pLine;
+    for( int x=0; x<pLine->length && !bRetVal; x++ ) {
+      // try each word once, at it's first char
+      if( !isalpha( pLine->szBuf[x] ) && pLine->szBuf[x] != '_' )
+        continue;
+      if( x > 0 && ( isalnum( pLine->szBuf[x-1] ) || pLine->szBuf[x-1] == '_' ) )
+        continue;
+      pSrcEdr->Caret.y = caretY;
+      pSrcEdr->Caret.x = x;
+      SLocation *pLocation = src_edr_goto_symbol( pSrcEdr, pElem, pJournal );
+      bRetVal = pLocation != NULL && pLocation->pCodeBaseLoc != NULL;
+    }
+  }
+  return( bRetVal );
+}
+// runs the benchmark with the given command line arguments
+// returns false if the arguments are bad or the codefile can't be loaded
+bool render_bench( const wxArrayString& Args ) {
+  bool bRetVal = false;
+  const char* aszScenario[BENCH_SCENARIOS] = { "top", "end", "goto-storm", "expanded" };
+  wxString strCodeFile;
+  long numFrames = 100;
+  long scrnW = 1920;
+  long scrnH = 1080;
+  double dScale = 1.0;
+  long compressLevel = HXP_COMPRESS_LEVEL;
+  bool bArgsOK = true;
+  // parse the command line
+  for( int i=1; i<(int)Args.GetCount() && bArgsOK; i++ ) {
+    if( Args[i] == "--frames" && i+1 < (int)Args.GetCount() )
+      bArgsOK = Args[++i].ToLong( &numFrames ) && numFrames > 0;
+    else if( Args[i] == "--size" && i+1 < (int)Args.GetCount() ) {
+      i++;
+      bArgsOK = Args[i].BeforeFirst('x').ToLong( &scrnW ) && Args[i].AfterFirst('x').ToLong( &scrnH );
+      bArgsOK = bArgsOK && scrnW > 0 && scrnH > 0;
+    }
+    else if( Args[i] == "--scale" && i+1 < (int)Args.GetCount() )
+      bArgsOK = Args[++i].ToDouble( &dScale ) && dScale > 0.0;
+    else if( Args[i] == "--compress" && i+1 < (int)Args.GetCount() )
+      bArgsOK = Args[++i].ToLong( &compressLevel ) && compressLevel >= 1 && compressLevel <= 9;
+    else
+      strCodeFile = Args[i];
+  }
+  SCodeBase *pCodeBase = NULL;
+  if( bArgsOK && !strCodeFile.IsEmpty() )
+    pCodeBase = new_codebase();
+  else
+    wxPrintf( "usage: EngageWX <codefile> [--frames N] [--size WxH] [--scale S] [--compress L]\n" );
+  // load the codefile before the src editor is pushed
+  // so it's on_load does not ask for one
+  // the time to read it alone is reported apart from the time to load (read and parse) it
+  if( pCodeBase != NULL ) {
+    wxStopWatch LoadClock;
+    STxtPage *pPage = read_codefile( strCodeFile );
+    long tRead = LoadClock.Time();
+    free_txt_page( pPage );
+    LoadClock.Start();
+    if( pPage != NULL && pCodeBase->load_codefile( strCodeFile ) )
+      wxPrintf( "load: read %ld ms, read and parse %ld ms\n", tRead, LoadClock.Time() );
+    else {
+      wxPrintf( "could not load %s\n", (const char*)strCodeFile.mb_str() );
+      free_codebase( pCodeBase );
+      pCodeBase = NULL;
+    }
+  }
+  if( pCodeBase != NULL ) {
+    wxFont *pFont = new_default_font();
+    SModeManager *pModeManager = new_mode_manager( scrnW, scrnH, pFont );
+    SMode *pMode = new_src_edr( scrnW, scrnH, pFont );
+    SModeSrcEdr *pSrcEdr = pMode->sExt.pSrcEdr;
+    pSrcEdr->set_codebase( pCodeBase );
+    pModeManager->push( pMode );
+    if( dScale != 1.0 )
+      pMode->adjust_font_scale( dScale );
+    wxBitmap Bitmap( scrnW, scrnH );
+    wxMemoryDC DC( Bitmap );
+    wxStopWatch Clock;
+    unsigned int seed = 1;
+    // render a frame to compute the display params
+    pModeManager->disp_stack( NULL, DC, false, NULL );
+    int numGotos = 0;
+    wxPrintf( "%s %ldx%ld scale %.2f, %ld frames per scenario\n", (const char*)strCodeFile.mb_str(), scrnW, scrnH, dScale, numFrames );
+    wxPrintf( "%-12s %10s %10s %10s %14s %14s\n", "scenario", "min us", "mean us", "max us", "elem_at/frame", "extent/frame" );
+    for( int s=0; s<BENCH_SCENARIOS; s++ ) {
+      long long tMin = -1;
+      long long tMax = 0;
+      long long tTotal = 0;
+      long long numElemAt = 0;
+      long long numTxtExtent = 0;
+      pSrcEdr->fileOffset = 0;
+      pSrcEdr->Caret.x = 0;
+      pSrcEdr->Caret.y = 0;
+      if( s == BENCH_EXPANDED )
+        bench_expand_all( pCodeBase->pBaseSec );
+      for( int f=0; f<numFrames; f++ ) {
+        int fileLength = pCodeBase->pBaseSec->get_length();
+        if( fileLength < 1 )
+          fileLength = 1;
+        // script this frame
+        switch( s ) {
+          case BENCH_END:
+            // disp_state trims the offset back to the last screenful
+            pSrcEdr->fileOffset = fileLength;
+            pSrcEdr->Caret.y = 0;
+            break;
+          case BENCH_EXPANDED:
+            pSrcEdr->fileOffset = (f * pSrcEdr->dispLines) % fileLength;
+            break;
+          default:
+            break;
+        }
+        benchElemAtCalls = 0;
+        benchTxtExtentCalls = 0;
+        Clock.Start();
+        // the goto is timed with the frame it's rendered in
+        if( s == BENCH_GOTO_STORM && !bench_goto_symbol( pSrcEdr, pModeManager->pJournal, &seed ) ) {
+          // no symbol on screen, go back or start over at a random line
+          if( !src_edr_do_back_to( pSrcEdr ) ) {
+            seed = seed * 1103515245 + 12345;
+            src_edr_goto_location( pSrcEdr, (seed >> 8) % fileLength, pModeManager->pJournal );
+          }
+        }
+        else if( s == BENCH_GOTO_STORM )
+          numGotos++;
+        pModeManager->disp_stack( NULL, DC, false, NULL );
+        long long t = Clock.TimeInMicro().GetValue();
+        // the bench's journal is never opened, a commit only empties it's buffer
+        pModeManager->pJournal->commit();
+        numElemAt += benchElemAtCalls;
+        numTxtExtent += benchTxtExtentCalls;
+        tTotal += t;
+        if( tMin < 0 || t < tMin )
+          tMin = t;
+        if( t > tMax )
+          tMax = t;
+      }
+      wxPrintf( "%-12s %10lld %10lld %10lld %14lld %14lld\n", aszScenario[s], tMin, tTotal / numFrames, tMax, numElemAt / numFrames, numTxtExtent / numFrames );
+      if( s == BENCH_GOTO_STORM )
+        wxPrintf( "%-12s %d of %ld frames went to a symbol\n", "", numGotos, numFrames );
+    }
+    // save and restore the session through a buffered file
+    // the serializers' Write()/Read() calls are the syscalls an unbuffered wxFile would make
+    // once with the code tree and symbols stored as is and once deflated
+    int aLevel[2] = { 0, (int) compressLevel };
+    for( int l=0; l<2; l++ ) {
+      SBufFile *pFile = new_buf_file();
+      pFile->compressLevel = aLevel[l];
+      wxPrintf( "level %d\n", aLevel[l] );
+      if( pFile->create( "Bench.hxp" ) ) {
+        Clock.Start();
+        pModeManager->serialize( *pFile, true );
+        pFile->close();
+        long long tSave = Clock.TimeInMicro().GetValue();
+        wxPrintf( "save    %10lld us %10ld field writes %8ld syscalls\n", tSave, pFile->numCalls, pFile->numSyscalls );
+        if( pFile->open( "Bench.hxp" ) ) {
+          long long size = pFile->pFile->Length();
+          SModeManager *pRestored = new_mode_manager( scrnW, scrnH, new_default_font() );
+          Clock.Start();
+          pRestored->serialize( *pFile, false );
+          long long tRestore = Clock.TimeInMicro().GetValue();
+          pFile->close();
+          wxPrintf( "restore %10lld us %10ld field reads  %8ld syscalls\n", tRestore, pFile->numCalls, pFile->numSyscalls );
+          wxPrintf( "size    %10lld bytes\n", size );
+          free_mode_manager( pRestored );
+        }
+        wxRemoveFile( "Bench.hxp" );
+      }
+      free_buf_file( pFile );
+    }
+    DC.SelectObject( wxNullBitmap );
+    // frees the src editor, it's codebase and the font
+    free_mode_manager( pModeManager );
+    bRetVal = true;
+  }
+  return( bRetVal );
+}
+#endif